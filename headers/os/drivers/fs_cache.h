@@ -109,6 +109,9 @@ extern status_t entry_cache_add_missing(dev_t mountID, ino_t dirID,
 					const char* name);
 extern status_t entry_cache_remove(dev_t mountID, ino_t dirID,
 					const char* name);
+extern status_t entry_cache_add_complete_directory(dev_t mountID,
+					ino_t dirID, const char* const* names,
+					const ino_t* nodeIDs, int32 count);
 
 #ifdef __cplusplus
 }
@@ -90,6 +90,9 @@ typedef struct area_info {
 	/* "stack" protection is not available on most platforms - it's used
 	   to only commit memory as needed, and have guard pages at the
 	   bottom of the stack. */
+#define B_LARGE_PAGES			0x10000
+	/* hint that the area should be backed by large pages where possible,
+	   to reduce TLB misses; ignored on platforms that don't support them */
 
 extern area_id		create_area(const char *name, void **startAddress,
 						uint32 addressSpec, size_t size, uint32 lock,
@@ -645,6 +648,38 @@ extern ssize_t		wait_for_objects(object_wait_info* infos, int numInfos);
 extern ssize_t		wait_for_objects_etc(object_wait_info* infos, int numInfos,
 						uint32 flags, bigtime_t timeout);
 
+/* Event queues keep the objects they have been told to watch, so that waiting
+   for their events does not depend on the number of objects watched. An event
+   queue is a file descriptor, and is deleted by closing it.
+   event_queue_select() adds an object to the queue, or changes the events
+   it's watched for; with an events mask of 0, the object is removed again.
+   By default, an event is only reported once each time it occurs. The flags
+   below can be added to the events mask to change that. Objects that became
+   invalid are removed from the queue automatically, after B_EVENT_INVALID
+   has been reported for them.
+   event_queue_wait() returns the objects that had events, and sets the
+   event_wait_info::events field to the events that occurred. */
+
+enum {
+	B_EVENT_LEVEL_TRIGGERED		= 0x0400,	/* report the event for as long as
+											   the condition holds */
+	B_EVENT_ONE_SHOT			= 0x0800	/* remove the object after its
+											   first event */
+};
+
+typedef struct event_wait_info {
+	int32		object;						/* ID of the object */
+	uint16		type;						/* type of the object */
+	uint16		events;						/* events mask */
+	void*		user_data;					/* returned with the events */
+} event_wait_info;
+
+extern int			create_event_queue(uint32 openFlags);
+extern status_t		event_queue_select(int queue, event_wait_info* infos,
+						int numInfos);
+extern ssize_t		event_queue_wait(int queue, event_wait_info* infos,
+						int numInfos, uint32 flags, bigtime_t timeout);
+
 
 #ifdef __cplusplus
 }
@@ -78,6 +78,10 @@ public:
 										= NULL);
 			status_t			SetInstallPath(const char* installPath);
 			void				SetCheckLicenses(bool checkLicenses);
+			void				SetThreadCount(int32 threadCount);
+									// number of threads compressing the heap
+									// chunks, 0 means one per CPU; to be
+									// called before Init()
 			status_t			AddEntry(const char* fileName, int fd = -1);
 			status_t			Finish();
 
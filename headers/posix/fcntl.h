@@ -67,6 +67,14 @@
 #define AT_REMOVEDIR		0x04	/* unlinkat() */
 #define AT_EACCESS			0x08	/* faccessat() */
 
+/* advice for posix_fadvise() */
+#define POSIX_FADV_NORMAL		0	/* no particular access pattern */
+#define POSIX_FADV_RANDOM		1	/* random access */
+#define POSIX_FADV_SEQUENTIAL	2	/* sequential access */
+#define POSIX_FADV_WILLNEED		3	/* the data will be needed soon */
+#define POSIX_FADV_DONTNEED		4	/* the data won't be needed soon */
+#define POSIX_FADV_NOREUSE		5	/* the data will only be used once */
+
 /* advisory file locking */
 
 struct flock {
@@ -90,6 +98,8 @@ extern int	openat(int fd, const char *path, int openMode, ...);
 
 extern int	fcntl(int fd, int op, ...);
 
+extern int	posix_fadvise(int fd, off_t offset, off_t length, int advice);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,9 @@
 #define POSIX_MADV_WILLNEED		4
 #define POSIX_MADV_DONTNEED		5
 
+/* non-POSIX advice: the contents of the range may be discarded */
+#define MADV_FREE				6
+
 
 __BEGIN_DECLS
 
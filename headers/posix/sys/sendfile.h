@@ -0,0 +1,22 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+
+#include <sys/types.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ssize_t sendfile(int socket, int fd, off_t *offset, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SYS_SENDFILE_H */
@@ -874,6 +874,8 @@
 #define entry_cache_add					fssh_entry_cache_add
 #define entry_cache_add_missing			fssh_entry_cache_add_missing
 #define entry_cache_remove				fssh_entry_cache_remove
+#define entry_cache_add_complete_directory \
+	fssh_entry_cache_add_complete_directory
 
 ////////////////////////////////////////////////////////////////////////////////
 // #pragma mark - fssh_fs_index.h
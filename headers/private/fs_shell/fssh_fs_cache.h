@@ -132,6 +132,10 @@ extern fssh_status_t	fssh_entry_cache_add_missing(fssh_dev_t mountID,
 							fssh_ino_t dirID, const char* name);
 extern fssh_status_t	fssh_entry_cache_remove(fssh_dev_t mountID,
 							fssh_ino_t dirID, const char* name);
+extern fssh_status_t	fssh_entry_cache_add_complete_directory(
+							fssh_dev_t mountID, fssh_ino_t dirID,
+							const char* const* names,
+							const fssh_ino_t* nodeIDs, int32_t count);
 
 #ifdef __cplusplus
 }
@@ -21,8 +21,10 @@
 #include <util/FixedWidthPointer.h>
 
 
-#define CURRENT_KERNEL_ARGS_VERSION	2
+#define CURRENT_KERNEL_ARGS_VERSION	3
 #define MAX_KERNEL_ARGS_RANGE		20
+#define MAX_MEMORY_NODES			8
+#define MAX_MEMORY_NODE_RANGES		32
 
 // names of common boot_volume fields
 #define BOOT_METHOD						"boot method"
@@ -50,6 +52,11 @@ enum {
 #define MAX_PHYSICAL_FREE_RANGE		(MAX_PHYSICAL_ALLOCATED_RANGE * 3)
 #endif
 
+typedef struct memory_node_range {
+	addr_range	range;
+	uint32		node;
+} _PACKED memory_node_range;
+
 typedef struct kernel_args {
 	uint32		kernel_args_size;
 	uint32		version;
@@ -72,6 +79,15 @@ typedef struct kernel_args {
 	uint32		num_cpus;
 	addr_range	cpu_kstack[SMP_MAX_CPUS];
 
+	// memory locality (NUMA) information; num_memory_nodes is 0 unless the
+	// firmware told us about more than one node
+	uint32		num_memory_nodes;
+	uint32		num_memory_node_ranges;
+	memory_node_range memory_node_range[MAX_MEMORY_NODE_RANGES];
+	uint8		cpu_memory_node[SMP_MAX_CPUS];
+	uint8		memory_node_distance[MAX_MEMORY_NODES][MAX_MEMORY_NODES];
+		// relative distances as found in the ACPI SLIT, 10 means local
+
 	// boot volume KMessage data
 	FixedWidthPointer<void> boot_volume;
 	int32		boot_volume_size;
@@ -79,6 +79,7 @@ typedef struct cpu_ent {
 	// CPU topology information
 	int				topology_id[CPU_TOPOLOGY_LEVELS];
 	int				cache_id[CPU_MAX_CACHE_LEVEL];
+	int				memory_node;
 
 	// IRQs assigned to this CPU
 	struct list		irqs;
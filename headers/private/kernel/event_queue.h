@@ -0,0 +1,35 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_EVENT_QUEUE_H
+#define _KERNEL_EVENT_QUEUE_H
+
+
+#include <OS.h>
+
+
+struct select_info;
+struct select_sync;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+extern status_t	event_queue_notify(struct select_info* info, uint16 events);
+extern void		event_queue_free_sync(struct select_sync* sync);
+
+extern int		_user_create_event_queue(uint32 openFlags);
+extern status_t	_user_event_queue_select(int queue, event_wait_info* userInfos,
+					int numInfos);
+extern ssize_t	_user_event_queue_wait(int queue, event_wait_info* userInfos,
+					int numInfos, uint32 flags, bigtime_t timeout);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _KERNEL_EVENT_QUEUE_H
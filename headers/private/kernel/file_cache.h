@@ -23,6 +23,13 @@
 #define FILE_CACHE_LOADED_COMPLETELY	0x02
 #define FILE_CACHE_NO_IO				0x04
 
+struct file_cache_mapping {
+	void*	address;
+	size_t	length;
+	void*	cookie;
+		// to be passed to file_cache_unmap_page()
+};
+
 struct cache_module_info {
 	module_info	info;
 
@@ -45,6 +52,13 @@ extern void cache_node_launched(size_t argCount, char * const *args);
 extern void cache_prefetch_vnode(struct vnode *vnode, off_t offset, size_t size);
 extern void cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size);
 
+extern status_t file_cache_map_pages(struct vnode *vnode, void *cookie,
+				off_t offset, size_t size, struct file_cache_mapping *mappings,
+				uint32 *_count);
+extern void file_cache_unmap_page(void *cookie);
+extern status_t file_cache_advise(VMCache *cache, off_t offset, off_t length,
+				int advice);
+
 extern status_t file_map_init(void);
 extern status_t file_cache_init_post_boot_device(void);
 extern status_t file_cache_init(void);
@@ -67,7 +67,8 @@ enum fd_types {
 	FDTYPE_INDEX,
 	FDTYPE_INDEX_DIR,
 	FDTYPE_QUERY,
-	FDTYPE_SOCKET
+	FDTYPE_SOCKET,
+	FDTYPE_EVENT_QUEUE
 };
 
 // additional open mode - kernel special
@@ -88,6 +89,7 @@ extern void inc_fd_ref_count(struct file_descriptor *descriptor);
 extern int dup_foreign_fd(team_id fromTeam, int fd, bool kernel);
 extern status_t select_fd(int32 fd, struct select_info *info, bool kernel);
 extern status_t deselect_fd(int32 fd, struct select_info *info, bool kernel);
+extern void deselect_all_fds(struct io_context *context);
 extern bool fd_is_valid(int fd, bool kernel);
 extern struct vnode *fd_vnode(struct file_descriptor *descriptor);
 
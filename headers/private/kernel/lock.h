@@ -22,9 +22,10 @@ typedef struct mutex {
 	const char*				name;
 	struct mutex_waiter*	waiters;
 	spinlock				lock;
-#if KDEBUG
 	thread_id				holder;
-#else
+								// Without KDEBUG, this is only a hint for
+								// the threads that spin on the lock.
+#if !KDEBUG
 	int32					count;
 	uint16					ignore_unlock_count;
 #endif
@@ -98,7 +99,7 @@ typedef struct rw_lock {
 #	define RECURSIVE_LOCK_INITIALIZER(name)	{ MUTEX_INITIALIZER(name), 0 }
 #else
 #	define MUTEX_INITIALIZER(name) \
-	{ name, NULL, B_SPINLOCK_INITIALIZER, 0, 0, 0 }
+	{ name, NULL, B_SPINLOCK_INITIALIZER, -1, 0, 0, 0 }
 #	define RECURSIVE_LOCK_INITIALIZER(name)	{ MUTEX_INITIALIZER(name), -1, 0 }
 #endif
 
@@ -219,6 +220,7 @@ mutex_lock(mutex* lock)
 #else
 	if (atomic_add(&lock->count, -1) < 0)
 		return _mutex_lock(lock, NULL);
+	lock->holder = find_thread(NULL);
 	return B_OK;
 #endif
 }
@@ -232,6 +234,7 @@ mutex_trylock(mutex* lock)
 #else
 	if (atomic_test_and_set(&lock->count, -1, 0) != 0)
 		return B_WOULD_BLOCK;
+	lock->holder = find_thread(NULL);
 	return B_OK;
 #endif
 }
@@ -245,6 +248,7 @@ mutex_lock_with_timeout(mutex* lock, uint32 timeoutFlags, bigtime_t timeout)
 #else
 	if (atomic_add(&lock->count, -1) < 0)
 		return _mutex_lock_with_timeout(lock, timeoutFlags, timeout);
+	lock->holder = find_thread(NULL);
 	return B_OK;
 #endif
 }
@@ -254,6 +258,7 @@ static inline void
 mutex_unlock(mutex* lock)
 {
 #if !KDEBUG
+	lock->holder = -1;
 	if (atomic_add(&lock->count, 1) < -1)
 #endif
 		_mutex_unlock(lock);
@@ -263,9 +268,7 @@ mutex_unlock(mutex* lock)
 static inline void
 mutex_transfer_lock(mutex* lock, thread_id thread)
 {
-#if KDEBUG
 	lock->holder = thread;
-#endif
 }
 
 
@@ -284,6 +287,7 @@ recursive_lock_transfer_lock(recursive_lock* lock, thread_id thread)
 
 
 extern void lock_debug_init();
+extern status_t lock_init_post_generic_syscalls();
 
 #ifdef __cplusplus
 }
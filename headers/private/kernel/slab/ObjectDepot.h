@@ -12,16 +12,19 @@
 
 
 struct DepotMagazine;
+struct object_cache_stats;
 
 typedef struct object_depot {
-	rw_lock					outer_lock;
 	spinlock				inner_lock;
 	DepotMagazine*			full;
 	DepotMagazine*			empty;
 	size_t					full_count;
 	size_t					empty_count;
 	size_t					max_count;
+	size_t					min_max_count;
+	size_t					recent_misses;
 	size_t					magazine_capacity;
+	uint64					contention_count;
 	struct depot_cpu_store*	stores;
 	void*					cookie;
 
@@ -45,6 +48,9 @@ void object_depot_store(object_depot* depot, void* object, uint32 flags);
 
 void object_depot_make_empty(object_depot* depot, uint32 flags);
 
+void object_depot_get_stats(object_depot* depot,
+	struct object_cache_stats* stats);
+
 #if PARANOID_KERNEL_FREE
 bool object_depot_contains_object(object_depot* depot, void* object);
 #endif
@@ -33,6 +33,8 @@ enum {
 struct ObjectCache;
 typedef struct ObjectCache object_cache;
 
+struct object_cache_stats;
+
 typedef status_t (*object_cache_constructor)(void* cookie, void* object);
 typedef void (*object_cache_destructor)(void* cookie, void* object);
 typedef void (*object_cache_reclaimer)(void* cookie, int32 level);
@@ -64,6 +66,10 @@ status_t object_cache_reserve(object_cache* cache, size_t object_count,
 
 void object_cache_get_usage(object_cache* cache, size_t* _allocatedMemory);
 
+/* syscalls */
+status_t _user_get_object_cache_stats(struct object_cache_stats* stats,
+	uint32* _count);
+
 #ifdef __cplusplus
 }
 #endif
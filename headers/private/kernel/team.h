@@ -85,6 +85,7 @@ status_t _user_get_team_usage_info(team_id team, int32 who,
 			team_usage_info *info, size_t size);
 status_t _user_get_extended_team_info(team_id teamID, uint32 flags,
 			void* buffer, size_t size, size_t* _sizeNeeded);
+status_t _user_set_team_io_priority(team_id team, int32 priority);
 
 #ifdef __cplusplus
 }
@@ -234,6 +234,8 @@ struct Team : TeamThreadIteratorEntry<team_id>, KernelReferenceable,
 	int				num_threads;	// number of threads in this team
 	int				state;			// current team state, see above
 	int32			flags;
+	int32			io_priority;	// I/O priority hint for the team's
+									// threads, -1 if none; protected by fLock
 	struct io_context *io_context;
 	struct realtime_sem_context	*realtime_sem_context;
 	struct xsi_sem_context *xsi_sem_context;
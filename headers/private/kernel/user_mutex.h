@@ -9,11 +9,16 @@
 #include <SupportDefs.h>
 
 
+struct lock_contention_stats;
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void		user_mutex_init();
+void		user_mutex_get_contention_stats(
+				struct lock_contention_stats* stats);
 
 status_t	_user_mutex_lock(int32* mutex, const char* name, uint32 flags,
 				bigtime_t timeout);
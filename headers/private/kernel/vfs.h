@@ -25,7 +25,7 @@
 
 
 #define DEFAULT_FD_TABLE_SIZE	256
-#define MAX_FD_TABLE_SIZE		8192
+#define MAX_FD_TABLE_SIZE		65536
 #define DEFAULT_NODE_MONITORS	4096
 #define MAX_NODE_MONITORS		65536
 
@@ -129,6 +129,10 @@ status_t	vfs_disconnect_vnode(dev_t mountID, ino_t vnodeID);
 status_t	vfs_resolve_parent(struct vnode* parent, dev_t* device,
 				ino_t* node);
 void		vfs_free_unused_vnodes(int32 level);
+void		vfs_entry_created(dev_t mountID, ino_t directoryID,
+				const char *name);
+void		vfs_entry_removed(dev_t mountID, ino_t directoryID,
+				const char *name, ino_t nodeID);
 
 status_t	vfs_read_stat(int fd, const char *path, bool traverseLeafLink,
 				struct stat *stat, bool kernel);
@@ -182,6 +186,7 @@ int			_user_open_dir(int fd, const char *path);
 int			_user_open_parent_dir(int fd, char *name, size_t nameLength);
 status_t	_user_fcntl(int fd, int op, size_t argument);
 status_t	_user_fsync(int fd);
+status_t	_user_file_advice(int fd, off_t offset, off_t length, int advice);
 status_t	_user_flock(int fd, int op);
 status_t	_user_read_stat(int fd, const char *path, bool traverseLink,
 				struct stat *stat, size_t statSize);
@@ -268,6 +273,7 @@ ssize_t		_user_send(int socket, const void *data, size_t length, int flags);
 ssize_t		_user_sendto(int socket, const void *data, size_t length, int flags,
 				const struct sockaddr *address, socklen_t addressLength);
 ssize_t		_user_sendmsg(int socket, const struct msghdr *message, int flags);
+ssize_t		_user_sendfile(int socket, int fd, off_t *pos, size_t count);
 status_t	_user_getsockopt(int socket, int level, int option, void *value,
 				socklen_t *_length);
 status_t	_user_setsockopt(int socket, int level, int option,
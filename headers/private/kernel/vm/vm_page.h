@@ -65,6 +65,8 @@ struct vm_page *vm_page_allocate_page(vm_page_reservation* reservation,
 	uint32 flags);
 struct vm_page *vm_page_allocate_page_run(uint32 flags, page_num_t length,
 	const physical_address_restrictions* restrictions, int priority);
+struct vm_page *vm_page_allocate_large_page(uint32 flags, page_num_t length,
+	int priority);
 struct vm_page *vm_page_at_index(int32 index);
 struct vm_page *vm_lookup_page(page_num_t pageNumber);
 bool vm_page_is_dummy(struct vm_page *page);
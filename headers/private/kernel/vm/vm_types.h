@@ -151,7 +151,8 @@ public:
 		// used in VMAnonymousCache::Merge()
 	bool					accessed : 1;
 	bool					modified : 1;
-	uint8					unused : 1;
+	bool					cpu_cached : 1;
+		// free page sitting in a per-CPU page cache
 
 	uint8					usage_count;
 
@@ -210,6 +211,7 @@ vm_page::Init(page_num_t pageNumber)
 	fWiredCount = 0;
 	usage_count = 0;
 	busy_writing = false;
+	cpu_cached = false;
 	SetCacheRef(NULL);
 	#if DEBUG_PAGE_QUEUE
 		queue = NULL;
@@ -12,6 +12,7 @@
 
 
 struct select_sync;
+struct EventQueue;
 
 
 typedef struct select_info {
@@ -26,6 +27,9 @@ typedef struct select_sync {
 	sem_id				sem;
 	uint32				count;
 	struct select_info*	set;
+	struct EventQueue*	queue;
+		// if set, the events are delivered to this event queue, and the
+		// sync object belongs to one of its entries
 } select_sync;
 
 #define SELECT_FLAG(type) (1L << (type - 1))
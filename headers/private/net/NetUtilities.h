@@ -76,6 +76,9 @@ public:
 	static uint16 PseudoHeader(net_address_module_info* addressModule,
 		net_buffer_module_info* bufferModule, net_buffer* buffer,
 		uint16 protocol);
+	static uint16 PartialPseudoHeader(
+		net_address_module_info* addressModule, net_buffer* buffer,
+		uint16 protocol);
 
 private:
 	uint32 fSum;
@@ -95,6 +98,21 @@ Checksum::PseudoHeader(net_address_module_info* addressModule,
 }
 
 
+/*!	Returns the uncomplemented sum of the pseudo header alone, as needed for
+	a partial checksum (see NET_BUFFER_CHECKSUM_PARTIAL).
+*/
+inline uint16
+Checksum::PartialPseudoHeader(net_address_module_info* addressModule,
+	net_buffer* buffer, uint16 protocol)
+{
+	Checksum checksum;
+	addressModule->checksum_address(&checksum, buffer->source);
+	addressModule->checksum_address(&checksum, buffer->destination);
+	checksum << (uint16)htons(protocol) << (uint16)htons(buffer->size);
+	return ~(uint16)checksum;
+}
+
+
 /*!	Helper class that prints an address (and optionally a port) into a buffer
 	that is automatically freed at end of scope.
 */
@@ -27,6 +27,15 @@ enum {
 		/* get line speed, quality, duplex mode, etc. (ether_link_state_t *) */
 };
 
+/* optional ioctl() opcodes to offload work to the device */
+enum {
+	ETHER_GET_OFFLOAD = B_DEVICE_OP_CODES_END + 0x100,
+		/* get the supported ETHER_OFFLOAD_* features (uint32 *) */
+	ETHER_SET_OFFLOAD
+		/* enable the given features (uint32 *); from then on, every frame
+		   read or written is preceded by an ether_offload_header */
+};
+
 
 /* ETHER_GETADDR - MAC address */
 typedef struct ether_address {
@@ -40,4 +49,26 @@ typedef struct ether_link_state {
 	uint64	speed;		/* in bit/s */
 } ether_link_state_t;
 
+/* ETHER_GET_OFFLOAD, ETHER_SET_OFFLOAD */
+#define ETHER_OFFLOAD_CHECKSUM		0x01	/* completes partial checksums */
+#define ETHER_OFFLOAD_RX_CHECKSUM	0x02	/* verifies received checksums */
+#define ETHER_OFFLOAD_TSO4			0x04	/* splits TCP/IPv4 segments */
+#define ETHER_OFFLOAD_TSO6			0x08	/* splits TCP/IPv6 segments */
+
+typedef struct ether_offload_header {
+	uint16	flags;
+	uint16	checksum_start;
+		/* where the partial checksum starts, from the start of the frame */
+	uint16	checksum_offset;
+		/* offset of the checksum field, relative to checksum_start */
+	uint16	segment_size;
+		/* maximum TCP payload of each segment */
+} ether_offload_header;
+
+/* ether_offload_header::flags */
+#define ETHER_FRAME_CHECKSUM_VALID		0x01
+#define ETHER_FRAME_CHECKSUM_PARTIAL	0x02
+#define ETHER_FRAME_SEGMENT_TCP4		0x04
+#define ETHER_FRAME_SEGMENT_TCP6		0x08
+
 #endif	/* _ETHER_DRIVER_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef LOOPBACK_CONTROL_H
+#define LOOPBACK_CONTROL_H
+
+
+#include <sys/sockio.h>
+
+#include <SupportDefs.h>
+
+
+/*!	Network emulation settings of the loopback device. They are set with
+	SIOCSDRVSPEC, and retrieved with SIOCGDRVSPEC, using an ifreq whose
+	ifr_data member points to this structure.
+
+	All values are zero by default, which lets the packets pass through
+	unchanged.
+*/
+struct loopback_emulation {
+	bigtime_t	delay;
+		// added to every packet, in microseconds
+	bigtime_t	jitter;
+		// maximum random variation of the delay
+	uint32		loss;
+		// packets dropped, in parts per million
+	uint32		rate;
+		// in bytes per second, or zero for no limit
+	uint32		queue_limit;
+		// maximum number of delayed packets, or zero for the default
+};
+
+
+#endif	// LOOPBACK_CONTROL_H
@@ -15,6 +15,19 @@
 
 #define NET_BUFFER_MODULE_NAME "network/stack/buffer/v1"
 
+// net_buffer::offload flags
+#define NET_BUFFER_CHECKSUM_VALID	0x01
+	// received: the transport checksum has already been verified
+#define NET_BUFFER_CHECKSUM_PARTIAL	0x02
+	// The transport checksum field at checksum_start + checksum_offset only
+	// contains the pseudo header sum, the checksum over the data starting at
+	// checksum_start still needs to be added (by the device, or by
+	// finish_checksum()). Received buffers with this flag can be trusted.
+#define NET_BUFFER_SEGMENT_TCP4		0x04
+#define NET_BUFFER_SEGMENT_TCP6		0x08
+	// The TCP segment is larger than the MTU, and needs to be split into
+	// segments of segment_size bytes by the device.
+
 
 typedef struct net_buffer {
 	struct list_link		link;
@@ -35,8 +48,23 @@ typedef struct net_buffer {
 	uint32					flags;
 	uint32					size;
 	uint8					protocol;
+	uint16					offload;
+	uint16					checksum_start;
+	uint16					checksum_offset;
+	uint16					segment_size;
 } net_buffer;
 
+/*!	Data that is not owned by the buffer module, and that can be referenced
+	by a net_buffer without copying it. \c free is called with the \c cookie
+	once the last buffer referencing the data is gone.
+*/
+typedef struct net_external_data {
+	void*					data;
+	size_t					size;
+	void					(*free)(void* cookie);
+	void*					cookie;
+} net_external_data;
+
 struct ancillary_data_container;
 
 struct net_buffer_module_info {
@@ -101,6 +129,11 @@ struct net_buffer_module_info {
 	void			(*swap_addresses)(net_buffer* buffer);
 
 	void			(*dump)(net_buffer* buffer);
+
+	status_t		(*finish_checksum)(net_buffer* buffer);
+
+	status_t		(*append_external)(net_buffer* buffer,
+						const net_external_data* data);
 };
 
 
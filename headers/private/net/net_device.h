@@ -13,6 +13,13 @@
 
 typedef struct net_buffer net_buffer;
 
+// net_device::offload capabilities
+#define NET_DEVICE_OFFLOAD_CHECKSUM	0x01
+	// completes partial TCP and UDP checksums
+#define NET_DEVICE_OFFLOAD_TSO4		0x02
+#define NET_DEVICE_OFFLOAD_TSO6		0x04
+	// splits large TCP segments over IPv4, and IPv6
+
 
 struct net_hardware_address {
 	uint8	data[64];
@@ -31,6 +38,7 @@ typedef struct net_device {
 	uint64	link_speed;
 	uint32	link_quality;
 	size_t	header_length;
+	uint32	offload;	// NET_DEVICE_OFFLOAD_*
 
 	struct net_hardware_address address;
 
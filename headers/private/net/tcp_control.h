@@ -0,0 +1,22 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef TCP_CONTROL_H
+#define TCP_CONTROL_H
+
+
+#include <netinet/tcp.h>
+
+
+// generic syscall interface
+#define TCP_SYSCALLS "network/tcp"
+
+#define TCP_GET_DEFAULT_CONGESTION	1
+#define TCP_SET_DEFAULT_CONGESTION	2
+
+struct tcp_congestion_control {
+	char		name[TCP_CA_NAME_MAX];
+};
+
+#endif	// TCP_CONTROL_H
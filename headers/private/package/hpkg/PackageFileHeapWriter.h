@@ -39,7 +39,8 @@ public:
 									CompressionAlgorithmOwner*
 										compressionAlgorithm,
 									DecompressionAlgorithmOwner*
-										decompressionAlgorithm);
+										decompressionAlgorithm,
+									int32 threadCount = 1);
 								~PackageFileHeapWriter();
 
 			void				Init();
@@ -63,15 +64,24 @@ private:
 			struct Chunk;
 			struct ChunkSegment;
 			struct ChunkBuffer;
+			struct CompressionJob;
+			struct CompressionThread;
 
 			friend struct ChunkBuffer;
+			friend struct CompressionThread;
 
 private:
 			void				_Uninit();
 
 			status_t			_FlushPendingData();
+			status_t			_QueuePendingData();
+			status_t			_FlushQueuedChunks();
+			void				_CompressQueuedChunks();
 			status_t			_WriteChunk(const void* data, size_t size,
 									bool mayCompress);
+			status_t			_WriteQueuedChunk(const CompressionJob& job);
+			status_t			_CompressData(const void* data, size_t size,
+									void* buffer, size_t& _compressedSize);
 			status_t			_WriteDataCompressed(const void* data,
 									size_t size);
 			status_t			_WriteDataUncompressed(const void* data,
@@ -87,6 +97,14 @@ private:
 			size_t				fPendingDataSize;
 			Array<uint64>		fOffsets;
 			CompressionAlgorithmOwner* fCompressionAlgorithm;
+			int32				fThreadCount;
+			uint8*				fQueuedDataBuffer;
+			uint8*				fQueuedCompressedBuffer;
+			CompressionJob*		fCompressionJobs;
+			CompressionThread*	fCompressionThreads;
+			int32				fQueuedChunkCount;
+			int32				fMaxQueuedChunks;
+			bool				fQueueChunks;
 };
 
 
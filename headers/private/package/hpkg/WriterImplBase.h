@@ -44,6 +44,9 @@ public:
 									BErrorOutput* errorOutput);
 								~WriterImplBase();
 
+			void				SetThreadCount(int32 threadCount);
+									// to be called before Init()
+
 protected:
 			struct AttributeValue {
 				union {
@@ -191,6 +194,7 @@ private:
 			BErrorOutput*		fErrorOutput;
 			const char*			fFileName;
 			BPackageWriterParameters fParameters;
+			int32				fThreadCount;
 			BPositionIO*		fFile;
 			bool				fOwnsFile;
 			bool				fFinished;
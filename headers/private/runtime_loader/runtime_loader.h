@@ -118,6 +118,7 @@ typedef struct image_t {
 	int					rela_len;
 	Elf_Rel				*pltrel;
 	int					pltrel_len;
+	Elf_Addr			*pltgot;
 	addr_t				*init_array;
 	int					init_array_len;
 	addr_t				*preinit_array;
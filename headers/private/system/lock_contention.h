@@ -0,0 +1,31 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_LOCK_CONTENTION_H
+#define _SYSTEM_LOCK_CONTENTION_H
+
+#include <OS.h>
+
+
+#define LOCK_CONTENTION				"lock contention"
+#define GET_LOCK_CONTENTION_INFO	0x01
+
+
+typedef struct lock_contention_stats {
+	int64	contended;
+		// number of times the lock was not available right away
+	int64	spin_acquired;
+		// number of times it was acquired after spinning for a while
+	int64	blocked;
+		// number of times the thread had to wait for it
+} lock_contention_stats;
+
+typedef struct lock_contention_info {
+	lock_contention_stats	mutexes;
+	lock_contention_stats	rw_locks;
+	lock_contention_stats	user_mutexes;
+} lock_contention_info;
+
+
+#endif	/* _SYSTEM_LOCK_CONTENTION_H */
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_SLAB_DEFS_H
+#define _SYSTEM_SLAB_DEFS_H
+
+
+#include <OS.h>
+
+
+struct object_cache_stats {
+	char		name[B_OS_NAME_LENGTH];
+	size_t		object_size;
+	size_t		usage;					// bytes allocated for slabs
+	size_t		total_objects;
+	size_t		used_objects;
+
+	// magazine depot (all zero, if the cache doesn't have one)
+	uint64		alloc_hits;				// allocations served by a magazine
+	uint64		alloc_misses;			// allocations served by the slabs
+	uint64		free_hits;				// frees stored in a magazine
+	uint64		free_misses;			// frees returned to the slabs
+	uint64		depot_contention;		// contended depot lock acquisitions
+	uint32		full_magazines;
+	uint32		max_full_magazines;
+	uint32		magazine_capacity;
+};
+
+
+#endif	/* _SYSTEM_SLAB_DEFS_H */
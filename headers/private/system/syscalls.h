@@ -29,6 +29,7 @@ struct fs_info;
 struct iovec;
 struct msqid_ds;
 struct net_stat;
+struct object_cache_stats;
 struct pollfd;
 struct rlimit;
 struct scheduling_analysis;
@@ -73,6 +74,11 @@ extern status_t		_kern_get_safemode_option(const char *parameter,
 
 extern ssize_t		_kern_wait_for_objects(object_wait_info* infos, int numInfos,
 						uint32 flags, bigtime_t timeout);
+extern int			_kern_create_event_queue(uint32 openFlags);
+extern status_t		_kern_event_queue_select(int queue, event_wait_info* infos,
+						int numInfos);
+extern ssize_t		_kern_event_queue_wait(int queue, event_wait_info* infos,
+						int numInfos, uint32 flags, bigtime_t timeout);
 
 /* user mutex functions */
 extern status_t		_kern_mutex_lock(int32* mutex, const char* name,
@@ -183,6 +189,7 @@ extern status_t		_kern_get_team_usage_info(team_id team, int32 who,
 						team_usage_info *info, size_t size);
 extern status_t		_kern_get_extended_team_info(team_id teamID, uint32 flags,
 						void* buffer, size_t size, size_t* _sizeNeeded);
+extern status_t		_kern_set_team_io_priority(team_id team, int32 priority);
 
 extern status_t		_kern_start_watching_system(int32 object, uint32 flags,
 						port_id port, int32 token);
@@ -263,6 +270,8 @@ extern int			_kern_open_parent_dir(int fd, char *name,
 						size_t nameLength);
 extern status_t		_kern_fcntl(int fd, int op, size_t argument);
 extern status_t		_kern_fsync(int fd);
+extern status_t		_kern_file_advice(int fd, off_t offset, off_t length,
+						int advice);
 extern status_t		_kern_flock(int fd, int op);
 extern off_t		_kern_seek(int fd, off_t pos, int seekType);
 extern status_t		_kern_create_dir_entry_ref(dev_t device, ino_t inode,
@@ -363,6 +372,8 @@ extern ssize_t		_kern_sendto(int socket, const void *data, size_t length,
 						socklen_t addressLength);
 extern ssize_t		_kern_sendmsg(int socket, const struct msghdr *message,
 						int flags);
+extern ssize_t		_kern_sendfile(int socket, int fd, off_t *pos,
+						size_t count);
 extern status_t		_kern_getsockopt(int socket, int level, int option,
 						void *value, socklen_t *_length);
 extern status_t		_kern_setsockopt(int socket, int level, int option,
@@ -533,6 +544,9 @@ extern status_t		_kern_analyze_scheduling(bigtime_t from, bigtime_t until,
 						void* buffer, size_t size,
 						struct scheduling_analysis* analysis);
 
+extern status_t		_kern_get_object_cache_stats(
+						struct object_cache_stats* stats, uint32* _count);
+
 /* Debug output */
 extern void			_kern_debug_output(const char *message);
 extern void			_kern_ktrace_output(const char *message);
@@ -29,7 +29,7 @@
 #define VIRTIO_FEATURE_RING_EVENT_IDX		(1 << 29)
 #define VIRTIO_FEATURE_BAD_FEATURE 			(1 << 30)
 
-#define VIRTIO_VIRTQUEUES_MAX_COUNT	8
+#define VIRTIO_VIRTQUEUES_MAX_COUNT	32
 
 #define VIRTIO_CONFIG_STATUS_RESET	0x00
 #define VIRTIO_CONFIG_STATUS_ACK	0x01
@@ -52,8 +52,10 @@ typedef void* virtio_sim;
 typedef void* virtio_device;
 // queue cookie, issued by virtio bus manager
 typedef void* virtio_queue;
-// callback function for requests
-typedef void (*virtio_callback_func)(void* driverCookie, void *cookie);
+// callback function for requests, usedLength is the number of bytes the
+// device has written into the request's buffers
+typedef void (*virtio_callback_func)(void* driverCookie, void *cookie,
+	uint32 usedLength);
 // callback function for interrupts
 typedef void (*virtio_intr_func)(void *cookie);
 
@@ -135,6 +135,9 @@ private:
 			void				Finish();
 
 			VirtioDevice*		fDevice;
+			spinlock			fLock;
+				// protects the ring against concurrent requests and
+				// completions; the request callbacks are called with it held
 			uint16				fQueueNumber;
 			uint16				fRingSize;
 			uint16				fRingFree;
@@ -56,7 +56,7 @@ public:
 
 			status_t			InitCheck() { return fStatus; }
 
-			void				Callback();
+			void				Callback(uint32 usedLength);
 			uint16				Size() { return fDescriptorCount; }
 			void				SetTo(uint16 size,
 									virtio_callback_func callback,
@@ -119,10 +119,10 @@ TransferDescriptor::~TransferDescriptor()
 
 
 void
-TransferDescriptor::Callback()
+TransferDescriptor::Callback(uint32 usedLength)
 {
 	if (fCallback != NULL)
-		fCallback(fQueue->Device()->DriverCookie(), fCookie);
+		fCallback(fQueue->Device()->DriverCookie(), fCookie, usedLength);
 }
 
 
@@ -160,6 +160,8 @@ VirtioQueue::VirtioQueue(VirtioDevice* device, uint16 queueNumber,
 	fStatus(B_OK),
 	fIndirectMaxSize(0)
 {
+	B_INITIALIZE_SPINLOCK(&fLock);
+
 	fDescriptors = new(std::nothrow) TransferDescriptor*[fRingSize];
 	if (fDescriptors == NULL) {
 		fStatus = B_NO_MEMORY;
@@ -236,6 +238,7 @@ status_t
 VirtioQueue::Interrupt()
 {
 	CALLED();
+	InterruptsSpinLocker locker(fLock);
 	DisableInterrupt();
 
 	while (fRingUsedIndex != fRing.used->idx)
@@ -255,9 +258,9 @@ VirtioQueue::Finish()
 	TRACE("Finish() usedIndex: %u\n", usedIndex);
 	struct vring_used_elem *element = &fRing.used->ring[usedIndex];
 	uint16 descriptorIndex = element->id;
-		// uint32 length = element->len;
+	uint32 length = element->len;
 
-	fDescriptors[descriptorIndex]->Callback();
+	fDescriptors[descriptorIndex]->Callback(length);
 	uint16 size = fDescriptors[descriptorIndex]->Size();
 	fDescriptors[descriptorIndex]->Unset();
 	fRingFree += size;
@@ -287,6 +290,9 @@ VirtioQueue::QueueRequest(const physical_entry* vector, size_t readVectorCount,
 	size_t count = readVectorCount + writtenVectorCount;
 	if (count < 1)
 		return B_BAD_VALUE;
+
+	InterruptsSpinLocker locker(fLock);
+
 	if ((fDevice->Features() & VIRTIO_FEATURE_RING_INDIRECT_DESC) != 0) {
 		return QueueRequestIndirect(vector, readVectorCount,
 			writtenVectorCount, callback, callbackCookie);
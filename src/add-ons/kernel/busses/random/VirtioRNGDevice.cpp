@@ -120,7 +120,8 @@ VirtioRNGDevice::Read(void* _buffer, size_t* _numBytes)
 
 
 void
-VirtioRNGDevice::_RequestCallback(void* driverCookie, void* cookie)
+VirtioRNGDevice::_RequestCallback(void* driverCookie, void* cookie,
+	uint32 usedLength)
 {
 	VirtioRNGDevice* device = (VirtioRNGDevice*)driverCookie;
 	device->_RequestInterrupt();
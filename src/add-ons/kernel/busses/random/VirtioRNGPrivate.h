@@ -41,7 +41,7 @@ public:
 
 private:
 	static	void				_RequestCallback(void* driverCookie,
-									void *cookie);
+									void *cookie, uint32 usedLength);
 			void				_RequestInterrupt();
 
 			device_node*		fNode;
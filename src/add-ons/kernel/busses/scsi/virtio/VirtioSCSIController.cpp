@@ -258,7 +258,8 @@ VirtioSCSIController::Control(uint8 targetID, uint32 op, void *buffer,
 
 
 void
-VirtioSCSIController::_RequestCallback(void* driverCookie, void* cookie)
+VirtioSCSIController::_RequestCallback(void* driverCookie, void* cookie,
+	uint32 usedLength)
 {
 	CALLED();
 	VirtioSCSIController* controller = (VirtioSCSIController*)driverCookie;
@@ -276,7 +277,8 @@ VirtioSCSIController::_RequestInterrupt()
 
 
 void
-VirtioSCSIController::_EventCallback(void* driverCookie, void* cookie)
+VirtioSCSIController::_EventCallback(void* driverCookie, void* cookie,
+	uint32 usedLength)
 {
 	CALLED();
 	VirtioSCSIController* controller = (VirtioSCSIController*)driverCookie;
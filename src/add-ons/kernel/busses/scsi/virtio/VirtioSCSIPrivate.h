@@ -63,9 +63,10 @@ public:
 
 private:
 	static	void				_RequestCallback(void* driverCookie,
-									void *cookie);
+									void *cookie, uint32 usedLength);
 			void				_RequestInterrupt();
-	static	void				_EventCallback(void *driverCookie, void *cookie);
+	static	void				_EventCallback(void *driverCookie,
+									void *cookie, uint32 usedLength);
 			void				_EventInterrupt(struct virtio_scsi_event* event);
 	static	void				_RescanChildBus(void *cookie);
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _NVME_H
+#define _NVME_H
+
+
+#include <SupportDefs.h>
+
+
+// controller registers
+#define NVME_CAP					0x00
+#define NVME_VS						0x08
+#define NVME_INTMS					0x0c
+#define NVME_INTMC					0x10
+#define NVME_CC						0x14
+#define NVME_CSTS					0x1c
+#define NVME_AQA					0x24
+#define NVME_ASQ					0x28
+#define NVME_ACQ					0x30
+#define NVME_DOORBELLS				0x1000
+
+#define NVME_CAP_MQES(cap)			((uint32)(cap) & 0xffff)
+#define NVME_CAP_TO(cap)			((uint32)((cap) >> 24) & 0xff)
+#define NVME_CAP_DSTRD(cap)			((uint32)((cap) >> 32) & 0xf)
+#define NVME_CAP_MPSMIN(cap)		((uint32)((cap) >> 48) & 0xf)
+
+#define NVME_CC_ENABLE				(1 << 0)
+#define NVME_CC_CSS_NVM				(0 << 4)
+#define NVME_CC_MPS(shift)			(((shift) - 12) << 7)
+#define NVME_CC_AMS_RR				(0 << 11)
+#define NVME_CC_SHN_NORMAL			(1 << 14)
+#define NVME_CC_SHN_MASK			(3 << 14)
+#define NVME_CC_IOSQES(shift)		((shift) << 16)
+#define NVME_CC_IOCQES(shift)		((shift) << 20)
+
+#define NVME_CSTS_READY				(1 << 0)
+#define NVME_CSTS_FATAL				(1 << 1)
+#define NVME_CSTS_SHST_MASK			(3 << 2)
+#define NVME_CSTS_SHST_COMPLETE		(2 << 2)
+
+// admin commands
+#define NVME_ADMIN_DELETE_SQ		0x00
+#define NVME_ADMIN_CREATE_SQ		0x01
+#define NVME_ADMIN_DELETE_CQ		0x04
+#define NVME_ADMIN_CREATE_CQ		0x05
+#define NVME_ADMIN_IDENTIFY			0x06
+#define NVME_ADMIN_SET_FEATURES		0x09
+
+// NVM command set
+#define NVME_CMD_FLUSH				0x00
+#define NVME_CMD_WRITE				0x01
+#define NVME_CMD_READ				0x02
+#define NVME_CMD_DSM				0x09
+
+// command flags
+#define NVME_CMD_PSDT_SGL			(1 << 6)
+	// the data pointer is an SGL descriptor instead of PRP entries
+
+// identify CNS values
+#define NVME_IDENTIFY_NAMESPACE		0x00
+#define NVME_IDENTIFY_CONTROLLER	0x01
+#define NVME_IDENTIFY_ACTIVE_NAMESPACES	0x02
+
+// features
+#define NVME_FEATURE_NUMBER_OF_QUEUES	0x07
+
+// create I/O queue flags
+#define NVME_QUEUE_PHYS_CONTIGUOUS	(1 << 0)
+#define NVME_CQ_INTERRUPTS_ENABLED	(1 << 1)
+
+// dataset management attributes
+#define NVME_DSM_DEALLOCATE			(1 << 2)
+
+// SGL descriptor types
+#define NVME_SGL_DATA_BLOCK			0x00
+#define NVME_SGL_LAST_SEGMENT		0x30
+
+// identify controller fields
+#define NVME_ONCS_DSM				(1 << 2)
+#define NVME_VWC_PRESENT			(1 << 0)
+#define NVME_SGLS_SUPPORTED			0x3
+
+// status fields
+#define NVME_STATUS_PHASE			0x0001
+#define NVME_STATUS_CODE(status)	(((status) >> 1) & 0xff)
+#define NVME_STATUS_TYPE(status)	(((status) >> 9) & 0x7)
+
+#define NVME_SCT_GENERIC			0x0
+#define NVME_SCT_MEDIA				0x2
+
+#define NVME_SC_SUCCESS				0x00
+#define NVME_SC_INVALID_OPCODE		0x01
+#define NVME_SC_INVALID_FIELD		0x02
+#define NVME_SC_LBA_OUT_OF_RANGE	0x80
+#define NVME_SC_WRITE_FAULT			0x80
+#define NVME_SC_UNRECOVERED_READ	0x81
+
+
+struct nvme_sgl_descriptor {
+	uint64		address;
+	uint32		length;
+	uint8		reserved[3];
+	uint8		type;
+} _PACKED;
+
+struct nvme_command {
+	uint8		opcode;
+	uint8		flags;
+	uint16		cid;
+	uint32		nsid;
+	uint32		reserved[2];
+	uint64		metadata;
+	union {
+		struct {
+			uint64	prp1;
+			uint64	prp2;
+		} prp;
+		nvme_sgl_descriptor sgl;
+	} data;
+	uint32		cdw10;
+	uint32		cdw11;
+	uint32		cdw12;
+	uint32		cdw13;
+	uint32		cdw14;
+	uint32		cdw15;
+} _PACKED;
+
+struct nvme_completion {
+	uint32		result;
+	uint32		reserved;
+	uint16		sq_head;
+	uint16		sq_id;
+	uint16		cid;
+	uint16		status;
+} _PACKED;
+
+struct nvme_identify_controller {
+	uint16		vid;
+	uint16		ssvid;
+	char		sn[20];
+	char		mn[40];
+	char		fr[8];
+	uint8		rab;
+	uint8		ieee[3];
+	uint8		cmic;
+	uint8		mdts;
+	uint8		reserved1[434];
+	uint8		sqes;
+	uint8		cqes;
+	uint16		maxcmd;
+	uint32		nn;
+	uint16		oncs;
+	uint16		fuses;
+	uint8		fna;
+	uint8		vwc;
+	uint16		awun;
+	uint16		awupf;
+	uint8		nvscc;
+	uint8		reserved2;
+	uint16		acwu;
+	uint16		reserved3;
+	uint32		sgls;
+	uint8		reserved4[3556];
+} _PACKED;
+
+struct nvme_lba_format {
+	uint16		ms;
+	uint8		lbads;
+	uint8		rp;
+} _PACKED;
+
+struct nvme_identify_namespace {
+	uint64		nsze;
+	uint64		ncap;
+	uint64		nuse;
+	uint8		nsfeat;
+	uint8		nlbaf;
+	uint8		flbas;
+	uint8		mc;
+	uint8		dpc;
+	uint8		dps;
+	uint8		reserved1[98];
+	nvme_lba_format lbaf[16];
+	uint8		reserved2[3904];
+} _PACKED;
+
+struct nvme_dsm_range {
+	uint32		attributes;
+	uint32		length;
+	uint64		slba;
+} _PACKED;
+
+
+#endif	// _NVME_H
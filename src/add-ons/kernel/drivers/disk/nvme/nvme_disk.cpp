@@ -0,0 +1,1823 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Driver for NVM Express controllers.
+
+	Every CPU gets its own I/O submission/completion queue pair with its own
+	MSI-X vector. Transfers are still submitted by the thread of the I/O
+	scheduler, but each command is put on the queue of the CPU that issued
+	its request, so that it is completed on that CPU, and the completions of
+	different CPUs do not contend on a single queue lock. The admin queue is
+	only used during initialization, and is polled.
+
+	Every active namespace is published as a disk device of its own, with
+	its own I/O scheduler.
+
+	I/O operations are handed over to the controller asynchronously, and
+	completed from the interrupt handler. Their physical vecs are directly
+	turned into an SGL, or, if the controller does not support them, a PRP
+	list. Only transfers that cannot be described by PRPs go through a
+	bounce buffer.
+*/
+
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <AutoDeleter.h>
+#include <bus/PCI.h>
+#include <PCI_x86.h>
+#include <condition_variable.h>
+#include <fs/devfs.h>
+#include <int.h>
+#include <kernel.h>
+#include <lock.h>
+#include <smp.h>
+#include <util/AutoLock.h>
+#include <util/fs_trim_support.h>
+#include <vm/vm.h>
+
+#include "dma_resources.h"
+#include "IORequest.h"
+#include "IOSchedulerSimple.h"
+#include "nvme.h"
+
+
+//#define TRACE_NVME_DISK
+#ifdef TRACE_NVME_DISK
+#	define TRACE(x...) dprintf("nvme_disk: " x)
+#else
+#	define TRACE(x...) ;
+#endif
+#define TRACE_ALWAYS(x...)	dprintf("nvme_disk: " x)
+#define ERROR(x...)			dprintf("\33[33mnvme_disk:\33[0m " x)
+#define CALLED() 			TRACE("CALLED %s\n", __PRETTY_FUNCTION__)
+
+
+#define NVME_DISK_DRIVER_MODULE_NAME	"drivers/disk/nvme_disk/driver_v1"
+#define NVME_DISK_DEVICE_MODULE_NAME	"drivers/disk/nvme_disk/device_v1"
+#define NVME_DISK_DEVICE_ID_GENERATOR	"nvme_disk/device_id"
+
+
+static const uint16 kAdminQueueEntries = 32;
+static const uint16 kQueueEntries = 128;
+static const int32 kMaxQueuePairs = 32;
+static const uint32 kMaxNamespaces = 32;
+static const uint32 kMaxTransferSize = 128 * B_PAGE_SIZE;
+static const uint32 kMaxSGLDescriptors
+	= B_PAGE_SIZE / sizeof(nvme_sgl_descriptor);
+static const uint32 kMaxDSMRanges = B_PAGE_SIZE / sizeof(nvme_dsm_range);
+static const bigtime_t kAdminCommandTimeout = 5000000;
+static const bigtime_t kShutdownTimeout = 2000000;
+
+
+typedef enum {
+	NVME_IRQ_LEGACY,
+	NVME_IRQ_MSI,
+	NVME_IRQ_MSI_X,
+} nvme_irq_type;
+
+struct nvme_driver_info;
+struct nvme_namespace;
+
+/*!	Keeps track of a command submitted to an I/O queue; its index is used as
+	the command identifier. Each tracker has a page of its own for PRP lists,
+	SGL segments, or DSM ranges.
+*/
+struct nvme_tracker {
+	nvme_tracker*		next;
+	IOOperation*		operation;
+		// NULL for synchronously executed commands
+	nvme_namespace*		ns;
+		// the namespace the operation belongs to
+	bool				done;
+	uint16				status;
+	void*				page;
+	phys_addr_t			page_physical;
+};
+
+struct nvme_queue_pair {
+	nvme_driver_info*	info;
+	uint16				id;
+	uint16				entries;
+	uint8				vector;
+	spinlock			lock;
+
+	area_id				area;
+	nvme_command*		submission;
+	nvme_completion*	completion;
+	phys_addr_t			submission_physical;
+	phys_addr_t			completion_physical;
+	uint32				submission_doorbell;
+	uint32				completion_doorbell;
+	uint16				submission_tail;
+	uint16				completion_head;
+	uint16				phase;
+
+	area_id				tracker_area;
+	nvme_tracker*		trackers;
+	nvme_tracker*		free_trackers;
+	ConditionVariable	condition;
+		// notified when commands have been completed
+};
+
+struct nvme_driver_info {
+	device_node*			node;
+	pci_device_module_info*	pci;
+	pci_device*				device;
+	pci_info				pci_info;
+
+	area_id					registers_area;
+	volatile uint8*			registers;
+	uint32					doorbell_stride;
+	uint64					capabilities;
+
+	nvme_irq_type			irq_type;
+	uint8					irq;
+
+	mutex					admin_lock;
+	nvme_queue_pair			admin_queue;
+	nvme_queue_pair*		queues;
+	int32					queue_count;
+
+	nvme_namespace*			namespaces;
+	uint32					namespace_count;
+	uint32					max_transfer_size;
+	bool					supports_sgl;
+	bool					supports_trim;
+	bool					volatile_cache;
+	char					model[41];
+
+	mutex					bounce_lock;
+	area_id					bounce_area;
+	void*					bounce_buffer;
+	phys_addr_t				bounce_buffer_physical;
+
+};
+
+/*!	An active namespace of the controller; it is published as
+	"disk/nvme/<device_id>/raw".
+*/
+struct nvme_namespace {
+	nvme_driver_info*		info;
+	uint32					id;
+	int32					device_id;
+	char					device_name[64];
+	uint64					capacity;
+	uint32					block_size;
+
+	DMAResource*			dma_resource;
+	IOScheduler*			io_scheduler;
+	status_t				media_status;
+};
+
+typedef struct {
+	nvme_namespace*			ns;
+} nvme_disk_handle;
+
+
+static device_manager_info* sDeviceManager;
+static pci_x86_module_info* sPCIx86Module;
+
+
+static inline uint32
+read_register(nvme_driver_info* info, uint32 offset)
+{
+	return *(volatile uint32*)(info->registers + offset);
+}
+
+
+static inline void
+write_register(nvme_driver_info* info, uint32 offset, uint32 value)
+{
+	*(volatile uint32*)(info->registers + offset) = value;
+}
+
+
+static inline void
+write_register64(nvme_driver_info* info, uint32 offset, uint64 value)
+{
+	write_register(info, offset, (uint32)value);
+	write_register(info, offset + 4, (uint32)(value >> 32));
+}
+
+
+static status_t
+nvme_status_to_error(uint16 status)
+{
+	uint8 code = NVME_STATUS_CODE(status);
+	switch (NVME_STATUS_TYPE(status)) {
+		case NVME_SCT_GENERIC:
+			switch (code) {
+				case NVME_SC_SUCCESS:
+					return B_OK;
+				case NVME_SC_INVALID_OPCODE:
+					return B_NOT_SUPPORTED;
+				case NVME_SC_INVALID_FIELD:
+				case NVME_SC_LBA_OUT_OF_RANGE:
+					return B_BAD_VALUE;
+			}
+			break;
+
+		case NVME_SCT_MEDIA:
+			switch (code) {
+				case NVME_SC_WRITE_FAULT:
+					return B_DEV_WRITE_ERROR;
+				case NVME_SC_UNRECOVERED_READ:
+					return B_DEV_READ_ERROR;
+			}
+			break;
+	}
+
+	return B_IO_ERROR;
+}
+
+
+static status_t
+wait_for_ready(nvme_driver_info* info, bool ready)
+{
+	// CAP.TO is in units of 500 ms
+	bigtime_t timeout = system_time()
+		+ max_c(NVME_CAP_TO(info->capabilities), 1) * 500000LL;
+
+	while (true) {
+		uint32 status = read_register(info, NVME_CSTS);
+		if (status == 0xffffffff)
+			return B_DEV_NOT_READY;
+		if (((status & NVME_CSTS_READY) != 0) == ready)
+			return B_OK;
+		if (ready && (status & NVME_CSTS_FATAL) != 0)
+			return B_DEV_NOT_READY;
+		if (system_time() > timeout)
+			return B_TIMED_OUT;
+
+		snooze(1000);
+	}
+}
+
+
+//	#pragma mark - queues
+
+
+static status_t
+init_queue_pair(nvme_driver_info* info, nvme_queue_pair* queue, uint16 id,
+	uint16 entries, bool withTrackers)
+{
+	queue->info = info;
+	queue->id = id;
+	queue->entries = entries;
+	queue->vector = 0;
+	B_INITIALIZE_SPINLOCK(&queue->lock);
+	queue->submission_doorbell = NVME_DOORBELLS
+		+ 2 * id * info->doorbell_stride;
+	queue->completion_doorbell = NVME_DOORBELLS
+		+ (2 * id + 1) * info->doorbell_stride;
+	queue->submission_tail = 0;
+	queue->completion_head = 0;
+	queue->phase = 1;
+	queue->tracker_area = -1;
+	queue->trackers = NULL;
+	queue->free_trackers = NULL;
+	queue->condition.Init(queue, "nvme queue");
+
+	// The controller requires both queues to be physically contiguous
+	size_t submissionSize = ROUNDUP(entries * sizeof(nvme_command),
+		B_PAGE_SIZE);
+	size_t areaSize = submissionSize
+		+ ROUNDUP(entries * sizeof(nvme_completion), B_PAGE_SIZE);
+
+	void* address;
+	queue->area = create_area("nvme queue", &address, B_ANY_KERNEL_ADDRESS,
+		areaSize, B_CONTIGUOUS, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (queue->area < 0)
+		return queue->area;
+
+	memset(address, 0, areaSize);
+
+	physical_entry entry;
+	get_memory_map(address, B_PAGE_SIZE, &entry, 1);
+
+	queue->submission = (nvme_command*)address;
+	queue->submission_physical = entry.address;
+	queue->completion = (nvme_completion*)((uint8*)address + submissionSize);
+	queue->completion_physical = entry.address + submissionSize;
+
+	if (!withTrackers)
+		return B_OK;
+
+	// one slot of the submission queue always stays empty, so that we never
+	// have to check whether it's full
+	uint32 trackerCount = entries - 1;
+	queue->trackers = (nvme_tracker*)calloc(trackerCount,
+		sizeof(nvme_tracker));
+	if (queue->trackers == NULL)
+		return B_NO_MEMORY;
+
+	queue->tracker_area = create_area("nvme tracker pages", &address,
+		B_ANY_KERNEL_ADDRESS, trackerCount * B_PAGE_SIZE, B_FULL_LOCK,
+		B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (queue->tracker_area < 0)
+		return queue->tracker_area;
+
+	for (uint32 i = trackerCount; i-- > 0;) {
+		nvme_tracker* tracker = &queue->trackers[i];
+		tracker->page = (uint8*)address + i * B_PAGE_SIZE;
+		get_memory_map(tracker->page, B_PAGE_SIZE, &entry, 1);
+		tracker->page_physical = entry.address;
+
+		tracker->next = queue->free_trackers;
+		queue->free_trackers = tracker;
+	}
+
+	return B_OK;
+}
+
+
+static void
+uninit_queue_pair(nvme_queue_pair* queue)
+{
+	if (queue->area >= 0)
+		delete_area(queue->area);
+	if (queue->tracker_area >= 0)
+		delete_area(queue->tracker_area);
+	free(queue->trackers);
+}
+
+
+/*!	Copies the command into the submission queue, and tells the controller
+	about it. The queue must be locked.
+*/
+static void
+submit_command(nvme_queue_pair* queue, const nvme_command& command)
+{
+	memcpy(&queue->submission[queue->submission_tail], &command,
+		sizeof(nvme_command));
+	if (++queue->submission_tail == queue->entries)
+		queue->submission_tail = 0;
+
+	memory_write_barrier();
+	write_register(queue->info, queue->submission_doorbell,
+		queue->submission_tail);
+}
+
+
+/*!	Returns the next completion queue entry the controller has written, or
+	\c NULL if there is none yet. The queue must be locked.
+*/
+static nvme_completion*
+next_completion(nvme_queue_pair* queue)
+{
+	nvme_completion* completion = &queue->completion[queue->completion_head];
+	if ((*(volatile uint16*)&completion->status & NVME_STATUS_PHASE)
+			!= queue->phase) {
+		return NULL;
+	}
+
+	memory_read_barrier();
+
+	if (++queue->completion_head == queue->entries) {
+		queue->completion_head = 0;
+		queue->phase ^= NVME_STATUS_PHASE;
+	}
+
+	return completion;
+}
+
+
+static void
+free_tracker(nvme_queue_pair* queue, nvme_tracker* tracker)
+{
+	tracker->operation = NULL;
+	tracker->next = queue->free_trackers;
+	queue->free_trackers = tracker;
+}
+
+
+/*!	Returns a free tracker of the queue; waits for one, if there is none.
+	The queue must be locked.
+*/
+static nvme_tracker*
+allocate_tracker(nvme_queue_pair* queue, InterruptsSpinLocker& locker)
+{
+	while (queue->free_trackers == NULL) {
+		ConditionVariableEntry entry;
+		queue->condition.Add(&entry);
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+
+	nvme_tracker* tracker = queue->free_trackers;
+	queue->free_trackers = tracker->next;
+	tracker->operation = NULL;
+	tracker->done = false;
+	return tracker;
+}
+
+
+/*!	Returns the I/O queue of the given CPU. Since threads might be
+	rescheduled on another CPU anytime, the CPU is merely a hint, but using
+	another CPU's queue is perfectly fine, as they are all locked.
+*/
+static inline nvme_queue_pair*
+cpu_queue(nvme_driver_info* info, int32 cpu)
+{
+	return &info->queues[cpu % info->queue_count];
+}
+
+
+/*!	Returns the I/O queue for commands the current thread executes itself. */
+static inline nvme_queue_pair*
+current_queue(nvme_driver_info* info)
+{
+	return cpu_queue(info, smp_get_current_cpu());
+}
+
+
+/*!	Returns the I/O queue for the given operation. This is the queue of the
+	CPU that issued its request, not the one of the I/O scheduler thread that
+	submits it.
+*/
+static inline nvme_queue_pair*
+operation_queue(nvme_driver_info* info, IOOperation* operation)
+{
+	return cpu_queue(info, operation->Parent()->IssuingCPU());
+}
+
+
+static bool
+process_completions(nvme_queue_pair* queue)
+{
+	nvme_driver_info* info = queue->info;
+	bool processed = false;
+
+	while (nvme_completion* completion = next_completion(queue)) {
+		processed = true;
+
+		if (completion->cid >= queue->entries - 1) {
+			ERROR("completion for invalid command %u on queue %u\n",
+				completion->cid, queue->id);
+			continue;
+		}
+
+		nvme_tracker* tracker = &queue->trackers[completion->cid];
+		IOOperation* operation = tracker->operation;
+		nvme_namespace* ns = tracker->ns;
+		if (operation == NULL) {
+			// a synchronous command, the waiter will free the tracker
+			tracker->status = completion->status;
+			tracker->done = true;
+			continue;
+		}
+
+		status_t status = nvme_status_to_error(completion->status);
+		if (status != B_OK) {
+			ERROR("I/O error on queue %u: status %#x\n", queue->id,
+				completion->status >> 1);
+		}
+
+		free_tracker(queue, tracker);
+		ns->io_scheduler->OperationCompleted(operation, status,
+			status == B_OK ? operation->Length() : 0);
+	}
+
+	if (processed) {
+		write_register(info, queue->completion_doorbell,
+			queue->completion_head);
+		queue->condition.NotifyAll();
+	}
+
+	return processed;
+}
+
+
+static int32
+nvme_queue_interrupt(void* data)
+{
+	nvme_queue_pair* queue = (nvme_queue_pair*)data;
+
+	SpinLocker locker(queue->lock);
+	return process_completions(queue)
+		? B_HANDLED_INTERRUPT : B_UNHANDLED_INTERRUPT;
+}
+
+
+/*!	Submits the command to the queue, and waits for it to be completed.
+	The tracker will be freed afterwards.
+*/
+static status_t
+execute_command(nvme_queue_pair* queue, nvme_tracker* tracker,
+	nvme_command& command, InterruptsSpinLocker& locker)
+{
+	command.cid = tracker - queue->trackers;
+	submit_command(queue, command);
+
+	while (!tracker->done) {
+		ConditionVariableEntry entry;
+		queue->condition.Add(&entry);
+		locker.Unlock();
+		entry.Wait();
+		locker.Lock();
+	}
+
+	status_t status = nvme_status_to_error(tracker->status);
+	free_tracker(queue, tracker);
+	queue->condition.NotifyAll();
+
+	return status;
+}
+
+
+/*!	Executes an admin command. Since admin commands are rare, and only used
+	while initializing the controller, their completion is polled for.
+*/
+static status_t
+execute_admin_command(nvme_driver_info* info, nvme_command& command,
+	uint32* _result = NULL)
+{
+	MutexLocker locker(info->admin_lock);
+	nvme_queue_pair* queue = &info->admin_queue;
+
+	command.cid = queue->submission_tail;
+	submit_command(queue, command);
+
+	bigtime_t timeout = system_time() + kAdminCommandTimeout;
+	nvme_completion* completion;
+	while ((completion = next_completion(queue)) == NULL) {
+		if (system_time() > timeout) {
+			ERROR("admin command %#x timed out\n", command.opcode);
+			return B_TIMED_OUT;
+		}
+		snooze(10);
+	}
+
+	uint16 status = completion->status;
+	if (_result != NULL)
+		*_result = completion->result;
+
+	write_register(info, queue->completion_doorbell, queue->completion_head);
+
+	if (NVME_STATUS_CODE(status) != NVME_SC_SUCCESS
+		|| NVME_STATUS_TYPE(status) != NVME_SCT_GENERIC) {
+		ERROR("admin command %#x failed: status %#x\n", command.opcode,
+			status >> 1);
+	}
+
+	return nvme_status_to_error(status);
+}
+
+
+//	#pragma mark - data transfer
+
+
+/*!	Sets up the data pointer of the command for the given physical vecs,
+	either as an SGL, or as PRP entries. Returns \c B_BAD_VALUE if the vecs
+	cannot be described by PRP entries, ie. if a vec in the middle does not
+	start or end on a page boundary.
+*/
+static status_t
+set_data_pointer(nvme_driver_info* info, nvme_tracker* tracker,
+	nvme_command& command, const generic_io_vec* vecs, uint32 vecCount)
+{
+	if (info->supports_sgl) {
+		if (vecCount > kMaxSGLDescriptors)
+			return B_BAD_VALUE;
+
+		command.flags |= NVME_CMD_PSDT_SGL;
+
+		if (vecCount == 1) {
+			command.data.sgl.address = vecs[0].base;
+			command.data.sgl.length = vecs[0].length;
+			command.data.sgl.type = NVME_SGL_DATA_BLOCK;
+			return B_OK;
+		}
+
+		nvme_sgl_descriptor* descriptors = (nvme_sgl_descriptor*)tracker->page;
+		memset(descriptors, 0, vecCount * sizeof(nvme_sgl_descriptor));
+		for (uint32 i = 0; i < vecCount; i++) {
+			descriptors[i].address = vecs[i].base;
+			descriptors[i].length = vecs[i].length;
+			descriptors[i].type = NVME_SGL_DATA_BLOCK;
+		}
+
+		command.data.sgl.address = tracker->page_physical;
+		command.data.sgl.length = vecCount * sizeof(nvme_sgl_descriptor);
+		command.data.sgl.type = NVME_SGL_LAST_SEGMENT;
+		return B_OK;
+	}
+
+	// The first entry may start anywhere, all further ones must be page
+	// aligned, and all but the last must end on a page boundary.
+	uint64* list = (uint64*)tracker->page;
+	uint32 listCount = 0;
+	uint32 maxListCount = B_PAGE_SIZE / sizeof(uint64);
+
+	command.data.prp.prp1 = vecs[0].base;
+	command.data.prp.prp2 = 0;
+
+	for (uint32 i = 0; i < vecCount; i++) {
+		generic_addr_t base = vecs[i].base;
+		generic_addr_t end = base + vecs[i].length;
+		if ((i > 0 && base % B_PAGE_SIZE != 0)
+			|| (i < vecCount - 1 && end % B_PAGE_SIZE != 0)) {
+			return B_BAD_VALUE;
+		}
+
+		generic_addr_t page = i == 0
+			? ROUNDDOWN(base, B_PAGE_SIZE) + B_PAGE_SIZE : base;
+		for (; page < end; page += B_PAGE_SIZE) {
+			if (listCount == maxListCount)
+				return B_BAD_VALUE;
+			list[listCount++] = page;
+		}
+	}
+
+	if (listCount == 1)
+		command.data.prp.prp2 = list[0];
+	else if (listCount > 1)
+		command.data.prp.prp2 = tracker->page_physical;
+
+	return B_OK;
+}
+
+
+static void
+set_block_range(nvme_namespace* ns, nvme_command& command, off_t offset,
+	generic_size_t length)
+{
+	uint64 block = offset / ns->block_size;
+	command.nsid = ns->id;
+	command.cdw10 = (uint32)block;
+	command.cdw11 = (uint32)(block >> 32);
+	command.cdw12 = length / ns->block_size - 1;
+}
+
+
+/*!	Transfers the operation through the bounce buffer, for the rare case
+	that its vecs cannot be handed to the controller directly. The transfer
+	is done synchronously.
+*/
+static status_t
+do_bounced_io(nvme_namespace* ns, IOOperation* operation)
+{
+	nvme_driver_info* info = ns->info;
+	MutexLocker bounceLocker(info->bounce_lock);
+
+	const generic_io_vec* vecs = operation->Vecs();
+	uint32 vecCount = operation->VecCount();
+	generic_size_t length = operation->Length();
+	status_t status = B_OK;
+
+	if (operation->IsWrite()) {
+		uint8* buffer = (uint8*)info->bounce_buffer;
+		for (uint32 i = 0; i < vecCount && status == B_OK; i++) {
+			status = vm_memcpy_from_physical(buffer, vecs[i].base,
+				vecs[i].length, false);
+			buffer += vecs[i].length;
+		}
+	}
+
+	if (status == B_OK) {
+		nvme_command command;
+		memset(&command, 0, sizeof(command));
+		command.opcode = operation->IsWrite() ? NVME_CMD_WRITE : NVME_CMD_READ;
+		set_block_range(ns, command, operation->Offset(), length);
+
+		generic_io_vec vec;
+		vec.base = info->bounce_buffer_physical;
+		vec.length = length;
+
+		nvme_queue_pair* queue = operation_queue(info, operation);
+		InterruptsSpinLocker locker(queue->lock);
+		nvme_tracker* tracker = allocate_tracker(queue, locker);
+		set_data_pointer(info, tracker, command, &vec, 1);
+		status = execute_command(queue, tracker, command, locker);
+	}
+
+	if (status == B_OK && !operation->IsWrite()) {
+		const uint8* buffer = (const uint8*)info->bounce_buffer;
+		for (uint32 i = 0; i < vecCount && status == B_OK; i++) {
+			status = vm_memcpy_to_physical(vecs[i].base, buffer,
+				vecs[i].length, false);
+			buffer += vecs[i].length;
+		}
+	}
+
+	ns->io_scheduler->OperationCompleted(operation, status,
+		status == B_OK ? length : 0);
+	return status;
+}
+
+
+static status_t
+do_io(void* cookie, IOOperation* operation)
+{
+	nvme_namespace* ns = (nvme_namespace*)cookie;
+	nvme_driver_info* info = ns->info;
+
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = operation->IsWrite() ? NVME_CMD_WRITE : NVME_CMD_READ;
+	set_block_range(ns, command, operation->Offset(), operation->Length());
+
+	nvme_queue_pair* queue = operation_queue(info, operation);
+	InterruptsSpinLocker locker(queue->lock);
+
+	nvme_tracker* tracker = allocate_tracker(queue, locker);
+	if (set_data_pointer(info, tracker, command, operation->Vecs(),
+			operation->VecCount()) != B_OK) {
+		free_tracker(queue, tracker);
+		locker.Unlock();
+		return do_bounced_io(ns, operation);
+	}
+
+	// the operation is completed by the interrupt handler
+	tracker->operation = operation;
+	tracker->ns = ns;
+	command.cid = tracker - queue->trackers;
+	submit_command(queue, command);
+
+	return B_OK;
+}
+
+
+static status_t
+flush_cache(nvme_namespace* ns)
+{
+	nvme_driver_info* info = ns->info;
+	if (!info->volatile_cache)
+		return B_OK;
+
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_CMD_FLUSH;
+	command.nsid = ns->id;
+
+	nvme_queue_pair* queue = current_queue(info);
+	InterruptsSpinLocker locker(queue->lock);
+	nvme_tracker* tracker = allocate_tracker(queue, locker);
+	return execute_command(queue, tracker, command, locker);
+}
+
+
+static status_t
+trim_ranges(nvme_namespace* ns, nvme_dsm_range* ranges, uint32 count)
+{
+	nvme_driver_info* info = ns->info;
+
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_CMD_DSM;
+	command.nsid = ns->id;
+	command.cdw10 = count - 1;
+	command.cdw11 = NVME_DSM_DEALLOCATE;
+
+	nvme_queue_pair* queue = current_queue(info);
+	InterruptsSpinLocker locker(queue->lock);
+	nvme_tracker* tracker = allocate_tracker(queue, locker);
+
+	memcpy(tracker->page, ranges, count * sizeof(nvme_dsm_range));
+	command.data.prp.prp1 = tracker->page_physical;
+
+	return execute_command(queue, tracker, command, locker);
+}
+
+
+static status_t
+trim_device(nvme_namespace* ns, fs_trim_data* trimData)
+{
+	trimData->trimmed_size = 0;
+
+	if (!ns->info->supports_trim)
+		return B_NOT_SUPPORTED;
+
+	nvme_dsm_range* ranges = (nvme_dsm_range*)malloc(
+		kMaxDSMRanges * sizeof(nvme_dsm_range));
+	if (ranges == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter rangesDeleter(ranges);
+
+	uint32 count = 0;
+	uint64 trimmedBlocks = 0;
+	status_t status = B_OK;
+
+	for (uint32 i = 0; i < trimData->range_count && status == B_OK; i++) {
+		// only trim whole blocks
+		uint64 start = (trimData->ranges[i].offset + ns->block_size - 1)
+			/ ns->block_size;
+		uint64 end = (trimData->ranges[i].offset + trimData->ranges[i].size)
+			/ ns->block_size;
+		end = min_c(end, ns->capacity);
+
+		while (start < end && status == B_OK) {
+			uint32 length = (uint32)min_c(end - start, (uint64)UINT32_MAX);
+			ranges[count].attributes = 0;
+			ranges[count].length = length;
+			ranges[count].slba = start;
+			count++;
+			start += length;
+
+			if (count == kMaxDSMRanges) {
+				status = trim_ranges(ns, ranges, count);
+				count = 0;
+			}
+			if (status == B_OK)
+				trimmedBlocks += length;
+		}
+	}
+
+	if (count > 0 && status == B_OK)
+		status = trim_ranges(ns, ranges, count);
+
+	if (status == B_OK)
+		trimData->trimmed_size = trimmedBlocks * ns->block_size;
+
+	return status;
+}
+
+
+//	#pragma mark - controller initialization
+
+
+static status_t
+map_registers(nvme_driver_info* info)
+{
+	pci_info* pciInfo = &info->pci_info;
+
+	phys_addr_t address = pciInfo->u.h0.base_registers[0]
+		& PCI_address_memory_32_mask;
+	if ((pciInfo->u.h0.base_register_flags[0] & PCI_address_type)
+			== PCI_address_type_64) {
+		address |= (uint64)pciInfo->u.h0.base_registers[1] << 32;
+	}
+
+	size_t size = ROUNDUP(pciInfo->u.h0.base_register_sizes[0], B_PAGE_SIZE);
+	if (address == 0 || size == 0) {
+		ERROR("BAR 0 not assigned\n");
+		return B_DEV_NOT_READY;
+	}
+
+	void* registers;
+	info->registers_area = map_physical_memory("nvme registers", address,
+		size, B_ANY_KERNEL_ADDRESS, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA,
+		&registers);
+	if (info->registers_area < 0)
+		return info->registers_area;
+
+	info->registers = (volatile uint8*)registers;
+
+	// enable bus mastering and memory space access
+	uint16 command = info->pci->read_pci_config(info->device, PCI_command, 2);
+	command |= PCI_command_master | PCI_command_memory;
+	command &= ~PCI_command_io;
+	info->pci->write_pci_config(info->device, PCI_command, 2, command);
+
+	return B_OK;
+}
+
+
+static status_t
+enable_controller(nvme_driver_info* info)
+{
+	info->capabilities = read_register(info, NVME_CAP)
+		| (uint64)read_register(info, NVME_CAP + 4) << 32;
+	info->doorbell_stride = 4 << NVME_CAP_DSTRD(info->capabilities);
+
+	if (NVME_CAP_MPSMIN(info->capabilities) != 0) {
+		ERROR("controller does not support %d byte pages\n", B_PAGE_SIZE);
+		return B_NOT_SUPPORTED;
+	}
+
+	uint32 version = read_register(info, NVME_VS);
+	TRACE_ALWAYS("NVMe %" B_PRIu32 ".%" B_PRIu32 " controller, capabilities %#"
+		B_PRIx64 "\n", version >> 16, (version >> 8) & 0xff,
+		info->capabilities);
+
+	// disable the controller, if the firmware left it running
+	uint32 config = read_register(info, NVME_CC);
+	if ((config & NVME_CC_ENABLE) != 0) {
+		write_register(info, NVME_CC, config & ~NVME_CC_ENABLE);
+		status_t status = wait_for_ready(info, false);
+		if (status != B_OK) {
+			ERROR("could not disable controller: %s\n", strerror(status));
+			return status;
+		}
+	}
+
+	uint16 entries = min_c(kAdminQueueEntries,
+		NVME_CAP_MQES(info->capabilities) + 1);
+	status_t status = init_queue_pair(info, &info->admin_queue, 0, entries,
+		false);
+	if (status != B_OK)
+		return status;
+
+	write_register(info, NVME_AQA, (entries - 1) << 16 | (entries - 1));
+	write_register64(info, NVME_ASQ, info->admin_queue.submission_physical);
+	write_register64(info, NVME_ACQ, info->admin_queue.completion_physical);
+
+	// Interrupt vector 0 must stay unmasked: without MSI-X, it is shared
+	// with the I/O queue. The admin queue is polled, and acknowledged right
+	// away, so it won't keep the interrupt asserted. With MSI-X, INTMS and
+	// INTMC must not be used at all.
+
+	write_register(info, NVME_CC, NVME_CC_ENABLE | NVME_CC_CSS_NVM
+		| NVME_CC_MPS(12) | NVME_CC_AMS_RR | NVME_CC_IOSQES(6)
+		| NVME_CC_IOCQES(4));
+
+	status = wait_for_ready(info, true);
+	if (status != B_OK)
+		ERROR("could not enable controller: %s\n", strerror(status));
+
+	return status;
+}
+
+
+static void
+shutdown_controller(nvme_driver_info* info)
+{
+	uint32 config = read_register(info, NVME_CC);
+	if ((config & NVME_CC_ENABLE) == 0)
+		return;
+
+	write_register(info, NVME_CC,
+		(config & ~NVME_CC_SHN_MASK) | NVME_CC_SHN_NORMAL);
+
+	bigtime_t timeout = system_time() + kShutdownTimeout;
+	while ((read_register(info, NVME_CSTS) & NVME_CSTS_SHST_MASK)
+			!= NVME_CSTS_SHST_COMPLETE) {
+		if (system_time() > timeout) {
+			ERROR("controller shutdown timed out\n");
+			break;
+		}
+		snooze(1000);
+	}
+}
+
+
+static void
+copy_identify_string(char* target, const char* source, size_t length)
+{
+	memcpy(target, source, length);
+	target[length] = '\0';
+
+	// strip the padding
+	while (length > 0 && target[length - 1] == ' ')
+		target[--length] = '\0';
+}
+
+
+/*!	Reads the size and block size of the namespace. Returns
+	\c B_ENTRY_NOT_FOUND if the namespace is not active, and
+	\c B_DEV_UNREADABLE if we cannot use it.
+*/
+static status_t
+identify_namespace(nvme_namespace* ns, void* buffer, phys_addr_t physicalBuffer)
+{
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_IDENTIFY;
+	command.nsid = ns->id;
+	command.data.prp.prp1 = physicalBuffer;
+	command.cdw10 = NVME_IDENTIFY_NAMESPACE;
+
+	status_t status = execute_admin_command(ns->info, command);
+	if (status != B_OK)
+		return status;
+
+	nvme_identify_namespace* identify = (nvme_identify_namespace*)buffer;
+	uint8 format = identify->flbas & 0xf;
+
+	ns->capacity = identify->nsze;
+	if (ns->capacity == 0)
+		return B_ENTRY_NOT_FOUND;
+
+	if (identify->lbaf[format].lbads < 9 || identify->lbaf[format].lbads > 16
+		|| identify->lbaf[format].ms != 0) {
+		return B_DEV_UNREADABLE;
+	}
+
+	ns->block_size = 1 << identify->lbaf[format].lbads;
+	return B_OK;
+}
+
+
+/*!	Fills \a ids with the IDs of the active namespaces, and returns their
+	number. Controllers before NVMe 1.1 cannot list their active namespaces;
+	for those, all valid IDs are returned, and the inactive ones are sorted
+	out by identify_namespace().
+*/
+static uint32
+get_active_namespaces(nvme_driver_info* info, uint32 namespaceCount,
+	void* buffer, phys_addr_t physicalBuffer, uint32* ids)
+{
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_IDENTIFY;
+	command.nsid = 0;
+		// list all active namespaces, starting with the first one
+	command.data.prp.prp1 = physicalBuffer;
+	command.cdw10 = NVME_IDENTIFY_ACTIVE_NAMESPACES;
+
+	uint32 count = 0;
+
+	if (execute_admin_command(info, command) == B_OK) {
+		const uint32* list = (const uint32*)buffer;
+		for (uint32 i = 0; i < B_PAGE_SIZE / sizeof(uint32) && list[i] != 0
+				&& count < kMaxNamespaces; i++) {
+			ids[count++] = list[i];
+		}
+	} else {
+		for (uint32 id = 1; id <= namespaceCount && count < kMaxNamespaces;
+				id++) {
+			ids[count++] = id;
+		}
+	}
+
+	if (count == kMaxNamespaces && namespaceCount > kMaxNamespaces) {
+		ERROR("only using the first %" B_PRIu32 " of up to %" B_PRIu32
+			" namespaces\n", kMaxNamespaces, namespaceCount);
+	}
+
+	return count;
+}
+
+
+static status_t
+identify(nvme_driver_info* info)
+{
+	void* buffer;
+	area_id area = create_area("nvme identify", &buffer, B_ANY_KERNEL_ADDRESS,
+		B_PAGE_SIZE, B_FULL_LOCK, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (area < 0)
+		return area;
+
+	physical_entry entry;
+	get_memory_map(buffer, B_PAGE_SIZE, &entry, 1);
+
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_IDENTIFY;
+	command.data.prp.prp1 = entry.address;
+	command.cdw10 = NVME_IDENTIFY_CONTROLLER;
+
+	status_t status = execute_admin_command(info, command);
+	if (status != B_OK) {
+		delete_area(area);
+		return status;
+	}
+
+	nvme_identify_controller* controller = (nvme_identify_controller*)buffer;
+	copy_identify_string(info->model, controller->mn,
+		sizeof(controller->mn));
+
+	info->supports_sgl = (controller->sgls & NVME_SGLS_SUPPORTED) != 0;
+	info->supports_trim = (controller->oncs & NVME_ONCS_DSM) != 0;
+	info->volatile_cache = (controller->vwc & NVME_VWC_PRESENT) != 0;
+
+	info->max_transfer_size = kMaxTransferSize;
+	if (controller->mdts != 0 && controller->mdts < 32) {
+		info->max_transfer_size = min_c(info->max_transfer_size,
+			(uint64)B_PAGE_SIZE << controller->mdts);
+	}
+
+	uint32 namespaceCount = controller->nn;
+
+	TRACE_ALWAYS("%s, %" B_PRIu32 " namespaces, max transfer %" B_PRIu32
+		", SGL %d, trim %d, volatile cache %d\n", info->model, namespaceCount,
+		info->max_transfer_size, info->supports_sgl, info->supports_trim,
+		info->volatile_cache);
+
+	uint32 ids[kMaxNamespaces];
+	uint32 count = get_active_namespaces(info, namespaceCount, buffer,
+		entry.address, ids);
+	if (count > 0) {
+		info->namespaces = (nvme_namespace*)calloc(count,
+			sizeof(nvme_namespace));
+		if (info->namespaces == NULL) {
+			delete_area(area);
+			return B_NO_MEMORY;
+		}
+	}
+
+	for (uint32 i = 0; i < count; i++) {
+		nvme_namespace* ns = &info->namespaces[info->namespace_count];
+		ns->info = info;
+		ns->id = ids[i];
+		ns->device_id = -1;
+		ns->media_status = B_OK;
+
+		status = identify_namespace(ns, buffer, entry.address);
+		if (status == B_DEV_UNREADABLE)
+			ERROR("namespace %" B_PRIu32 " is not usable\n", ns->id);
+		if (status != B_OK)
+			continue;
+
+		TRACE_ALWAYS("namespace %" B_PRIu32 ": %" B_PRIu64 " blocks of %"
+			B_PRIu32 " bytes\n", ns->id, ns->capacity, ns->block_size);
+		info->namespace_count++;
+	}
+
+	delete_area(area);
+
+	if (info->namespace_count == 0) {
+		ERROR("no usable namespaces\n");
+		return B_DEV_UNREADABLE;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Sets up the interrupts for up to \a queueCount I/O queues. Returns the
+	number of queues that can be used, or an error code.
+*/
+static int32
+setup_interrupts(nvme_driver_info* info, int32 queueCount)
+{
+	pci_info* pciInfo = &info->pci_info;
+
+	info->irq_type = NVME_IRQ_LEGACY;
+	info->irq = pciInfo->u.h0.interrupt_line;
+
+	if (sPCIx86Module != NULL) {
+		uint8 msixCount = sPCIx86Module->get_msix_count(pciInfo->bus,
+			pciInfo->device, pciInfo->function);
+		uint8 vector;
+		if (msixCount >= 1) {
+			queueCount = min_c(queueCount, msixCount);
+			if (sPCIx86Module->configure_msix(pciInfo->bus, pciInfo->device,
+					pciInfo->function, queueCount, &vector) == B_OK
+				&& sPCIx86Module->enable_msix(pciInfo->bus, pciInfo->device,
+					pciInfo->function) == B_OK) {
+				TRACE_ALWAYS("using MSI-X count %" B_PRId32 " starting at %u\n",
+					queueCount, vector);
+				info->irq = vector;
+				info->irq_type = NVME_IRQ_MSI_X;
+				return queueCount;
+			}
+			ERROR("couldn't use MSI-X\n");
+		}
+
+		if (sPCIx86Module->get_msi_count(pciInfo->bus, pciInfo->device,
+				pciInfo->function) >= 1
+			&& sPCIx86Module->configure_msi(pciInfo->bus, pciInfo->device,
+				pciInfo->function, 1, &vector) == B_OK
+			&& sPCIx86Module->enable_msi(pciInfo->bus, pciInfo->device,
+				pciInfo->function) == B_OK) {
+			TRACE_ALWAYS("using MSI vector %u\n", vector);
+			info->irq = vector;
+			info->irq_type = NVME_IRQ_MSI;
+		}
+	}
+
+	if (info->irq_type == NVME_IRQ_LEGACY) {
+		if (info->irq == 0 || info->irq == 0xff) {
+			ERROR("PCI IRQ not assigned\n");
+			return B_ERROR;
+		}
+		TRACE_ALWAYS("using legacy interrupt %u\n", info->irq);
+	}
+
+	// without MSI-X, there is only a single vector for a single queue
+	return 1;
+}
+
+
+static void
+remove_interrupts(nvme_driver_info* info)
+{
+	for (int32 i = 0; i < info->queue_count; i++) {
+		nvme_queue_pair* queue = &info->queues[i];
+		remove_io_interrupt_handler(queue->vector, nvme_queue_interrupt,
+			queue);
+	}
+
+	if (info->irq_type != NVME_IRQ_LEGACY && sPCIx86Module != NULL) {
+		pci_info* pciInfo = &info->pci_info;
+		sPCIx86Module->disable_msi(pciInfo->bus, pciInfo->device,
+			pciInfo->function);
+		sPCIx86Module->unconfigure_msi(pciInfo->bus, pciInfo->device,
+			pciInfo->function);
+	}
+}
+
+
+static status_t
+create_io_queue(nvme_driver_info* info, nvme_queue_pair* queue, int32 index)
+{
+	if (info->irq_type == NVME_IRQ_MSI_X)
+		queue->vector = info->irq + index;
+	else
+		queue->vector = info->irq;
+
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_CREATE_CQ;
+	command.data.prp.prp1 = queue->completion_physical;
+	command.cdw10 = (uint32)(queue->entries - 1) << 16 | queue->id;
+	command.cdw11 = (uint32)(info->irq_type == NVME_IRQ_MSI_X ? index : 0) << 16
+		| NVME_CQ_INTERRUPTS_ENABLED | NVME_QUEUE_PHYS_CONTIGUOUS;
+	status_t status = execute_admin_command(info, command);
+	if (status != B_OK)
+		return status;
+
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_CREATE_SQ;
+	command.data.prp.prp1 = queue->submission_physical;
+	command.cdw10 = (uint32)(queue->entries - 1) << 16 | queue->id;
+	command.cdw11 = (uint32)queue->id << 16 | NVME_QUEUE_PHYS_CONTIGUOUS;
+	status = execute_admin_command(info, command);
+	if (status != B_OK)
+		return status;
+
+	status = install_io_interrupt_handler(queue->vector, nvme_queue_interrupt,
+		queue, 0);
+	if (status != B_OK) {
+		ERROR("can't install interrupt handler: %s\n", strerror(status));
+		return status;
+	}
+
+	// let the CPU that most likely submits to the queue handle its
+	// completions, too
+	if (info->irq_type == NVME_IRQ_MSI_X)
+		assign_io_interrupt_to_cpu(queue->vector, index % smp_get_num_cpus());
+
+	return B_OK;
+}
+
+
+static status_t
+create_io_queues(nvme_driver_info* info)
+{
+	int32 queueCount = min_c(smp_get_num_cpus(), kMaxQueuePairs);
+	queueCount = setup_interrupts(info, queueCount);
+	if (queueCount < 0)
+		return queueCount;
+
+	// ask the controller how many queues we may have
+	nvme_command command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVME_ADMIN_SET_FEATURES;
+	command.cdw10 = NVME_FEATURE_NUMBER_OF_QUEUES;
+	command.cdw11 = (queueCount - 1) << 16 | (queueCount - 1);
+
+	uint32 result;
+	status_t status = execute_admin_command(info, command, &result);
+	if (status != B_OK)
+		return status;
+
+	queueCount = min_c(queueCount, (int32)(result & 0xffff) + 1);
+	queueCount = min_c(queueCount, (int32)(result >> 16) + 1);
+
+	info->queues = (nvme_queue_pair*)calloc(queueCount,
+		sizeof(nvme_queue_pair));
+	if (info->queues == NULL)
+		return B_NO_MEMORY;
+
+	uint16 entries = min_c(kQueueEntries,
+		NVME_CAP_MQES(info->capabilities) + 1);
+
+	for (int32 i = 0; i < queueCount; i++) {
+		nvme_queue_pair* queue = &info->queues[i];
+		status = init_queue_pair(info, queue, i + 1, entries, true);
+		if (status == B_OK)
+			status = create_io_queue(info, queue, i);
+		if (status != B_OK) {
+			uninit_queue_pair(queue);
+			break;
+		}
+
+		info->queue_count = i + 1;
+	}
+
+	if (info->queue_count == 0)
+		return status;
+
+	if (status != B_OK) {
+		// just make do with the queues we have
+		ERROR("could only set up %" B_PRId32 " I/O queues: %s\n",
+			info->queue_count, strerror(status));
+	}
+
+	TRACE_ALWAYS("using %" B_PRId32 " I/O queues with %u entries\n",
+		info->queue_count, entries);
+	return B_OK;
+}
+
+
+static status_t
+init_io_scheduler(nvme_namespace* ns)
+{
+	nvme_driver_info* info = ns->info;
+
+	dma_restrictions restrictions;
+	memset(&restrictions, 0, sizeof(restrictions));
+	restrictions.alignment = 4;
+	restrictions.max_transfer_size = info->max_transfer_size;
+	restrictions.max_segment_count = info->supports_sgl
+		? kMaxSGLDescriptors : info->max_transfer_size / B_PAGE_SIZE + 1;
+
+	ns->dma_resource = new(std::nothrow) DMAResource;
+	if (ns->dma_resource == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = ns->dma_resource->Init(restrictions, ns->block_size,
+		1024, 32);
+	if (status != B_OK)
+		return status;
+
+	ns->io_scheduler = new(std::nothrow) IOSchedulerSimple(ns->dma_resource);
+	if (ns->io_scheduler == NULL)
+		return B_NO_MEMORY;
+
+	status = ns->io_scheduler->Init("nvme");
+	if (status != B_OK)
+		return status;
+
+	ns->io_scheduler->SetCallback(do_io, ns);
+	return B_OK;
+}
+
+
+/*!	Creates the buffer for the transfers we cannot do directly; it is shared
+	by all namespaces.
+*/
+static status_t
+init_bounce_buffer(nvme_driver_info* info)
+{
+	info->bounce_area = create_area("nvme bounce buffer",
+		&info->bounce_buffer, B_ANY_KERNEL_ADDRESS, info->max_transfer_size,
+		B_CONTIGUOUS, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+	if (info->bounce_area < 0)
+		return info->bounce_area;
+
+	physical_entry entry;
+	get_memory_map(info->bounce_buffer, B_PAGE_SIZE, &entry, 1);
+	info->bounce_buffer_physical = entry.address;
+
+	return B_OK;
+}
+
+
+static void
+free_driver_info(nvme_driver_info* info)
+{
+	for (uint32 i = 0; i < info->namespace_count; i++) {
+		delete info->namespaces[i].io_scheduler;
+		delete info->namespaces[i].dma_resource;
+	}
+	free(info->namespaces);
+
+	if (info->queues != NULL) {
+		for (int32 i = 0; i < info->queue_count; i++)
+			uninit_queue_pair(&info->queues[i]);
+		free(info->queues);
+	}
+	uninit_queue_pair(&info->admin_queue);
+
+	if (info->bounce_area >= 0)
+		delete_area(info->bounce_area);
+	if (info->registers_area >= 0)
+		delete_area(info->registers_area);
+
+	mutex_destroy(&info->admin_lock);
+	mutex_destroy(&info->bounce_lock);
+	free(info);
+}
+
+
+//	#pragma mark - device module API
+
+
+static status_t
+get_geometry(nvme_disk_handle* handle, device_geometry* geometry)
+{
+	nvme_namespace* ns = handle->ns;
+
+	devfs_compute_geometry_size(geometry, ns->capacity, ns->block_size);
+
+	geometry->device_type = B_DISK;
+	geometry->removable = false;
+	geometry->read_only = false;
+	geometry->write_once = false;
+
+	return B_OK;
+}
+
+
+static status_t
+nvme_disk_init_device(void* _info, void** _cookie)
+{
+	CALLED();
+	*_cookie = _info;
+	return B_OK;
+}
+
+
+static void
+nvme_disk_uninit_device(void* _cookie)
+{
+	CALLED();
+}
+
+
+static status_t
+nvme_disk_open(void* _info, const char* path, int openMode, void** _cookie)
+{
+	CALLED();
+	nvme_driver_info* info = (nvme_driver_info*)_info;
+
+	// all namespaces share the same device node, so we have to find out
+	// which one is meant by its path
+	nvme_namespace* ns = NULL;
+	for (uint32 i = 0; i < info->namespace_count; i++) {
+		if (strcmp(info->namespaces[i].device_name, path) == 0) {
+			ns = &info->namespaces[i];
+			break;
+		}
+	}
+	if (ns == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	nvme_disk_handle* handle = (nvme_disk_handle*)malloc(
+		sizeof(nvme_disk_handle));
+	if (handle == NULL)
+		return B_NO_MEMORY;
+
+	handle->ns = ns;
+
+	*_cookie = handle;
+	return B_OK;
+}
+
+
+static status_t
+nvme_disk_close(void* cookie)
+{
+	CALLED();
+	return B_OK;
+}
+
+
+static status_t
+nvme_disk_free(void* cookie)
+{
+	CALLED();
+	nvme_disk_handle* handle = (nvme_disk_handle*)cookie;
+
+	free(handle);
+	return B_OK;
+}
+
+
+static status_t
+nvme_disk_read(void* cookie, off_t pos, void* buffer, size_t* _length)
+{
+	CALLED();
+	nvme_disk_handle* handle = (nvme_disk_handle*)cookie;
+	size_t length = *_length;
+
+	IORequest request;
+	status_t status = request.Init(pos, (addr_t)buffer, length, false, 0);
+	if (status != B_OK)
+		return status;
+
+	status = handle->ns->io_scheduler->ScheduleRequest(&request);
+	if (status != B_OK)
+		return status;
+
+	status = request.Wait(0, 0);
+	if (status == B_OK)
+		*_length = length;
+	else
+		dprintf("read(): request.Wait() returned: %s\n", strerror(status));
+
+	return status;
+}
+
+
+static status_t
+nvme_disk_write(void* cookie, off_t pos, const void* buffer, size_t* _length)
+{
+	CALLED();
+	nvme_disk_handle* handle = (nvme_disk_handle*)cookie;
+	size_t length = *_length;
+
+	IORequest request;
+	status_t status = request.Init(pos, (addr_t)buffer, length, true, 0);
+	if (status != B_OK)
+		return status;
+
+	status = handle->ns->io_scheduler->ScheduleRequest(&request);
+	if (status != B_OK)
+		return status;
+
+	status = request.Wait(0, 0);
+	if (status == B_OK)
+		*_length = length;
+	else
+		dprintf("write(): request.Wait() returned: %s\n", strerror(status));
+
+	return status;
+}
+
+
+static status_t
+nvme_disk_io(void* cookie, io_request* request)
+{
+	CALLED();
+	nvme_disk_handle* handle = (nvme_disk_handle*)cookie;
+
+	return handle->ns->io_scheduler->ScheduleRequest(request);
+}
+
+
+static status_t
+nvme_disk_ioctl(void* cookie, uint32 op, void* buffer, size_t length)
+{
+	CALLED();
+	nvme_disk_handle* handle = (nvme_disk_handle*)cookie;
+	nvme_namespace* ns = handle->ns;
+
+	TRACE("ioctl(op = %" B_PRIu32 ")\n", op);
+
+	switch (op) {
+		case B_GET_MEDIA_STATUS:
+		{
+			*(status_t*)buffer = ns->media_status;
+			ns->media_status = B_OK;
+			return B_OK;
+		}
+
+		case B_GET_DEVICE_SIZE:
+		{
+			size_t size = ns->capacity * ns->block_size;
+			return user_memcpy(buffer, &size, sizeof(size_t));
+		}
+
+		case B_GET_GEOMETRY:
+		{
+			if (buffer == NULL)
+				return B_BAD_VALUE;
+
+			device_geometry geometry;
+			status_t status = get_geometry(handle, &geometry);
+			if (status != B_OK)
+				return status;
+
+			return user_memcpy(buffer, &geometry, sizeof(device_geometry));
+		}
+
+		case B_GET_ICON_NAME:
+			return user_strlcpy((char*)buffer, "devices/drive-harddisk",
+				B_FILE_NAME_LENGTH);
+
+		case B_GET_DEVICE_NAME:
+			return user_strlcpy((char*)buffer, ns->info->model, length);
+
+		case B_FLUSH_DRIVE_CACHE:
+			return flush_cache(ns);
+
+		case B_TRIM_DEVICE:
+		{
+			fs_trim_data* trimData;
+			MemoryDeleter deleter;
+			status_t status = get_trim_data_from_user(buffer, length, deleter,
+				trimData);
+			if (status != B_OK)
+				return status;
+
+			status = trim_device(ns, trimData);
+			if (status != B_OK)
+				return status;
+
+			return copy_trim_data_to_user(buffer, trimData);
+		}
+	}
+
+	return B_DEV_INVALID_IOCTL;
+}
+
+
+//	#pragma mark - driver module API
+
+
+static float
+nvme_disk_supports_device(device_node* parent)
+{
+	CALLED();
+	const char* bus;
+	uint16 baseClass, subClass, classAPI;
+
+	if (sDeviceManager->get_attr_string(parent, B_DEVICE_BUS, &bus, false)
+			!= B_OK
+		|| strcmp(bus, "pci") != 0) {
+		return 0.0f;
+	}
+
+	if (sDeviceManager->get_attr_uint16(parent, B_DEVICE_TYPE, &baseClass,
+			false) != B_OK
+		|| sDeviceManager->get_attr_uint16(parent, B_DEVICE_SUB_TYPE,
+			&subClass, false) != B_OK
+		|| sDeviceManager->get_attr_uint16(parent, B_DEVICE_INTERFACE,
+			&classAPI, false) != B_OK) {
+		return 0.0f;
+	}
+
+	if (baseClass != PCI_mass_storage || subClass != PCI_nvm
+		|| (classAPI != PCI_nvm_hci && classAPI != PCI_nvm_hci_enterprise)) {
+		return 0.0f;
+	}
+
+	TRACE("NVMe controller found!\n");
+	return 0.8f;
+}
+
+
+static status_t
+nvme_disk_register_device(device_node* parent)
+{
+	CALLED();
+
+	device_attr attrs[] = {
+		{ B_DEVICE_PRETTY_NAME, B_STRING_TYPE, { string: "NVMe Disk" }},
+		{ NULL }
+	};
+
+	return sDeviceManager->register_node(parent, NVME_DISK_DRIVER_MODULE_NAME,
+		attrs, NULL, NULL);
+}
+
+
+static status_t
+nvme_disk_init_driver(device_node* node, void** cookie)
+{
+	CALLED();
+
+	nvme_driver_info* info = (nvme_driver_info*)malloc(
+		sizeof(nvme_driver_info));
+	if (info == NULL)
+		return B_NO_MEMORY;
+
+	memset(info, 0, sizeof(*info));
+	info->node = node;
+	info->registers_area = -1;
+	info->bounce_area = -1;
+	info->admin_queue.area = -1;
+	info->admin_queue.tracker_area = -1;
+	mutex_init(&info->admin_lock, "nvme admin queue");
+	mutex_init(&info->bounce_lock, "nvme bounce buffer");
+
+	device_node* parent = sDeviceManager->get_parent_node(node);
+	sDeviceManager->get_driver(parent, (driver_module_info**)&info->pci,
+		(void**)&info->device);
+	sDeviceManager->put_node(parent);
+
+	info->pci->get_pci_info(info->device, &info->pci_info);
+
+	status_t status = map_registers(info);
+	if (status == B_OK)
+		status = enable_controller(info);
+	if (status == B_OK)
+		status = identify(info);
+	if (status == B_OK)
+		status = create_io_queues(info);
+	if (status == B_OK)
+		status = init_bounce_buffer(info);
+	for (uint32 i = 0; status == B_OK && i < info->namespace_count; i++)
+		status = init_io_scheduler(&info->namespaces[i]);
+
+	if (status != B_OK) {
+		ERROR("initializing controller failed: %s\n", strerror(status));
+		if (info->registers != NULL) {
+			remove_interrupts(info);
+			shutdown_controller(info);
+		}
+		free_driver_info(info);
+		return status;
+	}
+
+	*cookie = info;
+	return B_OK;
+}
+
+
+static void
+nvme_disk_uninit_driver(void* _cookie)
+{
+	CALLED();
+	nvme_driver_info* info = (nvme_driver_info*)_cookie;
+
+	for (uint32 i = 0; i < info->namespace_count; i++)
+		flush_cache(&info->namespaces[i]);
+	remove_interrupts(info);
+	shutdown_controller(info);
+	free_driver_info(info);
+}
+
+
+static status_t
+nvme_disk_register_child_devices(void* _cookie)
+{
+	CALLED();
+	nvme_driver_info* info = (nvme_driver_info*)_cookie;
+
+	for (uint32 i = 0; i < info->namespace_count; i++) {
+		nvme_namespace* ns = &info->namespaces[i];
+
+		ns->device_id = sDeviceManager->create_id(
+			NVME_DISK_DEVICE_ID_GENERATOR);
+		if (ns->device_id < 0)
+			return ns->device_id;
+
+		snprintf(ns->device_name, sizeof(ns->device_name),
+			"disk/nvme/%" B_PRId32 "/raw", ns->device_id);
+
+		status_t status = sDeviceManager->publish_device(info->node,
+			ns->device_name, NVME_DISK_DEVICE_MODULE_NAME);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+std_ops(int32 op, ...)
+{
+	switch (op) {
+		case B_MODULE_INIT:
+			if (get_module(B_PCI_X86_MODULE_NAME,
+					(module_info**)&sPCIx86Module) != B_OK) {
+				sPCIx86Module = NULL;
+			}
+			return B_OK;
+
+		case B_MODULE_UNINIT:
+			if (sPCIx86Module != NULL)
+				put_module(B_PCI_X86_MODULE_NAME);
+			return B_OK;
+	}
+
+	return B_ERROR;
+}
+
+
+//	#pragma mark -
+
+
+module_dependency module_dependencies[] = {
+	{B_DEVICE_MANAGER_MODULE_NAME, (module_info**)&sDeviceManager},
+	{}
+};
+
+struct device_module_info sNvmeDiskDevice = {
+	{
+		NVME_DISK_DEVICE_MODULE_NAME,
+		0,
+		NULL
+	},
+
+	nvme_disk_init_device,
+	nvme_disk_uninit_device,
+	NULL, // remove,
+
+	nvme_disk_open,
+	nvme_disk_close,
+	nvme_disk_free,
+	nvme_disk_read,
+	nvme_disk_write,
+	nvme_disk_io,
+	nvme_disk_ioctl,
+
+	NULL,	// select
+	NULL,	// deselect
+};
+
+struct driver_module_info sNvmeDiskDriver = {
+	{
+		NVME_DISK_DRIVER_MODULE_NAME,
+		0,
+		std_ops
+	},
+
+	nvme_disk_supports_device,
+	nvme_disk_register_device,
+	nvme_disk_init_driver,
+	nvme_disk_uninit_driver,
+	nvme_disk_register_child_devices,
+	NULL,	// rescan
+	NULL,	// removed
+};
+
+module_info* modules[] = {
+	(module_info*)&sNvmeDiskDriver,
+	(module_info*)&sNvmeDiskDevice,
+	NULL
+};
@@ -22,12 +22,14 @@
 #include <stdlib.h>
 
 #include <AutoDeleter.h>
+#include <driver_settings.h>
 
 #include <fs/devfs.h>
 #include <util/fs_trim_support.h>
 
 #include "dma_resources.h"
 #include "IORequest.h"
+#include "IOSchedulerDeadline.h"
 #include "IOSchedulerSimple.h"
 
 
@@ -439,6 +441,25 @@ das_ioctl(void* cookie, uint32 op, void* buffer, size_t length)
 //	#pragma mark - scsi_periph callbacks
 
 
+/*!	The deadline I/O scheduler has not seen much testing yet, so it is only
+	used if "io_scheduler deadline" is set in the kernel settings.
+*/
+static bool
+use_deadline_io_scheduler()
+{
+	void* settings = load_driver_settings("kernel");
+	if (settings == NULL)
+		return false;
+
+	const char* scheduler = get_driver_parameter(settings, "io_scheduler",
+		NULL, NULL);
+	bool useDeadline = scheduler != NULL && strcmp(scheduler, "deadline") == 0;
+
+	unload_driver_settings(settings);
+	return useDeadline;
+}
+
+
 static void
 das_set_capacity(das_driver_info* info, uint64 capacity, uint32 blockSize)
 {
@@ -466,8 +487,13 @@ das_set_capacity(das_driver_info* info, uint64 capacity, uint32 blockSize)
 		if (status != B_OK)
 			panic("initializing DMAResource failed: %s", strerror(status));
 
-		info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
-			info->dma_resource);
+		if (use_deadline_io_scheduler()) {
+			info->io_scheduler = new(std::nothrow) IOSchedulerDeadline(
+				info->dma_resource);
+		} else {
+			info->io_scheduler = new(std::nothrow) IOSchedulerSimple(
+				info->dma_resource);
+		}
 		if (info->io_scheduler == NULL)
 			panic("allocating IOScheduler failed.");
 
@@ -184,7 +184,7 @@ virtio_block_config_callback(void* driverCookie)
 
 
 static void
-virtio_block_callback(void* driverCookie, void* cookie)
+virtio_block_callback(void* driverCookie, void* cookie, uint32 usedLength)
 {
 	virtio_block_driver_info* info = (virtio_block_driver_info*)cookie;
 
@@ -8,8 +8,13 @@
 #include <virtio.h>
 
 #include <net/if_media.h>
+#include <netinet/ip.h>
 #include <new>
 
+#include <condition_variable.h>
+#include <smp.h>
+#include <util/AutoLock.h>
+
 #include "ether_driver.h"
 #define ETHER_ADDR_LEN	ETHER_ADDRESS_LENGTH
 #include "virtio_net.h"
@@ -19,37 +24,112 @@
 #define VIRTIO_NET_DEVICE_ID_GENERATOR	"virtio_net/device_id"
 
 #define BUFFER_SIZE	2048
+	// size of the receive and transmit buffers; frames that don't fit are
+	// spread over several of them
 // #define MAX_FRAME_SIZE	(BUFFER_SIZE - sizeof(virtio_net_hdr))
 #define MAX_FRAME_SIZE 1536
+#define MAX_TX_BUFFERS	((sizeof(virtio_net_hdr_mrg_rxbuf) \
+	+ ETHER_HEADER_LENGTH + IP_MAXPACKET + BUFFER_SIZE - 1) / BUFFER_SIZE)
+	// maximum number of buffers used for a single (TSO) frame
+#define MAX_QUEUE_BUFFERS	256
+
+static const bigtime_t kTxTimeout = 1000000;
+static const bigtime_t kCtrlTimeout = 1000000;
+
+
+struct virtio_net_driver_info;
+struct virtio_net_rx_queue;
+struct virtio_net_tx_queue;
+
+
+typedef struct virtio_net_rx_buffer {
+	virtio_net_rx_queue*	queue;
+	uint8*					data;
+	physical_entry			entry;
+	uint32					used_length;
+	uint16					frame_buffers;
+		// number of buffers of the frame starting in this buffer
+	virtio_net_rx_buffer*	next;
+} virtio_net_rx_buffer;
+
+
+typedef struct virtio_net_rx_queue {
+	virtio_net_driver_info*	info;
+	::virtio_queue			queue;
+	area_id					area;
+	virtio_net_rx_buffer*	buffers;
+	uint32					buffer_count;
+
+	spinlock				lock;
+	virtio_net_rx_buffer*	done_head;
+	virtio_net_rx_buffer*	done_tail;
+		// received buffers, in the order the device used them
+	uint32					frames_done;
+	uint16					frame_buffers_left;
+		// buffers still missing of the frame the device is delivering
+} virtio_net_rx_queue;
+
+
+typedef struct virtio_net_tx_buffer {
+	virtio_net_tx_queue*	queue;
+	uint8*					data;
+	physical_entry			entry;
+	uint32					count;
+		// number of buffers of the frame starting in this buffer
+	virtio_net_tx_buffer*	next;
+} virtio_net_tx_buffer;
+
+
+typedef struct virtio_net_tx_queue {
+	virtio_net_driver_info*	info;
+	::virtio_queue			queue;
+	area_id					area;
+	virtio_net_tx_buffer*	buffers;
+
+	spinlock				lock;
+	virtio_net_tx_buffer*	free_buffers;
+	uint32					free_count;
+	ConditionVariable		buffers_freed;
+} virtio_net_tx_queue;
+
 
 typedef struct {
+	virtio_net_ctrl_hdr		header;
+	virtio_net_ctrl_mq		mq;
+	uint8					ack;
+} virtio_net_ctrl_data;
+
+
+typedef struct virtio_net_driver_info {
 	device_node*			node;
 	::virtio_device			virtio_device;
 	virtio_device_interface*	virtio;
 
 	uint32 					features;
+	size_t					header_size;
 
 	uint32					pairs_count;
 
-	virtio_net_hdr			hdr;
-	physical_entry			hdr_entry;
-
-	::virtio_queue*			rx_queues;
-	uint8					rx_buffer[2048];
-	physical_entry			rx_entry;
+	virtio_net_rx_queue*	rx_queues;
 	sem_id 					rx_done;
+	uint32					rx_next;
 
-	::virtio_queue*			tx_queues;
-	uint8					tx_buffer[2048];
-	physical_entry			tx_entry;
-	sem_id 					tx_done;
+	virtio_net_tx_queue*	tx_queues;
 
 	::virtio_queue			ctrl_queue;
+	bool					has_ctrl_queue;
+	area_id					ctrl_area;
+	virtio_net_ctrl_data*	ctrl_data;
+	phys_addr_t				ctrl_physical;
+	sem_id					ctrl_done;
 
 	bool					nonblocking;
 	uint32					maxframesize;
 	uint8					macaddr[6];
 
+	uint32					offload;
+		// ETHER_OFFLOAD_* features enabled by the stack
+	bool					offload_header;
 } virtio_net_driver_info;
 
 
@@ -129,9 +209,371 @@ get_feature_name(uint32 feature)
 }
 
 
+static uint16
+compute_checksum(const uint8* data, size_t length)
+{
+	uint32 sum = 0;
+	for (; length > 1; data += 2, length -= 2)
+		sum += (data[0] << 8) | data[1];
+	if (length > 0)
+		sum += data[0] << 8;
+
+	while ((sum >> 16) != 0)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~(uint16)sum;
+}
+
+
+static area_id
+alloc_buffers(const char* name, size_t size, uint8** _address)
+{
+	return create_area(name, (void**)_address, B_ANY_KERNEL_ADDRESS,
+		ROUNDUP(size, B_PAGE_SIZE), B_FULL_LOCK,
+		B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+}
+
+
+/*!	Returns the ETHER_OFFLOAD_* features the negotiated device features
+	allow for.
+*/
+static uint32
+get_offload_features(virtio_net_driver_info* info)
+{
+	uint32 features = 0;
+	if ((info->features & VIRTIO_NET_F_CSUM) != 0) {
+		features |= ETHER_OFFLOAD_CHECKSUM;
+		if ((info->features & VIRTIO_NET_F_HOST_TSO4) != 0)
+			features |= ETHER_OFFLOAD_TSO4;
+		if ((info->features & VIRTIO_NET_F_HOST_TSO6) != 0)
+			features |= ETHER_OFFLOAD_TSO6;
+	}
+	if ((info->features & VIRTIO_NET_F_GUEST_CSUM) != 0)
+		features |= ETHER_OFFLOAD_RX_CHECKSUM;
+
+	return features;
+}
+
+
+//	#pragma mark - receive queues
+
+
+static void
+virtio_net_rx_done(void* driverCookie, void* cookie, uint32 usedLength)
+{
+	CALLED();
+	virtio_net_rx_buffer* buffer = (virtio_net_rx_buffer*)cookie;
+	virtio_net_rx_queue* queue = buffer->queue;
+	virtio_net_driver_info* info = queue->info;
+
+	buffer->used_length = usedLength;
+	buffer->next = NULL;
+
+	SpinLocker locker(queue->lock);
+
+	if (queue->frame_buffers_left == 0) {
+		// this buffer starts a new frame
+		buffer->frame_buffers = 1;
+		if ((info->features & VIRTIO_NET_F_MRG_RXBUF) != 0) {
+			virtio_net_hdr_mrg_rxbuf* header
+				= (virtio_net_hdr_mrg_rxbuf*)buffer->data;
+			if (header->num_buffers > 1)
+				buffer->frame_buffers = header->num_buffers;
+		}
+		queue->frame_buffers_left = buffer->frame_buffers;
+	}
+
+	if (queue->done_tail != NULL)
+		queue->done_tail->next = buffer;
+	else
+		queue->done_head = buffer;
+	queue->done_tail = buffer;
+
+	if (--queue->frame_buffers_left > 0)
+		return;
+
+	queue->frames_done++;
+	locker.Unlock();
+
+	release_sem_etc(info->rx_done, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+static status_t
+virtio_net_rx_queue_buffer(virtio_net_rx_buffer* buffer)
+{
+	virtio_net_driver_info* info = buffer->queue->info;
+
+	// legacy devices want the header in its own descriptor
+	physical_entry entries[2];
+	entries[0].address = buffer->entry.address;
+	entries[0].size = info->header_size;
+	entries[1].address = buffer->entry.address + info->header_size;
+	entries[1].size = BUFFER_SIZE - info->header_size;
+
+	return info->virtio->queue_request_v(buffer->queue->queue, entries, 0, 2,
+		virtio_net_rx_done, buffer);
+}
+
+
+static status_t
+virtio_net_rx_queue_init(virtio_net_driver_info* info,
+	virtio_net_rx_queue* queue, ::virtio_queue virtioQueue)
+{
+	queue->info = info;
+	queue->queue = virtioQueue;
+	queue->buffer_count = min_c(info->virtio->queue_size(virtioQueue) / 2,
+		MAX_QUEUE_BUFFERS);
+	B_INITIALIZE_SPINLOCK(&queue->lock);
+
+	queue->buffers = new(std::nothrow)
+		virtio_net_rx_buffer[queue->buffer_count];
+	if (queue->buffers == NULL)
+		return B_NO_MEMORY;
+
+	uint8* data;
+	queue->area = alloc_buffers("virtio_net rx buffers",
+		queue->buffer_count * BUFFER_SIZE, &data);
+	if (queue->area < 0)
+		return queue->area;
+
+	for (uint32 i = 0; i < queue->buffer_count; i++) {
+		virtio_net_rx_buffer& buffer = queue->buffers[i];
+		buffer.queue = queue;
+		buffer.data = data + i * BUFFER_SIZE;
+		get_memory_map(buffer.data, BUFFER_SIZE, &buffer.entry, 1);
+		buffer.next = NULL;
+	}
+
+	return B_OK;
+}
+
+
+static void
+virtio_net_rx_queue_uninit(virtio_net_rx_queue* queue)
+{
+	if (queue->area >= 0)
+		delete_area(queue->area);
+	delete[] queue->buffers;
+}
+
+
+/*!	Completes the partial checksum of a received frame, if the stack
+	cannot do that itself.
+	Returns \c false if the frame had to be dropped instead.
+*/
+static bool
+virtio_net_rx_finish_checksum(virtio_net_driver_info* info,
+	virtio_net_rx_buffer* frame, size_t length)
+{
+	virtio_net_hdr* header = (virtio_net_hdr*)frame->data;
+	if ((header->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) == 0)
+		return true;
+	if (info->offload_header
+		&& (info->offload & ETHER_OFFLOAD_RX_CHECKSUM) != 0)
+		return true;
+
+	// frames spread over several buffers are never partial, as long as we
+	// don't accept any segmentation offload
+	uint32 start = header->csum_start;
+	uint32 offset = start + header->csum_offset;
+	if (frame->frame_buffers > 1 || start > length
+		|| offset + sizeof(uint16) > length) {
+		ERROR("rx: dropping frame with unsupported partial checksum\n");
+		return false;
+	}
+
+	uint8* data = frame->data + info->header_size;
+	uint16 checksum = compute_checksum(data + start, length - start);
+	data[offset] = checksum >> 8;
+	data[offset + 1] = checksum & 0xff;
+
+	header->flags &= ~VIRTIO_NET_HDR_F_NEEDS_CSUM;
+	return true;
+}
+
+
+//	#pragma mark - transmit queues
+
+
+static void
+virtio_net_tx_done(void* driverCookie, void* cookie, uint32 usedLength)
+{
+	CALLED();
+	virtio_net_tx_buffer* buffer = (virtio_net_tx_buffer*)cookie;
+	virtio_net_tx_queue* queue = buffer->queue;
+
+	virtio_net_tx_buffer* last = buffer;
+	for (uint32 i = 1; i < buffer->count; i++)
+		last = last->next;
+
+	InterruptsSpinLocker locker(queue->lock);
+
+	last->next = queue->free_buffers;
+	queue->free_buffers = buffer;
+	queue->free_count += buffer->count;
+
+	queue->buffers_freed.NotifyAll();
+}
+
+
+static status_t
+virtio_net_tx_queue_init(virtio_net_driver_info* info,
+	virtio_net_tx_queue* queue, ::virtio_queue virtioQueue)
+{
+	queue->info = info;
+	queue->queue = virtioQueue;
+	queue->free_count = min_c(info->virtio->queue_size(virtioQueue),
+		MAX_QUEUE_BUFFERS);
+	queue->free_buffers = NULL;
+	B_INITIALIZE_SPINLOCK(&queue->lock);
+	queue->buffers_freed.Init(queue, "virtio_net tx");
+
+	queue->buffers = new(std::nothrow) virtio_net_tx_buffer[queue->free_count];
+	if (queue->buffers == NULL)
+		return B_NO_MEMORY;
+
+	uint8* data;
+	queue->area = alloc_buffers("virtio_net tx buffers",
+		queue->free_count * BUFFER_SIZE, &data);
+	if (queue->area < 0)
+		return queue->area;
+
+	for (uint32 i = queue->free_count; i-- > 0;) {
+		virtio_net_tx_buffer& buffer = queue->buffers[i];
+		buffer.queue = queue;
+		buffer.data = data + i * BUFFER_SIZE;
+		get_memory_map(buffer.data, BUFFER_SIZE, &buffer.entry, 1);
+		buffer.count = 1;
+		buffer.next = queue->free_buffers;
+		queue->free_buffers = &buffer;
+	}
+
+	return B_OK;
+}
+
+
+static void
+virtio_net_tx_queue_uninit(virtio_net_tx_queue* queue)
+{
+	if (queue->area >= 0)
+		delete_area(queue->area);
+	delete[] queue->buffers;
+}
+
+
+/*!	Takes \a count buffers off the free list of the queue, waiting for the
+	device to finish sending earlier frames if needed.
+*/
+static status_t
+virtio_net_tx_get_buffers(virtio_net_tx_queue* queue, uint32 count,
+	virtio_net_tx_buffer** _first)
+{
+	while (true) {
+		InterruptsSpinLocker locker(queue->lock);
+
+		if (queue->free_count >= count) {
+			virtio_net_tx_buffer* first = queue->free_buffers;
+			virtio_net_tx_buffer* last = first;
+			for (uint32 i = 1; i < count; i++)
+				last = last->next;
+
+			queue->free_buffers = last->next;
+			queue->free_count -= count;
+			last->next = NULL;
+
+			first->count = count;
+			*_first = first;
+			return B_OK;
+		}
+
+		ConditionVariableEntry entry;
+		queue->buffers_freed.Add(&entry);
+		locker.Unlock();
+
+		status_t status = entry.Wait(B_RELATIVE_TIMEOUT, kTxTimeout);
+		if (status != B_OK)
+			return status;
+	}
+}
+
+
+//	#pragma mark - control queue
+
+
+static void
+virtio_net_ctrl_done(void* driverCookie, void* cookie, uint32 usedLength)
+{
+	CALLED();
+	virtio_net_driver_info* info = (virtio_net_driver_info*)cookie;
+	release_sem_etc(info->ctrl_done, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+static status_t
+virtio_net_set_queue_pairs(virtio_net_driver_info* info, uint16 pairs)
+{
+	virtio_net_ctrl_data* data = info->ctrl_data;
+	data->header.net_class = VIRTIO_NET_CTRL_MQ;
+	data->header.cmd = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+	data->mq.virtqueue_pairs = pairs;
+	data->ack = VIRTIO_NET_ERR;
+
+	physical_entry entries[3];
+	entries[0].address = info->ctrl_physical
+		+ offsetof(virtio_net_ctrl_data, header);
+	entries[0].size = sizeof(data->header);
+	entries[1].address = info->ctrl_physical
+		+ offsetof(virtio_net_ctrl_data, mq);
+	entries[1].size = sizeof(data->mq);
+	entries[2].address = info->ctrl_physical
+		+ offsetof(virtio_net_ctrl_data, ack);
+	entries[2].size = sizeof(data->ack);
+
+	status_t status = info->virtio->queue_request_v(info->ctrl_queue, entries,
+		2, 1, virtio_net_ctrl_done, info);
+	if (status != B_OK)
+		return status;
+
+	status = acquire_sem_etc(info->ctrl_done, 1, B_RELATIVE_TIMEOUT,
+		kCtrlTimeout);
+	if (status != B_OK)
+		return status;
+
+	return data->ack == VIRTIO_NET_OK ? B_OK : B_ERROR;
+}
+
+
 //	#pragma mark - device module API
 
 
+static void
+virtio_net_free_queues(virtio_net_driver_info* info)
+{
+	if (info->rx_queues != NULL) {
+		for (uint32 i = 0; i < info->pairs_count; i++)
+			virtio_net_rx_queue_uninit(&info->rx_queues[i]);
+	}
+	if (info->tx_queues != NULL) {
+		for (uint32 i = 0; i < info->pairs_count; i++)
+			virtio_net_tx_queue_uninit(&info->tx_queues[i]);
+	}
+	delete[] info->rx_queues;
+	delete[] info->tx_queues;
+	info->rx_queues = NULL;
+	info->tx_queues = NULL;
+
+	if (info->ctrl_area >= 0)
+		delete_area(info->ctrl_area);
+	info->ctrl_area = -1;
+
+	delete_sem(info->rx_done);
+	delete_sem(info->ctrl_done);
+	info->rx_done = -1;
+	info->ctrl_done = -1;
+}
+
+
 static status_t
 virtio_net_init_device(void* _info, void** _cookie)
 {
@@ -144,29 +586,46 @@ virtio_net_init_device(void* _info, void** _cookie)
 	sDeviceManager->put_node(parent);
 
 	info->virtio->negociate_features(info->virtio_device,
-		VIRTIO_NET_F_STATUS | VIRTIO_NET_F_MAC
-		/* VIRTIO_NET_F_CTRL_VQ | VIRTIO_NET_F_MQ */,
+		VIRTIO_NET_F_STATUS | VIRTIO_NET_F_MAC | VIRTIO_NET_F_CSUM
+			| VIRTIO_NET_F_GUEST_CSUM | VIRTIO_NET_F_HOST_TSO4
+			| VIRTIO_NET_F_HOST_TSO6 | VIRTIO_NET_F_MRG_RXBUF
+			| VIRTIO_NET_F_CTRL_VQ | VIRTIO_NET_F_MQ,
 		 &info->features, &get_feature_name);
 
+	if ((info->features & VIRTIO_NET_F_MRG_RXBUF) != 0)
+		info->header_size = sizeof(virtio_net_hdr_mrg_rxbuf);
+	else
+		info->header_size = sizeof(virtio_net_hdr);
+
+	// The control queue follows the maximum number of queue pairs the
+	// device supports, even if we use fewer of them.
+	uint16 maxPairs = 1;
 	if ((info->features & VIRTIO_NET_F_MQ) != 0
-			&& (info->features & VIRTIO_NET_F_CTRL_VQ) != 0
-			&& info->virtio->read_device_config(info->virtio_device,
+		&& (info->features & VIRTIO_NET_F_CTRL_VQ) != 0) {
+		if (info->virtio->read_device_config(info->virtio_device,
 				offsetof(struct virtio_net_config, max_virtqueue_pairs),
-				&info->pairs_count, sizeof(info->pairs_count)) == B_OK) {
-		system_info sysinfo;
-		if (get_system_info(&sysinfo) == B_OK
-			&& info->pairs_count > sysinfo.cpu_count) {
-			info->pairs_count = sysinfo.cpu_count;
+				&maxPairs, sizeof(maxPairs)) != B_OK || maxPairs == 0)
+			maxPairs = 1;
+	}
+
+	info->has_ctrl_queue = (info->features & VIRTIO_NET_F_CTRL_VQ) != 0;
+	uint32 queueCount = maxPairs * 2;
+	if (info->has_ctrl_queue) {
+		queueCount++;
+		if (queueCount > VIRTIO_VIRTQUEUES_MAX_COUNT) {
+			// we cannot reach the control queue, stick with the first pair
+			info->has_ctrl_queue = false;
+			maxPairs = 1;
+			queueCount = 2;
 		}
-	} else
-		info->pairs_count = 1;
+	}
 
-	// TODO read config
+	info->pairs_count = min_c(maxPairs, smp_get_num_cpus());
+	info->rx_done = -1;
+	info->ctrl_done = -1;
+	info->ctrl_area = -1;
 
 	// Setup queues
-	uint32 queueCount = info->pairs_count * 2;
-	if ((info->features & VIRTIO_NET_F_CTRL_VQ) != 0)
-		queueCount++;
 	::virtio_queue virtioQueues[queueCount];
 	status_t status = info->virtio->alloc_queues(info->virtio_device, queueCount,
 		virtioQueues);
@@ -175,32 +634,90 @@ virtio_net_init_device(void* _info, void** _cookie)
 		return status;
 	}
 
-	info->rx_queues = new(std::nothrow) virtio_queue[info->pairs_count];
-	info->tx_queues = new(std::nothrow) virtio_queue[info->pairs_count];
-	if (info->rx_queues == NULL || info->tx_queues == NULL)
+	info->rx_queues = new(std::nothrow) virtio_net_rx_queue[info->pairs_count];
+	info->tx_queues = new(std::nothrow) virtio_net_tx_queue[info->pairs_count];
+	if (info->rx_queues == NULL || info->tx_queues == NULL) {
+		delete[] info->rx_queues;
+		delete[] info->tx_queues;
+		info->rx_queues = NULL;
+		info->tx_queues = NULL;
 		return B_NO_MEMORY;
+	}
 	for (uint32 i = 0; i < info->pairs_count; i++) {
-		info->rx_queues[i] = virtioQueues[i * 2];
-		info->tx_queues[i] = virtioQueues[i * 2 + 1];
+		info->rx_queues[i].area = -1;
+		info->rx_queues[i].buffers = NULL;
+		info->tx_queues[i].area = -1;
+		info->tx_queues[i].buffers = NULL;
 	}
-	if ((info->features & VIRTIO_NET_F_CTRL_VQ) != 0)
-		info->ctrl_queue = virtioQueues[info->pairs_count * 2];
 
 	// Setup buffers
-	get_memory_map(&info->rx_buffer, sizeof(info->tx_buffer), &info->rx_entry, 1);
-	get_memory_map(&info->tx_buffer, sizeof(info->tx_buffer), &info->tx_entry, 1);
-	get_memory_map(&info->hdr, sizeof(info->hdr), &info->hdr_entry, 1);
+	for (uint32 i = 0; i < info->pairs_count; i++) {
+		status = virtio_net_rx_queue_init(info, &info->rx_queues[i],
+			virtioQueues[i * 2]);
+		if (status == B_OK) {
+			status = virtio_net_tx_queue_init(info, &info->tx_queues[i],
+				virtioQueues[i * 2 + 1]);
+		}
+		if (status != B_OK) {
+			ERROR("buffer allocation failed (%s)\n", strerror(status));
+			virtio_net_free_queues(info);
+			return status;
+		}
+	}
+
+	if (info->has_ctrl_queue) {
+		info->ctrl_queue = virtioQueues[maxPairs * 2];
+
+		info->ctrl_area = alloc_buffers("virtio_net control",
+			sizeof(virtio_net_ctrl_data), (uint8**)&info->ctrl_data);
+		if (info->ctrl_area < 0) {
+			status = info->ctrl_area;
+			virtio_net_free_queues(info);
+			return status;
+		}
+
+		physical_entry entry;
+		get_memory_map(info->ctrl_data, sizeof(virtio_net_ctrl_data), &entry,
+			1);
+		info->ctrl_physical = entry.address;
+	}
 
 	// Setup interrupt
 	info->rx_done = create_sem(0, "virtio_net_rx");
-	info->tx_done = create_sem(0, "virtio_net_tx");
+	info->ctrl_done = create_sem(0, "virtio_net_ctrl");
+	if (info->rx_done < 0 || info->ctrl_done < 0) {
+		virtio_net_free_queues(info);
+		return B_NO_MORE_SEMS;
+	}
 
 	status = info->virtio->setup_interrupt(info->virtio_device, NULL, info);
 	if (status != B_OK) {
 		ERROR("interrupt setup failed (%s)\n", strerror(status));
+		virtio_net_free_queues(info);
 		return status;
 	}
 
+	// Hand all receive buffers to the device
+	for (uint32 i = 0; i < info->pairs_count; i++) {
+		virtio_net_rx_queue* queue = &info->rx_queues[i];
+		for (uint32 j = 0; j < queue->buffer_count; j++) {
+			status = virtio_net_rx_queue_buffer(&queue->buffers[j]);
+			if (status != B_OK) {
+				ERROR("rx queueing on queue %" B_PRIu32 " failed (%s)\n", i,
+					strerror(status));
+				break;
+			}
+		}
+	}
+
+	if (info->pairs_count > 1
+		&& virtio_net_set_queue_pairs(info, info->pairs_count) != B_OK) {
+		// the device keeps using the first pair only
+		ERROR("could not enable %" B_PRIu32 " queue pairs\n",
+			info->pairs_count);
+		info->pairs_count = 1;
+	}
+
 	*_cookie = info;
 	return B_OK;
 }
@@ -212,10 +729,7 @@ virtio_net_uninit_device(void* _cookie)
 	CALLED();
 	virtio_net_driver_info* info = (virtio_net_driver_info*)_cookie;
 
-	delete_sem(info->rx_done);
-	delete_sem(info->tx_done);
-	delete[] info->rx_queues;
-	delete[] info->tx_queues;
+	virtio_net_free_queues(info);
 }
 
 
@@ -232,6 +746,8 @@ virtio_net_open(void* _info, const char* path, int openMode, void** _cookie)
 
 	info->nonblocking = (openMode & O_NONBLOCK) != 0;
 	info->maxframesize = MAX_FRAME_SIZE;
+	info->offload = 0;
+	info->offload_header = false;
 	handle->info = info;
 
 	if ((info->features & VIRTIO_NET_F_MAC) != 0) {
@@ -266,15 +782,6 @@ virtio_net_free(void* cookie)
 }
 
 
-static void
-virtio_net_rx_done(void* driverCookie, void* cookie)
-{
-	CALLED();
-	virtio_net_driver_info* info = (virtio_net_driver_info*)cookie;
-	release_sem_etc(info->rx_done, 1, B_DO_NOT_RESCHEDULE);
-}
-
-
 static status_t
 virtio_net_read(void* cookie, off_t pos, void* buffer, size_t* _length)
 {
@@ -282,41 +789,104 @@ virtio_net_read(void* cookie, off_t pos, void* buffer, size_t* _length)
 	virtio_net_handle* handle = (virtio_net_handle*)cookie;
 	virtio_net_driver_info* info = handle->info;
 
-	// return B_ERROR;
+	// wait for a complete frame on any of the queues
+	status_t status = acquire_sem_etc(info->rx_done, 1,
+		info->nonblocking ? B_RELATIVE_TIMEOUT : 0, 0);
+	if (status != B_OK) {
+		if (status == B_TIMED_OUT)
+			return B_WOULD_BLOCK;
+		ERROR("acquire_sem(rx_done) failed (%s)\n", strerror(status));
+		return status;
+	}
 
-	physical_entry entries[2];
-	entries[0] = info->hdr_entry;
-	entries[1] = info->rx_entry;
+	virtio_net_rx_buffer* frame = NULL;
+	for (uint32 i = 0; i < info->pairs_count && frame == NULL; i++) {
+		virtio_net_rx_queue* queue
+			= &info->rx_queues[(info->rx_next + i) % info->pairs_count];
 
-	memset(&info->hdr, 0, sizeof(info->hdr));
+		InterruptsSpinLocker locker(queue->lock);
+		if (queue->frames_done == 0)
+			continue;
 
-	// queue the rx buffer
-	status_t status = info->virtio->queue_request_v(info->rx_queues[0],
-		entries, 0, 2, virtio_net_rx_done, info);
-	if (status != B_OK) {
-		ERROR("rx queueing on queue %d failed (%s)\n", 0, strerror(status));
-		return status;
+		frame = queue->done_head;
+		virtio_net_rx_buffer* last = frame;
+		for (uint32 j = 1; j < frame->frame_buffers; j++)
+			last = last->next;
+
+		queue->done_head = last->next;
+		if (queue->done_head == NULL)
+			queue->done_tail = NULL;
+		last->next = NULL;
+		queue->frames_done--;
+
+		info->rx_next = (info->rx_next + i + 1) % info->pairs_count;
 	}
 
-	// wait for reception
-	status = acquire_sem(info->rx_done);
-	if (status != B_OK) {
-		ERROR("acquire_sem(rx_done) failed (%s)\n", strerror(status));
-		return status;
+	if (frame == NULL)
+		return B_ERROR;
+
+	size_t frameLength = 0;
+	for (virtio_net_rx_buffer* rxBuffer = frame; rxBuffer != NULL;
+			rxBuffer = rxBuffer->next) {
+		frameLength += rxBuffer->used_length;
 	}
+	frameLength -= min_c(frameLength, info->header_size);
+
+	size_t length = 0;
+	if (virtio_net_rx_finish_checksum(info, frame, frameLength)) {
+		uint8* target = (uint8*)buffer;
+		size_t bufferSize = *_length;
+
+		if (info->offload_header
+			&& bufferSize >= sizeof(ether_offload_header)) {
+			virtio_net_hdr* header = (virtio_net_hdr*)frame->data;
+			ether_offload_header offload;
+			memset(&offload, 0, sizeof(offload));
+
+			if ((header->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) != 0) {
+				offload.flags |= ETHER_FRAME_CHECKSUM_PARTIAL;
+				offload.checksum_start = header->csum_start;
+				offload.checksum_offset = header->csum_offset;
+			} else if ((header->flags & VIRTIO_NET_HDR_F_DATA_VALID) != 0
+				&& (info->offload & ETHER_OFFLOAD_RX_CHECKSUM) != 0)
+				offload.flags |= ETHER_FRAME_CHECKSUM_VALID;
+
+			status = user_memcpy(target, &offload, sizeof(offload));
+			target += sizeof(offload);
+			length += sizeof(offload);
+		}
 
-	*_length = MIN(entries[1].size, *_length);
-	user_memcpy(buffer, &info->rx_buffer, *_length);
-	return B_OK;
-}
+		size_t offset = info->header_size;
+		for (virtio_net_rx_buffer* rxBuffer = frame;
+				rxBuffer != NULL && status == B_OK;
+				rxBuffer = rxBuffer->next) {
+			size_t toCopy = min_c(rxBuffer->used_length - min_c(offset,
+				rxBuffer->used_length), bufferSize - length);
+			status = user_memcpy(target, rxBuffer->data + offset, toCopy);
+			target += toCopy;
+			length += toCopy;
+			offset = 0;
+		}
+	} else
+		status = B_BAD_DATA;
 
+	// give the buffers back to the device
+	while (frame != NULL) {
+		virtio_net_rx_buffer* next = frame->next;
+		frame->next = NULL;
 
-static void
-virtio_net_tx_done(void* driverCookie, void* cookie)
-{
-	CALLED();
-	virtio_net_driver_info* info = (virtio_net_driver_info*)cookie;
-	release_sem_etc(info->tx_done, 1, B_DO_NOT_RESCHEDULE);
+		status_t queueStatus = virtio_net_rx_queue_buffer(frame);
+		if (queueStatus != B_OK) {
+			ERROR("rx queueing failed (%s)\n", strerror(queueStatus));
+		}
+		frame = next;
+	}
+
+	if (status != B_OK)
+		return status;
+
+	*_length = length;
+	return B_OK;
 }
 
 
@@ -328,31 +898,112 @@ virtio_net_write(void* cookie, off_t pos, const void* buffer,
 	virtio_net_handle* handle = (virtio_net_handle*)cookie;
 	virtio_net_driver_info* info = handle->info;
 
-	// legacy interface: one descriptor for all
-	// so we have no choice but to concat a virtio_net_hdr with buffer data
-	// together...
+	const uint8* source = (const uint8*)buffer;
+	size_t length = *_length;
 
-	physical_entry entries[2];
-	entries[0] = info->hdr_entry;
-	entries[0].size = sizeof(virtio_net_hdr);
-	entries[1] = info->tx_entry;
-	entries[1].size = MIN(MAX_FRAME_SIZE, *_length);
+	ether_offload_header offload;
+	memset(&offload, 0, sizeof(offload));
+	if (info->offload_header) {
+		if (length < sizeof(offload)
+			|| user_memcpy(&offload, source, sizeof(offload)) != B_OK)
+			return B_BAD_VALUE;
 
-	memset(&info->hdr, 0, sizeof(info->hdr));
-	user_memcpy(&info->tx_buffer, buffer, MIN(MAX_FRAME_SIZE, *_length));
+		source += sizeof(offload);
+		length -= sizeof(offload);
+	}
 
-	// queue the virtio_net_hdr + buffer data
-	status_t status = info->virtio->queue_request_v(info->tx_queues[0],
-		entries, 2, 0, virtio_net_tx_done, info);
+	size_t maxLength = MAX_FRAME_SIZE;
+	if ((offload.flags
+			& (ETHER_FRAME_SEGMENT_TCP4 | ETHER_FRAME_SEGMENT_TCP6)) != 0)
+		maxLength = ETHER_HEADER_LENGTH + IP_MAXPACKET;
+	if (length > maxLength)
+		return B_BAD_VALUE;
+
+	// spread the virtio_net_hdr and the frame over as many buffers as needed
+	uint32 count = (info->header_size + length + BUFFER_SIZE - 1)
+		/ BUFFER_SIZE;
+
+	virtio_net_tx_queue* queue
+		= &info->tx_queues[smp_get_current_cpu() % info->pairs_count];
+	virtio_net_tx_buffer* first;
+	status_t status = virtio_net_tx_get_buffers(queue, count, &first);
 	if (status != B_OK) {
-		ERROR("tx queueing on queue %d failed (%s)\n", 0, strerror(status));
+		ERROR("no tx buffers available (%s)\n", strerror(status));
 		return status;
 	}
 
-	// wait for transmission done signal
-	status = acquire_sem_etc(info->tx_done, 1, B_RELATIVE_TIMEOUT, 10000);
+	// legacy devices want the header in its own descriptor
+	physical_entry entries[MAX_TX_BUFFERS + 1];
+	entries[0].address = first->entry.address;
+	entries[0].size = info->header_size;
+	uint32 entryCount = 1;
+
+	size_t offset = info->header_size;
+	size_t copied = 0;
+	for (virtio_net_tx_buffer* txBuffer = first; txBuffer != NULL;
+			txBuffer = txBuffer->next) {
+		size_t toCopy = min_c(BUFFER_SIZE - offset, length - copied);
+		if (user_memcpy(txBuffer->data + offset, source + copied, toCopy)
+				!= B_OK) {
+			status = B_BAD_ADDRESS;
+			break;
+		}
+
+		entries[entryCount].address = txBuffer->entry.address + offset;
+		entries[entryCount].size = toCopy;
+		entryCount++;
+
+		copied += toCopy;
+		offset = 0;
+	}
+
+	virtio_net_hdr* header = (virtio_net_hdr*)first->data;
+	memset(header, 0, info->header_size);
+
+	if ((offload.flags & ETHER_FRAME_CHECKSUM_PARTIAL) != 0) {
+		header->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		header->csum_start = offload.checksum_start;
+		header->csum_offset = offload.checksum_offset;
+	}
+
+	if (status == B_OK && (offload.flags
+			& (ETHER_FRAME_SEGMENT_TCP4 | ETHER_FRAME_SEGMENT_TCP6)) != 0) {
+		// the device needs to know the length of all headers to replicate
+		size_t tcpOffset = info->header_size + offload.checksum_start;
+		if ((offload.flags & ETHER_FRAME_CHECKSUM_PARTIAL) == 0
+			|| offload.checksum_start + 13u > length
+			|| tcpOffset + 13 > BUFFER_SIZE || offload.segment_size == 0) {
+			status = B_BAD_VALUE;
+		} else {
+			header->gso_type = (offload.flags & ETHER_FRAME_SEGMENT_TCP4) != 0
+				? VIRTIO_NET_HDR_GSO_TCPV4 : VIRTIO_NET_HDR_GSO_TCPV6;
+			header->gso_size = offload.segment_size;
+			header->hdr_len = offload.checksum_start
+				+ (first->data[tcpOffset + 12] >> 4) * 4;
+		}
+	}
+
+	bigtime_t timeout = system_time() + kTxTimeout;
+	while (status == B_OK) {
+		status = info->virtio->queue_request_v(queue->queue, entries,
+			entryCount, 0, virtio_net_tx_done, first);
+		if (status != B_BUSY || system_time() >= timeout)
+			break;
+
+		// the ring is full, wait until the device is done with something
+		InterruptsSpinLocker locker(queue->lock);
+		ConditionVariableEntry entry;
+		queue->buffers_freed.Add(&entry);
+		locker.Unlock();
+
+		entry.Wait(B_ABSOLUTE_TIMEOUT, timeout);
+		status = B_OK;
+	}
+
 	if (status != B_OK) {
-		ERROR("acquire_sem(tx_done) failed (%s)\n", strerror(status));
+		ERROR("tx queueing failed (%s)\n", strerror(status));
+		// put the buffers back
+		virtio_net_tx_done(info, first, 0);
 		return status;
 	}
 
@@ -419,6 +1070,23 @@ virtio_net_ioctl(void* cookie, uint32 op, void* buffer, size_t length)
 			return user_memcpy(buffer, &state, sizeof(ether_link_state_t));
 		}
 
+		case ETHER_GET_OFFLOAD:
+			TRACE("ioctl: get offload\n");
+			*(uint32*)buffer = get_offload_features(info);
+			return B_OK;
+
+		case ETHER_SET_OFFLOAD:
+		{
+			TRACE("ioctl: set offload\n");
+			uint32 offload = *(uint32*)buffer;
+			if ((offload & ~get_offload_features(info)) != 0)
+				return B_NOT_SUPPORTED;
+
+			info->offload = offload;
+			info->offload_header = true;
+			return B_OK;
+		}
+
 		default:
 			ERROR("ioctl: unknown message %" B_PRIx32 "\n", op);
 			break;
@@ -405,7 +405,9 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fFlushesStarted(0),
+	fFlushesDone(0)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
@@ -911,11 +913,20 @@ Journal::_WriteTransactionToLog()
 
 
 /*!	Flushes the current log entry to disk. If \a flushBlocks is \c true it will
-	also write back all dirty blocks for this volume.
+	also write back all dirty blocks for this volume. In any case, the drive's
+	cache is flushed as well, so that everything written to the device before
+	is safe when this method returns successfully.
+
+	Threads that want to flush the log at the same time share a single log
+	write and drive cache flush: a thread that has waited for the lock while
+	someone else started and completed a flush doesn't need to flush again,
+	unless it also needs to have the blocks written back.
 */
 status_t
 Journal::_FlushLog(bool canWait, bool flushBlocks)
 {
+	int32 flushesStarted = atomic_get(&fFlushesStarted);
+
 	status_t status = canWait ? recursive_lock_lock(&fLock)
 		: recursive_lock_trylock(&fLock);
 	if (status != B_OK)
@@ -927,22 +938,59 @@ Journal::_FlushLog(bool canWait, bool flushBlocks)
 		return B_OK;
 	}
 
+	if (!flushBlocks && fFlushesDone - flushesStarted > 0) {
+		// another thread did the work for us while we were waiting
+		recursive_lock_unlock(&fLock);
+		return B_OK;
+	}
+
+	int32 flush = atomic_add(&fFlushesStarted, 1) + 1;
+	bool driveCacheFlushed = false;
+
 	// write the current log entry to disk
 
 	if (fUnwrittenTransactions != 0 && _TransactionSize() != 0) {
 		status = _WriteTransactionToLog();
-		if (status < B_OK)
-			FATAL(("writing current log entry failed: %s\n", strerror(status)));
+		if (status < B_OK) {
+			FATAL(("writing current log entry failed: %s\n",
+				strerror(status)));
+		} else
+			driveCacheFlushed = true;
 	}
 
-	if (flushBlocks)
+	if (flushBlocks) {
 		status = fVolume->FlushDevice();
+		driveCacheFlushed = false;
+	}
+
+	if (status == B_OK) {
+		// _WriteTransactionToLog() already flushed the drive cache after
+		// writing the log; if it wasn't called, or if blocks have been written
+		// back since, we need to do it here. If that call fails, we can't do
+		// anything about it anyway.
+		if (!driveCacheFlushed)
+			ioctl(fVolume->Device(), B_FLUSH_DRIVE_CACHE);
+
+		fFlushesDone = flush;
+	}
 
 	recursive_lock_unlock(&fLock);
 	return status;
 }
 
 
+/*!	Writes all transactions that are done to the log, and flushes the drive
+	cache, so that they survive a crash, as well as anything else that has
+	been written to the device before. Unlike FlushLogAndBlocks(), this
+	doesn't wait for the blocks to be written back to their actual location.
+*/
+status_t
+Journal::FlushLog()
+{
+	return _FlushLog(true, false);
+}
+
+
 /*!	Flushes the current log entry to disk, and also writes back all dirty
 	blocks for this volume (completing all open transactions).
 */
@@ -1105,6 +1153,8 @@ Journal::Dump()
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
 	kprintf("  separate sub-trans.:  %d\n", fSeparateSubTransactions);
+	kprintf("  flushes:              %" B_PRId32 " (%" B_PRId32 " done)\n",
+		fFlushesStarted, fFlushesDone);
 	kprintf("entries:\n");
 	kprintf("  address        id  start length\n");
 
@@ -35,6 +35,7 @@ public:
 			size_t			CurrentTransactionSize() const;
 			bool			CurrentTransactionTooLarge() const;
 
+			status_t		FlushLog();
 			status_t		FlushLogAndBlocks();
 			Volume*			GetVolume() const { return fVolume; }
 			int32			TransactionID() const { return fTransactionID; }
@@ -76,6 +77,8 @@ private:
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
 			bool			fSeparateSubTransactions;
+			int32			fFlushesStarted;
+			int32			fFlushesDone;
 };
 
 
@@ -662,9 +662,13 @@ Volume::Identify(int fd, disk_super_block* superBlock)
 }
 
 
+/*!	Initializes the volume on \a fd. If \a logSize is not 0, a log of that
+	many blocks is created, instead of one sized after the volume; a larger
+	log allows more transactions to be batched into one log write.
+*/
 status_t
 Volume::Initialize(int fd, const char* name, uint32 blockSize,
-	uint32 flags)
+	uint32 flags, uint32 logSize)
 {
 	// although there is no really good reason for it, we won't
 	// accept '/' in disk names (mkbfs does this, too - and since
@@ -701,18 +705,27 @@ Volume::Initialize(int fd, const char* name, uint32 blockSize,
 	fBlockShift = fSuperBlock.BlockShift();
 	fAllocationGroupShift = fSuperBlock.AllocationGroupShift();
 
-	// determine log size depending on the size of the volume
-	off_t logSize = 2048;
-	if (numBlocks <= 20480)
-		logSize = 512;
-	if (deviceSize > 1LL * 1024 * 1024 * 1024)
-		logSize = 4096;
-
 	// since the allocator has not been initialized yet, we
 	// cannot use BlockAllocator::BitmapSize() here
 	off_t bitmapBlocks = (numBlocks + blockSize * 8 - 1) / (blockSize * 8);
 
 	fSuperBlock.log_blocks = ToBlockRun(bitmapBlocks + 1);
+
+	// determine log size depending on the size of the volume, unless one has
+	// been requested; that one must fit into the allocation group, and leave
+	// enough space for the rest of the file system
+	if (logSize == 0) {
+		logSize = 2048;
+		if (numBlocks <= 20480)
+			logSize = 512;
+		if (deviceSize > 1LL * 1024 * 1024 * 1024)
+			logSize = 4096;
+	} else if (logSize < 512 || logSize > MAX_BLOCK_RUN_LENGTH
+		|| Log().Start() + logSize > 1UL << AllocationGroupShift()
+		|| bitmapBlocks + 1 + logSize > numBlocks / 2) {
+		return B_BAD_VALUE;
+	}
+
 	fSuperBlock.log_blocks.length = HOST_ENDIAN_TO_BFS_INT16(logSize);
 	fSuperBlock.log_start = fSuperBlock.log_end = HOST_ENDIAN_TO_BFS_INT64(
 		ToBlock(Log()));
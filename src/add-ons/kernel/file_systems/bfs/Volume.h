@@ -36,7 +36,8 @@ public:
 			status_t		Mount(const char* device, uint32 flags);
 			status_t		Unmount();
 			status_t		Initialize(int fd, const char* name,
-								uint32 blockSize, uint32 flags);
+								uint32 blockSize, uint32 flags,
+								uint32 logSize = 0);
 
 			bool			IsInitializing() const { return fVolume == NULL; }
 
@@ -31,6 +31,12 @@ parse_initialize_parameters(const char* parameterString,
 	if (string != NULL)
 		blockSize = strtoul(string, NULL, 0);
 
+	// the log size is given in blocks, 0 lets the file system decide
+	string = get_driver_parameter(handle, "log_size", NULL, NULL);
+	uint32 logSize = 0;
+	if (string != NULL)
+		logSize = strtoul(string, NULL, 0);
+
 	delete_driver_settings(handle);
 
 	if (blockSize != 1024 && blockSize != 2048 && blockSize != 4096
@@ -39,6 +45,7 @@ parse_initialize_parameters(const char* parameterString,
 	}
 
 	parameters.blockSize = blockSize;
+	parameters.logSize = logSize;
 
 	return B_OK;
 }
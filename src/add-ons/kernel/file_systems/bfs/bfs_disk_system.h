@@ -11,6 +11,7 @@
 struct initialize_parameters {
 	uint32	blockSize;
 	uint32	flags;
+	uint32	logSize;
 	bool	verbose;
 };
 
@@ -786,8 +786,17 @@ bfs_fsync(fs_volume* _volume, fs_vnode* _node)
 {
 	FUNCTION();
 
+	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
-	return inode->Sync();
+
+	status_t status = inode->Sync();
+	if (status != B_OK)
+		return status;
+
+	// The data written above, and the changes to the inode itself are only
+	// safe once they are in the log, and the drive cache has been flushed;
+	// concurrent calls will share a single log write and drive cache flush.
+	return volume->GetJournal(0)->FlushLog();
 }
 
 
@@ -2318,7 +2327,7 @@ bfs_initialize(int fd, partition_id partitionID, const char* name,
 	// initialize the volume
 	Volume volume(NULL);
 	status = volume.Initialize(fd, name, parameters.blockSize,
-		parameters.flags);
+		parameters.flags, parameters.logSize);
 	if (status < B_OK) {
 		INFORM(("Initializing volume failed: %s\n", strerror(status)));
 		return status;
@@ -10,6 +10,7 @@
 
 #include <new>
 
+#include <fs_cache.h>
 #include <fs_info.h>
 #include <fs_interface.h>
 #include <KernelExport.h>
@@ -31,6 +32,7 @@
 
 
 static const uint32 kOptimalIOSize = 64 * 1024;
+static const int32 kMaxCompleteDirectoryEntries = 256;
 
 
 // #pragma mark - helper functions
@@ -115,6 +117,52 @@ packagefs_read_fs_info(fs_volume* fsVolume, struct fs_info* info)
 // #pragma mark - VNodes
 
 
+/*!	Called when looking up an entry in \a dir failed. If the directory is
+	small enough, all of its entries are added to the entry cache, so that
+	the VFS can resolve any further lookup in it, successful or not, without
+	calling us. Otherwise only the missing entry is added.
+	The caller must hold a read lock on the directory, so that it cannot be
+	changed before the entries are in the cache; since the node monitoring
+	notifications for a change are sent after the change has been done, they
+	will invalidate the cached entries again.
+*/
+static void
+cache_directory_entries(Volume* volume, Directory* dir, const char* entryName)
+{
+	int32 count = 0;
+	for (Node* child = dir->FirstChild(); child != NULL;
+			child = dir->NextChild(child)) {
+		if (++count > kMaxCompleteDirectoryEntries) {
+			entry_cache_add_missing(volume->ID(), dir->ID(), entryName);
+			return;
+		}
+	}
+
+	const char** names = (const char**)malloc(
+		(count + 1) * sizeof(const char*));
+	ino_t* nodeIDs = (ino_t*)malloc((count + 1) * sizeof(ino_t));
+	MemoryDeleter namesDeleter(names);
+	MemoryDeleter nodeIDsDeleter(nodeIDs);
+	if (names == NULL || nodeIDs == NULL) {
+		entry_cache_add_missing(volume->ID(), dir->ID(), entryName);
+		return;
+	}
+
+	int32 index = 0;
+	for (Node* child = dir->FirstChild(); child != NULL;
+			child = dir->NextChild(child)) {
+		names[index] = child->Name();
+		nodeIDs[index] = child->ID();
+		index++;
+	}
+
+	if (entry_cache_add_complete_directory(volume->ID(), dir->ID(), names,
+			nodeIDs, count) != B_OK) {
+		entry_cache_add_missing(volume->ID(), dir->ID(), entryName);
+	}
+}
+
+
 static status_t
 packagefs_lookup(fs_volume* fsVolume, fs_vnode* fsDir, const char* entryName,
 	ino_t* _vnid)
@@ -145,9 +193,12 @@ packagefs_lookup(fs_volume* fsVolume, fs_vnode* fsDir, const char* entryName,
 	// resolve normal entries -- look up the node
 	NodeReadLocker dirLocker(dir);
 	String entryNameString;
-	Node* node = dynamic_cast<Directory*>(dir)->FindChild(StringKey(entryName));
-	if (node == NULL)
+	Directory* directory = dynamic_cast<Directory*>(dir);
+	Node* node = directory->FindChild(StringKey(entryName));
+	if (node == NULL) {
+		cache_directory_entries(volume, directory, entryName);
 		return B_ENTRY_NOT_FOUND;
+	}
 	BReference<Node> nodeReference(node);
 	dirLocker.Unlock();
 
@@ -9,10 +9,12 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <new>
 
 #include <AppDefs.h>
@@ -24,6 +26,7 @@
 #include <AutoDeleter.h>
 #include <PackagesDirectoryDefs.h>
 
+#include <smp.h>
 #include <vfs.h>
 
 #include "AttributeIndex.h"
@@ -69,6 +72,9 @@ static const char* const kActivationFilePath
 	= PACKAGES_DIRECTORY_ADMIN_DIRECTORY "/"
 		PACKAGES_DIRECTORY_ACTIVATION_FILE;
 
+// maximum number of threads loading the initial packages
+static const int32 kMaxPackageLoaderThreads = 8;
+
 
 // #pragma mark - ShineThroughDirectory
 
@@ -159,6 +165,42 @@ private:
 };
 
 
+// #pragma mark - InitialPackageLoader
+
+
+/*!	Loads the packages to be added at mount time. Several threads may run it
+	at the same time, each picking the next package to load. The packages are
+	stored at their index, so that they can be added in the given order.
+*/
+struct Volume::InitialPackageLoader {
+	Volume*				volume;
+	PackagesDirectory*	packagesDirectory;
+	const char* const*	names;
+	Package**			packages;
+	status_t*			errors;
+	int32				count;
+	int32				nextIndex;
+
+	void Run()
+	{
+		while (true) {
+			int32 index = atomic_add(&nextIndex, 1);
+			if (index >= count)
+				return;
+
+			errors[index] = volume->_LoadPackage(packagesDirectory,
+				names[index], packages[index]);
+		}
+	}
+
+	static status_t ThreadEntry(void* data)
+	{
+		((InitialPackageLoader*)data)->Run();
+		return B_OK;
+	}
+};
+
+
 // #pragma mark - Volume
 
 
@@ -855,9 +897,22 @@ Volume::_AddInitialPackagesFromActivationFile(
 	// null-terminate to simplify parsing
 	fileContent[st.st_size] = '\0';
 
-	// parse the file and add the respective packages
-	const char* packageName = fileContent;
+	// Parse the file. There are at most as many package names as lines.
 	char* const fileContentEnd = fileContent + st.st_size;
+	int32 maxPackageCount = 1;
+	for (const char* c = fileContent; c < fileContentEnd; c++) {
+		if (*c == '\n')
+			maxPackageCount++;
+	}
+
+	const char** packageNames
+		= new(std::nothrow) const char*[maxPackageCount];
+	if (packageNames == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+	ArrayDeleter<const char*> packageNamesDeleter(packageNames);
+	int32 packageCount = 0;
+
+	const char* packageName = fileContent;
 	while (packageName < fileContentEnd) {
 		char* packageNameEnd = strchr(packageName, '\n');
 		if (packageNameEnd == NULL)
@@ -875,15 +930,13 @@ Volume::_AddInitialPackagesFromActivationFile(
 			RETURN_ERROR(B_BAD_DATA);
 		}
 
-		status_t error = _LoadAndAddInitialPackage(packagesDirectory,
-			packageName);
-		if (error != B_OK)
-			RETURN_ERROR(error);
-
+		packageNames[packageCount++] = packageName;
 		packageName = packageNameEnd + 1;
 	}
 
-	return B_OK;
+	// load and add the respective packages
+	return _LoadAndAddInitialPackages(packagesDirectory, packageNames,
+		packageCount, false);
 }
 
 
@@ -905,6 +958,11 @@ Volume::_AddInitialPackagesFromDirectory()
 	}
 	CObjectDeleter<DIR, int> dirCloser(dir, closedir);
 
+	char** packageNames = NULL;
+	int32 packageCount = 0;
+	int32 maxPackageCount = 0;
+	status_t error = B_OK;
+
 	while (dirent* entry = readdir(dir)) {
 		// skip "." and ".."
 		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
@@ -917,30 +975,105 @@ Volume::_AddInitialPackagesFromDirectory()
 			continue;
 		}
 
-		_LoadAndAddInitialPackage(fPackagesDirectory, entry->d_name);
+		if (packageCount == maxPackageCount) {
+			maxPackageCount = std::max(maxPackageCount * 2, (int32)32);
+			char** names = (char**)realloc(packageNames,
+				maxPackageCount * sizeof(char*));
+			if (names == NULL) {
+				error = B_NO_MEMORY;
+				break;
+			}
+			packageNames = names;
+		}
+
+		packageNames[packageCount] = strdup(entry->d_name);
+		if (packageNames[packageCount] == NULL) {
+			error = B_NO_MEMORY;
+			break;
+		}
+		packageCount++;
 	}
 
-	return B_OK;
+	// load and add the packages, ignoring those that fail to load
+	if (error == B_OK) {
+		error = _LoadAndAddInitialPackages(fPackagesDirectory, packageNames,
+			packageCount, true);
+	}
+
+	for (int32 i = 0; i < packageCount; i++)
+		free(packageNames[i]);
+	free(packageNames);
+
+	return error;
 }
 
 
+/*!	Loads the given packages and adds them to the volume. Parsing the
+	packages is the most expensive part of mounting, so it is done by several
+	threads at once. The packages are added in the given order nonetheless.
+	Unless \a ignoreErrors is \c true, the first error is returned, but all
+	packages that could be loaded are added anyway.
+*/
 status_t
-Volume::_LoadAndAddInitialPackage(PackagesDirectory* packagesDirectory,
-	const char* name)
+Volume::_LoadAndAddInitialPackages(PackagesDirectory* packagesDirectory,
+	const char* const* names, int32 count, bool ignoreErrors)
 {
-	Package* package;
-	status_t error = _LoadPackage(packagesDirectory, name, package);
-	if (error != B_OK) {
-		ERROR("Failed to load package \"%s\": %s\n", name, strerror(error));
-		RETURN_ERROR(error);
+	if (count == 0)
+		return B_OK;
+
+	Package** packages = new(std::nothrow) Package*[count];
+	status_t* errors = new(std::nothrow) status_t[count];
+	ArrayDeleter<Package*> packagesDeleter(packages);
+	ArrayDeleter<status_t> errorsDeleter(errors);
+	if (packages == NULL || errors == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	InitialPackageLoader loader;
+	loader.volume = this;
+	loader.packagesDirectory = packagesDirectory;
+	loader.names = names;
+	loader.packages = packages;
+	loader.errors = errors;
+	loader.count = count;
+	loader.nextIndex = 0;
+
+	// The calling thread loads packages, too. If spawning a thread fails, the
+	// others just have more to do.
+	int32 threadCount = std::min(std::min(count, (int32)smp_get_num_cpus()),
+		kMaxPackageLoaderThreads);
+	thread_id threads[kMaxPackageLoaderThreads];
+	for (int32 i = 1; i < threadCount; i++) {
+		threads[i] = spawn_kernel_thread(&InitialPackageLoader::ThreadEntry,
+			"packagefs package loader", B_NORMAL_PRIORITY, &loader);
+		if (threads[i] >= 0)
+			resume_thread(threads[i]);
+	}
+
+	loader.Run();
+
+	for (int32 i = 1; i < threadCount; i++) {
+		if (threads[i] >= 0)
+			wait_for_thread(threads[i], NULL);
 	}
-	BReference<Package> packageReference(package, true);
 
 	VolumeWriteLocker systemVolumeLocker(_SystemVolumeIfNotSelf());
 	VolumeWriteLocker volumeLocker(this);
-	_AddPackage(package);
 
-	return B_OK;
+	status_t error = B_OK;
+	for (int32 i = 0; i < count; i++) {
+		if (errors[i] != B_OK) {
+			ERROR("Failed to load package \"%s\": %s\n", names[i],
+				strerror(errors[i]));
+			if (error == B_OK && !ignoreErrors)
+				error = errors[i];
+			continue;
+		}
+
+		_AddPackage(packages[i]);
+		packages[i]->ReleaseReference();
+	}
+
+	RETURN_ERROR(error);
 }
 
 
@@ -108,6 +108,9 @@ private:
 private:
 			struct ShineThroughDirectory;
 			struct ActivationChangeRequest;
+			struct InitialPackageLoader;
+
+			friend struct InitialPackageLoader;
 
 private:
 			status_t			_LoadOldPackagesStates(
@@ -117,9 +120,10 @@ private:
 			status_t			_AddInitialPackagesFromActivationFile(
 									PackagesDirectory* packagesDirectory);
 			status_t			_AddInitialPackagesFromDirectory();
-			status_t			_LoadAndAddInitialPackage(
+			status_t			_LoadAndAddInitialPackages(
 									PackagesDirectory* packagesDirectory,
-									const char* name);
+									const char* const* names, int32 count,
+									bool ignoreErrors);
 
 	inline	void				_AddPackage(Package* package);
 	inline	void				_RemovePackage(Package* package);
@@ -29,3 +29,11 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 {
 	return B_OK;
 }
+
+
+status_t
+entry_cache_add_complete_directory(dev_t mountID, ino_t dirID,
+	const char* const* names, const ino_t* nodeIDs, int32 count)
+{
+	return B_OK;
+}
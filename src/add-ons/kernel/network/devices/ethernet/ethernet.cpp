@@ -25,6 +25,7 @@
 #include <net/if_dl.h>
 #include <net/if_media.h>
 #include <net/if_types.h>
+#include <netinet/ip.h>
 #include <new>
 #include <stdlib.h>
 #include <string.h>
@@ -33,6 +34,7 @@
 struct ethernet_device : net_device, DoublyLinkedListLinkImpl<ethernet_device> {
 	int		fd;
 	uint32	frame_size;
+	bool	offload_header;
 };
 
 static const bigtime_t kLinkCheckInterval = 1000000;
@@ -112,6 +114,33 @@ ethernet_link_checker(void *)
 }
 
 
+static void
+setup_offload(ethernet_device *device)
+{
+	device->offload = 0;
+	device->offload_header = false;
+
+	uint32 features;
+	if (ioctl(device->fd, ETHER_GET_OFFLOAD, &features, sizeof(features)) < 0
+		|| features == 0) {
+		// this call is optional, too
+		return;
+	}
+
+	if (ioctl(device->fd, ETHER_SET_OFFLOAD, &features, sizeof(features)) < 0)
+		return;
+
+	device->offload_header = true;
+
+	if ((features & ETHER_OFFLOAD_CHECKSUM) != 0)
+		device->offload |= NET_DEVICE_OFFLOAD_CHECKSUM;
+	if ((features & ETHER_OFFLOAD_TSO4) != 0)
+		device->offload |= NET_DEVICE_OFFLOAD_TSO4;
+	if ((features & ETHER_OFFLOAD_TSO6) != 0)
+		device->offload |= NET_DEVICE_OFFLOAD_TSO6;
+}
+
+
 //	#pragma mark -
 
 
@@ -186,6 +215,8 @@ ethernet_up(net_device *_device)
 		device->frame_size = ETHER_MAX_FRAME_SIZE;
 	}
 
+	setup_offload(device);
+
 	if (update_link_state(device, false) == B_OK) {
 		// device supports retrieval of the link state
 
@@ -251,23 +282,63 @@ ethernet_send_data(net_device *_device, net_buffer *buffer)
 	ethernet_device *device = (ethernet_device *)_device;
 
 //dprintf("try to send ethernet packet of %lu bytes (flags %ld):\n", buffer->size, buffer->flags);
-	if (buffer->size > device->frame_size || buffer->size < ETHER_HEADER_LENGTH)
+	size_t maxSize = device->frame_size;
+	if ((buffer->offload
+			& (NET_BUFFER_SEGMENT_TCP4 | NET_BUFFER_SEGMENT_TCP6)) != 0)
+		maxSize = ETHER_HEADER_LENGTH + IP_MAXPACKET;
+
+	if (buffer->size > maxSize || buffer->size < ETHER_HEADER_LENGTH)
 		return B_BAD_VALUE;
 
+	if (device->offload_header) {
+		// tell the driver what is left to do for this frame
+		ether_offload_header header;
+		header.flags = 0;
+		header.checksum_start = 0;
+		header.checksum_offset = 0;
+		header.segment_size = 0;
+
+		if ((buffer->offload & NET_BUFFER_CHECKSUM_PARTIAL) != 0) {
+			header.flags |= ETHER_FRAME_CHECKSUM_PARTIAL;
+			header.checksum_start = buffer->checksum_start;
+			header.checksum_offset = buffer->checksum_offset;
+		}
+		if ((buffer->offload & NET_BUFFER_SEGMENT_TCP4) != 0)
+			header.flags |= ETHER_FRAME_SEGMENT_TCP4;
+		if ((buffer->offload & NET_BUFFER_SEGMENT_TCP6) != 0)
+			header.flags |= ETHER_FRAME_SEGMENT_TCP6;
+		if (header.flags != 0)
+			header.segment_size = buffer->segment_size;
+
+		status_t status = gBufferModule->prepend(buffer, &header,
+			sizeof(header));
+		if (status != B_OK)
+			return status;
+	}
+
 	net_buffer *allocated = NULL;
 	net_buffer *original = buffer;
 
 	if (gBufferModule->count_iovecs(buffer) > 1) {
 		// TODO: for now, create a new buffer containing the data
 		buffer = gBufferModule->duplicate(original);
-		if (buffer == NULL)
+		if (buffer == NULL) {
+			if (device->offload_header) {
+				gBufferModule->remove_header(original,
+					sizeof(ether_offload_header));
+			}
 			return ENOBUFS;
+		}
 
 		allocated = buffer;
 
 		if (gBufferModule->count_iovecs(buffer) > 1) {
 			dprintf("scattered I/O is not yet supported by ethernet device.\n");
 			gBufferModule->free(buffer);
+			if (device->offload_header) {
+				gBufferModule->remove_header(original,
+					sizeof(ether_offload_header));
+			}
 			device->stats.send.errors++;
 			return B_NOT_SUPPORTED;
 		}
@@ -281,12 +352,20 @@ ethernet_send_data(net_device *_device, net_buffer *buffer)
 //dprintf("sent: %ld\n", bytesWritten);
 
 	if (bytesWritten < 0) {
+		status_t status = errno;
 		device->stats.send.errors++;
 		if (allocated)
 			gBufferModule->free(allocated);
-		return errno;
+		if (device->offload_header) {
+			gBufferModule->remove_header(original,
+				sizeof(ether_offload_header));
+		}
+		return status;
 	}
 
+	if (device->offload_header)
+		bytesWritten -= sizeof(ether_offload_header);
+
 	device->stats.send.packets++;
 	device->stats.send.bytes += bytesWritten;
 
@@ -317,8 +396,11 @@ ethernet_receive_data(net_device *_device, net_buffer **_buffer)
 
 	ssize_t bytesRead;
 	void *data;
+	size_t readSize = device->frame_size;
+	if (device->offload_header)
+		readSize += sizeof(ether_offload_header);
 
-	status_t status = gBufferModule->append_size(buffer, device->frame_size, &data);
+	status_t status = gBufferModule->append_size(buffer, readSize, &data);
 	if (status == B_OK && data == NULL) {
 		dprintf("scattered I/O is not yet supported by ethernet device.\n");
 		status = B_NOT_SUPPORTED;
@@ -326,7 +408,7 @@ ethernet_receive_data(net_device *_device, net_buffer **_buffer)
 	if (status < B_OK)
 		goto err;
 
-	bytesRead = read(device->fd, data, device->frame_size);
+	bytesRead = read(device->fd, data, readSize);
 	if (bytesRead < 0) {
 		device->stats.receive.errors++;
 		status = errno;
@@ -340,6 +422,34 @@ ethernet_receive_data(net_device *_device, net_buffer **_buffer)
 		goto err;
 	}
 
+	if (device->offload_header) {
+		if (bytesRead < (ssize_t)sizeof(ether_offload_header)) {
+			device->stats.receive.errors++;
+			status = B_BAD_DATA;
+			goto err;
+		}
+
+		ether_offload_header* header = (ether_offload_header*)data;
+		buffer->offload = 0;
+		if ((header->flags & ETHER_FRAME_CHECKSUM_VALID) != 0)
+			buffer->offload |= NET_BUFFER_CHECKSUM_VALID;
+		if ((header->flags & ETHER_FRAME_CHECKSUM_PARTIAL) != 0) {
+			// the checksum of this frame has not been computed, but the
+			// data cannot have been corrupted on the way either
+			buffer->offload |= NET_BUFFER_CHECKSUM_PARTIAL;
+			buffer->checksum_start = header->checksum_start
+				+ sizeof(ether_offload_header);
+			buffer->checksum_offset = header->checksum_offset;
+		}
+
+		status = gBufferModule->remove_header(buffer,
+			sizeof(ether_offload_header));
+		if (status != B_OK)
+			goto err;
+
+		bytesRead -= sizeof(ether_offload_header);
+	}
+
 	device->stats.receive.bytes += bytesRead;
 	device->stats.receive.packets++;
 
@@ -7,11 +7,15 @@
  */
 
 
+#include <loopback_control.h>
 #include <net_buffer.h>
 #include <net_device.h>
 #include <net_stack.h>
 
 #include <KernelExport.h>
+#include <lock.h>
+#include <util/AutoLock.h>
+#include <util/list.h>
 
 #include <net/if.h>
 #include <net/if_types.h>
@@ -19,9 +23,25 @@
 #include <new>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 
+static const uint32 kDefaultQueueLimit = 1000;
+
+
+struct delayed_packet {
+	list_link			link;
+	net_buffer			*buffer;
+	bigtime_t			due;
+};
+
 struct loopback_device : net_device {
+	mutex				lock;
+	loopback_emulation	emulation;
+	struct list			delayed_packets;
+	uint32				delayed_count;
+	bigtime_t			last_due;
+	net_timer			timer;
 };
 
 
@@ -29,6 +49,115 @@ struct net_buffer_module_info *gBufferModule;
 static struct net_stack_module_info *sStackModule;
 
 
+static bool
+emulation_enabled(const loopback_emulation &emulation)
+{
+	return emulation.delay != 0 || emulation.jitter != 0
+		|| emulation.loss != 0 || emulation.rate != 0;
+}
+
+
+/*!	Hands all delayed packets that are due over to the stack, and
+	reschedules the timer for the next one.
+*/
+static void
+loopback_deliver(net_timer *timer, void *_device)
+{
+	loopback_device *device = (loopback_device *)_device;
+	MutexLocker locker(device->lock);
+
+	bigtime_t now = system_time();
+	delayed_packet *packet;
+	while ((packet = (delayed_packet *)list_get_first_item(
+			&device->delayed_packets)) != NULL) {
+		if (packet->due > now) {
+			sStackModule->set_timer(&device->timer, packet->due - now);
+			break;
+		}
+
+		list_remove_item(&device->delayed_packets, packet);
+		device->delayed_count--;
+
+		if (sStackModule->device_enqueue_buffer(device, packet->buffer)
+				!= B_OK) {
+			gBufferModule->free(packet->buffer);
+			device->stats.receive.dropped++;
+		}
+		delete packet;
+	}
+}
+
+
+static void
+loopback_flush(loopback_device *device)
+{
+	delayed_packet *packet;
+	while ((packet = (delayed_packet *)list_remove_head_item(
+			&device->delayed_packets)) != NULL) {
+		gBufferModule->free(packet->buffer);
+		delete packet;
+	}
+
+	device->delayed_count = 0;
+	device->last_due = 0;
+}
+
+
+/*!	Queues \a buffer to be delivered according to the emulation settings:
+	it may be dropped, has to wait until all packets before it have been
+	sent at the configured rate, and is then delayed further.
+*/
+static status_t
+loopback_emulate(loopback_device *device, net_buffer *buffer)
+{
+	MutexLocker locker(device->lock);
+
+	const loopback_emulation &emulation = device->emulation;
+	uint32 queueLimit = emulation.queue_limit != 0
+		? emulation.queue_limit : kDefaultQueueLimit;
+
+	if ((emulation.loss != 0 && (uint32)rand() % 1000000 < emulation.loss)
+		|| device->delayed_count >= queueLimit) {
+		device->stats.send.dropped++;
+		gBufferModule->free(buffer);
+		return B_OK;
+	}
+
+	delayed_packet *packet = new(std::nothrow) delayed_packet;
+	if (packet == NULL)
+		return B_NO_MEMORY;
+
+	bigtime_t now = system_time();
+	bigtime_t due = now;
+	if (emulation.rate != 0) {
+		// the packets leave one after the other at the given rate
+		due = max_c(now, device->last_due)
+			+ (bigtime_t)buffer->size * 1000000 / emulation.rate;
+	}
+	device->last_due = due;
+
+	due += emulation.delay;
+	if (emulation.jitter != 0)
+		due += rand() % (2 * emulation.jitter + 1) - emulation.jitter;
+
+	// packets are never reordered
+	delayed_packet *last
+		= (delayed_packet *)list_get_last_item(&device->delayed_packets);
+	if (last != NULL && due < last->due)
+		due = last->due;
+
+	packet->buffer = buffer;
+	packet->due = due;
+	list_add_item(&device->delayed_packets, packet);
+	device->delayed_count++;
+
+	if (!sStackModule->is_timer_active(&device->timer))
+		sStackModule->set_timer(&device->timer, max_c(due - now, 0));
+
+	return B_OK;
+}
+
+
 //	#pragma mark -
 
 
@@ -56,11 +185,17 @@ loopback_init(const char *name, net_device **_device)
 
 	memset(device, 0, sizeof(loopback_device));
 
+	mutex_init(&device->lock, "loopback emulation");
+	list_init(&device->delayed_packets);
+	sStackModule->init_timer(&device->timer, loopback_deliver, device);
+
 	strcpy(device->name, name);
 	device->flags = IFF_LOOPBACK | IFF_LINK;
 	device->type = IFT_LOOP;
 	device->mtu = 16384;
 	device->media = IFM_ACTIVE;
+	device->offload = NET_DEVICE_OFFLOAD_CHECKSUM;
+		// nothing to checksum; the data never leaves the machine
 
 	*_device = device;
 	return B_OK;
@@ -78,6 +213,11 @@ loopback_uninit(net_device *_device)
 {
 	loopback_device *device = (loopback_device *)_device;
 
+	sStackModule->cancel_timer(&device->timer);
+	sStackModule->wait_for_timer(&device->timer);
+	loopback_flush(device);
+	mutex_destroy(&device->lock);
+
 	put_module(NET_STACK_MODULE_NAME);
 	put_module(NET_BUFFER_MODULE_NAME);
 	delete device;
@@ -94,22 +234,70 @@ loopback_up(net_device *device)
 
 
 void
-loopback_down(net_device *device)
+loopback_down(net_device *_device)
 {
+	loopback_device *device = (loopback_device *)_device;
+
+	sStackModule->cancel_timer(&device->timer);
+
+	MutexLocker locker(device->lock);
+	loopback_flush(device);
 }
 
 
 status_t
-loopback_control(net_device *device, int32 op, void *argument,
+loopback_control(net_device *_device, int32 op, void *argument,
 	size_t length)
 {
+	loopback_device *device = (loopback_device *)_device;
+
+	switch (op) {
+		case SIOCSDRVSPEC:
+		case SIOCGDRVSPEC:
+		{
+			ifreq request;
+			if (length < sizeof(ifreq))
+				return B_BAD_VALUE;
+			if (user_memcpy(&request, argument, sizeof(ifreq)) != B_OK)
+				return B_BAD_ADDRESS;
+
+			MutexLocker locker(device->lock);
+
+			if (op == SIOCGDRVSPEC) {
+				return user_memcpy(request.ifr_data, &device->emulation,
+					sizeof(loopback_emulation));
+			}
+
+			// this affects all loopback traffic, so only root may change it
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			loopback_emulation emulation;
+			if (user_memcpy(&emulation, request.ifr_data,
+					sizeof(loopback_emulation)) != B_OK)
+				return B_BAD_ADDRESS;
+			if (emulation.delay < 0 || emulation.jitter < 0
+				|| emulation.jitter > emulation.delay
+				|| emulation.loss > 1000000)
+				return B_BAD_VALUE;
+
+			device->emulation = emulation;
+			return B_OK;
+		}
+	}
+
 	return B_BAD_VALUE;
 }
 
 
 status_t
-loopback_send_data(net_device *device, net_buffer *buffer)
+loopback_send_data(net_device *_device, net_buffer *buffer)
 {
+	loopback_device *device = (loopback_device *)_device;
+
+	if (emulation_enabled(device->emulation) || device->delayed_count != 0)
+		return loopback_emulate(device, buffer);
+
 	return sStackModule->device_enqueue_buffer(device, buffer);
 }
 
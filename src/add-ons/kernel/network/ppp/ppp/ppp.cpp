@@ -93,6 +93,7 @@ ppp_init(const char *name, net_device **_device)
 	device->frame_size = 1500;
 	device->media = IFM_ACTIVE | IFM_ETHER;
 	device->header_length = PPP_HEADER_LENGTH;
+	device->offload = 0;
 
 	status =sStackModule->init_fifo(&(device->ppp_fifo), "ppp_fifo", 10 * 1500);
 		// 10 ppp packet at most
@@ -1455,8 +1455,14 @@ ipv4_send_routed_data(net_protocol* _protocol, struct net_route* route,
 		ntohl(destination.sin_addr.s_addr));
 
 	uint32 mtu = route->mtu ? route->mtu : interface->mtu;
-	if (buffer->size > mtu) {
-		// we need to fragment the packet
+	if (buffer->size > mtu
+		&& (buffer->offload & NET_BUFFER_SEGMENT_TCP4) == 0) {
+		// we need to fragment the packet, and the fragments can only be
+		// checksummed as a whole
+		status_t status = gBufferModule->finish_checksum(buffer);
+		if (status != B_OK)
+			return status;
+
 		return send_fragments(protocol, route, buffer, mtu);
 	}
 
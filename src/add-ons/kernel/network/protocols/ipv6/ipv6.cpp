@@ -1328,8 +1328,14 @@ ipv6_send_routed_data(net_protocol* _protocol, struct net_route* route,
 	TRACE_SK(protocol, "  SendRoutedData(): destination: %s", addrbuf);
 
 	uint32 mtu = route->mtu ? route->mtu : interface->mtu;
-	if (buffer->size > mtu) {
-		// we need to fragment the packet
+	if (buffer->size > mtu
+		&& (buffer->offload & NET_BUFFER_SEGMENT_TCP6) == 0) {
+		// we need to fragment the packet, and the fragments can only be
+		// checksummed as a whole
+		status_t status = gBufferModule->finish_checksum(buffer);
+		if (status != B_OK)
+			return status;
+
 		return send_fragments(protocol, route, buffer, mtu);
 	}
 
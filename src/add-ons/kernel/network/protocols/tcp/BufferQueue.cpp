@@ -436,6 +436,60 @@ BufferQueue::SetPushPointer()
 		fPushPointer = fList.Tail()->sequence + fList.Tail()->size;
 }
 
+/*!	Fills \a sacks with up to \a maxSackCount blocks of data that have been
+	received beyond a hole in the queue, and returns the number of blocks.
+	As required by RFC 2018, the block containing \a sequence, which should
+	be the sequence of the most recently received segment, is reported first.
+*/
+int
+BufferQueue::PopulateSackInfo(tcp_sequence sequence, int maxSackCount,
+	tcp_sack* sacks) const
+{
+	if (maxSackCount <= 0 || IsContiguous())
+		return 0;
+
+	int count = 0;
+	tcp_sequence first = 0;
+	bool haveFirst = false;
+
+	for (int pass = 0; pass < 2; pass++) {
+		SegmentList::ConstIterator iterator = fList.GetIterator();
+		net_buffer* buffer = iterator.Next();
+
+		// skip the contiguous data at the start of the queue
+		while (buffer != NULL
+			&& tcp_sequence(buffer->sequence) < NextSequence())
+			buffer = iterator.Next();
+
+		while (buffer != NULL && count < maxSackCount) {
+			// collect adjacent buffers into a single block
+			tcp_sequence left = buffer->sequence;
+			tcp_sequence right = buffer->sequence + buffer->size;
+			while ((buffer = iterator.Next()) != NULL
+				&& tcp_sequence(buffer->sequence) == right) {
+				right += buffer->size;
+			}
+
+			bool containsSequence = sequence >= left && sequence < right;
+			if (pass == 0 ? !containsSequence : (haveFirst && left == first))
+				continue;
+
+			sacks[count].left_edge = left.Number();
+			sacks[count].right_edge = right.Number();
+			count++;
+
+			if (pass == 0) {
+				first = left;
+				haveFirst = true;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+
 #if DEBUG_BUFFER_QUEUE
 
 /*!	Perform a sanity check of the whole queue.
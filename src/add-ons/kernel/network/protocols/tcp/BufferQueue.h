@@ -43,6 +43,9 @@ public:
 	inline	size_t				PushedData() const;
 			void				SetPushPointer();
 
+			int					PopulateSackInfo(tcp_sequence sequence,
+									int maxSackCount, tcp_sack* sacks) const;
+
 			size_t				Used() const { return fNumBytes; }
 	inline	size_t				Free() const;
 			size_t				Size() const { return fMaxBytes; }
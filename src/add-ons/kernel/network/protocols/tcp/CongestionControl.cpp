@@ -0,0 +1,610 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CongestionControl.h"
+
+#include <KernelExport.h>
+
+#include <new>
+#include <string.h>
+
+
+//	#pragma mark - NewReno
+
+
+CongestionControl::~CongestionControl()
+{
+}
+
+
+/*!	Opens the window by up to one segment per acknowledgement in slow start,
+	and by about one segment per round trip in congestion avoidance.
+*/
+void
+CongestionControl::Acknowledged(uint32& window, uint32 threshold,
+	uint32 bytesAcknowledged, uint32 maxSegmentSize)
+{
+	if (window < threshold) {
+		window += min_c(bytesAcknowledged, maxSegmentSize);
+		return;
+	}
+
+	uint32 increment = maxSegmentSize * maxSegmentSize;
+	if (increment < window)
+		increment = 1;
+	else
+		increment /= window;
+
+	window += increment;
+}
+
+
+/*!	Returns the new slow start threshold after a loss has been detected.
+*/
+uint32
+CongestionControl::LossDetected(uint32 window, uint32 flightSize,
+	uint32 maxSegmentSize)
+{
+	return max_c(flightSize / 2, 2 * maxSegmentSize);
+}
+
+
+void
+CongestionControl::RetransmitTimeout()
+{
+}
+
+
+void
+CongestionControl::RoundTripTimeSample(bigtime_t roundTripTime)
+{
+}
+
+
+/*!	Returns the rate in bytes per second at which segments should be sent,
+	or zero if they don't need to be paced at all.
+*/
+uint32
+CongestionControl::PacingRate(uint32 window,
+	bigtime_t smoothedRoundTripTime) const
+{
+	return 0;
+}
+
+
+class NewReno : public CongestionControl {
+public:
+	virtual	const char*			Name() const { return "newreno"; }
+};
+
+
+//	#pragma mark - CUBIC
+
+
+/*!	CUBIC as described in RFC 8312: after a loss, the window grows along a
+	cubic function of the time since then, which quickly returns to the
+	window size at which the loss happened, stays there for a while, and then
+	probes for more bandwidth. This makes the growth independent from the
+	round trip time, and lets it fill long fat pipes a lot faster than
+	NewReno.
+
+	All computations are done in integer arithmetic, with the time in
+	milliseconds, and the window in bytes.
+*/
+class Cubic : public CongestionControl {
+public:
+								Cubic();
+
+	virtual	const char*			Name() const { return "cubic"; }
+
+	virtual	void				Acknowledged(uint32& window, uint32 threshold,
+									uint32 bytesAcknowledged,
+									uint32 maxSegmentSize);
+	virtual	uint32				LossDetected(uint32 window, uint32 flightSize,
+									uint32 maxSegmentSize);
+	virtual	void				RetransmitTimeout();
+	virtual	void				RoundTripTimeSample(bigtime_t roundTripTime);
+
+private:
+			uint32				_Target(bigtime_t elapsed,
+									uint32 maxSegmentSize) const;
+			void				_Grow(uint32& window, uint32 target,
+									uint32 bytesAcknowledged);
+
+private:
+			uint32				fWindowMax;
+			bigtime_t			fEpochStart;
+			int64				fTimeToMax;
+				// K, in milliseconds
+			bigtime_t			fMinRoundTrip;
+			uint64				fIncrementRemainder;
+};
+
+
+// beta and C are scaled by 10 here
+static const uint32 kCubicBeta = 7;
+static const uint32 kCubicFastConvergence = 17;
+	// (1 + beta) / 2, scaled by 20
+static const uint64 kCubicScale = 2500000;
+	// 1 / C, in millisegments per cubic millisecond
+
+
+static uint64
+cube_root(uint64 value)
+{
+	uint64 root = 0;
+	for (int32 shift = 63; shift >= 0; shift -= 3) {
+		root <<= 1;
+		uint64 next = 3 * root * (root + 1) + 1;
+		if ((value >> shift) >= next) {
+			value -= next << shift;
+			root++;
+		}
+	}
+
+	return root;
+}
+
+
+Cubic::Cubic()
+	:
+	fWindowMax(0),
+	fEpochStart(0),
+	fTimeToMax(0),
+	fMinRoundTrip(0),
+	fIncrementRemainder(0)
+{
+}
+
+
+void
+Cubic::Acknowledged(uint32& window, uint32 threshold,
+	uint32 bytesAcknowledged, uint32 maxSegmentSize)
+{
+	if (window < threshold) {
+		window += min_c(bytesAcknowledged, maxSegmentSize);
+		return;
+	}
+
+	bigtime_t now = system_time();
+	if (fEpochStart == 0) {
+		// the first acknowledgement in congestion avoidance after a loss
+		fEpochStart = now;
+		fIncrementRemainder = 0;
+
+		if (window < fWindowMax) {
+			uint64 difference = min_c(fWindowMax - window, (uint32)1 << 30);
+			fTimeToMax = cube_root(difference * kCubicScale * 1000
+				/ maxSegmentSize);
+		} else {
+			fWindowMax = window;
+			fTimeToMax = 0;
+		}
+	}
+
+	// The target is where the cubic function will be one round trip
+	// from now
+	bigtime_t elapsed = now - fEpochStart + fMinRoundTrip;
+	uint32 target = _Target(elapsed, maxSegmentSize);
+
+	// In the TCP friendly region, the window is at least as large as that
+	// of standard TCP with the same multiplicative decrease would be; it
+	// grows by 3 * (1 - beta) / (1 + beta) segments per round trip.
+	if (fMinRoundTrip > 0) {
+		uint64 estimate = (uint64)fWindowMax * kCubicBeta / 10
+			+ (uint64)maxSegmentSize * 529 * elapsed / (1000 * fMinRoundTrip);
+		if (estimate > target)
+			target = min_c(estimate, (uint64)UINT32_MAX);
+	}
+
+	_Grow(window, target, bytesAcknowledged);
+}
+
+
+uint32
+Cubic::LossDetected(uint32 window, uint32 flightSize, uint32 maxSegmentSize)
+{
+	fEpochStart = 0;
+
+	// fast convergence: release bandwidth if the window is already smaller
+	// than before the last loss, as a new flow is likely competing with us
+	if (window < fWindowMax)
+		fWindowMax = (uint64)window * kCubicFastConvergence / 20;
+	else
+		fWindowMax = window;
+
+	return max_c((uint64)window * kCubicBeta / 10, 2 * maxSegmentSize);
+}
+
+
+void
+Cubic::RetransmitTimeout()
+{
+	fEpochStart = 0;
+}
+
+
+void
+Cubic::RoundTripTimeSample(bigtime_t roundTripTime)
+{
+	if (fMinRoundTrip == 0 || roundTripTime < fMinRoundTrip)
+		fMinRoundTrip = roundTripTime;
+}
+
+
+/*!	Returns W_cubic(t) = C * (t - K)^3 + W_max for \a elapsed microseconds
+	since the start of the current epoch.
+*/
+uint32
+Cubic::_Target(bigtime_t elapsed, uint32 maxSegmentSize) const
+{
+	int64 offset = elapsed / 1000 - fTimeToMax;
+	if (offset > 1000000)
+		offset = 1000000;
+	else if (offset < -1000000)
+		offset = -1000000;
+
+	int64 delta = offset * offset * offset / (int64)kCubicScale
+		* maxSegmentSize / 1000;
+	int64 target = (int64)fWindowMax + delta;
+	if (target < 0)
+		return 0;
+	if (target > UINT32_MAX)
+		return UINT32_MAX;
+
+	return target;
+}
+
+
+/*!	Increases the window by (target - window) / window for every byte
+	acknowledged, but never by more than half of the bytes acknowledged,
+	which limits the growth to 1.5 times the window per round trip.
+*/
+void
+Cubic::_Grow(uint32& window, uint32 target, uint32 bytesAcknowledged)
+{
+	if (target <= window) {
+		// close to W_max, grow very slowly
+		target = window + window / 100;
+	}
+
+	fIncrementRemainder += (uint64)(target - window) * bytesAcknowledged;
+	uint64 increment = fIncrementRemainder / window;
+	fIncrementRemainder %= window;
+
+	window += min_c(increment, (uint64)bytesAcknowledged / 2);
+}
+
+
+//	#pragma mark - paced
+
+
+/*!	A model based congestion control in the spirit of BBR: instead of
+	reacting to losses, it estimates the bottleneck bandwidth and the round
+	trip propagation delay, and paces the segments out at about the
+	bottleneck rate. The window only limits the amount of data in flight to a
+	small multiple of the bandwidth-delay product.
+
+	It starts with an exponential startup phase that ends when the bandwidth
+	estimate stops growing, drains the queue it has built up that way, and
+	then cycles through a phase that probes for more bandwidth, one that
+	drains the queue again, and a few cruising at the estimated rate.
+*/
+class Paced : public CongestionControl {
+public:
+								Paced();
+
+	virtual	const char*			Name() const { return "paced"; }
+
+	virtual	void				Acknowledged(uint32& window, uint32 threshold,
+									uint32 bytesAcknowledged,
+									uint32 maxSegmentSize);
+	virtual	uint32				LossDetected(uint32 window, uint32 flightSize,
+									uint32 maxSegmentSize);
+	virtual	void				RetransmitTimeout();
+	virtual	void				RoundTripTimeSample(bigtime_t roundTripTime);
+
+	virtual	uint32				PacingRate(uint32 window,
+									bigtime_t smoothedRoundTripTime) const;
+
+private:
+			void				_RoundCompleted(bigtime_t now);
+			uint32				_Bandwidth() const;
+			uint32				_BandwidthDelayProduct() const;
+			uint32				_Gain() const;
+
+private:
+	enum mode {
+		STARTUP,
+		DRAIN,
+		PROBE_BANDWIDTH
+	};
+
+	static const int32	kBandwidthSamples = 10;
+	static const int32	kGainCycleLength = 8;
+
+			mode				fMode;
+			uint32				fBandwidthSamples[kBandwidthSamples];
+				// delivery rate per round, in bytes per second
+			int32				fSampleIndex;
+			bigtime_t			fRoundStart;
+			uint64				fRoundDelivered;
+			bigtime_t			fMinRoundTrip;
+			bigtime_t			fMinRoundTripStamp;
+			uint32				fFullBandwidth;
+			int32				fFullBandwidthRounds;
+			int32				fCycleIndex;
+};
+
+
+// all gains are in percent
+static const uint32 kStartupGain = 289;
+	// 2 / ln(2), doubles the delivery rate each round
+static const uint32 kDrainGain = 35;
+static const uint32 kProbeGains[] = {125, 75, 100, 100, 100, 100, 100, 100};
+static const uint32 kWindowGain = 200;
+
+static const bigtime_t kMinRoundTripLifetime = 10000000;
+
+
+Paced::Paced()
+	:
+	fMode(STARTUP),
+	fSampleIndex(0),
+	fRoundStart(0),
+	fRoundDelivered(0),
+	fMinRoundTrip(0),
+	fMinRoundTripStamp(0),
+	fFullBandwidth(0),
+	fFullBandwidthRounds(0),
+	fCycleIndex(0)
+{
+	memset(fBandwidthSamples, 0, sizeof(fBandwidthSamples));
+}
+
+
+void
+Paced::Acknowledged(uint32& window, uint32 threshold,
+	uint32 bytesAcknowledged, uint32 maxSegmentSize)
+{
+	bigtime_t now = system_time();
+	if (fRoundStart == 0)
+		fRoundStart = now;
+
+	fRoundDelivered += bytesAcknowledged;
+
+	if (fMinRoundTrip == 0) {
+		// no samples yet, behave like slow start
+		window += min_c(bytesAcknowledged, maxSegmentSize);
+		return;
+	}
+
+	if (now - fRoundStart >= fMinRoundTrip)
+		_RoundCompleted(now);
+
+	uint32 minWindow = 4 * maxSegmentSize;
+	uint32 bandwidthDelayProduct = _BandwidthDelayProduct();
+
+	switch (fMode) {
+		case STARTUP:
+			window += bytesAcknowledged;
+			break;
+		case DRAIN:
+			window = max_c(bandwidthDelayProduct, minWindow);
+			break;
+		case PROBE_BANDWIDTH:
+			window = max_c((uint64)bandwidthDelayProduct * kWindowGain / 100,
+				minWindow);
+			break;
+	}
+}
+
+
+uint32
+Paced::LossDetected(uint32 window, uint32 flightSize, uint32 maxSegmentSize)
+{
+	// losses are not taken as a congestion signal, but the window must not
+	// stay larger than what the path can hold
+	uint32 bandwidthDelayProduct = _BandwidthDelayProduct();
+	if (bandwidthDelayProduct == 0)
+		return CongestionControl::LossDetected(window, flightSize,
+			maxSegmentSize);
+
+	return max_c(bandwidthDelayProduct, 2 * maxSegmentSize);
+}
+
+
+void
+Paced::RetransmitTimeout()
+{
+	fRoundStart = 0;
+	fRoundDelivered = 0;
+}
+
+
+void
+Paced::RoundTripTimeSample(bigtime_t roundTripTime)
+{
+	bigtime_t now = system_time();
+	if (fMinRoundTrip == 0 || roundTripTime <= fMinRoundTrip
+		|| now - fMinRoundTripStamp > kMinRoundTripLifetime) {
+		fMinRoundTrip = roundTripTime;
+		fMinRoundTripStamp = now;
+	}
+}
+
+
+uint32
+Paced::PacingRate(uint32 window, bigtime_t smoothedRoundTripTime) const
+{
+	uint64 bandwidth = _Bandwidth();
+	if (bandwidth == 0) {
+		// no estimate yet, derive one from the window
+		if (smoothedRoundTripTime <= 0)
+			return 0;
+		bandwidth = (uint64)window * 1000000 / smoothedRoundTripTime;
+	}
+
+	uint64 rate = bandwidth * _Gain() / 100;
+	return min_c(rate, (uint64)UINT32_MAX);
+}
+
+
+void
+Paced::_RoundCompleted(bigtime_t now)
+{
+	fBandwidthSamples[fSampleIndex] = min_c(
+		fRoundDelivered * 1000000 / (now - fRoundStart), (uint64)UINT32_MAX);
+	fSampleIndex = (fSampleIndex + 1) % kBandwidthSamples;
+	fRoundDelivered = 0;
+	fRoundStart = now;
+
+	switch (fMode) {
+		case STARTUP:
+		{
+			// leave startup when the bandwidth did not grow by at least 25%
+			// for three rounds in a row
+			uint32 bandwidth = _Bandwidth();
+			if (bandwidth >= (uint64)fFullBandwidth * 5 / 4) {
+				fFullBandwidth = bandwidth;
+				fFullBandwidthRounds = 0;
+			} else if (++fFullBandwidthRounds >= 3)
+				fMode = DRAIN;
+			break;
+		}
+		case DRAIN:
+			fMode = PROBE_BANDWIDTH;
+			fCycleIndex = 0;
+			break;
+		case PROBE_BANDWIDTH:
+			fCycleIndex = (fCycleIndex + 1) % kGainCycleLength;
+			break;
+	}
+}
+
+
+/*!	Returns the windowed maximum of the recent delivery rate samples.
+*/
+uint32
+Paced::_Bandwidth() const
+{
+	uint32 bandwidth = 0;
+	for (int32 i = 0; i < kBandwidthSamples; i++)
+		bandwidth = max_c(bandwidth, fBandwidthSamples[i]);
+
+	return bandwidth;
+}
+
+
+uint32
+Paced::_BandwidthDelayProduct() const
+{
+	uint64 product = (uint64)_Bandwidth() * fMinRoundTrip / 1000000;
+	return min_c(product, (uint64)UINT32_MAX);
+}
+
+
+uint32
+Paced::_Gain() const
+{
+	switch (fMode) {
+		case STARTUP:
+			return kStartupGain;
+		case DRAIN:
+			return kDrainGain;
+		case PROBE_BANDWIDTH:
+		default:
+			return kProbeGains[fCycleIndex];
+	}
+}
+
+
+//	#pragma mark - registry
+
+
+static CongestionControl*
+create_new_reno()
+{
+	return new(std::nothrow) NewReno;
+}
+
+
+static CongestionControl*
+create_cubic()
+{
+	return new(std::nothrow) Cubic;
+}
+
+
+static CongestionControl*
+create_paced()
+{
+	return new(std::nothrow) Paced;
+}
+
+
+struct congestion_control_algorithm {
+	const char*			name;
+	CongestionControl*	(*create)();
+};
+
+static const congestion_control_algorithm kAlgorithms[] = {
+	{"newreno", &create_new_reno},
+	{"cubic", &create_cubic},
+	{"paced", &create_paced},
+};
+static const int32 kAlgorithmCount
+	= sizeof(kAlgorithms) / sizeof(kAlgorithms[0]);
+
+static int32 sDefaultAlgorithm = 1;
+	// CUBIC
+
+
+static int32
+find_algorithm(const char* name)
+{
+	for (int32 i = 0; i < kAlgorithmCount; i++) {
+		if (strcmp(kAlgorithms[i].name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+
+/*!	Creates a new instance of the congestion control algorithm \a name, or
+	of the system wide default if \a name is \c NULL. Returns \c NULL if
+	there is no such algorithm, or if the memory is exhausted.
+*/
+CongestionControl*
+create_congestion_control(const char* name)
+{
+	int32 index = name != NULL
+		? find_algorithm(name) : atomic_get(&sDefaultAlgorithm);
+	if (index < 0)
+		return NULL;
+
+	return kAlgorithms[index].create();
+}
+
+
+status_t
+set_default_congestion_control(const char* name)
+{
+	int32 index = find_algorithm(name);
+	if (index < 0)
+		return B_NAME_NOT_FOUND;
+
+	atomic_set(&sDefaultAlgorithm, index);
+	return B_OK;
+}
+
+
+const char*
+default_congestion_control()
+{
+	return kAlgorithms[atomic_get(&sDefaultAlgorithm)].name;
+}
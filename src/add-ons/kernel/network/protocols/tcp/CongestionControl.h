@@ -0,0 +1,43 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef CONGESTION_CONTROL_H
+#define CONGESTION_CONTROL_H
+
+
+#include <SupportDefs.h>
+
+
+/*!	The congestion control algorithm of a TCP endpoint. The endpoint owns the
+	congestion window and the slow start threshold, and runs loss recovery
+	itself; the algorithm only decides how the window grows, and how far it
+	is reduced when congestion has been detected.
+
+	The default implementation is NewReno (RFC 5681).
+*/
+class CongestionControl {
+public:
+	virtual						~CongestionControl();
+
+	virtual	const char*			Name() const = 0;
+
+	virtual	void				Acknowledged(uint32& window, uint32 threshold,
+									uint32 bytesAcknowledged,
+									uint32 maxSegmentSize);
+	virtual	uint32				LossDetected(uint32 window, uint32 flightSize,
+									uint32 maxSegmentSize);
+	virtual	void				RetransmitTimeout();
+	virtual	void				RoundTripTimeSample(bigtime_t roundTripTime);
+
+	virtual	uint32				PacingRate(uint32 window,
+									bigtime_t smoothedRoundTripTime) const;
+};
+
+
+CongestionControl* create_congestion_control(const char* name);
+status_t set_default_congestion_control(const char* name);
+const char* default_congestion_control();
+
+
+#endif	// CONGESTION_CONTROL_H
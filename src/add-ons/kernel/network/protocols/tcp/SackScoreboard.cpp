@@ -0,0 +1,255 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "SackScoreboard.h"
+
+#include <KernelExport.h>
+
+#include <string.h>
+
+
+// The number of duplicate acknowledgements, or SACKed segments above a hole,
+// after which the hole is considered lost (RFC 6675, DupThresh)
+static const uint32 kDuplicateThreshold = 3;
+
+
+SackScoreboard::SackScoreboard()
+	:
+	fCount(0)
+{
+}
+
+
+void
+SackScoreboard::Clear()
+{
+	fCount = 0;
+}
+
+
+/*!	Adds the SACK blocks of an incoming acknowledgement to the scoreboard.
+	Blocks that are outside of the range between \a unacknowledged and \a max
+	are bogus, or report duplicates (RFC 2883), and are ignored.
+*/
+void
+SackScoreboard::Update(tcp_sequence unacknowledged, tcp_sequence max,
+	const tcp_sack* sacks, int count)
+{
+	RemoveUntil(unacknowledged);
+
+	for (int i = 0; i < count; i++) {
+		tcp_sequence left = sacks[i].left_edge;
+		tcp_sequence right = sacks[i].right_edge;
+
+		if (left >= right || right > max || right <= unacknowledged)
+			continue;
+		if (left < unacknowledged)
+			left = unacknowledged;
+
+		_Add(left, right);
+	}
+}
+
+
+/*!	Forgets about all ranges below \a sequence, ie. everything that has
+	been acknowledged cumulatively.
+*/
+void
+SackScoreboard::RemoveUntil(tcp_sequence sequence)
+{
+	int32 removed = 0;
+	while (removed < fCount && fRanges[removed].right <= sequence)
+		removed++;
+
+	if (removed > 0) {
+		fCount -= removed;
+		memmove(fRanges, fRanges + removed, fCount * sizeof(Range));
+	}
+
+	if (fCount > 0 && fRanges[0].left < sequence)
+		fRanges[0].left = sequence;
+}
+
+
+tcp_sequence
+SackScoreboard::HighestSacked() const
+{
+	if (fCount == 0)
+		return 0;
+
+	return fRanges[fCount - 1].right;
+}
+
+
+bool
+SackScoreboard::IsSacked(tcp_sequence sequence) const
+{
+	for (int32 i = 0; i < fCount; i++) {
+		if (sequence < fRanges[i].left)
+			return false;
+		if (sequence < fRanges[i].right)
+			return true;
+	}
+
+	return false;
+}
+
+
+/*!	Returns whether or not the data at \a sequence is considered lost, that
+	is, if either enough discontiguous ranges, or more than
+	(DupThresh - 1) * SMSS bytes above it have been SACKed (RFC 6675, IsLost).
+*/
+bool
+SackScoreboard::IsLost(tcp_sequence sequence, uint32 maxSegmentSize) const
+{
+	int32 index = 0;
+	while (index < fCount && fRanges[index].right <= sequence)
+		index++;
+
+	if (index < fCount && fRanges[index].left <= sequence)
+		return false;
+
+	return _IsLost(index, maxSegmentSize);
+}
+
+
+/*!	Finds the first hole at or after \a from that is below the highest SACKed
+	sequence. Data beyond that has not been reported by the peer at all, and
+	is never considered to be a hole.
+*/
+bool
+SackScoreboard::NextHole(tcp_sequence from, tcp_sequence& _start,
+	uint32& _length) const
+{
+	for (int32 i = 0; i < fCount; i++) {
+		if (from >= fRanges[i].right)
+			continue;
+
+		if (from >= fRanges[i].left) {
+			// we're within a SACKed range, the hole starts after it
+			from = fRanges[i].right;
+			continue;
+		}
+
+		_start = from;
+		_length = (fRanges[i].left - from).Number();
+		return true;
+	}
+
+	return false;
+}
+
+
+/*!	Estimates the number of bytes that are still in flight, as defined by
+	SetPipe() in RFC 6675: every byte between \a unacknowledged and \a max
+	that has not been SACKed counts once if it's not considered lost, and
+	once more if it has been retransmitted already.
+*/
+uint32
+SackScoreboard::Pipe(tcp_sequence unacknowledged, tcp_sequence max,
+	tcp_sequence highRetransmitted, uint32 maxSegmentSize) const
+{
+	uint32 pipe = 0;
+	tcp_sequence start = unacknowledged;
+
+	for (int32 i = 0; i <= fCount; i++) {
+		tcp_sequence end = i < fCount ? fRanges[i].left : max;
+		if (end > start) {
+			// the hole before range i - all holes but the last one may have
+			// been lost
+			if (i == fCount || !_IsLost(i, maxSegmentSize))
+				pipe += (end - start).Number();
+
+			if (highRetransmitted > start) {
+				tcp_sequence retransmitted = highRetransmitted < end
+					? highRetransmitted : end;
+				pipe += (retransmitted - start).Number();
+			}
+		}
+
+		if (i < fCount)
+			start = fRanges[i].right;
+	}
+
+	return pipe;
+}
+
+
+void
+SackScoreboard::Dump() const
+{
+	kprintf("    SACK scoreboard: %" B_PRId32 " ranges\n", fCount);
+	for (int32 i = 0; i < fCount; i++) {
+		kprintf("      %" B_PRIu32 " - %" B_PRIu32 "\n",
+			fRanges[i].left.Number(), fRanges[i].right.Number());
+	}
+}
+
+
+void
+SackScoreboard::_Add(tcp_sequence left, tcp_sequence right)
+{
+	// find the first range that ends at or after the new one begins
+	int32 index = 0;
+	while (index < fCount && fRanges[index].right < left)
+		index++;
+
+	if (index < fCount && fRanges[index].left <= right) {
+		// merge with the existing range, and all ranges that we now cover
+		if (left < fRanges[index].left)
+			fRanges[index].left = left;
+		if (right > fRanges[index].right)
+			fRanges[index].right = right;
+
+		while (index + 1 < fCount
+			&& fRanges[index + 1].left <= fRanges[index].right) {
+			if (fRanges[index + 1].right > fRanges[index].right)
+				fRanges[index].right = fRanges[index + 1].right;
+			_Remove(index + 1);
+		}
+		return;
+	}
+
+	if (fCount == kMaxRanges) {
+		// Forget about the highest range; the data will just be considered
+		// outstanding again, which is on the safe side.
+		if (index == fCount)
+			return;
+		fCount--;
+	}
+
+	memmove(fRanges + index + 1, fRanges + index,
+		(fCount - index) * sizeof(Range));
+	fRanges[index].left = left;
+	fRanges[index].right = right;
+	fCount++;
+}
+
+
+void
+SackScoreboard::_Remove(int32 index)
+{
+	fCount--;
+	memmove(fRanges + index, fRanges + index + 1,
+		(fCount - index) * sizeof(Range));
+}
+
+
+/*!	Returns whether a hole directly below the range at \a firstAbove is lost,
+	given that all ranges starting with that one are above it.
+*/
+bool
+SackScoreboard::_IsLost(int32 firstAbove, uint32 maxSegmentSize) const
+{
+	if ((uint32)(fCount - firstAbove) >= kDuplicateThreshold)
+		return true;
+
+	uint32 sackedBytes = 0;
+	for (int32 i = firstAbove; i < fCount; i++)
+		sackedBytes += (fRanges[i].right - fRanges[i].left).Number();
+
+	return sackedBytes > (kDuplicateThreshold - 1) * maxSegmentSize;
+}
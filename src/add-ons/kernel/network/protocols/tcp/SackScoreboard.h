@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef SACK_SCOREBOARD_H
+#define SACK_SCOREBOARD_H
+
+
+#include "tcp.h"
+
+
+/*!	Keeps track of the data the peer has selectively acknowledged, and
+	implements the loss detection and pipe estimation of RFC 6675 on top of
+	it. All sequences passed in must be within the current send window.
+*/
+class SackScoreboard {
+public:
+								SackScoreboard();
+
+			void				Clear();
+			bool				IsEmpty() const { return fCount == 0; }
+
+			void				Update(tcp_sequence unacknowledged,
+									tcp_sequence max, const tcp_sack* sacks,
+									int count);
+			void				RemoveUntil(tcp_sequence sequence);
+
+			tcp_sequence		HighestSacked() const;
+			bool				IsSacked(tcp_sequence sequence) const;
+			bool				IsLost(tcp_sequence sequence,
+									uint32 maxSegmentSize) const;
+			bool				NextHole(tcp_sequence from,
+									tcp_sequence& _start,
+									uint32& _length) const;
+			uint32				Pipe(tcp_sequence unacknowledged,
+									tcp_sequence max,
+									tcp_sequence highRetransmitted,
+									uint32 maxSegmentSize) const;
+
+			void				Dump() const;
+
+private:
+	struct Range {
+		tcp_sequence	left;
+		tcp_sequence	right;
+	};
+
+	static const int32	kMaxRanges = 32;
+
+			void				_Add(tcp_sequence left, tcp_sequence right);
+			void				_Remove(int32 index);
+			bool				_IsLost(int32 firstAbove,
+									uint32 maxSegmentSize) const;
+
+private:
+			Range				fRanges[kMaxRanges];
+				// sorted, non-overlapping, and non-adjacent
+			int32				fCount;
+};
+
+
+#endif	// SACK_SCOREBOARD_H
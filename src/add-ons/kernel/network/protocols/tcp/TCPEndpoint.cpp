@@ -25,6 +25,7 @@
 
 #include <net_buffer.h>
 #include <net_datalink.h>
+#include <net_device.h>
 #include <net_stat.h>
 #include <NetBufferUtilities.h>
 #include <NetUtilities.h>
@@ -41,6 +42,9 @@
 //	- RFC 793 - Transmission Control Protocol
 //	- RFC 813 - Window and Acknowledgement Strategy in TCP
 //	- RFC 1337 - TIME_WAIT Assassination Hazards in TCP
+//	- RFC 2018 - TCP Selective Acknowledgment Options
+//	- RFC 6675 - A Conservative Loss Recovery Algorithm Based on Selective
+//	  Acknowledgment (SACK) for TCP
 //
 // Things this implementation currently doesn't implement:
 //	- TCP Slow Start, Congestion Avoidance, Fast Retransmit, and Fast Recovery,
@@ -48,7 +52,7 @@
 //	- NewReno Modification to TCP's Fast Recovery, RFC 2582
 //	- Explicit Congestion Notification (ECN), RFC 3168
 //	- SYN-Cache
-//	- SACK, Selective Acknowledgment - RFC 2018, RFC 2883, RFC 3517
+//	- Duplicate SACK, RFC 2883
 //	- Forward RTO-Recovery, RFC 4138
 //	- Time-Wait hash instead of keeping sockets alive
 //
@@ -319,7 +323,10 @@ enum {
 	FLAG_CLOSED					= 0x08,
 	FLAG_DELETE_ON_CLOSE		= 0x10,
 	FLAG_LOCAL					= 0x20,
-	FLAG_RECOVERY				= 0x40
+	FLAG_RECOVERY				= 0x40,
+	FLAG_OPTION_SACK_PERMITTED	= 0x80,
+	FLAG_SACK_RECOVERY			= 0x100
+		// set together with FLAG_RECOVERY when it's driven by the scoreboard
 };
 
 
@@ -436,12 +443,14 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 	fDuplicateAcknowledgeCount(0),
 	fPreviousFlightSize(0),
 	fRecover(0),
+	fHighRetransmitted(0),
 	fRoute(NULL),
 	fReceiveNext(0),
 	fReceiveMaxAdvertised(0),
 	fReceiveWindow(socket->receive.buffer_size),
 	fReceiveMaxSegmentSize(TCP_DEFAULT_MAX_SEGMENT_SIZE),
 	fReceiveQueue(socket->receive.buffer_size),
+	fLastSegmentReceived(0),
 	fSmoothedRoundTripTime(0),
 	fRoundTripVariation(0),
 	fSendTime(0),
@@ -450,8 +459,11 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 	fReceivedTimestamp(0),
 	fCongestionWindow(0),
 	fSlowStartThreshold(0),
+	fCongestionControl(create_congestion_control(NULL)),
+	fNextSendTime(0),
 	fState(CLOSED),
-	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP)
+	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP
+		| FLAG_OPTION_SACK_PERMITTED)
 {
 	// TODO: to be replaced with a real read/write locking strategy!
 	mutex_init(&fLock, "tcp lock");
@@ -466,6 +478,7 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 		TCPEndpoint::_DelayedAcknowledgeTimer, this);
 	gStackModule->init_timer(&fTimeWaitTimer, TCPEndpoint::_TimeWaitTimer,
 		this);
+	gStackModule->init_timer(&fPacingTimer, TCPEndpoint::_PacingTimer, this);
 
 	T(APICall(this, "constructor"));
 }
@@ -493,14 +506,19 @@ TCPEndpoint::~TCPEndpoint()
 	gStackModule->wait_for_timer(&fPersistTimer);
 	gStackModule->wait_for_timer(&fDelayedAcknowledgeTimer);
 	gStackModule->wait_for_timer(&fTimeWaitTimer);
+	gStackModule->wait_for_timer(&fPacingTimer);
 
 	gDatalinkModule->put_route(Domain(), fRoute);
+	delete fCongestionControl;
 }
 
 
 status_t
 TCPEndpoint::InitCheck() const
 {
+	if (fCongestionControl == NULL)
+		return B_NO_MEMORY;
+
 	return B_OK;
 }
 
@@ -1051,6 +1069,17 @@ TCPEndpoint::SetReceiveBufferSize(size_t length)
 status_t
 TCPEndpoint::GetOption(int option, void* _value, int* _length)
 {
+	if (option == TCP_CONGESTION) {
+		if (*_length <= 0)
+			return B_BAD_VALUE;
+
+		MutexLocker _(fLock);
+		strlcpy((char*)_value, fCongestionControl->Name(),
+			min_c(*_length, TCP_CA_NAME_MAX));
+		*_length = strlen((char*)_value) + 1;
+		return B_OK;
+	}
+
 	if (*_length != sizeof(int))
 		return B_BAD_VALUE;
 
@@ -1077,6 +1106,19 @@ TCPEndpoint::GetOption(int option, void* _value, int* _length)
 status_t
 TCPEndpoint::SetOption(int option, const void* _value, int length)
 {
+	if (option == TCP_CONGESTION) {
+		if (length <= 0)
+			return B_BAD_VALUE;
+
+		char name[TCP_CA_NAME_MAX];
+		size_t nameLength = min_c((size_t)length, sizeof(name) - 1);
+		memcpy(name, _value, nameLength);
+		name[nameLength] = '\0';
+
+		MutexLocker _(fLock);
+		return _SetCongestionControl(name);
+	}
+
 	if (option != TCP_NODELAY)
 		return B_BAD_VALUE;
 
@@ -1171,6 +1213,27 @@ TCPEndpoint::_UpdateTimeWait()
 }
 
 
+/*!	Replaces the congestion control algorithm of this endpoint with a fresh
+	instance of \a name; it will have to learn about the path from scratch.
+*/
+status_t
+TCPEndpoint::_SetCongestionControl(const char* name)
+{
+	if (strcmp(fCongestionControl->Name(), name) == 0)
+		return B_OK;
+
+	CongestionControl* control = create_congestion_control(name);
+	if (control == NULL)
+		return B_BAD_VALUE;
+
+	delete fCongestionControl;
+	fCongestionControl = control;
+	fNextSendTime = 0;
+
+	return B_OK;
+}
+
+
 void
 TCPEndpoint::_CancelConnectionTimers()
 {
@@ -1180,6 +1243,8 @@ TCPEndpoint::_CancelConnectionTimers()
 	T(TimerSet(this, "persist", -1));
 	gStackModule->cancel_timer(&fDelayedAcknowledgeTimer);
 	T(TimerSet(this, "delayed ack", -1));
+	gStackModule->cancel_timer(&fPacingTimer);
+	T(TimerSet(this, "pacing", -1));
 }
 
 
@@ -1286,7 +1351,27 @@ TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 	if (fDuplicateAcknowledgeCount == 0)
 		fPreviousFlightSize = (fSendMax - fSendUnacknowledged).Number();
 
-	if (++fDuplicateAcknowledgeCount < 3) {
+	fDuplicateAcknowledgeCount++;
+
+	// The peer tells us exactly what it got; recovery is driven by the
+	// scoreboard instead of by inflating the congestion window
+	if ((fFlags & FLAG_SACK_RECOVERY) != 0) {
+		_SackRecoveryTransmit();
+		return;
+	}
+
+	if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0
+		&& (fFlags & FLAG_RECOVERY) == 0
+		&& !fSackScoreboard.IsEmpty()
+		&& (fDuplicateAcknowledgeCount >= 3
+			|| fSackScoreboard.IsLost(fSendUnacknowledged,
+				fSendMaxSegmentSize))
+		&& (segment.acknowledge - 1) > fRecover) {
+		_EnterSackRecovery();
+		return;
+	}
+
+	if (fDuplicateAcknowledgeCount < 3) {
 		if (fSendQueue.Available(fSendMax) != 0  && fSendWindow != 0) {
 			fSendNext = fSendMax;
 			fCongestionWindow += fDuplicateAcknowledgeCount * fSendMaxSegmentSize;
@@ -1301,7 +1386,8 @@ TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 			(fSendUnacknowledged - fPreviousHighestAcknowledge) <= 4 * fSendMaxSegmentSize)) {
 			fFlags |= FLAG_RECOVERY;
 			fRecover = fSendMax.Number() - 1;
-			fSlowStartThreshold = max_c(fPreviousFlightSize / 2, 2 * fSendMaxSegmentSize);
+			fSlowStartThreshold = fCongestionControl->LossDetected(
+				fCongestionWindow, fPreviousFlightSize, fSendMaxSegmentSize);
 			fCongestionWindow = fSlowStartThreshold + 3 * fSendMaxSegmentSize;
 			fSendNext = segment.acknowledge;
 			_SendQueued();
@@ -1319,6 +1405,82 @@ TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 }
 
 
+/*!	Starts loss recovery as described in RFC 6675: the congestion window is
+	halved, and the segments the peer reported missing are retransmitted as
+	far as the estimated amount of data in flight allows.
+*/
+void
+TCPEndpoint::_EnterSackRecovery()
+{
+	TRACE("_EnterSackRecovery(): una %" B_PRIu32 ", max %" B_PRIu32,
+		fSendUnacknowledged.Number(), fSendMax.Number());
+
+	fFlags |= FLAG_RECOVERY | FLAG_SACK_RECOVERY;
+	fRecover = fSendMax.Number() - 1;
+	fSlowStartThreshold = fCongestionControl->LossDetected(fCongestionWindow,
+		fPreviousFlightSize, fSendMaxSegmentSize);
+	fCongestionWindow = fSlowStartThreshold;
+	fHighRetransmitted = fSendUnacknowledged;
+
+	// the first hole is retransmitted in any case
+	tcp_sequence start;
+	uint32 length;
+	if (fSackScoreboard.NextHole(fSendUnacknowledged, start, length)) {
+		uint32 sent;
+		if (_SendRange(start, min_c(length, fSendMaxSegmentSize), sent)
+				== B_OK) {
+			fHighRetransmitted = start + sent;
+		}
+	}
+
+	_SackRecoveryTransmit();
+}
+
+
+/*!	Sends as many segments as the congestion window allows during SACK
+	recovery, choosing them as NextSeg() in RFC 6675 does: lost holes first,
+	then new data, and then holes that have not been declared lost yet.
+*/
+void
+TCPEndpoint::_SackRecoveryTransmit()
+{
+	while (true) {
+		uint32 pipe = fSackScoreboard.Pipe(fSendUnacknowledged, fSendMax,
+			fHighRetransmitted, fSendMaxSegmentSize);
+		if (fCongestionWindow < pipe + fSendMaxSegmentSize)
+			break;
+
+		tcp_sequence from = fHighRetransmitted > fSendUnacknowledged
+			? fHighRetransmitted : fSendUnacknowledged;
+		tcp_sequence start;
+		uint32 length;
+		bool hole = fSackScoreboard.NextHole(from, start, length);
+
+		uint32 window = fSendWindow - min_c(fSendWindow,
+			(fSendMax - fSendUnacknowledged).Number());
+		uint32 available = min_c(fSendQueue.Available(fSendMax), window);
+
+		uint32 sent;
+		if (hole && fSackScoreboard.IsLost(start, fSendMaxSegmentSize)) {
+			if (_SendRange(start, min_c(length, fSendMaxSegmentSize), sent)
+					!= B_OK)
+				break;
+			fHighRetransmitted = start + sent;
+		} else if (available > 0) {
+			if (_SendRange(fSendMax, min_c(available, fSendMaxSegmentSize),
+					sent) != B_OK)
+				break;
+		} else if (hole) {
+			if (_SendRange(start, min_c(length, fSendMaxSegmentSize), sent)
+					!= B_OK)
+				break;
+			fHighRetransmitted = start + sent;
+		} else
+			break;
+	}
+}
+
+
 void
 TCPEndpoint::_UpdateTimestamps(tcp_segment_header& segment,
 	size_t segmentLength)
@@ -1370,6 +1532,7 @@ TCPEndpoint::_AddData(tcp_segment_header& segment, net_buffer* buffer)
 		fFinishReceivedAt = segment.sequence + buffer->size;
 	}
 
+	fLastSegmentReceived = segment.sequence;
 	fReceiveQueue.Add(buffer, segment.sequence);
 	fReceiveNext = fReceiveQueue.NextSequence();
 
@@ -1420,7 +1583,11 @@ TCPEndpoint::_PrepareReceivePath(tcp_segment_header& segment)
 			fReceivedTimestamp = segment.timestamp_value;
 		} else
 			fFlags &= ~FLAG_OPTION_TIMESTAMP;
-	}
+
+		if ((segment.options & TCP_SACK_PERMITTED) == 0)
+			fFlags &= ~FLAG_OPTION_SACK_PERMITTED;
+	} else
+		fFlags &= ~FLAG_OPTION_SACK_PERMITTED;
 
 	if (fSendMaxSegmentSize > 2190)
 		fCongestionWindow = 2 * fSendMaxSegmentSize;
@@ -1477,6 +1644,11 @@ TCPEndpoint::_Spawn(TCPEndpoint* parent, tcp_segment_header& segment,
 	fOptions = parent->fOptions;
 	fAcceptSemaphore = parent->fAcceptSemaphore;
 
+	if (_SetCongestionControl(parent->fCongestionControl->Name()) != B_OK) {
+		T(Error(this, "congestion control failed", __LINE__));
+		return DROP;
+	}
+
 	_PrepareReceivePath(segment);
 
 	// send SYN+ACK
@@ -1581,7 +1753,8 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		&& segment.AcknowledgeOnly()
 		&& fReceiveNext == segment.sequence
 		&& advertisedWindow > 0 && advertisedWindow == fSendWindow
-		&& fSendNext == fSendMax) {
+		&& fSendNext == fSendMax
+		&& segment.sack_count == 0 && (fFlags & FLAG_RECOVERY) == 0) {
 		_UpdateTimestamps(segment, segmentLength);
 
 		if (segmentLength == 0) {
@@ -1729,6 +1902,13 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		if (fSendMax < segment.acknowledge)
 			return DROP | IMMEDIATE_ACKNOWLEDGE;
 
+		if (segment.sack_count > 0
+			&& (fFlags & FLAG_OPTION_SACK_PERMITTED) != 0
+			&& segment.acknowledge >= fSendUnacknowledged) {
+			fSackScoreboard.Update(segment.acknowledge, fSendMax,
+				segment.sacks, segment.sack_count);
+		}
+
 		if (segment.acknowledge == fSendUnacknowledged) {
 			if (buffer->size == 0 && advertisedWindow == fSendWindow
 				&& (segment.flags & TCP_FLAG_FINISH) == 0 && fSendUnacknowledged != fSendMax) {
@@ -1740,13 +1920,14 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		} else {
 			// this segment acknowledges in flight data
 
-			if (fDuplicateAcknowledgeCount >= 3) {
+			if (fDuplicateAcknowledgeCount >= 3
+				|| (fFlags & FLAG_RECOVERY) != 0) {
 				// deflate the window.
 				if (segment.acknowledge > fRecover) {
 					uint32 flightSize = (fSendMax - fSendUnacknowledged).Number();
 					fCongestionWindow = min_c(fSlowStartThreshold,
 						max_c(flightSize, fSendMaxSegmentSize) + fSendMaxSegmentSize);
-					fFlags &= ~FLAG_RECOVERY;
+					fFlags &= ~(FLAG_RECOVERY | FLAG_SACK_RECOVERY);
 				}
 			}
 
@@ -1962,7 +2143,7 @@ TCPEndpoint::_ShouldSendSegment(tcp_segment_header& segment, uint32 length,
 		// - the buffer is at least larger than half of the maximum send window,
 		//   or
 		// - we're retransmitting data
-		if (length == segmentMaxSize
+		if (length >= segmentMaxSize
 			|| (fOptions & TCP_NODELAY) != 0
 			|| tcp_sequence(fSendNext + length) == fSendQueue.LastSequence()
 			|| (fSendMaxWindow > 0 && length >= fSendMaxWindow / 2))
@@ -2002,21 +2183,12 @@ TCPEndpoint::_SendQueued(bool force)
 }
 
 
-/*!	Sends one or more TCP segments with the data waiting in the queue, or some
-	specific flags that need to be sent.
+/*!	Fills in the options, the window, and the acknowledgement of an outgoing
+	segment.
 */
-status_t
-TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
+void
+TCPEndpoint::_PrepareSegment(tcp_segment_header& segment)
 {
-	if (fRoute == NULL)
-		return B_ERROR;
-
-	// in passive state?
-	if (fState == LISTEN)
-		return B_ERROR;
-
-	tcp_segment_header segment(_CurrentFlags());
-
 	if ((fOptions & TCP_NOOPT) == 0) {
 		if ((fFlags & FLAG_OPTION_TIMESTAMP) != 0) {
 			segment.options |= TCP_HAS_TIMESTAMPS;
@@ -2032,6 +2204,15 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 				segment.options |= TCP_HAS_WINDOW_SCALE;
 				segment.window_shift = fReceiveWindowShift;
 			}
+			if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0)
+				segment.options |= TCP_SACK_PERMITTED;
+		}
+
+		if ((fFlags & FLAG_OPTION_SACK_PERMITTED) != 0
+			&& !fReceiveQueue.IsContiguous()) {
+			// tell the peer what we got beyond the holes in our queue
+			segment.sack_count = fReceiveQueue.PopulateSackInfo(
+				fLastSegmentReceived, TCP_MAX_SACK_BLOCKS, segment.sacks);
 		}
 	}
 
@@ -2057,6 +2238,134 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			// send window on overlap
 		segment.urgent_offset = 0;
 	}
+}
+
+
+/*!	Sends a single segment with \a segmentLength bytes from the send queue,
+	starting at fSendNext, and updates the send state accordingly.
+*/
+status_t
+TCPEndpoint::_SendSegment(tcp_segment_header& segment, uint32 segmentLength,
+	uint32 segmentMaxSize, uint32& sendWindow, bool retransmit,
+	bool& startRetransmitTimer)
+{
+	net_buffer *buffer = gBufferModule->create(256);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = B_OK;
+	if (segmentLength > 0)
+		status = fSendQueue.Get(buffer, fSendNext, segmentLength);
+	if (status < B_OK) {
+		gBufferModule->free(buffer);
+		return status;
+	}
+
+	LocalAddress().CopyTo(buffer->source);
+	PeerAddress().CopyTo(buffer->destination);
+
+	uint32 size = buffer->size;
+	segment.sequence = fSendNext.Number();
+
+	TRACE("_SendSegment(): buffer %p (%" B_PRIu32 " bytes) address %s to "
+		"%s flags %#" B_PRIx8 ", seq %" B_PRIu32 ", ack %" B_PRIu32
+		", rwnd %" B_PRIu16 ", cwnd %" B_PRIu32 ", ssthresh %" B_PRIu32
+		", len %" B_PRIu32 ", first %" B_PRIu32 ", last %" B_PRIu32,
+		buffer, buffer->size, PrintAddress(buffer->source),
+		PrintAddress(buffer->destination), segment.flags, segment.sequence,
+		segment.acknowledge, segment.advertised_window,
+		fCongestionWindow, fSlowStartThreshold, segmentLength,
+		fSendQueue.FirstSequence().Number(),
+		fSendQueue.LastSequence().Number());
+	T(Send(this, segment, buffer, fSendQueue.FirstSequence(),
+		fSendQueue.LastSequence()));
+
+	PROBE(buffer, sendWindow);
+	sendWindow -= buffer->size;
+
+	if (segmentLength > segmentMaxSize) {
+		buffer->offload |= Domain()->family == AF_INET6
+			? NET_BUFFER_SEGMENT_TCP6 : NET_BUFFER_SEGMENT_TCP4;
+		buffer->segment_size = segmentMaxSize;
+	}
+
+	status = add_tcp_header(AddressModule(), segment, buffer);
+	if (status != B_OK) {
+		gBufferModule->free(buffer);
+		return status;
+	}
+
+	// Update send status - we need to do this before we send the data
+	// for local connections as the answer is directly handled
+
+	if (segment.flags & TCP_FLAG_SYNCHRONIZE) {
+		segment.options &= ~(TCP_HAS_WINDOW_SCALE | TCP_SACK_PERMITTED);
+		segment.max_segment_size = 0;
+		size++;
+	}
+
+	if (segment.flags & TCP_FLAG_FINISH)
+		size++;
+
+	uint32 sendMax = fSendMax.Number();
+	fSendNext += size;
+	if (fSendMax < fSendNext)
+		fSendMax = fSendNext;
+
+	fReceiveMaxAdvertised = fReceiveNext
+		+ ((uint32)segment.advertised_window << fReceiveWindowShift);
+
+	if (segmentLength != 0 && fState == ESTABLISHED) {
+		fSendMaxSegments -= min_c(fSendMaxSegments,
+			(segmentLength + segmentMaxSize - 1) / segmentMaxSize);
+	}
+
+	status = next->module->send_routed_data(next, fRoute, buffer);
+	if (status < B_OK) {
+		gBufferModule->free(buffer);
+
+		fSendNext = segment.sequence;
+		fSendMax = sendMax;
+			// restore send status
+		return status;
+	}
+
+	if (fSendTime == 0 && !retransmit
+		&& (segmentLength != 0 || (segment.flags & TCP_FLAG_SYNCHRONIZE) !=0)) {
+		fSendTime = tcp_now();
+		fRoundTripStartSequence = segment.sequence;
+	}
+
+	if (startRetransmitTimer && size > 0) {
+		TRACE("starting initial retransmit timer of: %" B_PRIdBIGTIME,
+			fRetransmitTimeout);
+		gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
+		T(TimerSet(this, "retransmit", fRetransmitTimeout));
+		startRetransmitTimer = false;
+	}
+
+	if (segment.flags & TCP_FLAG_ACKNOWLEDGE)
+		fLastAcknowledgeSent = segment.acknowledge;
+
+	return B_OK;
+}
+
+
+/*!	Sends one or more TCP segments with the data waiting in the queue, or some
+	specific flags that need to be sent.
+*/
+status_t
+TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
+{
+	if (fRoute == NULL)
+		return B_ERROR;
+
+	// in passive state?
+	if (fState == LISTEN)
+		return B_ERROR;
+
+	tcp_segment_header segment(_CurrentFlags());
+	_PrepareSegment(segment);
 
 	if (fCongestionWindow > 0 && fCongestionWindow < sendWindow)
 		sendWindow = fCongestionWindow;
@@ -2104,6 +2413,13 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			- tcp_options_length(segment);
 		uint32 segmentLength = min_c(length, segmentMaxSize);
 
+		if (length > segmentMaxSize && !retransmit
+			&& (segment.flags & TCP_FLAG_SYNCHRONIZE) == 0) {
+			// let the device split up as much as possible at once
+			segmentLength = max_c(segmentLength,
+				min_c(length, _OffloadSegmentLength(segmentMaxSize)));
+		}
+
 		if (fSendNext + segmentLength == fSendQueue.LastSequence()) {
 			if (state_needs_finish(fState))
 				segment.flags |= TCP_FLAG_FINISH;
@@ -2121,109 +2437,125 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			break;
 		}
 
-		net_buffer *buffer = gBufferModule->create(256);
-		if (buffer == NULL)
-			return B_NO_MEMORY;
-
-		status_t status = B_OK;
-		if (segmentLength > 0)
-			status = fSendQueue.Get(buffer, fSendNext, segmentLength);
-		if (status < B_OK) {
-			gBufferModule->free(buffer);
-			return status;
+		bigtime_t delay;
+		if (!force && !retransmit && segmentLength > 0 && _ShouldPace(delay)) {
+			// the pacing timer will send the rest
+			if (!gStackModule->is_timer_active(&fPacingTimer)) {
+				gStackModule->set_timer(&fPacingTimer, delay);
+				T(TimerSet(this, "pacing", delay));
+			}
+			break;
 		}
 
-		LocalAddress().CopyTo(buffer->source);
-		PeerAddress().CopyTo(buffer->destination);
-
-		uint32 size = buffer->size;
-		segment.sequence = fSendNext.Number();
-
-		TRACE("SendQueued(): buffer %p (%" B_PRIu32 " bytes) address %s to "
-			"%s flags %#" B_PRIx8 ", seq %" B_PRIu32 ", ack %" B_PRIu32
-			", rwnd %" B_PRIu16 ", cwnd %" B_PRIu32 ", ssthresh %" B_PRIu32
-			", len %" B_PRIu32 ", first %" B_PRIu32 ", last %" B_PRIu32,
-			buffer, buffer->size, PrintAddress(buffer->source),
-			PrintAddress(buffer->destination), segment.flags, segment.sequence,
-			segment.acknowledge, segment.advertised_window,
-			fCongestionWindow, fSlowStartThreshold, segmentLength,
-			fSendQueue.FirstSequence().Number(),
-			fSendQueue.LastSequence().Number());
-		T(Send(this, segment, buffer, fSendQueue.FirstSequence(),
-			fSendQueue.LastSequence()));
-
-		PROBE(buffer, sendWindow);
-		sendWindow -= buffer->size;
-
-		status = add_tcp_header(AddressModule(), segment, buffer);
-		if (status != B_OK) {
-			gBufferModule->free(buffer);
+		status_t status = _SendSegment(segment, segmentLength, segmentMaxSize,
+			sendWindow, retransmit, shouldStartRetransmitTimer);
+		if (status != B_OK)
 			return status;
-		}
 
-		// Update send status - we need to do this before we send the data
-		// for local connections as the answer is directly handled
+		_UpdatePacing(segmentLength);
 
-		if (segment.flags & TCP_FLAG_SYNCHRONIZE) {
-			segment.options &= ~TCP_HAS_WINDOW_SCALE;
-			segment.max_segment_size = 0;
-			size++;
-		}
+		length -= segmentLength;
+		segment.flags &= ~(TCP_FLAG_SYNCHRONIZE | TCP_FLAG_RESET
+			| TCP_FLAG_FINISH);
 
-		if (segment.flags & TCP_FLAG_FINISH)
-			size++;
+		if (retransmit)
+			break;
 
-		uint32 sendMax = fSendMax.Number();
-		fSendNext += size;
-		if (fSendMax < fSendNext)
-			fSendMax = fSendNext;
+	} while (length > 0);
 
-		fReceiveMaxAdvertised = fReceiveNext
-			+ ((uint32)segment.advertised_window << fReceiveWindowShift);
+	return B_OK;
+}
 
-		if (segmentLength != 0 && fState == ESTABLISHED)
-			--fSendMaxSegments;
 
-		status = next->module->send_routed_data(next, fRoute, buffer);
-		if (status < B_OK) {
-			gBufferModule->free(buffer);
+/*!	Sends a single segment of at most \a length bytes starting at
+	\a sequence, no matter what the send window currently looks like; the
+	caller is responsible for that. This is used to fill in the holes the
+	peer reported, and to send new data during SACK recovery. The amount of
+	data actually sent is returned in \a _sent.
+*/
+status_t
+TCPEndpoint::_SendRange(tcp_sequence sequence, uint32 length, uint32& _sent)
+{
+	if (fRoute == NULL)
+		return B_ERROR;
 
-			fSendNext = segment.sequence;
-			fSendMax = sendMax;
-				// restore send status
-			return status;
-		}
+	length = min_c(length, fSendQueue.Available(sequence));
+	if (length == 0)
+		return B_BAD_VALUE;
 
-		if (fSendTime == 0 && !retransmit
-			&& (segmentLength != 0 || (segment.flags & TCP_FLAG_SYNCHRONIZE) !=0)) {
-			fSendTime = tcp_now();
-			fRoundTripStartSequence = segment.sequence;
-		}
+	tcp_sequence sendNext = fSendNext;
+	bool retransmit = sequence < fSendMax;
+	fSendNext = sequence;
 
-		if (shouldStartRetransmitTimer && size > 0) {
-			TRACE("starting initial retransmit timer of: %" B_PRIdBIGTIME,
-				fRetransmitTimeout);
-			gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
-			T(TimerSet(this, "retransmit", fRetransmitTimeout));
-			shouldStartRetransmitTimer = false;
-		}
+	tcp_segment_header segment(_CurrentFlags());
+	_PrepareSegment(segment);
 
-		if (segment.flags & TCP_FLAG_ACKNOWLEDGE)
-			fLastAcknowledgeSent = segment.acknowledge;
+	uint32 segmentMaxSize = fSendMaxSegmentSize
+		- tcp_options_length(segment);
+	uint32 segmentLength = min_c(length, segmentMaxSize);
 
-		length -= segmentLength;
-		segment.flags &= ~(TCP_FLAG_SYNCHRONIZE | TCP_FLAG_RESET
-			| TCP_FLAG_FINISH);
+	if (fSendNext + segmentLength == fSendQueue.LastSequence()) {
+		if (state_needs_finish(fState))
+			segment.flags |= TCP_FLAG_FINISH;
+		segment.flags |= TCP_FLAG_PUSH;
+	}
 
-		if (retransmit)
-			break;
+	bool startRetransmitTimer = sequence == fSendUnacknowledged;
+	uint32 sendWindow = segmentLength;
+	status_t status = _SendSegment(segment, segmentLength, segmentMaxSize,
+		sendWindow, retransmit, startRetransmitTimer);
 
-	} while (length > 0);
+	if (retransmit || status != B_OK)
+		fSendNext = sendNext;
+	if (status != B_OK)
+		return status;
 
+	_sent = segmentLength;
 	return B_OK;
 }
 
 
+/*!	Returns whether or not sending new data has to be deferred to keep up
+	the pacing rate of the congestion control algorithm, and for how long.
+*/
+bool
+TCPEndpoint::_ShouldPace(bigtime_t& _delay)
+{
+	if (fNextSendTime == 0)
+		return false;
+
+	bigtime_t now = system_time();
+	if (fNextSendTime <= now)
+		return false;
+
+	_delay = fNextSendTime - now;
+	return true;
+}
+
+
+/*!	Computes when the next segment may be sent after \a size bytes have
+	just been sent, if the congestion control algorithm wants the segments
+	to be paced out.
+*/
+void
+TCPEndpoint::_UpdatePacing(uint32 size)
+{
+	uint32 rate = fCongestionControl->PacingRate(fCongestionWindow,
+		(bigtime_t)fSmoothedRoundTripTime * kTimestampFactor);
+	if (rate == 0) {
+		fNextSendTime = 0;
+		return;
+	}
+
+	// idle time does not allow for a burst later on
+	bigtime_t now = system_time();
+	if (fNextSendTime < now)
+		fNextSendTime = now;
+
+	fNextSendTime += (bigtime_t)size * 1000000 / rate;
+}
+
+
 int
 TCPEndpoint::_MaxSegmentSize(const sockaddr* address) const
 {
@@ -2231,6 +2563,27 @@ TCPEndpoint::_MaxSegmentSize(const sockaddr* address) const
 }
 
 
+/*!	Returns how much data can be passed to the device at once, to be split
+	into segments of \a segmentMaxSize bytes by the device itself. Returns
+	zero, if the device can't do that.
+*/
+uint32
+TCPEndpoint::_OffloadSegmentLength(uint32 segmentMaxSize) const
+{
+	net_device* device = fRoute->interface_address->interface->device;
+	uint32 capability = Domain()->family == AF_INET6
+		? NET_DEVICE_OFFLOAD_TSO6 : NET_DEVICE_OFFLOAD_TSO4;
+	if ((device->offload & capability) == 0)
+		return 0;
+
+	uint32 segments = TCP_MAX_OFFLOAD_LENGTH / segmentMaxSize;
+	if (fState == ESTABLISHED && fSendMaxSegments < segments)
+		segments = fSendMaxSegments;
+
+	return segments * segmentMaxSize;
+}
+
+
 status_t
 TCPEndpoint::_PrepareSendPath(const sockaddr* peer)
 {
@@ -2284,6 +2637,7 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 
 	if (fSendUnacknowledged < segment.acknowledge) {
 		fSendQueue.RemoveUntil(segment.acknowledge);
+		fSackScoreboard.RemoveUntil(segment.acknowledge);
 
 		uint32 bytesAcknowledged = segment.acknowledge - fSendUnacknowledged.Number();
 		fPreviousHighestAcknowledge = fSendUnacknowledged;
@@ -2298,26 +2652,21 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 
 		// the acknowledgment of the SYN/ACK MUST NOT increase the size of the congestion window
 		if (fSendUnacknowledged != fInitialSendSequence) {
-			if (fCongestionWindow < fSlowStartThreshold)
-				fCongestionWindow += min_c(bytesAcknowledged, fSendMaxSegmentSize);
-			else {
-				uint32 increment = fSendMaxSegmentSize * fSendMaxSegmentSize;
-
-				if (increment < fCongestionWindow)
-					increment = 1;
-				else
-					increment /= fCongestionWindow;
-
-				fCongestionWindow += increment;
-			}
-
+			fCongestionControl->Acknowledged(fCongestionWindow,
+				fSlowStartThreshold, bytesAcknowledged, fSendMaxSegmentSize);
 			fSendMaxSegments = UINT32_MAX;
 		}
 
-		if ((fFlags & FLAG_RECOVERY) != 0) {
+		if ((fFlags & FLAG_SACK_RECOVERY) != 0) {
+			// partial acknowledgement during SACK recovery - the congestion
+			// window is left alone, the pipe decides what to send; this
+			// holds even if the acknowledgement emptied the scoreboard
+			fCongestionWindow = fSlowStartThreshold;
+			_SackRecoveryTransmit();
+		} else if ((fFlags & FLAG_RECOVERY) != 0) {
 			fSendNext = fSendUnacknowledged;
 			_SendQueued();
-			fCongestionWindow -= bytesAcknowledged;
+			fCongestionWindow -= min_c(fCongestionWindow, bytesAcknowledged);
 
 			if (bytesAcknowledged > fSendMaxSegmentSize)
 				fCongestionWindow += fSendMaxSegmentSize;
@@ -2372,6 +2721,9 @@ TCPEndpoint::_Retransmit()
 	} else {
 		_ResetSlowStart();
 		fDuplicateAcknowledgeCount = 0;
+		// The peer may renege on what it SACKed before (RFC 2018)
+		fSackScoreboard.Clear();
+		fHighRetransmitted = fSendUnacknowledged;
 		// Do exponential back off of the retransmit timeout
 		fRetransmitTimeout *= 2;
 		if (fRetransmitTimeout > TCP_MAX_RETRANSMIT_TIMEOUT)
@@ -2382,8 +2734,7 @@ TCPEndpoint::_Retransmit()
 	_SendQueued();
 
 	fRecover = fSendNext.Number() - 1;
-	if ((fFlags & FLAG_RECOVERY) != 0)
-		fFlags &= ~FLAG_RECOVERY;
+	fFlags &= ~(FLAG_RECOVERY | FLAG_SACK_RECOVERY);
 }
 
 
@@ -2411,6 +2762,10 @@ TCPEndpoint::_UpdateRoundTripTime(int32 roundTripTime, int32 expectedSamples)
 	if (fRetransmitTimeout < TCP_MIN_RETRANSMIT_TIMEOUT)
 		fRetransmitTimeout = TCP_MIN_RETRANSMIT_TIMEOUT;
 
+	// the timestamps only have a resolution of a millisecond
+	fCongestionControl->RoundTripTimeSample(
+		(bigtime_t)max_c(roundTripTime, 1) * kTimestampFactor);
+
 	TRACE("  RTO is now %" B_PRIdBIGTIME " (after rtt %" B_PRId32 "ms)",
 		fRetransmitTimeout, roundTripTime);
 }
@@ -2419,9 +2774,10 @@ TCPEndpoint::_UpdateRoundTripTime(int32 roundTripTime, int32 expectedSamples)
 void
 TCPEndpoint::_ResetSlowStart()
 {
-	fSlowStartThreshold = max_c((fSendMax - fSendUnacknowledged).Number() / 2,
-		2 * fSendMaxSegmentSize);
+	fSlowStartThreshold = fCongestionControl->LossDetected(fCongestionWindow,
+		(fSendMax - fSendUnacknowledged).Number(), fSendMaxSegmentSize);
 	fCongestionWindow = fSendMaxSegmentSize;
+	fCongestionControl->RetransmitTimeout();
 }
 
 
@@ -2478,6 +2834,24 @@ TCPEndpoint::_DelayedAcknowledgeTimer(net_timer* timer, void* _endpoint)
 }
 
 
+/*static*/ void
+TCPEndpoint::_PacingTimer(net_timer* timer, void* _endpoint)
+{
+	TCPEndpoint* endpoint = (TCPEndpoint*)_endpoint;
+	T(TimerTriggered(endpoint, "pacing"));
+
+	MutexLocker locker(endpoint->fLock);
+	if (!locker.IsLocked())
+		return;
+
+	// the timer might not have been canceled early enough
+	if (endpoint->State() == CLOSED)
+		return;
+
+	endpoint->_SendQueued();
+}
+
+
 /*static*/ void
 TCPEndpoint::_TimeWaitTimer(net_timer* timer, void* _endpoint)
 {
@@ -2543,6 +2917,9 @@ TCPEndpoint::Dump() const
 #if DEBUG_BUFFER_QUEUE
 	fSendQueue.Dump();
 #endif
+	kprintf("    high retransmitted: %" B_PRIu32 "\n",
+		fHighRetransmitted.Number());
+	fSackScoreboard.Dump();
 	kprintf("    last acknowledge sent: %" B_PRIu32 "\n",
 		fLastAcknowledgeSent.Number());
 	kprintf("    initial sequence: %" B_PRIu32 "\n",
@@ -2568,5 +2945,8 @@ TCPEndpoint::Dump() const
 	kprintf("  retransmit timeout: %" B_PRId64 "\n", fRetransmitTimeout);
 	kprintf("  congestion window: %" B_PRIu32 "\n", fCongestionWindow);
 	kprintf("  slow start threshold: %" B_PRIu32 "\n", fSlowStartThreshold);
+	kprintf("  congestion control: %s\n", fCongestionControl->Name());
+	if (fNextSendTime != 0)
+		kprintf("  next send time: %" B_PRIdBIGTIME "\n", fNextSendTime);
 }
 
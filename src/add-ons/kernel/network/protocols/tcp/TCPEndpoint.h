@@ -12,7 +12,9 @@
 
 
 #include "BufferQueue.h"
+#include "CongestionControl.h"
 #include "EndpointManager.h"
+#include "SackScoreboard.h"
 #include "tcp.h"
 
 #include <ProtocolUtilities.h>
@@ -77,9 +79,17 @@ private:
 			bool		_ShouldSendSegment(tcp_segment_header& segment,
 							uint32 length, uint32 segmentMaxSize,
 							uint32 flightSize);
+			void		_PrepareSegment(tcp_segment_header& segment);
+			status_t	_SendSegment(tcp_segment_header& segment,
+							uint32 segmentLength, uint32 segmentMaxSize,
+							uint32& sendWindow, bool retransmit,
+							bool& startRetransmitTimer);
 			status_t	_SendQueued(bool force = false);
 			status_t	_SendQueued(bool force, uint32 sendWindow);
+			status_t	_SendRange(tcp_sequence sequence, uint32 length,
+							uint32& _sent);
 			int			_MaxSegmentSize(const struct sockaddr* address) const;
+			uint32		_OffloadSegmentLength(uint32 segmentMaxSize) const;
 			status_t	_Disconnect(bool closing);
 			ssize_t		_AvailableData() const;
 			void		_NotifyReader();
@@ -109,12 +119,18 @@ private:
 			void		_UpdateRoundTripTime(int32 roundTripTime, int32 expectedSamples);
 			void		_ResetSlowStart();
 			void		_DuplicateAcknowledge(tcp_segment_header& segment);
+			void		_EnterSackRecovery();
+			void		_SackRecoveryTransmit();
+			status_t	_SetCongestionControl(const char* name);
+			bool		_ShouldPace(bigtime_t& _delay);
+			void		_UpdatePacing(uint32 size);
 
 	static	void		_TimeWaitTimer(net_timer* timer, void* _endpoint);
 	static	void		_RetransmitTimer(net_timer* timer, void* _endpoint);
 	static	void		_PersistTimer(net_timer* timer, void* _endpoint);
 	static	void		_DelayedAcknowledgeTimer(net_timer* timer,
 							void* _endpoint);
+	static	void		_PacingTimer(net_timer* timer, void* _endpoint);
 
 	static	status_t	_WaitForCondition(ConditionVariable& condition,
 							MutexLocker& locker, bigtime_t timeout);
@@ -153,6 +169,8 @@ private:
 	uint32			fDuplicateAcknowledgeCount;
 	uint32			fPreviousFlightSize;
 	uint32			fRecover;
+	SackScoreboard	fSackScoreboard;
+	tcp_sequence	fHighRetransmitted;
 
 	net_route		*fRoute;
 		// TODO: don't use a net_route, but a net_route_info!!!
@@ -166,6 +184,8 @@ private:
 	bool			fFinishReceived;
 	tcp_sequence	fFinishReceivedAt;
 	tcp_sequence	fInitialReceiveSequence;
+	tcp_sequence	fLastSegmentReceived;
+		// sequence of the latest segment, reported first in SACK blocks
 
 	// round trip time and retransmit timeout computation
 	int32			fSmoothedRoundTripTime;
@@ -178,6 +198,9 @@ private:
 
 	uint32			fCongestionWindow;
 	uint32			fSlowStartThreshold;
+	CongestionControl* fCongestionControl;
+	bigtime_t		fNextSendTime;
+		// earliest time the next segment may be sent when pacing
 
 	tcp_state		fState;
 	uint32			fFlags;
@@ -187,6 +210,7 @@ private:
 	net_timer		fPersistTimer;
 	net_timer		fDelayedAcknowledgeTimer;
 	net_timer		fTimeWaitTimer;
+	net_timer		fPacingTimer;
 };
 
 #endif	// TCP_ENDPOINT_H
@@ -9,13 +9,16 @@
  */
 
 
+#include "CongestionControl.h"
 #include "EndpointManager.h"
 #include "TCPEndpoint.h"
 
 #include <net_protocol.h>
 #include <net_stat.h>
+#include <tcp_control.h>
 
 #include <KernelExport.h>
+#include <generic_syscall.h>
 #include <util/list.h>
 
 #include <netinet/in.h>
@@ -23,6 +26,7 @@
 #include <new>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <lock.h>
 #include <util/AutoLock.h>
@@ -152,7 +156,11 @@ add_options(tcp_segment_header &segment, uint8 *buffer, size_t bufferSize)
 			bump_option(option, length);
 			option->kind = TCP_OPTION_SACK;
 			option->length = 2 + sackCount * sizeof(tcp_sack);
-			memcpy(option->sack, segment.sacks, sackCount * sizeof(tcp_sack));
+			for (int i = 0; i < sackCount; i++) {
+				option->sack[i].left_edge = htonl(segment.sacks[i].left_edge);
+				option->sack[i].right_edge
+					= htonl(segment.sacks[i].right_edge);
+			}
 			bump_option(option, length);
 		}
 	}
@@ -218,6 +226,22 @@ process_options(tcp_segment_header &segment, net_buffer *buffer, size_t size)
 				if (option->length == 2 && size >= 2)
 					segment.options |= TCP_SACK_PERMITTED;
 				break;
+			case TCP_OPTION_SACK:
+				if (option->length > 2 && option->length <= size
+					&& ((option->length - 2) % sizeof(tcp_sack)) == 0) {
+					int count = (option->length - 2) / sizeof(tcp_sack);
+					if (count > TCP_MAX_SACK_BLOCKS)
+						count = TCP_MAX_SACK_BLOCKS;
+
+					for (int i = 0; i < count; i++) {
+						segment.sacks[i].left_edge
+							= ntohl(option->sack[i].left_edge);
+						segment.sacks[i].right_edge
+							= ntohl(option->sack[i].right_edge);
+					}
+					segment.sack_count = count;
+				}
+				break;
 		}
 
 		if (length < 0) {
@@ -408,8 +432,13 @@ add_tcp_header(net_address_module_info* addressModule,
 		"win %u\n", buffer, segment.flags, segment.sequence,
 		segment.acknowledge, segment.urgent_offset, segment.advertised_window));
 
-	*TCPChecksumField(buffer) = Checksum::PseudoHeader(addressModule,
-		gBufferModule, buffer, IPPROTO_TCP);
+	// The checksum is completed by the device, or right before the buffer
+	// is handed to one that cannot do it.
+	*TCPChecksumField(buffer) = Checksum::PartialPseudoHeader(addressModule,
+		buffer, IPPROTO_TCP);
+	buffer->offload |= NET_BUFFER_CHECKSUM_PARTIAL;
+	buffer->checksum_start = 0;
+	buffer->checksum_offset = offsetof(tcp_header, checksum);
 
 	return B_OK;
 }
@@ -677,7 +706,9 @@ tcp_receive_data(net_buffer* buffer)
 	if (headerLength < sizeof(tcp_header))
 		return B_BAD_DATA;
 
-	if (Checksum::PseudoHeader(addressModule, gBufferModule, buffer,
+	if ((buffer->offload & (NET_BUFFER_CHECKSUM_VALID
+				| NET_BUFFER_CHECKSUM_PARTIAL)) == 0
+		&& Checksum::PseudoHeader(addressModule, gBufferModule, buffer,
 			IPPROTO_TCP) != 0)
 		return B_BAD_DATA;
 
@@ -745,6 +776,36 @@ tcp_error_reply(net_protocol* protocol, net_buffer* cause, net_error error,
 //	#pragma mark -
 
 
+static status_t
+tcp_control(const char* subsystem, uint32 function, void* buffer,
+	size_t bufferSize)
+{
+	struct tcp_congestion_control control;
+	if (bufferSize != sizeof(struct tcp_congestion_control))
+		return B_BAD_VALUE;
+
+	switch (function) {
+		case TCP_GET_DEFAULT_CONGESTION:
+			strlcpy(control.name, default_congestion_control(),
+				sizeof(control.name));
+			return user_memcpy(buffer, &control, sizeof(control));
+
+		case TCP_SET_DEFAULT_CONGESTION:
+			// this affects all new connections, so only root may change it
+			if (geteuid() != 0)
+				return B_NOT_ALLOWED;
+
+			if (user_memcpy(&control, buffer, sizeof(control)) != B_OK)
+				return B_BAD_ADDRESS;
+			control.name[sizeof(control.name) - 1] = '\0';
+
+			return set_default_congestion_control(control.name);
+	}
+
+	return B_BAD_VALUE;
+}
+
+
 static status_t
 tcp_init()
 {
@@ -794,6 +855,8 @@ tcp_init()
 	add_debugger_command("tcp_endpoint", dump_endpoint,
 		"dumps a TCP endpoint internal state");
 
+	register_generic_syscall(TCP_SYSCALLS, tcp_control, 1, 0);
+
 	return B_OK;
 }
 
@@ -801,6 +864,8 @@ tcp_init()
 static status_t
 tcp_uninit()
 {
+	unregister_generic_syscall(TCP_SYSCALLS, 1);
+
 	remove_debugger_command("tcp_endpoint", dump_endpoint);
 	remove_debugger_command("tcp_endpoints", dump_endpoints);
 
@@ -186,6 +186,9 @@ operator==(tcp_sequence a, tcp_sequence b)
 #define TCP_MAX_WINDOW					65535
 #define TCP_MAX_SEGMENT_LIFETIME		60000000	// 60 secs
 #define TCP_PERSIST_TIMEOUT				1000000		// 1 sec
+// Maximum amount of data handed to a device for segmentation at once; must
+// fit into a single IP packet with maximum IP and TCP header sizes
+#define TCP_MAX_OFFLOAD_LENGTH			(65535 - 60 - 60)
 
 // Initial estimate for packet round trip time (RTT)
 #define TCP_INITIAL_RTT					2000000		// 2 secs
@@ -227,6 +230,9 @@ enum tcp_option_kind {
 
 #define TCP_MAX_WINDOW_SHIFT	14
 
+// Maximum number of SACK blocks a segment can carry (RFC 2018)
+#define TCP_MAX_SACK_BLOCKS		4
+
 enum {
 	TCP_HAS_WINDOW_SCALE	= 1 << 0,
 	TCP_HAS_TIMESTAMPS		= 1 << 1,
@@ -254,8 +260,9 @@ struct tcp_segment_header {
 	uint32	timestamp_value;
 	uint32	timestamp_reply;
 
-	tcp_sack	*sacks;
+	tcp_sack	sacks[TCP_MAX_SACK_BLOCKS];
 	int			sack_count;
+		// the SACK blocks are kept in host byte order
 
 	uint32	options;
 
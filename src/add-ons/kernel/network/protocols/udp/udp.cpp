@@ -806,7 +806,8 @@ UdpEndpointManager::Deframe(net_buffer* buffer)
 	if (buffer->size > udpLength)
 		gBufferModule->trim(buffer, udpLength);
 
-	if (header.udp_checksum != 0) {
+	if (header.udp_checksum != 0 && (buffer->offload
+			& (NET_BUFFER_CHECKSUM_VALID | NET_BUFFER_CHECKSUM_PARTIAL)) == 0) {
 		// check UDP-checksum (simulating a so-called "pseudo-header"):
 		uint16 sum = Checksum::PseudoHeader(addressModule, gBufferModule,
 			buffer, IPPROTO_UDP);
@@ -1015,12 +1016,12 @@ UdpEndpoint::SendRoutedData(net_buffer *buffer, net_route *route)
 
 	header.Sync();
 
-	uint16 calculatedChecksum = Checksum::PseudoHeader(AddressModule(),
-		gBufferModule, buffer, IPPROTO_UDP);
-	if (calculatedChecksum == 0)
-		calculatedChecksum = 0xffff;
-
-	*UDPChecksumField(buffer) = calculatedChecksum;
+	// leave the checksum to the device, if possible
+	*UDPChecksumField(buffer) = Checksum::PartialPseudoHeader(AddressModule(),
+		buffer, IPPROTO_UDP);
+	buffer->offload |= NET_BUFFER_CHECKSUM_PARTIAL;
+	buffer->checksum_start = 0;
+	buffer->checksum_offset = offsetof(udp_header, udp_checksum);
 
 	return next->module->send_routed_data(next, route, buffer);
 }
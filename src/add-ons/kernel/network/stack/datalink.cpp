@@ -677,6 +677,21 @@ interface_protocol_send_data(net_datalink_protocol* _protocol,
 	interface_protocol* protocol = (interface_protocol*)_protocol;
 	Interface* interface = (Interface*)protocol->interface;
 
+	if ((buffer->offload & (NET_BUFFER_SEGMENT_TCP4 | NET_BUFFER_SEGMENT_TCP6))
+			!= 0
+		&& (protocol->device->offload
+			& (NET_DEVICE_OFFLOAD_TSO4 | NET_DEVICE_OFFLOAD_TSO6)) == 0) {
+		// the device has changed since the segment was built
+		return EMSGSIZE;
+	}
+
+	if ((buffer->offload & NET_BUFFER_CHECKSUM_PARTIAL) != 0
+		&& (protocol->device->offload & NET_DEVICE_OFFLOAD_CHECKSUM) == 0) {
+		status_t status = gNetBufferModule.finish_checksum(buffer);
+		if (status != B_OK)
+			return status;
+	}
+
 	if (atomic_get(&interface->DeviceInterface()->monitor_count) > 0)
 		device_interface_monitor_receive(interface->DeviceInterface(), buffer);
 
@@ -139,6 +139,8 @@ register_domain(int family, const char* name,
 	domain->module = module;
 	domain->address_module = addressModule;
 
+	domain->route_table.Init(family);
+
 	sDomains.Add(domain);
 
 	*_domain = domain;
@@ -13,6 +13,7 @@
 #include <util/list.h>
 #include <util/DoublyLinkedList.h>
 
+#include "route_table.h"
 #include "routes.h"
 
 
@@ -24,6 +25,7 @@ struct net_domain_private : net_domain,
 	recursive_lock		lock;
 
 	RouteList			routes;
+	RouteTable			route_table;
 	RouteInfoList		route_infos;
 };
 
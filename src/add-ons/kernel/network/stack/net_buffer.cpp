@@ -22,6 +22,7 @@
 #include <util/DoublyLinkedList.h>
 
 #include <algorithm>
+#include <netinet/in.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
@@ -53,6 +54,8 @@
 #define DATA_NODE_READ_ONLY		0x1
 #define DATA_NODE_STORED_HEADER	0x2
 
+#define DATA_HEADER_EXTERNAL	0x1
+
 struct header_space {
 	uint16	size;
 	uint16	free;
@@ -70,6 +73,14 @@ struct data_header {
 	uint8*			data_end;
 	header_space	space;
 	uint16			tail_space;
+	uint16			flags;
+};
+
+// A header for data that lives outside of the buffer module; it has no space
+// of its own, and is only used to count the references to the data.
+struct external_data_header : data_header {
+	void			(*free)(void* cookie);
+	void*			cookie;
 };
 
 struct data_node {
@@ -153,6 +164,7 @@ struct net_buffer_private : net_buffer {
 
 static object_cache* sNetBufferCache;
 static object_cache* sDataNodeCache;
+static object_cache* sExternalHeaderCache;
 
 
 static status_t append_data(net_buffer* buffer, const void* data, size_t size);
@@ -612,6 +624,11 @@ dump_buffer(net_buffer* _buffer)
 	dprintf("buffer %p, size %" B_PRIu32 ", flags %" B_PRIx32 ", stored header "
 		"%" B_PRIuSIZE ", interface address %p\n", buffer, buffer->size,
 		buffer->flags, buffer->stored_header_length, buffer->interface_address);
+	if (buffer->offload != 0) {
+		dprintf("  offload %#x, checksum start %u, offset %u, segment size "
+			"%u\n", buffer->offload, buffer->checksum_start,
+			buffer->checksum_offset, buffer->segment_size);
+	}
 
 	dump_address("source", buffer->source, buffer->interface_address);
 	dump_address("destination", buffer->destination, buffer->interface_address);
@@ -813,6 +830,7 @@ create_data_header(size_t headerSpace)
 	header->tail_space = (uint8*)header + BUFFER_SIZE - header->data_end
 		- headerSpace;
 	header->first_free = NULL;
+	header->flags = 0;
 
 	TRACE(("%ld:   create new data header %p\n", find_thread(NULL), header));
 	T2(CreateDataHeader(header));
@@ -829,6 +847,14 @@ release_data_header(data_header* header)
 		return;
 
 	TRACE(("%ld:   free header %p\n", find_thread(NULL), header));
+
+	if ((header->flags & DATA_HEADER_EXTERNAL) != 0) {
+		external_data_header* external = (external_data_header*)header;
+		external->free(external->cookie);
+		object_cache_free(sExternalHeaderCache, external, 0);
+		return;
+	}
+
 	free_data_header(header);
 }
 
@@ -1081,6 +1107,31 @@ copy_metadata(net_buffer* destination, const net_buffer* source)
 	destination->offset = source->offset;
 	destination->protocol = source->protocol;
 	destination->type = source->type;
+
+	destination->offload = source->offload;
+	destination->checksum_start = source->checksum_start;
+	destination->checksum_offset = source->checksum_offset;
+	destination->segment_size = source->segment_size;
+}
+
+
+/*!	Moves the start of the partial checksum along with the start of the
+	buffer. Once the checksum start has been removed, the buffer is a
+	received one, and the data can be trusted.
+*/
+static inline void
+adjust_checksum_start(net_buffer* buffer, int32 delta)
+{
+	if ((buffer->offload & NET_BUFFER_CHECKSUM_PARTIAL) == 0)
+		return;
+
+	if (delta < 0 && (uint32)-delta > buffer->checksum_start) {
+		buffer->offload &= ~NET_BUFFER_CHECKSUM_PARTIAL;
+		buffer->offload |= NET_BUFFER_CHECKSUM_VALID;
+		return;
+	}
+
+	buffer->checksum_start += delta;
 }
 
 
@@ -1128,6 +1179,7 @@ create_buffer(size_t headerSpace)
 	buffer->offset = 0;
 	buffer->flags = 0;
 	buffer->size = 0;
+	buffer->offload = 0;
 
 	CHECK_BUFFER(buffer);
 	CREATE_PARANOIA_CHECK_SET(buffer, "net_buffer");
@@ -1413,7 +1465,8 @@ merge_buffer(net_buffer* _buffer, net_buffer* _with, bool after)
 		if (node == NULL)
 			break;
 
-		if ((uint8*)node > (uint8*)node->header
+		if ((node->header->flags & DATA_HEADER_EXTERNAL) == 0
+			&& (uint8*)node > (uint8*)node->header
 			&& (uint8*)node < (uint8*)node->header + BUFFER_SIZE) {
 			// The node is already in the buffer, we can just move it
 			// over to the new owner
@@ -1590,6 +1643,7 @@ prepend_size(net_buffer* _buffer, size_t size, void** _contiguousBuffer)
 				size_t headerSpace = MAX_FREE_BUFFER_SIZE;
 				data_header* header = create_data_header(headerSpace);
 				if (header == NULL) {
+					adjust_checksum_start(buffer, sizePrepended);
 					remove_header(buffer, sizePrepended);
 					return B_NO_MEMORY;
 				}
@@ -1643,6 +1697,7 @@ prepend_size(net_buffer* _buffer, size_t size, void** _contiguousBuffer)
 	}
 
 	buffer->size += size;
+	adjust_checksum_start(buffer, size);
 
 	SET_PARANOIA_CHECK(PARANOIA_SUSPICIOUS, buffer, &buffer->size,
 		sizeof(buffer->size));
@@ -1862,6 +1917,8 @@ remove_header(net_buffer* _buffer, size_t bytes)
 	}
 
 	buffer->size -= bytes;
+	adjust_checksum_start(buffer, -(int32)bytes);
+
 	SET_PARANOIA_CHECK(PARANOIA_SUSPICIOUS, buffer, &buffer->size,
 		sizeof(buffer->size));
 
@@ -2008,6 +2065,55 @@ append_cloned_data(net_buffer* _buffer, net_buffer* _source, uint32 offset,
 }
 
 
+/*!	Appends the external \a data to the buffer without copying it. The data is
+	referenced until the last buffer containing it has been freed, then its
+	free hook is called. If this function fails, the data is left untouched.
+	The data must not be changed by anyone while it is part of a buffer, and
+	it is never changed by the buffer module either.
+*/
+static status_t
+append_external(net_buffer* _buffer, const net_external_data* data)
+{
+	net_buffer_private* buffer = (net_buffer_private*)_buffer;
+
+	if (data->size == 0)
+		return B_OK;
+	if (data->size > UINT16_MAX || data->free == NULL)
+		return B_BAD_VALUE;
+
+	external_data_header* header = (external_data_header*)object_cache_alloc(
+		sExternalHeaderCache, 0);
+	if (header == NULL)
+		return ENOBUFS;
+
+	memset(header, 0, sizeof(external_data_header));
+	header->ref_count = 1;
+	header->flags = DATA_HEADER_EXTERNAL;
+	header->free = data->free;
+	header->cookie = data->cookie;
+
+	data_node* node = add_data_node(buffer, header);
+	if (node == NULL) {
+		object_cache_free(sExternalHeaderCache, header, 0);
+		return ENOBUFS;
+	}
+
+	// the node holds the only reference to the header now
+	atomic_add(&header->ref_count, -1);
+
+	node->offset = buffer->size;
+	node->start = (uint8*)data->data;
+	node->used = data->size;
+	node->flags = DATA_NODE_READ_ONLY;
+
+	list_add_item(&buffer->buffers, node);
+	buffer->size += data->size;
+
+	CHECK_BUFFER(buffer);
+	return B_OK;
+}
+
+
 void
 set_ancillary_data(net_buffer* buffer, ancillary_data_container* container)
 {
@@ -2304,6 +2410,35 @@ swap_addresses(net_buffer* buffer)
 }
 
 
+/*!	Completes a partial transport checksum in software, for devices that
+	cannot do it themselves, or before the buffer gets fragmented.
+*/
+static status_t
+finish_checksum(net_buffer* buffer)
+{
+	if ((buffer->offload & NET_BUFFER_CHECKSUM_PARTIAL) == 0)
+		return B_OK;
+
+	uint32 start = buffer->checksum_start;
+	uint32 fieldOffset = start + buffer->checksum_offset;
+	if (fieldOffset + sizeof(uint16) > buffer->size)
+		return B_BAD_VALUE;
+
+	// the checksum field already contains the pseudo header sum
+	uint16 checksum = checksum_data(buffer, start, buffer->size - start, true);
+	if (checksum == 0 && buffer->protocol == IPPROTO_UDP)
+		checksum = 0xffff;
+
+	status_t status = write_data(buffer, fieldOffset, &checksum,
+		sizeof(checksum));
+	if (status != B_OK)
+		return status;
+
+	buffer->offload &= ~NET_BUFFER_CHECKSUM_PARTIAL;
+	return B_OK;
+}
+
+
 static status_t
 std_ops(int32 op, ...)
 {
@@ -2324,6 +2459,14 @@ std_ops(int32 op, ...)
 				return B_NO_MEMORY;
 			}
 
+			sExternalHeaderCache = create_object_cache("external data cache",
+				sizeof(external_data_header), 8, NULL, NULL, NULL);
+			if (sExternalHeaderCache == NULL) {
+				delete_object_cache(sNetBufferCache);
+				delete_object_cache(sDataNodeCache);
+				return B_NO_MEMORY;
+			}
+
 #if ENABLE_STATS
 			add_debugger_command_etc("net_buffer_stats", &dump_net_buffer_stats,
 				"Print net buffer statistics",
@@ -2345,6 +2488,7 @@ std_ops(int32 op, ...)
 #endif
 			delete_object_cache(sNetBufferCache);
 			delete_object_cache(sDataNodeCache);
+			delete_object_cache(sExternalHeaderCache);
 			return B_OK;
 
 		default:
@@ -2402,5 +2546,8 @@ net_buffer_module_info gNetBufferModule = {
 	swap_addresses,
 
 	dump_buffer,	// dump
+
+	finish_checksum,
+	append_external,
 };
 
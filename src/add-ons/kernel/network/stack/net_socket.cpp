@@ -1494,6 +1494,76 @@ socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
 }
 
 
+/*!	Sends the external \a data over the connected \a socket without copying
+	it. The socket takes over all of the \a count data vectors: those that
+	could not be sent are freed before this function returns.
+*/
+ssize_t
+socket_send_external(net_socket* socket, const net_external_data* data,
+	uint32 count, int flags)
+{
+	ssize_t result = 0;
+	uint32 index = 0;
+
+	if (socket->peer.ss_len == 0)
+		result = ENOTCONN;
+	else if (socket->first_info->send_data_no_buffer != NULL)
+		result = B_NOT_SUPPORTED;
+
+	while (result >= 0 && index < count) {
+		net_buffer* buffer = gNetBufferModule.create(256);
+		if (buffer == NULL) {
+			result = result > 0 ? result : ENOBUFS;
+			break;
+		}
+
+		status_t status = B_OK;
+		while (index < count && (buffer->size == 0
+				|| buffer->size + data[index].size
+					<= socket->send.buffer_size)) {
+			status = gNetBufferModule.append_external(buffer, &data[index]);
+			if (status != B_OK)
+				break;
+
+			index++;
+		}
+		if (status != B_OK) {
+			gNetBufferModule.free(buffer);
+			result = result > 0 ? result : status;
+			break;
+		}
+
+		size_t bufferSize = buffer->size;
+		buffer->flags = flags;
+		memcpy(buffer->source, &socket->address, socket->address.ss_len);
+		memcpy(buffer->destination, &socket->peer, socket->peer.ss_len);
+
+		status = socket->first_info->send_data(socket->first_protocol,
+			buffer);
+		if (status != B_OK) {
+			size_t sizeAfterSend = buffer->size;
+			gNetBufferModule.free(buffer);
+
+			if ((sizeAfterSend != bufferSize || result > 0)
+				&& (status == B_INTERRUPTED || status == B_WOULD_BLOCK)) {
+				// this appears to be a partial write
+				result += bufferSize - sizeAfterSend;
+			} else
+				result = status;
+			break;
+		}
+
+		result += bufferSize;
+	}
+
+	// free what has not been put into a buffer
+	for (; index < count; index++)
+		data[index].free(data[index].cookie);
+
+	return result;
+}
+
+
 status_t
 socket_set_option(net_socket* socket, int level, int option, const void* value,
 	int length)
@@ -1773,6 +1843,8 @@ net_socket_module_info gNetSocketModule = {
 	socket_send,
 	socket_setsockopt,
 	socket_shutdown,
-	socket_socketpair
+	socket_socketpair,
+
+	socket_send_external
 };
 
@@ -0,0 +1,470 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "route_table.h"
+
+#include "routes.h"
+
+#include <net_device.h>
+
+#include <KernelExport.h>
+
+#include <netinet/in.h>
+#include <netinet6/in6.h>
+#include <net/route.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/atomic.h>
+
+
+struct RouteTable::Node {
+	Node*				children[2];
+	net_route_private*	routes;
+	Node*				next_retired;
+	int32				length;
+		// of the prefix, in bits
+	uint8				key[kMaxKeyLength];
+};
+
+
+static inline int
+key_bit(const uint8* key, int32 bit)
+{
+	return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+
+/*!	Returns whether or not the first \a length bits of both keys are equal.
+*/
+static inline bool
+keys_match(const uint8* a, const uint8* b, int32 length)
+{
+	int32 bytes = length / 8;
+	if (memcmp(a, b, bytes) != 0)
+		return false;
+
+	int32 bits = length % 8;
+	if (bits == 0)
+		return true;
+
+	uint8 mask = 0xff << (8 - bits);
+	return ((a[bytes] ^ b[bytes]) & mask) == 0;
+}
+
+
+static int32
+common_prefix_length(const uint8* a, const uint8* b, int32 maxLength)
+{
+	int32 length = 0;
+	while (length < maxLength && key_bit(a, length) == key_bit(b, length))
+		length++;
+
+	return length;
+}
+
+
+static void
+nop(void* /*cookie*/, int /*cpu*/)
+{
+}
+
+
+//	#pragma mark -
+
+
+RouteTable::RouteTable()
+	:
+	fKeyOffset(0),
+	fKeyLength(0),
+	fRoot(NULL),
+	fRetired(NULL)
+{
+}
+
+
+RouteTable::~RouteTable()
+{
+	_DeleteTree(fRoot);
+}
+
+
+void
+RouteTable::Init(int family)
+{
+	switch (family) {
+		case AF_INET:
+			fKeyOffset = offsetof(sockaddr_in, sin_addr);
+			fKeyLength = sizeof(in_addr);
+			break;
+		case AF_INET6:
+			fKeyOffset = offsetof(sockaddr_in6, sin6_addr);
+			fKeyLength = sizeof(in6_addr);
+			break;
+
+		default:
+			fKeyLength = 0;
+			break;
+	}
+}
+
+
+/*!	Adds \a route to the table. It is inserted in the same order the domain
+	keeps its route list in: defaults are sorted by the link speed of their
+	device, other routes with the same prefix are appended.
+*/
+status_t
+RouteTable::Add(net_route_private* route)
+{
+	uint8 key[kMaxKeyLength];
+	if (!_GetKey(route->destination, key))
+		return B_BAD_VALUE;
+
+	Node* node = _InsertNode(key, _PrefixLength(route));
+	if (node == NULL)
+		return B_NO_MEMORY;
+
+	net_route_private** link = &node->routes;
+	while (net_route_private* before = *link) {
+		if ((route->flags & RTF_DEFAULT) != 0
+			&& (before->flags & RTF_DEFAULT) != 0
+			&& before->interface_address->interface->device->link_speed
+				< route->interface_address->interface->device->link_speed)
+			break;
+
+		link = &before->table_next;
+	}
+
+	route->table_next = *link;
+	atomic_pointer_set(link, route);
+	return B_OK;
+}
+
+
+/*!	Removes \a route from the table. When this method returns, no lookup can
+	see the route anymore, and it can safely be deleted.
+*/
+void
+RouteTable::Remove(net_route_private* route)
+{
+	uint8 key[kMaxKeyLength];
+	if (!_GetKey(route->destination, key))
+		return;
+
+	Node** link;
+	Node** parentLink;
+	Node* node = _FindNode(key, _PrefixLength(route), &link, &parentLink);
+	if (node == NULL)
+		return;
+
+	net_route_private** routeLink = &node->routes;
+	while (*routeLink != NULL && *routeLink != route)
+		routeLink = &(*routeLink)->table_next;
+	if (*routeLink == NULL)
+		return;
+
+	// a lookup that is currently looking at the route can still follow its
+	// link, so it must stay intact
+	atomic_pointer_set(routeLink, route->table_next);
+
+	if (node->routes == NULL)
+		_RemoveNode(node, link, parentLink);
+
+	_Synchronize();
+}
+
+
+/*!	Returns the first of the routes that share the prefix described by
+	\a description, or \c NULL if there are none. The others can be reached
+	via net_route_private::table_next.
+	The caller must hold the domain lock.
+*/
+net_route_private*
+RouteTable::Routes(const net_route* description) const
+{
+	uint8 key[kMaxKeyLength];
+	if (!_GetKey(description->destination, key))
+		return NULL;
+
+	Node* node = _FindNode(key, _PrefixLength(description), NULL, NULL);
+	if (node == NULL)
+		return NULL;
+
+	return node->routes;
+}
+
+
+/*!	Finds the route with the longest prefix matching \a address, and returns
+	it with a reference acquired. Routes whose device has no link are only
+	considered if there is no other route.
+	This method does not need any locks.
+*/
+net_route_private*
+RouteTable::Lookup(const sockaddr* address) const
+{
+	uint8 key[kMaxKeyLength];
+	if (!_GetKey(address, key))
+		return NULL;
+
+	net_route_private* found = NULL;
+	net_route_private* candidate = NULL;
+
+	cpu_status state = disable_interrupts();
+
+	Node* node = atomic_pointer_get(const_cast<Node**>(&fRoot));
+	while (node != NULL && keys_match(node->key, key, node->length)) {
+		net_route_private* route = atomic_pointer_get(&node->routes);
+		if (route != NULL) {
+			// the deeper the node, the more specific its routes
+			candidate = route;
+
+			while (route != NULL) {
+				if ((route->interface_address->interface->device->flags
+						& IFF_LINK) != 0) {
+					found = route;
+					break;
+				}
+				route = atomic_pointer_get(&route->table_next);
+			}
+		}
+
+		if (node->length == fKeyLength * 8)
+			break;
+
+		node = atomic_pointer_get(
+			&node->children[key_bit(key, node->length)]);
+	}
+
+	if (found == NULL)
+		found = candidate;
+
+	if (found != NULL && atomic_add(&found->ref_count, 1) == 0) {
+		// the route has been deleted already
+		found = NULL;
+	}
+
+	restore_interrupts(state);
+	return found;
+}
+
+
+bool
+RouteTable::_GetKey(const sockaddr* address, uint8* key) const
+{
+	if (fKeyLength == 0)
+		return false;
+
+	memset(key, 0, kMaxKeyLength);
+	if (address == NULL)
+		return true;
+
+	if (address->sa_len < fKeyOffset + fKeyLength)
+		return false;
+
+	memcpy(key, (const uint8*)address + fKeyOffset, fKeyLength);
+	return true;
+}
+
+
+/*!	Returns the number of leading one bits in the mask of \a route.
+	The net_address_module_info::first_mask_bit() hook cannot be used for
+	this, as its meaning differs between the address families.
+*/
+int32
+RouteTable::_PrefixLength(const net_route* route) const
+{
+	if ((route->flags & RTF_DEFAULT) != 0)
+		return 0;
+	if (route->mask == NULL)
+		return fKeyLength * 8;
+
+	const uint8* mask = (const uint8*)route->mask + fKeyOffset;
+	int32 available = route->mask->sa_len - fKeyOffset;
+
+	int32 length = 0;
+	for (int32 i = 0; i < fKeyLength && i < available; i++) {
+		if (mask[i] == 0xff) {
+			length += 8;
+			continue;
+		}
+
+		for (uint8 bits = mask[i]; (bits & 0x80) != 0; bits <<= 1)
+			length++;
+		break;
+	}
+
+	return length;
+}
+
+
+/*!	Returns the node for the prefix \a key of \a length bits, if there is
+	one. \a _link is set to the pointer that points to the node, and
+	\a _parentLink to the one that points to its parent, if any.
+*/
+RouteTable::Node*
+RouteTable::_FindNode(const uint8* key, int32 length, Node*** _link,
+	Node*** _parentLink) const
+{
+	Node** link = const_cast<Node**>(&fRoot);
+	Node** parentLink = NULL;
+
+	Node* node = fRoot;
+	while (node != NULL && node->length <= length
+		&& keys_match(node->key, key, node->length)) {
+		if (node->length == length) {
+			if (_link != NULL)
+				*_link = link;
+			if (_parentLink != NULL)
+				*_parentLink = parentLink;
+			return node;
+		}
+
+		parentLink = link;
+		link = &node->children[key_bit(key, node->length)];
+		node = *link;
+	}
+
+	return NULL;
+}
+
+
+/*!	Returns the node for the prefix \a key of \a length bits, and creates it
+	if it doesn't exist yet. New nodes are completely set up before they
+	are linked into the trie.
+*/
+RouteTable::Node*
+RouteTable::_InsertNode(const uint8* key, int32 length)
+{
+	Node** link = &fRoot;
+	Node* node = fRoot;
+
+	while (node != NULL && node->length <= length
+		&& keys_match(node->key, key, node->length)) {
+		if (node->length == length)
+			return node;
+
+		link = &node->children[key_bit(key, node->length)];
+		node = *link;
+	}
+
+	Node* leaf = _NewNode(key, length);
+	if (leaf == NULL)
+		return NULL;
+
+	if (node == NULL) {
+		atomic_pointer_set(link, leaf);
+		return leaf;
+	}
+
+	int32 common = common_prefix_length(node->key, key,
+		min_c(node->length, length));
+	if (common == length) {
+		// the new node becomes the parent of the existing one
+		leaf->children[key_bit(node->key, length)] = node;
+		atomic_pointer_set(link, leaf);
+		return leaf;
+	}
+
+	// both need a new parent node that branches at the first differing bit
+	Node* branch = _NewNode(key, common);
+	if (branch == NULL) {
+		free(leaf);
+		return NULL;
+	}
+
+	branch->children[key_bit(key, common)] = leaf;
+	branch->children[key_bit(node->key, common)] = node;
+	atomic_pointer_set(link, branch);
+	return leaf;
+}
+
+
+/*!	Removes the \a node without any routes from the trie, if it isn't needed
+	as a branch anymore. Its parent, if it's a branch only, might become
+	superfluous with it, and is then removed as well.
+*/
+void
+RouteTable::_RemoveNode(Node* node, Node** link, Node** parentLink)
+{
+	if (node->children[0] != NULL && node->children[1] != NULL)
+		return;
+
+	Node* child = node->children[0] != NULL
+		? node->children[0] : node->children[1];
+	atomic_pointer_set(link, child);
+	_Retire(node);
+
+	if (child != NULL || parentLink == NULL)
+		return;
+
+	Node* parent = *parentLink;
+	if (parent->routes != NULL)
+		return;
+
+	Node* other = parent->children[0] != NULL
+		? parent->children[0] : parent->children[1];
+	atomic_pointer_set(parentLink, other);
+	_Retire(parent);
+}
+
+
+RouteTable::Node*
+RouteTable::_NewNode(const uint8* key, int32 length)
+{
+	Node* node = (Node*)malloc(sizeof(Node));
+	if (node == NULL)
+		return NULL;
+
+	node->children[0] = node->children[1] = NULL;
+	node->routes = NULL;
+	node->next_retired = NULL;
+	node->length = length;
+
+	memset(node->key, 0, sizeof(node->key));
+	memcpy(node->key, key, (length + 7) / 8);
+	if (length % 8 != 0)
+		node->key[length / 8] &= 0xff << (8 - length % 8);
+
+	return node;
+}
+
+
+void
+RouteTable::_Retire(Node* node)
+{
+	node->next_retired = fRetired;
+	fRetired = node;
+}
+
+
+/*!	Waits until no lookup can still see anything that has been removed from
+	the trie before, and frees the retired nodes.
+	Since lookups run with interrupts disabled, it's enough to have every
+	CPU process an interrupt.
+*/
+void
+RouteTable::_Synchronize()
+{
+	call_all_cpus_sync(&nop, NULL);
+
+	while (Node* node = fRetired) {
+		fRetired = node->next_retired;
+		free(node);
+	}
+}
+
+
+void
+RouteTable::_DeleteTree(Node* node)
+{
+	if (node == NULL)
+		return;
+
+	_DeleteTree(node->children[0]);
+	_DeleteTree(node->children[1]);
+	free(node);
+}
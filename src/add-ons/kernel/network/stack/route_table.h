@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+
+#include <net_datalink.h>
+
+
+struct net_route_private;
+
+
+/*!	A longest prefix match index over the routes of a domain, implemented as
+	a path compressed binary trie. The routes with the same prefix are kept
+	in a list hanging off its node.
+
+	Lookups do not take any locks, they only disable interrupts while they
+	walk the trie. Every change is published with a single pointer store,
+	and memory that a lookup could still see is only freed after all CPUs
+	have been interrupted once, which they cannot be in the middle of a
+	lookup.
+
+	Changes must be serialized by the caller, which uses the domain lock for
+	this.
+*/
+class RouteTable {
+public:
+								RouteTable();
+								~RouteTable();
+
+			void				Init(int family);
+			bool				IsSupported() const
+									{ return fKeyLength != 0; }
+
+			status_t			Add(net_route_private* route);
+			void				Remove(net_route_private* route);
+
+			net_route_private*	Routes(const net_route* description) const;
+			net_route_private*	Lookup(const sockaddr* address) const;
+
+private:
+	struct Node;
+
+	static const int32	kMaxKeyLength = 16;
+
+			bool				_GetKey(const sockaddr* address,
+									uint8* key) const;
+			int32				_PrefixLength(const net_route* route) const;
+			Node*				_FindNode(const uint8* key, int32 length,
+									Node*** _link, Node*** _parentLink) const;
+			Node*				_InsertNode(const uint8* key, int32 length);
+			void				_RemoveNode(Node* node, Node** link,
+									Node** parentLink);
+			Node*				_NewNode(const uint8* key, int32 length);
+			void				_Retire(Node* node);
+			void				_Synchronize();
+			void				_DeleteTree(Node* node);
+
+private:
+			int32				fKeyOffset;
+			int32				fKeyLength;
+				// in bytes, zero if the family isn't supported
+			Node*				fRoot;
+			Node*				fRetired;
+};
+
+
+#endif	// ROUTE_TABLE_H
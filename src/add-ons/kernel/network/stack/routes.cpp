@@ -40,6 +40,7 @@
 net_route_private::net_route_private()
 {
 	destination = mask = gateway = NULL;
+	table_next = NULL;
 }
 
 
@@ -100,36 +101,53 @@ user_copy_address(const sockaddr* from, sockaddr_storage* to)
 }
 
 
+static bool
+route_matches(struct net_domain_private* domain, net_route_private* route,
+	const net_route* description)
+{
+	if ((route->flags & RTF_DEFAULT) != 0
+		&& (description->flags & RTF_DEFAULT) != 0) {
+		// there can only be one default route per interface address family
+		// TODO: check this better
+		return route->interface_address == description->interface_address;
+	}
+
+	return (route->flags & (RTF_GATEWAY | RTF_HOST | RTF_LOCAL | RTF_DEFAULT))
+			== (description->flags
+				& (RTF_GATEWAY | RTF_HOST | RTF_LOCAL | RTF_DEFAULT))
+		&& domain->address_module->equal_masked_addresses(
+			route->destination, description->destination, description->mask)
+		&& domain->address_module->equal_addresses(route->mask,
+			description->mask)
+		&& domain->address_module->equal_addresses(route->gateway,
+			description->gateway)
+		&& (description->interface_address == NULL
+			|| description->interface_address == route->interface_address);
+}
+
+
 static net_route_private*
 find_route(struct net_domain* _domain, const net_route* description)
 {
 	struct net_domain_private* domain = (net_domain_private*)_domain;
+
+	if (domain->route_table.IsSupported()) {
+		// only the routes with the same prefix can match
+		net_route_private* route = domain->route_table.Routes(description);
+		for (; route != NULL; route = route->table_next) {
+			if (route_matches(domain, route, description))
+				return route;
+		}
+
+		return NULL;
+	}
+
 	RouteList::Iterator iterator = domain->routes.GetIterator();
 
 	while (iterator.HasNext()) {
 		net_route_private* route = iterator.Next();
 
-		if ((route->flags & RTF_DEFAULT) != 0
-			&& (description->flags & RTF_DEFAULT) != 0) {
-			// there can only be one default route per interface address family
-			// TODO: check this better
-			if (route->interface_address == description->interface_address)
-				return route;
-
-			continue;
-		}
-
-		if ((route->flags & (RTF_GATEWAY | RTF_HOST | RTF_LOCAL | RTF_DEFAULT))
-				== (description->flags
-					& (RTF_GATEWAY | RTF_HOST | RTF_LOCAL | RTF_DEFAULT))
-			&& domain->address_module->equal_masked_addresses(
-				route->destination, description->destination, description->mask)
-			&& domain->address_module->equal_addresses(route->mask,
-				description->mask)
-			&& domain->address_module->equal_addresses(route->gateway,
-				description->gateway)
-			&& (description->interface_address == NULL
-				|| description->interface_address == route->interface_address))
+		if (route_matches(domain, route, description))
 			return route;
 	}
 
@@ -187,11 +205,13 @@ find_route(net_domain* _domain, const sockaddr* address)
 }
 
 
+/*!	Releases a reference to the route. Unlike the other functions here, this
+	one does not need the domain lock: once a route has been removed from the
+	domain, nothing can acquire a new reference to it anymore.
+*/
 static void
 put_route_internal(struct net_domain_private* domain, net_route* _route)
 {
-	ASSERT_LOCKED_RECURSIVE(&domain->lock);
-
 	net_route_private* route = (net_route_private*)_route;
 	if (route == NULL || atomic_add(&route->ref_count, -1) != 1)
 		return;
@@ -229,7 +249,9 @@ get_route_internal(struct net_domain_private* domain,
 							device->address.length)))
 				break;
 		}
-	} else
+	} else if (domain->route_table.IsSupported())
+		return domain->route_table.Lookup(address);
+	else
 		route = find_route(domain, address);
 
 	if (route != NULL && atomic_add(&route->ref_count, 1) == 0) {
@@ -241,6 +263,21 @@ get_route_internal(struct net_domain_private* domain,
 }
 
 
+/*!	Like get_route_internal(), but it only acquires the domain lock if the
+	route table cannot be used for the \a address.
+*/
+static struct net_route*
+lookup_route(struct net_domain_private* domain,
+	const struct sockaddr* address)
+{
+	if (address->sa_family != AF_LINK && domain->route_table.IsSupported())
+		return domain->route_table.Lookup(address);
+
+	RecursiveLocker locker(domain->lock);
+	return get_route_internal(domain, address);
+}
+
+
 static void
 update_route_infos(struct net_domain_private* domain)
 {
@@ -491,6 +528,15 @@ add_route(struct net_domain* _domain, const struct net_route* newRoute)
 	route->mtu = 0;
 	route->ref_count = 1;
 
+	if (domain->route_table.IsSupported()) {
+		status_t status = domain->route_table.Add(route);
+		if (status != B_OK) {
+			((InterfaceAddress*)route->interface_address)->ReleaseReference();
+			delete route;
+			return status;
+		}
+	}
+
 	// Insert the route sorted by completeness of its mask
 
 	RouteList::Iterator iterator = domain->routes.GetIterator();
@@ -542,6 +588,8 @@ remove_route(struct net_domain* _domain, const struct net_route* removeRoute)
 		return B_ENTRY_NOT_FOUND;
 
 	domain->routes.Remove(route);
+	domain->route_table.Remove(route);
+		// waits until no lookup can see the route anymore
 
 	put_route_internal(domain, route);
 	update_route_infos(domain);
@@ -623,9 +671,8 @@ struct net_route*
 get_route(struct net_domain* _domain, const struct sockaddr* address)
 {
 	struct net_domain_private* domain = (net_domain_private*)_domain;
-	RecursiveLocker locker(domain->lock);
 
-	return get_route_internal(domain, address);
+	return lookup_route(domain, address);
 }
 
 
@@ -652,9 +699,7 @@ get_buffer_route(net_domain* _domain, net_buffer* buffer, net_route** _route)
 {
 	net_domain_private* domain = (net_domain_private*)_domain;
 
-	RecursiveLocker _(domain->lock);
-
-	net_route* route = get_route_internal(domain, buffer->destination);
+	net_route* route = lookup_route(domain, buffer->destination);
 	if (route == NULL)
 		return ENETUNREACH;
 
@@ -686,8 +731,6 @@ put_route(struct net_domain* _domain, net_route* route)
 	if (domain == NULL || route == NULL)
 		return;
 
-	RecursiveLocker locker(domain->lock);
-
 	put_route_internal(domain, (net_route*)route);
 }
 
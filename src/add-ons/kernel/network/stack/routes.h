@@ -20,7 +20,8 @@ class InterfaceAddress;
 
 struct net_route_private
 	: net_route, DoublyLinkedListLinkImpl<net_route_private> {
-	int32	ref_count;
+	int32				ref_count;
+	net_route_private*	table_next;
 
 	net_route_private();
 	~net_route_private();
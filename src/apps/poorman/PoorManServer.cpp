@@ -8,10 +8,13 @@
 
 #include "PoorManServer.h"
 
+#include <fcntl.h>
 #include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h> //for struct timeval
+#include <unistd.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -382,7 +385,26 @@ status_t PoorManServer::_HandleGet(httpd_conn* hc)
 		return B_ERROR;
 	}
 	
-	file.Seek(hc->first_byte_index, SEEK_SET);
+	// let the kernel send the file straight out of the file cache, and only
+	// fall back to copying it if that isn't supported
+	off_t offset = hc->first_byte_index;
+	int fd = open(hc->expnfilename, O_RDONLY);
+	if (fd >= 0) {
+		while (offset < hc->sb.st_size) {
+			ssize_t bytesSent = sendfile(hc->conn_fd, fd, &offset,
+				hc->sb.st_size - offset);
+			if (bytesSent <= 0)
+				break;
+		}
+		close(fd);
+	}
+
+	if (offset >= hc->sb.st_size) {
+		delete [] buf;
+		return B_OK;
+	}
+
+	file.Seek(offset, SEEK_SET);
 	while (true) {
 		bytesRead = file.Read(buf, POOR_MAN_BUF_SIZE);
 		if (bytesRead == 0)
@@ -39,6 +39,8 @@ command_create(int argc, const char* const* argv)
 	bool quiet = false;
 	bool verbose = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
+	int32 threadCount = 0;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -49,7 +51,7 @@ command_create(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+b0123456789C:hi:I:qv",
+		int c = getopt_long(argc, (char**)argv, "+b0123456789C:hi:I:j:qvz",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -88,6 +90,10 @@ command_create(int argc, const char* const* argv)
 				installPath = optarg;
 				break;
 
+			case 'j':
+				threadCount = atoi(optarg);
+				break;
+
 			case 'q':
 				quiet = true;
 				break;
@@ -96,6 +102,10 @@ command_create(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZSTD;
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -118,13 +128,12 @@ command_create(int argc, const char* const* argv)
 	// create package
 	BPackageWriterParameters writerParameters;
 	writerParameters.SetCompressionLevel(compressionLevel);
-	if (compressionLevel == 0) {
-		writerParameters.SetCompression(
-			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
-	}
+	writerParameters.SetCompression(compressionLevel == 0
+		? BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE : compression);
 
 	PackageWriterListener listener(verbose, quiet);
 	BPackageWriter packageWriter(&listener);
+	packageWriter.SetThreadCount(threadCount);
 	status_t result = packageWriter.Init(packageFileName, &writerParameters);
 	if (result != B_OK)
 		return 1;
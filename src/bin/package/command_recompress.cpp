@@ -45,6 +45,8 @@ command_recompress(int argc, const char* const* argv)
 	bool quiet = false;
 	bool verbose = false;
 	int32 compressionLevel = BPackageKit::BHPKG::B_HPKG_COMPRESSION_LEVEL_BEST;
+	uint32 compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZLIB;
+	int32 threadCount = 0;
 
 	while (true) {
 		static struct option sLongOptions[] = {
@@ -55,7 +57,7 @@ command_recompress(int argc, const char* const* argv)
 		};
 
 		opterr = 0; // don't print errors
-		int c = getopt_long(argc, (char**)argv, "+0123456789:hqv",
+		int c = getopt_long(argc, (char**)argv, "+0123456789:hj:qvz",
 			sLongOptions, NULL);
 		if (c == -1)
 			break;
@@ -78,6 +80,10 @@ command_recompress(int argc, const char* const* argv)
 				print_usage_and_exit(false);
 				break;
 
+			case 'j':
+				threadCount = atoi(optarg);
+				break;
+
 			case 'q':
 				quiet = true;
 				break;
@@ -86,6 +92,10 @@ command_recompress(int argc, const char* const* argv)
 				verbose = true;
 				break;
 
+			case 'z':
+				compression = BPackageKit::BHPKG::B_HPKG_COMPRESSION_ZSTD;
+				break;
+
 			default:
 				print_usage_and_exit(true);
 				break;
@@ -119,13 +129,12 @@ command_recompress(int argc, const char* const* argv)
 	// write the output package
 	BPackageWriterParameters writerParameters;
 	writerParameters.SetCompressionLevel(compressionLevel);
-	if (compressionLevel == 0) {
-		writerParameters.SetCompression(
-			BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE);
-	}
+	writerParameters.SetCompression(compressionLevel == 0
+		? BPackageKit::BHPKG::B_HPKG_COMPRESSION_NONE : compression);
 
 	PackageWriterListener listener(verbose, quiet);
 	BPackageWriter packageWriter(&listener);
+	packageWriter.SetThreadCount(threadCount);
 	if (strcmp(outputPackageFileName, "-") == 0) {
 		if (compressionLevel != 0) {
 			fprintf(stderr, "Error: Writing to stdout is supported only with "
@@ -70,8 +70,11 @@ static const char* kUsage =
 	"                 the package .self link to point to <path>, which is "
 		"useful\n"
 	"                 to redirect a \"make install\". Only allowed with -b.\n"
+	"    -j <count> - Compress with <count> threads. Defaults to one per CPU.\n"
+	"                 The package doesn't depend on the number of threads.\n"
 	"    -q         - Be quiet (don't show any output except for errors).\n"
 	"    -v         - Be verbose (show more info about created package).\n"
+	"    -z         - Use Zstandard instead of zlib compression.\n"
 	"\n"
 	"  dump [ <options> ] <package>\n"
 	"    Dumps the TOC section of package file <package>. For debugging only.\n"
@@ -118,8 +121,11 @@ static const char* kUsage =
 	"    -0 ... -9  - Use compression level 0 ... 9. 0 means no, 9 best "
 		"compression.\n"
 	"                 Defaults to 9.\n"
+	"    -j <count> - Compress with <count> threads. Defaults to one per CPU.\n"
+	"                 The package doesn't depend on the number of threads.\n"
 	"    -q         - Be quiet (don't show any output except for errors).\n"
 	"    -v         - Be verbose (show more info about created package).\n"
+	"    -z         - Use Zstandard instead of zlib compression.\n"
 	"\n"
 	"Common Options:\n"
 	"  -h, --help   - Print this usage info.\n"
@@ -9,12 +9,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <new>
+
+#include <slab_defs.h>
+#include <syscalls.h>
 #include <system_info.h>
 
 
 static struct option const kLongOptions[] = {
 	{"periodic", no_argument, 0, 'p'},
 	{"rate", required_argument, 0, 'r'},
+	{"slabs", no_argument, 0, 's'},
 	{"help", no_argument, 0, 'h'},
 	{NULL}
 };
@@ -26,23 +31,77 @@ static const char *kProgramName = __progname;
 void
 usage(int status)
 {
-	fprintf(stderr, "usage: %s [-p] [-r <time>]\n"
+	fprintf(stderr, "usage: %s [-p] [-r <time>] [-s]\n"
 		" -p,--periodic\tDumps changes periodically every second.\n"
-		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n",
+		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n"
+		" -s,--slabs\tDumps the kernel object cache statistics.\n",
 		kProgramName);
 
 	exit(status);
 }
 
 
+static int
+dump_slabs()
+{
+	object_cache_stats* stats = NULL;
+	uint32 count = 0;
+	status_t status;
+
+	// the number of caches may change between the calls
+	while (true) {
+		status = _kern_get_object_cache_stats(NULL, &count);
+		if (status != B_OK)
+			break;
+
+		count += 16;
+		delete[] stats;
+		stats = new(std::nothrow) object_cache_stats[count];
+		if (stats == NULL) {
+			status = B_NO_MEMORY;
+			break;
+		}
+
+		uint32 available = count;
+		status = _kern_get_object_cache_stats(stats, &count);
+		if (status != B_OK || count < available)
+			break;
+	}
+
+	if (status != B_OK) {
+		fprintf(stderr, "%s: cannot get object cache statistics: %s\n",
+			kProgramName, strerror(status));
+		delete[] stats;
+		return 1;
+	}
+
+	printf("%-24s %8s %10s %12s %12s %10s %10s %8s\n", "name", "objsize",
+		"usage", "alloc hits", "alloc misses", "free hits", "free miss",
+		"contend");
+
+	for (uint32 i = 0; i < count; i++) {
+		const object_cache_stats& cache = stats[i];
+		printf("%-24s %8" B_PRIuSIZE " %10" B_PRIuSIZE " %12" B_PRIu64 " %12"
+			B_PRIu64 " %10" B_PRIu64 " %10" B_PRIu64 " %8" B_PRIu64 "\n",
+			cache.name, cache.object_size, cache.usage, cache.alloc_hits,
+			cache.alloc_misses, cache.free_hits, cache.free_misses,
+			cache.depot_contention);
+	}
+
+	delete[] stats;
+	return 0;
+}
+
+
 int
 main(int argc, char** argv)
 {
 	bool periodically = false;
+	bool slabs = false;
 	bigtime_t rate = 1000000LL;
 
 	int c;
-	while ((c = getopt_long(argc, argv, "pr:h", kLongOptions, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "pr:sh", kLongOptions, NULL)) != -1) {
 		switch (c) {
 			case 0:
 				break;
@@ -58,6 +117,9 @@ main(int argc, char** argv)
 				}
 				periodically = true;
 				break;
+			case 's':
+				slabs = true;
+				break;
 			case 'h':
 				usage(0);
 				break;
@@ -66,6 +128,10 @@ main(int argc, char** argv)
 				break;
 		}
 	}
+
+	if (slabs)
+		return dump_slabs();
+
 	system_info info;
 	status_t status = get_system_info(&info);
 	if (status != B_OK) {
@@ -6,6 +6,9 @@
 
 #include <package/hpkg/PackageFileHeapWriter.h>
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <new>
 
@@ -24,6 +27,13 @@
 // minimum length of data we require before trying to compress them
 static const size_t kCompressionSizeThreshold = 64;
 
+// upper limit for the number of threads compressing chunks
+static const int32 kMaxCompressionThreads = 32;
+
+// number of full chunks queued per compression thread, before they are
+// compressed and written
+static const int32 kQueuedChunksPerThread = 4;
+
 
 namespace BPackageKit {
 
@@ -47,6 +57,42 @@ struct PackageFileHeapWriter::ChunkSegment {
 };
 
 
+struct PackageFileHeapWriter::CompressionJob {
+	const void*	data;
+	size_t		size;
+	void*		buffer;
+	size_t		compressedSize;
+	status_t	status;
+};
+
+
+struct PackageFileHeapWriter::CompressionThread {
+	PackageFileHeapWriter*	writer;
+	pthread_t				thread;
+	int32					index;
+	int32					stride;
+	bool					started;
+
+	void Run()
+	{
+		// Every thread compresses every stride-th queued chunk. Since each
+		// chunk is compressed on its own, the result doesn't depend on which
+		// thread does it.
+		for (int32 i = index; i < writer->fQueuedChunkCount; i += stride) {
+			CompressionJob& job = writer->fCompressionJobs[i];
+			job.status = writer->_CompressData(job.data, job.size, job.buffer,
+				job.compressedSize);
+		}
+	}
+
+	static void* Entry(void* data)
+	{
+		((CompressionThread*)data)->Run();
+		return NULL;
+	}
+};
+
+
 struct PackageFileHeapWriter::ChunkBuffer {
 	ChunkBuffer(PackageFileHeapWriter* writer, size_t bufferSize)
 		:
@@ -197,7 +243,7 @@ private:
 PackageFileHeapWriter::PackageFileHeapWriter(BErrorOutput* errorOutput,
 	BPositionIO* file, off_t heapOffset,
 	CompressionAlgorithmOwner* compressionAlgorithm,
-	DecompressionAlgorithmOwner* decompressionAlgorithm)
+	DecompressionAlgorithmOwner* decompressionAlgorithm, int32 threadCount)
 	:
 	PackageFileHeapAccessorBase(errorOutput, file, heapOffset,
 		decompressionAlgorithm),
@@ -205,10 +251,24 @@ PackageFileHeapWriter::PackageFileHeapWriter(BErrorOutput* errorOutput,
 	fCompressedDataBuffer(NULL),
 	fPendingDataSize(0),
 	fOffsets(),
-	fCompressionAlgorithm(compressionAlgorithm)
+	fCompressionAlgorithm(compressionAlgorithm),
+	fThreadCount(threadCount),
+	fQueuedDataBuffer(NULL),
+	fQueuedCompressedBuffer(NULL),
+	fCompressionJobs(NULL),
+	fCompressionThreads(NULL),
+	fQueuedChunkCount(0),
+	fMaxQueuedChunks(0),
+	fQueueChunks(true)
 {
 	if (fCompressionAlgorithm != NULL)
 		fCompressionAlgorithm->AcquireReference();
+
+	if (fThreadCount <= 0) {
+		long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+		fThreadCount = cpuCount > 0 ? cpuCount : 1;
+	}
+	fThreadCount = std::min(fThreadCount, kMaxCompressionThreads);
 }
 
 
@@ -229,6 +289,21 @@ PackageFileHeapWriter::Init()
 	fCompressedDataBuffer = malloc(kChunkSize);
 	if (fPendingDataBuffer == NULL || fCompressedDataBuffer == NULL)
 		throw std::bad_alloc();
+
+	// Unless there is only a single thread to compress them, full chunks are
+	// queued, so that they can be compressed in parallel.
+	if (fCompressionAlgorithm == NULL || fThreadCount < 2)
+		return;
+
+	fMaxQueuedChunks = fThreadCount * kQueuedChunksPerThread;
+	fQueuedDataBuffer = (uint8*)malloc(fMaxQueuedChunks * kChunkSize);
+	fQueuedCompressedBuffer = (uint8*)malloc(fMaxQueuedChunks * kChunkSize);
+	fCompressionJobs = new(std::nothrow) CompressionJob[fMaxQueuedChunks];
+	fCompressionThreads = new(std::nothrow) CompressionThread[fThreadCount];
+	if (fQueuedDataBuffer == NULL || fQueuedCompressedBuffer == NULL
+		|| fCompressionJobs == NULL || fCompressionThreads == NULL) {
+		throw std::bad_alloc();
+	}
 }
 
 
@@ -239,6 +314,7 @@ PackageFileHeapWriter::Reinit(PackageFileHeapReader* heapReader)
 	fCompressedHeapSize = heapReader->CompressedHeapSize();
 	fUncompressedHeapSize = heapReader->UncompressedHeapSize();
 	fPendingDataSize = 0;
+	fQueuedChunkCount = 0;
 
 	// copy the offsets array
 	size_t chunkCount = (fUncompressedHeapSize + kChunkSize - 1) / kChunkSize;
@@ -281,7 +357,7 @@ PackageFileHeapWriter::AddData(BDataReader& dataReader, off_t size,
 		readOffset += toCopy;
 
 		if (fPendingDataSize == kChunkSize) {
-			error = _FlushPendingData();
+			error = _QueuePendingData();
 			if (error != B_OK)
 				return error;
 		}
@@ -319,6 +395,11 @@ PackageFileHeapWriter::RemoveDataRanges(
 	// handling and also can use the pending data buffer.
 	_FlushPendingData();
 
+	// Since we write the data back to where we read them from, the writing end
+	// must not get ahead of what we have read. Hence every chunk has to be
+	// written right away, instead of being queued.
+	fQueueChunks = false;
+
 	// We potentially have to recompress all data from the first affected chunk
 	// to the end (minus the removed ranges, of course). As a basic algorithm we
 	// can use our usual data writing strategy, i.e. read a chunk, decompress it
@@ -424,6 +505,8 @@ PackageFileHeapWriter::RemoveDataRanges(
 		chunkBuffer.CurrentSegmentDone();
 	}
 
+	fQueueChunks = true;
+
 	// Make sure a last partial chunk ends up in the pending data buffer. This
 	// is only necessary when we didn't have to move any chunk segments, since
 	// the loop would otherwise have read it in and left it in the pending data
@@ -488,6 +571,14 @@ PackageFileHeapWriter::ReadAndDecompressChunk(size_t chunkIndex,
 		return B_OK;
 	}
 
+	if (chunkIndex >= (size_t)fOffsets.Count()) {
+		// The chunk is complete, but still queued for compression.
+		memcpy(uncompressedDataBuffer,
+			fQueuedDataBuffer + (chunkIndex - fOffsets.Count()) * kChunkSize,
+			kChunkSize);
+		return B_OK;
+	}
+
 	uint64 offset = fOffsets[chunkIndex];
 	size_t compressedSize = chunkIndex + 1 == (size_t)fOffsets.Count()
 		? fCompressedHeapSize - offset
@@ -505,16 +596,27 @@ PackageFileHeapWriter::_Uninit()
 	free(fCompressedDataBuffer);
 	fPendingDataBuffer = NULL;
 	fCompressedDataBuffer = NULL;
+
+	free(fQueuedDataBuffer);
+	free(fQueuedCompressedBuffer);
+	delete[] fCompressionJobs;
+	delete[] fCompressionThreads;
+	fQueuedDataBuffer = NULL;
+	fQueuedCompressedBuffer = NULL;
+	fCompressionJobs = NULL;
+	fCompressionThreads = NULL;
 }
 
 
 status_t
 PackageFileHeapWriter::_FlushPendingData()
 {
-	if (fPendingDataSize == 0)
-		return B_OK;
+	// the queued chunks precede the pending data
+	status_t error = _FlushQueuedChunks();
+	if (error != B_OK || fPendingDataSize == 0)
+		return error;
 
-	status_t error = _WriteChunk(fPendingDataBuffer, fPendingDataSize, true);
+	error = _WriteChunk(fPendingDataBuffer, fPendingDataSize, true);
 	if (error == B_OK)
 		fPendingDataSize = 0;
 
@@ -522,6 +624,77 @@ PackageFileHeapWriter::_FlushPendingData()
 }
 
 
+status_t
+PackageFileHeapWriter::_QueuePendingData()
+{
+	if (!fQueueChunks || fMaxQueuedChunks == 0)
+		return _FlushPendingData();
+
+	uint8* data = fQueuedDataBuffer + (size_t)fQueuedChunkCount * kChunkSize;
+	memcpy(data, fPendingDataBuffer, fPendingDataSize);
+
+	CompressionJob& job = fCompressionJobs[fQueuedChunkCount];
+	job.data = data;
+	job.size = fPendingDataSize;
+	job.buffer = fQueuedCompressedBuffer
+		+ (size_t)fQueuedChunkCount * kChunkSize;
+
+	fPendingDataSize = 0;
+
+	if (++fQueuedChunkCount < fMaxQueuedChunks)
+		return B_OK;
+
+	return _FlushQueuedChunks();
+}
+
+
+status_t
+PackageFileHeapWriter::_FlushQueuedChunks()
+{
+	if (fQueuedChunkCount == 0)
+		return B_OK;
+
+	_CompressQueuedChunks();
+
+	// write the chunks in order, so that the file doesn't depend on the
+	// number of threads
+	status_t error = B_OK;
+	for (int32 i = 0; error == B_OK && i < fQueuedChunkCount; i++)
+		error = _WriteQueuedChunk(fCompressionJobs[i]);
+
+	fQueuedChunkCount = 0;
+	return error;
+}
+
+
+void
+PackageFileHeapWriter::_CompressQueuedChunks()
+{
+	int32 threadCount = std::min(fThreadCount, fQueuedChunkCount);
+
+	// The calling thread compresses the first share itself. Should we fail to
+	// spawn a thread, its share is compressed by the calling thread as well.
+	for (int32 i = 0; i < threadCount; i++) {
+		CompressionThread& thread = fCompressionThreads[i];
+		thread.writer = this;
+		thread.index = i;
+		thread.stride = threadCount;
+		thread.started = i > 0 && pthread_create(&thread.thread, NULL,
+			&CompressionThread::Entry, &thread) == 0;
+	}
+
+	fCompressionThreads[0].Run();
+
+	for (int32 i = 1; i < threadCount; i++) {
+		CompressionThread& thread = fCompressionThreads[i];
+		if (thread.started)
+			pthread_join(thread.thread, NULL);
+		else
+			thread.Run();
+	}
+}
+
+
 status_t
 PackageFileHeapWriter::_WriteChunk(const void* data, size_t size,
 	bool mayCompress)
@@ -554,6 +727,50 @@ PackageFileHeapWriter::_WriteChunk(const void* data, size_t size,
 }
 
 
+status_t
+PackageFileHeapWriter::_WriteQueuedChunk(const CompressionJob& job)
+{
+	// add offset
+	if (!fOffsets.Add(fCompressedHeapSize)) {
+		fErrorOutput->PrintError("Out of memory!\n");
+		return B_NO_MEMORY;
+	}
+
+	if (job.status == B_OK)
+		return _WriteDataUncompressed(job.buffer, job.compressedSize);
+
+	if (job.status != B_BUFFER_OVERFLOW) {
+		fErrorOutput->PrintError("Failed to compress chunk data: %s\n",
+			strerror(job.status));
+		return job.status;
+	}
+
+	return _WriteDataUncompressed(job.data, job.size);
+}
+
+
+/*!	Compresses the given data into \a buffer, which must be at least \a size
+	bytes large. Returns \c B_BUFFER_OVERFLOW, if compressing doesn't save any
+	space. May be called by several threads at the same time.
+*/
+status_t
+PackageFileHeapWriter::_CompressData(const void* data, size_t size,
+	void* buffer, size_t& _compressedSize)
+{
+	status_t error = fCompressionAlgorithm->algorithm->CompressBuffer(data,
+		size, buffer, size, _compressedSize,
+		fCompressionAlgorithm->parameters);
+	if (error != B_OK)
+		return error;
+
+	// only use compressed data when we've actually saved space
+	if (_compressedSize == size)
+		return B_BUFFER_OVERFLOW;
+
+	return B_OK;
+}
+
+
 status_t
 PackageFileHeapWriter::_WriteDataCompressed(const void* data, size_t size)
 {
@@ -561,9 +778,8 @@ PackageFileHeapWriter::_WriteDataCompressed(const void* data, size_t size)
 		return B_BUFFER_OVERFLOW;
 
 	size_t compressedSize;
-	status_t error = fCompressionAlgorithm->algorithm->CompressBuffer(data,
-		size, fCompressedDataBuffer, size, compressedSize,
-		fCompressionAlgorithm->parameters);
+	status_t error = _CompressData(data, size, fCompressedDataBuffer,
+		compressedSize);
 	if (error != B_OK) {
 		if (error != B_BUFFER_OVERFLOW) {
 			fErrorOutput->PrintError("Failed to compress chunk data: %s\n",
@@ -572,10 +788,6 @@ PackageFileHeapWriter::_WriteDataCompressed(const void* data, size_t size)
 		return error;
 	}
 
-	// only use compressed data when we've actually saved space
-	if (compressedSize == size)
-		return B_BUFFER_OVERFLOW;
-
 	return _WriteDataUncompressed(fCompressedDataBuffer, compressedSize);
 }
 
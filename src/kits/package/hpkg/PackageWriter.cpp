@@ -137,6 +137,14 @@ BPackageWriter::SetCheckLicenses(bool checkLicenses)
 }
 
 
+void
+BPackageWriter::SetThreadCount(int32 threadCount)
+{
+	if (fImpl != NULL)
+		fImpl->SetThreadCount(threadCount);
+}
+
+
 status_t
 BPackageWriter::AddEntry(const char* fileName, int fd)
 {
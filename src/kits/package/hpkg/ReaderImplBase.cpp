@@ -20,6 +20,7 @@
 #include <DataIO.h>
 
 #include <ZlibCompressionAlgorithm.h>
+#include <ZstdCompressionAlgorithm.h>
 
 #include <package/hpkg/HPKGDefsPrivate.h>
 #include <package/hpkg/PackageFileHeapReader.h>
@@ -824,6 +825,17 @@ ReaderImplBase::InitHeapReader(uint32 compression, uint32 chunkSize,
 				return B_NO_MEMORY;
 			}
 			break;
+		case B_HPKG_COMPRESSION_ZSTD:
+			decompressionAlgorithm = DecompressionAlgorithmOwner::Create(
+				new(std::nothrow) BZstdCompressionAlgorithm,
+				new(std::nothrow) BZstdDecompressionParameters);
+			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
+			if (decompressionAlgorithm == NULL
+				|| decompressionAlgorithm->algorithm == NULL
+				|| decompressionAlgorithm->parameters == NULL) {
+				return B_NO_MEMORY;
+			}
+			break;
 		default:
 			fErrorOutput->PrintError("Error: Invalid heap compression\n");
 			return B_BAD_DATA;
@@ -20,6 +20,7 @@
 
 #include <AutoDeleter.h>
 #include <ZlibCompressionAlgorithm.h>
+#include <ZstdCompressionAlgorithm.h>
 
 #include <package/hpkg/DataReader.h>
 #include <package/hpkg/ErrorOutput.h>
@@ -227,6 +228,7 @@ WriterImplBase::WriterImplBase(const char* fileType, BErrorOutput* errorOutput)
 	fErrorOutput(errorOutput),
 	fFileName(NULL),
 	fParameters(),
+	fThreadCount(0),
 	fFile(NULL),
 	fOwnsFile(false),
 	fFinished(false)
@@ -252,6 +254,13 @@ WriterImplBase::~WriterImplBase()
 }
 
 
+void
+WriterImplBase::SetThreadCount(int32 threadCount)
+{
+	fThreadCount = threadCount;
+}
+
+
 status_t
 WriterImplBase::Init(BPositionIO* file, bool keepFile, const char* fileName,
 	const BPackageWriterParameters& parameters)
@@ -317,6 +326,27 @@ WriterImplBase::InitHeapReader(size_t headerSize)
 				new(std::nothrow) BZlibDecompressionParameters);
 			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
 
+			if (compressionAlgorithm == NULL
+				|| compressionAlgorithm->algorithm == NULL
+				|| compressionAlgorithm->parameters == NULL
+				|| decompressionAlgorithm == NULL
+				|| decompressionAlgorithm->algorithm == NULL
+				|| decompressionAlgorithm->parameters == NULL) {
+				throw std::bad_alloc();
+			}
+			break;
+		case B_HPKG_COMPRESSION_ZSTD:
+			compressionAlgorithm = CompressionAlgorithmOwner::Create(
+				new(std::nothrow) BZstdCompressionAlgorithm,
+				new(std::nothrow) BZstdCompressionParameters(
+					fParameters.CompressionLevel()));
+			compressionAlgorithmReference.SetTo(compressionAlgorithm, true);
+
+			decompressionAlgorithm = DecompressionAlgorithmOwner::Create(
+				new(std::nothrow) BZstdCompressionAlgorithm,
+				new(std::nothrow) BZstdDecompressionParameters);
+			decompressionAlgorithmReference.SetTo(decompressionAlgorithm, true);
+
 			if (compressionAlgorithm == NULL
 				|| compressionAlgorithm->algorithm == NULL
 				|| compressionAlgorithm->parameters == NULL
@@ -333,7 +363,7 @@ WriterImplBase::InitHeapReader(size_t headerSize)
 
 	// create heap writer
 	fHeapWriter = new PackageFileHeapWriter(fErrorOutput, fFile, headerSize,
-		compressionAlgorithm, decompressionAlgorithm);
+		compressionAlgorithm, decompressionAlgorithm, fThreadCount);
 	fHeapWriter->Init();
 
 	return B_OK;
@@ -419,6 +419,8 @@ BZstdCompressionAlgorithm::_TranslateZstdError(size_t error)
 			return B_OK;
 		case ZSTD_error_seekableIO:
 			return B_BAD_VALUE;
+		case ZSTD_error_dstSize_tooSmall:
+			return B_BUFFER_OVERFLOW;
 		case ZSTD_error_corruption_detected:
 		case ZSTD_error_checksum_wrong:
 			return B_BAD_DATA;
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "arch_numa.h"
+
+#include <string.h>
+
+#include <KernelExport.h>
+
+#include <boot/stage2.h>
+
+
+//#define TRACE_NUMA
+#ifdef TRACE_NUMA
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+/*!	Maps the ACPI proximity domain \a domain to a dense memory node index,
+	allocating a new index if the domain hasn't been seen before.
+	\return The node index, or \c MAX_MEMORY_NODES if there are too many nodes.
+*/
+static uint32
+memory_node_for_domain(uint32 domain, uint32* domains)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_memory_nodes; i++) {
+		if (domains[i] == domain)
+			return i;
+	}
+
+	if (gKernelArgs.num_memory_nodes == MAX_MEMORY_NODES)
+		return MAX_MEMORY_NODES;
+
+	domains[gKernelArgs.num_memory_nodes] = domain;
+	return gKernelArgs.num_memory_nodes++;
+}
+
+
+static void
+set_cpu_memory_node(uint32 apicID, uint32 node)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+		if (gKernelArgs.arch_args.cpu_apic_id[i] == apicID) {
+			gKernelArgs.cpu_memory_node[i] = node;
+			return;
+		}
+	}
+}
+
+
+/*!	Fills in the memory nodes of the CPUs and of the physical memory, and the
+	distances between the nodes from the ACPI SRAT and SLIT. Both tables may
+	be \c NULL. Must be called after the CPUs have been enumerated, as it
+	refers to them by their APIC IDs.
+*/
+void
+arch_numa_init(acpi_srat* srat, acpi_slit* slit)
+{
+	gKernelArgs.num_memory_nodes = 0;
+	gKernelArgs.num_memory_node_ranges = 0;
+	memset(gKernelArgs.cpu_memory_node, 0,
+		sizeof(gKernelArgs.cpu_memory_node));
+
+	if (srat == NULL) {
+		TRACE(("numa: no SRAT, assuming uniform memory access\n"));
+		return;
+	}
+
+	uint32 domains[MAX_MEMORY_NODES];
+
+	acpi_srat_entry *entry
+		= (acpi_srat_entry *)((uint8 *)srat + sizeof(acpi_srat));
+	acpi_srat_entry *end
+		= (acpi_srat_entry *)((uint8 *)srat + srat->header.length);
+	for (; entry < end && entry->length > 0;
+			entry = (acpi_srat_entry *)((uint8 *)entry + entry->length)) {
+		switch (entry->type) {
+			case ACPI_SRAT_PROCESSOR_AFFINITY:
+			{
+				acpi_srat_processor_affinity *affinity
+					= (acpi_srat_processor_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0)
+					break;
+
+				uint32 domain = affinity->proximity_domain_low
+					| (affinity->proximity_domain_high[0] << 8)
+					| (affinity->proximity_domain_high[1] << 16)
+					| ((uint32)affinity->proximity_domain_high[2] << 24);
+				uint32 node = memory_node_for_domain(domain, domains);
+				if (node < MAX_MEMORY_NODES)
+					set_cpu_memory_node(affinity->apic_id, node);
+				break;
+			}
+
+			case ACPI_SRAT_X2_APIC_AFFINITY:
+			{
+				acpi_srat_x2_apic_affinity *affinity
+					= (acpi_srat_x2_apic_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0)
+					break;
+
+				uint32 node = memory_node_for_domain(
+					affinity->proximity_domain, domains);
+				if (node < MAX_MEMORY_NODES)
+					set_cpu_memory_node(affinity->x2apic_id, node);
+				break;
+			}
+
+			case ACPI_SRAT_MEMORY_AFFINITY:
+			{
+				acpi_srat_memory_affinity *affinity
+					= (acpi_srat_memory_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_AFFINITY_ENABLED) == 0
+					|| affinity->range_length == 0) {
+					break;
+				}
+
+				uint32 node = memory_node_for_domain(
+					affinity->proximity_domain, domains);
+				if (node == MAX_MEMORY_NODES
+					|| gKernelArgs.num_memory_node_ranges
+						== MAX_MEMORY_NODE_RANGES) {
+					TRACE(("numa: too many memory nodes or ranges\n"));
+					break;
+				}
+
+				memory_node_range &range = gKernelArgs.memory_node_range[
+					gKernelArgs.num_memory_node_ranges++];
+				range.range.start = affinity->base_address;
+				range.range.size = affinity->range_length;
+				range.node = node;
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	if (gKernelArgs.num_memory_nodes < 2) {
+		// nothing to gain from a single node
+		gKernelArgs.num_memory_nodes = 0;
+		gKernelArgs.num_memory_node_ranges = 0;
+		memset(gKernelArgs.cpu_memory_node, 0,
+			sizeof(gKernelArgs.cpu_memory_node));
+		return;
+	}
+
+	// Use the SLIT distances, if we have them, otherwise assume all remote
+	// nodes are equally far away.
+	uint64 localityCount = slit != NULL ? slit->locality_count : 0;
+
+	for (uint32 i = 0; i < gKernelArgs.num_memory_nodes; i++) {
+		for (uint32 j = 0; j < gKernelArgs.num_memory_nodes; j++) {
+			uint8 distance = i == j ? 10 : 20;
+			if (domains[i] < localityCount && domains[j] < localityCount) {
+				distance = slit->entries[domains[i] * localityCount
+					+ domains[j]];
+			}
+
+			gKernelArgs.memory_node_distance[i][j] = distance;
+		}
+	}
+
+	dprintf("numa: %" B_PRIu32 " memory nodes, %" B_PRIu32 " memory ranges\n",
+		gKernelArgs.num_memory_nodes, gKernelArgs.num_memory_node_ranges);
+}
@@ -0,0 +1,17 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef ARCH_NUMA_H
+#define ARCH_NUMA_H
+
+
+#include <SupportDefs.h>
+
+#include <arch/x86/arch_acpi.h>
+
+
+extern void arch_numa_init(acpi_srat* srat, acpi_slit* slit);
+
+
+#endif	/* ARCH_NUMA_H */
@@ -27,6 +27,7 @@
 
 #include "mmu.h"
 #include "acpi.h"
+#include "arch_numa.h"
 
 
 #define NO_SMP 0
@@ -315,7 +316,12 @@ smp_do_acpi_config(void)
 		apic = (acpi_apic *)((uint8 *)apic + apic->length);
 	}
 
-	return gKernelArgs.num_cpus > 0 ? B_OK : B_ERROR;
+	if (gKernelArgs.num_cpus == 0)
+		return B_ERROR;
+
+	arch_numa_init((acpi_srat *)acpi_find_table(ACPI_SRAT_SIGNATURE),
+		(acpi_slit *)acpi_find_table(ACPI_SLIT_SIGNATURE));
+	return B_OK;
 }
 
 
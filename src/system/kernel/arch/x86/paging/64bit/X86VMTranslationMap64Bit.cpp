@@ -15,6 +15,7 @@
 #include <slab/Slab.h>
 #include <thread.h>
 #include <util/AutoLock.h>
+#include <vm/vm.h>
 #include <vm/vm_page.h>
 #include <vm/VMAddressSpace.h>
 #include <vm/VMCache.h>
@@ -39,6 +40,7 @@ X86VMTranslationMap64Bit::X86VMTranslationMap64Bit()
 	:
 	fPagingStructures(NULL)
 {
+	fLargePageReservation.count = 0;
 }
 
 
@@ -68,8 +70,10 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 				uint64* virtualPageDir = (uint64*)fPageMapper->GetPageTableAt(
 					virtualPDPT[j] & X86_64_PDPTE_ADDRESS_MASK);
 				for (uint32 k = 0; k < 512; k++) {
-					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0)
+					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0
+						|| (virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0) {
 						continue;
+					}
 
 					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
 					page = vm_lookup_page(address / B_PAGE_SIZE);
@@ -107,6 +111,8 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 		fPageMapper->Delete();
 	}
 
+	vm_page_unreserve_pages(&fLargePageReservation);
+
 	fPagingStructures->RemoveReference();
 }
 
@@ -199,9 +205,8 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 
 	// Look up the page table for the virtual address, allocating new tables
 	// if required. Shouldn't fail.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
-		true, reservation, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(virtualAddress, true,
+		reservation);
 	ASSERT(entry != NULL);
 
 	// The entry should not already exist.
@@ -222,6 +227,80 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 }
 
 
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	return k64BitPageTableRange;
+}
+
+
+status_t
+X86VMTranslationMap64Bit::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	TRACE("X86VMTranslationMap64Bit::MapLargePage(%#" B_PRIxADDR ", %#"
+		B_PRIxPHYSADDR ")\n", virtualAddress, physicalAddress);
+
+	ASSERT(virtualAddress % k64BitPageTableRange == 0);
+	ASSERT(physicalAddress % k64BitPageTableRange == 0);
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	// Look up the page directory entry for the virtual address, allocating
+	// new tables if required.
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		true, reservation, fPageMapper, fMapCount);
+	ASSERT(pde != NULL);
+
+	// The range might still have an empty page table from earlier mappings.
+	// We can only replace it, if it doesn't map anything anymore.
+	uint64 oldEntry = *pde;
+	vm_page* oldPageTable = NULL;
+	if ((oldEntry & X86_64_PDE_PRESENT) != 0) {
+		if ((oldEntry & X86_64_PDE_LARGE_PAGE) != 0)
+			return B_BUSY;
+
+		phys_addr_t physicalPageTable = oldEntry & X86_64_PDE_ADDRESS_MASK;
+		uint64* pageTable
+			= (uint64*)fPageMapper->GetPageTableAt(physicalPageTable);
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+			if ((pageTable[i] & X86_64_PTE_PRESENT) != 0)
+				return B_BUSY;
+		}
+
+		oldPageTable = vm_lookup_page(physicalPageTable / B_PAGE_SIZE);
+		ASSERT(oldPageTable != NULL);
+	}
+
+	// Keep one of the reserved pages, so that the large page can be split up
+	// again later on. The caller has reserved a page for the page table.
+	ASSERT(reservation->count > 0);
+	reservation->count--;
+	fLargePageReservation.count++;
+
+	X86PagingMethod64Bit::SetTableEntry(pde,
+		X86PagingMethod64Bit::PageTableEntryFor(physicalAddress, attributes,
+			memoryType, fIsKernelMap)
+		| X86_64_PDE_LARGE_PAGE);
+
+	fMapCount += k64BitTableEntryCount;
+
+	if (oldPageTable != NULL) {
+		// Make sure no CPU still has the page table cached, before we free it.
+		InvalidatePage(virtualAddress);
+		Flush();
+
+		DEBUG_PAGE_ACCESS_START(oldPageTable);
+		vm_page_set_state(oldPageTable, PAGE_STATE_FREE);
+		fMapCount--;
+	}
+
+	return B_OK;
+}
+
+
 status_t
 X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 {
@@ -235,9 +314,7 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -285,9 +362,7 @@ X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -335,9 +410,7 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	// Look up the page table for the virtual address.
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
@@ -402,9 +475,7 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -535,9 +606,7 @@ X86VMTranslationMap64Bit::UnmapArea(VMArea* area, bool deletingAddressSpace,
 			addr_t address = area->Base()
 				+ ((page->cache_offset * B_PAGE_SIZE) - area->cache_offset);
 
-			uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-				fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-				false, NULL, fPageMapper, fMapCount);
+			uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 			if (entry == NULL) {
 				panic("page %p has mapping for area %p (%#" B_PRIxADDR "), but "
 					"has no page table", page, area, address);
@@ -683,9 +752,42 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
-		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
-			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
-			NULL, fPageMapper, fMapCount);
+		// A large page that is covered completely keeps being mapped as such.
+		// Otherwise _PageTableForAddress() splits it up.
+		bool coversTable = start % k64BitPageTableRange == 0
+			&& end - start >= k64BitPageTableRange - 1;
+		if (coversTable && fLargePageReservation.count > 0) {
+			uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+				fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
+				NULL, fPageMapper, fMapCount);
+			if (pde != NULL && (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+				TRACE("X86VMTranslationMap64Bit::Protect(): protect large "
+					"page %#" B_PRIxADDR "\n", start);
+
+				uint64 entry = *pde;
+				uint64 oldEntry;
+				while (true) {
+					oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+						(entry & ~(X86_64_PTE_PROTECTION_MASK
+								| X86_64_PTE_MEMORY_TYPE_MASK))
+							| newProtectionFlags
+							| X86PagingMethod64Bit
+								::MemoryTypeToPageTableEntryFlags(memoryType),
+						entry);
+					if (oldEntry == entry)
+						break;
+					entry = oldEntry;
+				}
+
+				if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+					InvalidatePage(start);
+
+				start += k64BitPageTableRange;
+				continue;
+			}
+		}
+
+		uint64* pageTable = _PageTableForAddress(start, false, NULL);
 		if (pageTable == NULL) {
 			// Move on to the next page table.
 			start = ROUNDUP(start + 1, k64BitPageTableRange);
@@ -726,6 +828,11 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 				InvalidatePage(start);
 			}
 		}
+
+		// If the whole table has got the same protection now, it might be
+		// possible to map it with a large page (again).
+		if (coversTable && memoryType == 0)
+			_TryJoinLargePage(start - k64BitPageTableRange);
 	} while (start != 0 && start < end);
 
 	return B_OK;
@@ -740,9 +847,7 @@ X86VMTranslationMap64Bit::ClearFlags(addr_t address, uint32 flags)
 
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return B_OK;
 
@@ -771,9 +876,7 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
-	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
-		fPagingStructures->VirtualPML4(), address, fIsKernelMap,
-		false, NULL, fPageMapper, fMapCount);
+	uint64* entry = _PageTableEntryForAddress(address, false, NULL);
 	if (entry == NULL)
 		return false;
 
@@ -838,6 +941,183 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 }
 
 
+/*!	Looks up the page table for the given virtual address like
+	X86PagingMethod64Bit::PageTableForAddress(), but splits up a large page
+	mapping the address first.
+*/
+uint64*
+X86VMTranslationMap64Bit::_PageTableForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation)
+{
+	if (fLargePageReservation.count > 0) {
+		uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+			fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+			false, NULL, fPageMapper, fMapCount);
+		if (pde != NULL && (*pde & X86_64_PDE_LARGE_PAGE) != 0)
+			_SplitLargePage(pde, virtualAddress);
+	}
+
+	return X86PagingMethod64Bit::PageTableForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		allocateTables, reservation, fPageMapper, fMapCount);
+}
+
+
+uint64*
+X86VMTranslationMap64Bit::_PageTableEntryForAddress(addr_t virtualAddress,
+	bool allocateTables, vm_page_reservation* reservation)
+{
+	uint64* pageTable = _PageTableForAddress(virtualAddress, allocateTables,
+		reservation);
+	if (pageTable == NULL)
+		return NULL;
+
+	return &pageTable[VADDR_TO_PTE(virtualAddress)];
+}
+
+
+/*!	Replaces the large page mapped by the given page directory entry with a
+	page table mapping the same physical memory with the same flags.
+	The thread must be pinned to the current CPU.
+*/
+void
+X86VMTranslationMap64Bit::_SplitLargePage(uint64* pde, addr_t virtualAddress)
+{
+	RecursiveLocker locker(fLock);
+
+	uint64 entry = *pde;
+	if ((entry & X86_64_PDE_LARGE_PAGE) == 0) {
+		// someone else was faster
+		return;
+	}
+
+	if (fLargePageReservation.count == 0) {
+		panic("X86VMTranslationMap64Bit::_SplitLargePage(): large page at %#"
+			B_PRIxADDR " (%#" B_PRIx64 ") wasn't mapped via MapLargePage()",
+			virtualAddress, entry);
+		return;
+	}
+
+	TRACE("X86VMTranslationMap64Bit::_SplitLargePage(%#" B_PRIxADDR ")\n",
+		virtualAddress);
+
+	vm_page* page = vm_page_allocate_page(&fLargePageReservation,
+		PAGE_STATE_WIRED);
+
+	DEBUG_PAGE_ACCESS_END(page);
+
+	phys_addr_t physicalPageTable
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+		physicalPageTable);
+
+	// The CPU might set the accessed or dirty flag of the large page in the
+	// meantime, so retry until we've got a consistent copy. Note, that the
+	// large page flag is the PAT flag in a page table entry, which we don't
+	// use.
+	while (true) {
+		phys_addr_t physicalAddress = entry & X86_64_PDE_ADDRESS_MASK
+			& ~(phys_addr_t)(k64BitPageTableRange - 1);
+		uint64 flags = entry
+			& ~(X86_64_PDE_ADDRESS_MASK | X86_64_PDE_LARGE_PAGE);
+
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+			X86PagingMethod64Bit::SetTableEntry(&pageTable[i],
+				(physicalAddress + i * B_PAGE_SIZE) | flags);
+		}
+
+		uint64 oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+			(physicalPageTable & X86_64_PDE_ADDRESS_MASK)
+				| X86_64_PDE_PRESENT
+				| X86_64_PDE_WRITABLE
+				| X86_64_PDE_USER,
+			entry);
+		if (oldEntry == entry)
+			break;
+		entry = oldEntry;
+	}
+
+	fMapCount++;
+
+	// Invalidating any address of the large page removes it from the TLB.
+	InvalidatePage(ROUNDDOWN(virtualAddress, k64BitPageTableRange));
+}
+
+
+/*!	Replaces the page table mapping the given virtual address with a large
+	page, if the page table maps a suitably aligned physically contiguous
+	range with identical flags.
+	The thread must be pinned to the current CPU.
+*/
+void
+X86VMTranslationMap64Bit::_TryJoinLargePage(addr_t virtualAddress)
+{
+	RecursiveLocker locker(fLock);
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		false, NULL, fPageMapper, fMapCount);
+	if (pde == NULL || (*pde & X86_64_PDE_PRESENT) == 0
+		|| (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+		return;
+	}
+
+	phys_addr_t physicalPageTable = *pde & X86_64_PDE_ADDRESS_MASK;
+	uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+		physicalPageTable);
+
+	const uint64 kAccessedDirty = X86_64_PTE_ACCESSED | X86_64_PTE_DIRTY;
+	uint64 firstEntry = pageTable[0];
+	phys_addr_t physicalAddress = firstEntry & X86_64_PTE_ADDRESS_MASK;
+	uint64 flags = firstEntry & ~(X86_64_PTE_ADDRESS_MASK | kAccessedDirty);
+	if ((firstEntry & X86_64_PTE_PRESENT) == 0
+		|| physicalAddress % k64BitPageTableRange != 0
+		|| (flags & (X86_64_PTE_PAT | X86_64_PTE_MEMORY_TYPE_MASK)) != 0) {
+		return;
+	}
+
+	for (uint32 i = 1; i < k64BitTableEntryCount; i++) {
+		uint64 entry = pageTable[i];
+		if ((entry & X86_64_PTE_ADDRESS_MASK)
+				!= physicalAddress + i * B_PAGE_SIZE
+			|| (entry & ~(X86_64_PTE_ADDRESS_MASK | kAccessedDirty))
+				!= flags) {
+			return;
+		}
+	}
+
+	// We need a page to be able to split the large page up again.
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, 1, VM_PRIORITY_SYSTEM))
+		return;
+
+	vm_page* page = vm_lookup_page(physicalPageTable / B_PAGE_SIZE);
+	ASSERT(page != NULL);
+
+	TRACE("X86VMTranslationMap64Bit::_TryJoinLargePage(%#" B_PRIxADDR ")\n",
+		virtualAddress);
+
+	X86PagingMethod64Bit::SetTableEntry(pde,
+		physicalAddress | flags | X86_64_PDE_LARGE_PAGE);
+
+	// Make sure no CPU uses the page table anymore. Afterwards collect the
+	// accessed and dirty flags the CPUs might have set in the meantime.
+	InvalidatePage(ROUNDDOWN(virtualAddress, k64BitPageTableRange));
+	Flush();
+
+	uint64 accessedDirty = 0;
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+		accessedDirty |= pageTable[i] & kAccessedDirty;
+	X86PagingMethod64Bit::SetTableEntryFlags(pde, accessedDirty);
+
+	DEBUG_PAGE_ACCESS_START(page);
+	vm_page_set_state(page, PAGE_STATE_FREE);
+	fMapCount--;
+
+	fLargePageReservation.count += reservation.count;
+}
+
+
 X86PagingStructures*
 X86VMTranslationMap64Bit::PagingStructures() const
 {
@@ -124,18 +124,23 @@ struct cache_notification : DoublyLinkedListLinkImpl<cache_notification> {
 
 typedef DoublyLinkedList<cache_notification> NotificationList;
 
+static const uint32 kBlockTableShardShift = 4;
+static const uint32 kBlockTableShards = 1 << kBlockTableShardShift;
+	// the shard is selected by the lowest bits of the block number, so the
+	// blocks of a contiguous range are spread over all shards
+
 struct BlockHash {
 	typedef off_t			KeyType;
 	typedef	cached_block	ValueType;
 
 	size_t HashKey(KeyType key) const
 	{
-		return key;
+		return key >> kBlockTableShardShift;
 	}
 
 	size_t Hash(ValueType* block) const
 	{
-		return block->block_number;
+		return block->block_number >> kBlockTableShardShift;
 	}
 
 	bool Compare(KeyType key, ValueType* block) const
@@ -149,7 +154,95 @@ struct BlockHash {
 	}
 };
 
-typedef BOpenHashTable<BlockHash> BlockTable;
+typedef BOpenHashTable<BlockHash> BlockShardTable;
+
+
+/*!	The hash table of all blocks in a cache, split into shards that are each
+	protected by their own read/write lock.
+	The table is only changed with the cache lock held, and the shard lock
+	write locked. Therefore, a thread that holds the cache lock may look up
+	and iterate the table without locking any shard. Only LookupAndAcquire(),
+	and ReleaseUnlessLast() work without the cache lock, and only read lock
+	the block's shard.
+
+	The lookups are not lock-free: the shard lock is what orders them against
+	removals and against blocks leaving the unused list. Deferring frees with
+	a call_all_cpus_sync() grace period, like the route table does, would not
+	be enough for this table. _GetUnusedBlock() recycles a cached_block for
+	another block number in place, and the shard tables reallocate their
+	buckets when they grow. Also, a lookup that only notices afterwards that
+	its block changed would hold a reference that DiscardBlock() cannot wait
+	for, because dropping it needs the cache lock. An uncontended read lock
+	is a single atomic operation on the shard.
+*/
+class BlockTable {
+public:
+								BlockTable();
+								~BlockTable();
+
+			status_t			Init(size_t initialSize);
+
+			cached_block*		Lookup(off_t blockNumber);
+			cached_block*		LookupAndAcquire(off_t blockNumber);
+			bool				ReleaseUnlessLast(off_t blockNumber);
+
+			void				Insert(cached_block* block);
+			void				Remove(cached_block* block);
+			bool				RemoveUnreferenced(cached_block* block);
+			void				MarkUsed(cached_block* block);
+			cached_block*		Clear();
+
+	class Iterator {
+	public:
+		Iterator(BlockTable* table)
+			:
+			fTable(table),
+			fShard(0),
+			fIterator(&table->fShards[0].table)
+		{
+			_Skip();
+		}
+
+		bool HasNext() const
+		{
+			return fIterator.HasNext();
+		}
+
+		cached_block* Next()
+		{
+			cached_block* block = fIterator.Next();
+			_Skip();
+			return block;
+		}
+
+	private:
+		void _Skip()
+		{
+			while (!fIterator.HasNext() && ++fShard < kBlockTableShards) {
+				fIterator = BlockShardTable::Iterator(
+					&fTable->fShards[fShard].table);
+			}
+		}
+
+	private:
+		BlockTable*					fTable;
+		uint32						fShard;
+		BlockShardTable::Iterator	fIterator;
+	};
+
+private:
+	friend class Iterator;
+
+	struct Shard {
+		rw_lock					lock;
+		BlockShardTable			table;
+	};
+
+	inline	Shard&				_ShardFor(off_t blockNumber);
+
+private:
+			Shard				fShards[kBlockTableShards];
+};
 
 
 struct TransactionHash {
@@ -181,6 +274,8 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 
 	object_cache*	buffer_cache;
 	block_list		unused_blocks;
+		// Blocks acquired via BlockTable::LookupAndAcquire() stay in this
+		// list until their last reference is released.
 	uint32			unused_block_count;
 
 	ConditionVariable busy_reading_condition;
@@ -1058,6 +1153,204 @@ cached_block::CanBeWritten() const
 }
 
 
+//	#pragma mark - BlockTable
+
+
+BlockTable::BlockTable()
+{
+	for (uint32 i = 0; i < kBlockTableShards; i++)
+		rw_lock_init(&fShards[i].lock, "block cache shard");
+}
+
+
+BlockTable::~BlockTable()
+{
+	for (uint32 i = 0; i < kBlockTableShards; i++)
+		rw_lock_destroy(&fShards[i].lock);
+}
+
+
+inline BlockTable::Shard&
+BlockTable::_ShardFor(off_t blockNumber)
+{
+	return fShards[blockNumber & (kBlockTableShards - 1)];
+}
+
+
+status_t
+BlockTable::Init(size_t initialSize)
+{
+	initialSize /= kBlockTableShards;
+
+	for (uint32 i = 0; i < kBlockTableShards; i++) {
+		status_t status = fShards[i].table.Init(initialSize);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+/*!	The cache must be locked. */
+cached_block*
+BlockTable::Lookup(off_t blockNumber)
+{
+	return _ShardFor(blockNumber).table.Lookup(blockNumber);
+}
+
+
+/*!	Looks up the block, and acquires a reference to it if it is cached, and
+	clean. The block must already be referenced by someone else, or be in the
+	unused list; a block that is just being read in, written back, or changed
+	will not be returned.
+	The cache does not need to be locked; this is the only way to get a block
+	without it.
+*/
+cached_block*
+BlockTable::LookupAndAcquire(off_t blockNumber)
+{
+	Shard& shard = _ShardFor(blockNumber);
+	ReadLocker locker(shard.lock);
+
+	cached_block* block = shard.table.Lookup(blockNumber);
+	if (block == NULL || block->busy_reading || block->busy_writing
+		|| block->is_dirty || block->discard || block->transaction != NULL
+		|| block->previous_transaction != NULL) {
+		return NULL;
+	}
+
+	// Neither can the block be removed from the table, nor can it leave the
+	// unused state while we hold the shard lock, so an unreferenced block
+	// cannot change under us.
+	int32 refCount = atomic_get(&block->ref_count);
+	while (true) {
+		if (refCount == 0 && !block->unused) {
+			// the block is just being set up, or released
+			return NULL;
+		}
+
+		int32 previous = atomic_test_and_set(&block->ref_count, refCount + 1,
+			refCount);
+		if (previous == refCount)
+			break;
+
+		refCount = previous;
+	}
+
+	block->last_accessed = system_time() / 1000000L;
+	return block;
+}
+
+
+/*!	Releases a reference to the block, unless it is the last one: releasing
+	that one might move the block into the unused list, and therefore needs
+	the cache to be locked.
+	Returns whether or not the reference has been released.
+*/
+bool
+BlockTable::ReleaseUnlessLast(off_t blockNumber)
+{
+	Shard& shard = _ShardFor(blockNumber);
+	ReadLocker locker(shard.lock);
+
+	cached_block* block = shard.table.Lookup(blockNumber);
+	if (block == NULL)
+		return false;
+
+	int32 refCount = atomic_get(&block->ref_count);
+	while (refCount > 1) {
+		int32 previous = atomic_test_and_set(&block->ref_count, refCount - 1,
+			refCount);
+		if (previous == refCount)
+			return true;
+
+		refCount = previous;
+	}
+
+	return false;
+}
+
+
+/*!	The cache must be locked. */
+void
+BlockTable::Insert(cached_block* block)
+{
+	Shard& shard = _ShardFor(block->block_number);
+	WriteLocker locker(shard.lock);
+
+	shard.table.Insert(block);
+}
+
+
+/*!	The cache must be locked. */
+void
+BlockTable::Remove(cached_block* block)
+{
+	Shard& shard = _ShardFor(block->block_number);
+	WriteLocker locker(shard.lock);
+
+	shard.table.Remove(block);
+}
+
+
+/*!	Removes the block from the table only if nobody has a reference to it.
+	Since lookups without the cache lock only work with the shard read locked,
+	the block cannot be acquired anymore once it has been removed.
+	The cache must be locked.
+*/
+bool
+BlockTable::RemoveUnreferenced(cached_block* block)
+{
+	Shard& shard = _ShardFor(block->block_number);
+	WriteLocker locker(shard.lock);
+
+	if (atomic_get(&block->ref_count) != 0)
+		return false;
+
+	shard.table.Remove(block);
+	return true;
+}
+
+
+/*!	Takes the block out of the unused state. LookupAndAcquire() relies on an
+	unused block staying unused while it holds the shard lock, so this must be
+	done with the shard write locked.
+	The cache must be locked.
+*/
+void
+BlockTable::MarkUsed(cached_block* block)
+{
+	Shard& shard = _ShardFor(block->block_number);
+	WriteLocker locker(shard.lock);
+
+	block->unused = false;
+}
+
+
+/*!	Removes all blocks from the table, and returns them as a list linked
+	via cached_block::next.
+	The cache must be locked, and nobody else may use it anymore.
+*/
+cached_block*
+BlockTable::Clear()
+{
+	cached_block* first = NULL;
+
+	for (uint32 i = 0; i < kBlockTableShards; i++) {
+		cached_block* block = fShards[i].table.Clear(true);
+		while (block != NULL) {
+			cached_block* next = block->next;
+			block->next = first;
+			first = block;
+			block = next;
+		}
+	}
+
+	return first;
+}
+
+
 //	#pragma mark - BlockWriter
 
 
@@ -1402,7 +1695,7 @@ block_cache::Init()
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	hash = new BlockTable();
+	hash = new(std::nothrow) BlockTable();
 	if (hash == NULL || hash->Init(1024) != B_OK)
 		return B_NO_MEMORY;
 
@@ -1550,9 +1843,12 @@ block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 		}
 
 		// remove block from lists
+		if (!hash->RemoveUnreferenced(block))
+			continue;
+
 		iterator.Remove();
 		unused_block_count--;
-		RemoveBlock(block);
+		FreeBlock(block);
 
 		if (--count <= 0)
 			break;
@@ -1650,9 +1946,11 @@ block_cache::_GetUnusedBlock()
 			BlockWriter::WriteBlock(this, block);
 
 		// remove block from lists
+		if (!hash->RemoveUnreferenced(block))
+			continue;
+
 		iterator.Remove();
 		unused_block_count--;
-		hash->Remove(block);
 
 		ASSERT(block->original_data == NULL && block->parent_data == NULL);
 		block->unused = false;
@@ -1808,21 +2106,34 @@ put_cached_block(block_cache* cache, cached_block* block)
 		return;
 	}
 
-	if (--block->ref_count == 0
+	if (atomic_add(&block->ref_count, -1) == 1
 		&& block->transaction == NULL && block->previous_transaction == NULL) {
 		// This block is not used anymore, and not part of any transaction
 		block->is_writing = false;
 
 		if (block->discard) {
-			cache->RemoveBlock(block);
+			// If the block has been acquired without the cache lock in the
+			// mean time, it will be removed when that reference is released.
+			if (cache->hash->RemoveUnreferenced(block)) {
+				if (block->unused) {
+					cache->unused_blocks.Remove(block);
+					cache->unused_block_count--;
+				}
+				cache->FreeBlock(block);
+			}
 		} else {
-			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
-			block->unused = true;
-
+			// put this block in the list of unused blocks -- if it was
+			// acquired without the cache lock, it is still in there, and
+			// just needs to be moved to the end
 			ASSERT(block->original_data == NULL && block->parent_data == NULL);
+
+			if (block->unused)
+				cache->unused_blocks.Remove(block);
+			else {
+				block->unused = true;
+				cache->unused_block_count++;
+			}
 			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
 		}
 	}
 }
@@ -1852,9 +2163,8 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 	\param _allocated tells you whether or not a new block has been allocated
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
-		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
-		block is read in.
+		not already in the cache, but cleared instead. If \c true, the cache
+		will be temporarily unlocked while the block is read in.
 */
 static cached_block*
 get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
@@ -1888,7 +2198,7 @@ retry:
 
 	if (block->unused) {
 		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
+		cache->hash->MarkUsed(block);
 		cache->unused_blocks.Remove(block);
 		cache->unused_block_count--;
 	}
@@ -1914,10 +2224,20 @@ retry:
 		}
 		TB(Read(cache, block));
 
+		mark_block_unbusy_reading(cache, block);
+	} else if (*_allocated) {
+		// Clear the block before anyone can see it: once we have a reference,
+		// it could be acquired without the cache lock.
+		mark_block_busy_reading(cache, block);
+		mutex_unlock(&cache->lock);
+
+		memset(block->current_data, 0, cache->block_size);
+
+		mutex_lock(&cache->lock);
 		mark_block_unbusy_reading(cache, block);
 	}
 
-	block->ref_count++;
+	atomic_add(&block->ref_count, 1);
 	block->last_accessed = system_time() / 1000000L;
 
 	return block;
@@ -1956,7 +2276,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
-		if (cleared) {
+		if (cleared && !allocated) {
 			mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
@@ -2059,7 +2379,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		&& block->parent_data == NULL && wasUnchanged)
 		transaction->sub_num_blocks++;
 
-	if (cleared) {
+	if (cleared && !allocated) {
 		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
@@ -3339,7 +3659,7 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
-	cached_block* block = cache->hash->Clear(true);
+	cached_block* block = cache->hash->Clear();
 	while (block != NULL) {
 		cached_block* next = block->next;
 		cache->FreeBlock(block);
@@ -3480,10 +3800,10 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
+		if (block->unused && cache->hash->RemoveUnreferenced(block)) {
 			cache->unused_blocks.Remove(block);
 			cache->unused_block_count--;
-			cache->RemoveBlock(block);
+			cache->FreeBlock(block);
 		} else {
 			if (block->transaction != NULL && block->parent_data != NULL
 				&& block->parent_data != block->current_data) {
@@ -3566,6 +3886,18 @@ const void*
 block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	if (blockNumber >= 0 && blockNumber < cache->max_blocks) {
+		// try to get a clean cached block without locking the cache first
+		cached_block* block = cache->hash->LookupAndAcquire(blockNumber);
+		if (block != NULL) {
+			TB(Get(cache, block));
+			return block->current_data;
+		}
+	}
+#endif
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
@@ -3626,6 +3958,15 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED && !BLOCK_CACHE_BLOCK_TRACING
+	// only the last reference needs the cache to be locked
+	if (blockNumber >= 0 && blockNumber < cache->max_blocks
+		&& cache->hash->ReleaseUnlessLast(blockNumber)) {
+		return;
+	}
+#endif
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
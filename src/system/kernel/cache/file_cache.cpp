@@ -6,6 +6,7 @@
 
 #include "vnode_store.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +43,13 @@
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
 
+// bounds of the read-ahead window for sequential reads
+#define MIN_READ_AHEAD_PAGES	16	// 64 kB
+#define MAX_READ_AHEAD_PAGES	512	// 2 MB
+
+// sequentially written data is scheduled for writing in clusters of this size
+#define WRITE_BEHIND_PAGES		256	// 1 MB
+
 struct file_cache_ref {
 	VMCache			*cache;
 	struct vnode	*vnode;
@@ -51,6 +59,18 @@ struct file_cache_ref {
 		//	write vs. read)
 	int32			last_access_index;
 	uint16			disabled_count;
+	uint8			advice;
+		// one of the POSIX_FADV_* constants
+
+	// sequential stream detection; protected by the cache lock
+	off_t			next_read;
+	off_t			read_ahead_end;
+	uint32			read_ahead_pages;
+		// size of the current read-ahead window, 0 when not reading ahead
+	off_t			next_write;
+	off_t			write_behind_start;
+		// start of the sequentially written data that has not been
+		// scheduled for writing yet
 
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
@@ -105,9 +125,16 @@ static void add_to_iovec(generic_io_vec* vecs, uint32 &index, uint32 max,
 	generic_addr_t address, generic_size_t size);
 
 
+struct mapped_page {
+	vm_page*		page;
+	addr_t			address;
+	void*			handle;
+};
+
 static struct cache_module_info* sCacheModule;
 
 
+static const int32 kMaxMapPagesTries = 3;
 static const uint32 kZeroVecCount = 32;
 static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
 static phys_addr_t sZeroPage;	// physical address
@@ -282,6 +309,170 @@ push_access(file_cache_ref* ref, off_t offset, generic_size_t bytes,
 }
 
 
+/*!	Reads those pages of the given range that are not in the cache yet
+	asynchronously. \a offset and \a size must be page aligned, and the
+	pages for the range must have been reserved in \a reservation.
+	The cache must be locked when calling this function; it is unlocked
+	while starting the I/O, though.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t size,
+	vm_page_reservation* reservation)
+{
+	VMCache* cache = ref->cache;
+
+	size_t bytesToRead = 0;
+	off_t lastOffset = offset;
+
+	while (true) {
+		// check if this page is already in memory
+		if (size > 0) {
+			vm_page* page = cache->LookupPage(offset);
+
+			offset += B_PAGE_SIZE;
+			size -= B_PAGE_SIZE;
+
+			if (page == NULL) {
+				bytesToRead += B_PAGE_SIZE;
+				continue;
+			}
+		}
+		if (bytesToRead != 0) {
+			// read the part before the current page (or the end of the request)
+			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
+				bytesToRead);
+			if (io == NULL || io->Prepare(reservation) != B_OK) {
+				delete io;
+				break;
+			}
+
+			// we must not have the cache locked during I/O
+			cache->Unlock();
+			io->ReadAsync();
+			cache->Lock();
+
+			bytesToRead = 0;
+		}
+
+		if (size == 0) {
+			// we have reached the end of the request
+			break;
+		}
+
+		lastOffset = offset;
+	}
+}
+
+
+/*!	Called after a successful read from the file. If the file is read
+	sequentially, the data following the read is read ahead asynchronously.
+	The read-ahead window starts small, and doubles every time it is moved
+	on, so that the I/O size adapts to the length of the stream. Any other
+	access resets it.
+*/
+static void
+read_ahead_if_sequential(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	AutoLocker<VMCache> locker(cache);
+
+	off_t end = offset + size;
+	bool sequential = offset == ref->next_read
+		|| ref->advice == POSIX_FADV_SEQUENTIAL;
+	ref->next_read = end;
+
+	if (!sequential || ref->advice == POSIX_FADV_RANDOM) {
+		ref->read_ahead_pages = 0;
+		ref->read_ahead_end = 0;
+		return;
+	}
+
+	// only move the window on when less than half of it is left
+	off_t start = max_c(ref->read_ahead_end, (off_t)PAGE_ALIGN(end));
+	off_t windowSize = (off_t)ref->read_ahead_pages * B_PAGE_SIZE;
+	if ((ref->read_ahead_pages != 0 && start - end > windowSize / 2)
+		|| start >= cache->virtual_end) {
+		return;
+	}
+
+	uint32 pages;
+	if (ref->read_ahead_pages == 0) {
+		pages = ref->advice == POSIX_FADV_SEQUENTIAL
+			? MAX_READ_AHEAD_PAGES : MIN_READ_AHEAD_PAGES;
+	} else
+		pages = min_c(2 * ref->read_ahead_pages, MAX_READ_AHEAD_PAGES);
+
+	off_t readEnd = min_c(start + (off_t)pages * B_PAGE_SIZE,
+		(off_t)PAGE_ALIGN(cache->virtual_end));
+	size_t readSize = readEnd - start;
+
+	// reading ahead is not worth waiting for memory
+	vm_page_reservation reservation;
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES) != B_NO_LOW_RESOURCE
+		|| !vm_page_try_reserve_pages(&reservation, readSize / B_PAGE_SIZE,
+			VM_PRIORITY_USER)) {
+		return;
+	}
+
+	ref->read_ahead_pages = pages;
+	ref->read_ahead_end = readEnd;
+
+	read_ahead(ref, start, readSize, &reservation);
+
+	locker.Unlock();
+	vm_page_unreserve_pages(&reservation);
+}
+
+
+/*!	Called after a successful write to the file. Once enough sequentially
+	written data has accumulated, it is scheduled for writing as one large
+	contiguous cluster, instead of leaving it to the page writer to pick up
+	the pages eventually.
+*/
+static void
+write_behind_if_sequential(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	AutoLocker<VMCache> locker(cache);
+
+	if (offset != ref->next_write || ref->advice == POSIX_FADV_RANDOM)
+		ref->write_behind_start = offset;
+	ref->next_write = offset + size;
+
+	// only completely written pages are included
+	uint32 firstPage = PAGE_ALIGN(ref->write_behind_start) >> PAGE_SHIFT;
+	uint32 endPage = ref->next_write >> PAGE_SHIFT;
+	if (endPage < firstPage + WRITE_BEHIND_PAGES)
+		return;
+
+	vm_page_schedule_write_page_range(cache, firstPage, endPage);
+	ref->write_behind_start = (off_t)endPage << PAGE_SHIFT;
+}
+
+
+/*!	Frees the cached pages in the given range that are neither modified,
+	mapped, nor busy.
+	The cache must be locked.
+*/
+static void
+free_clean_pages(VMCache* cache, uint32 firstPage, uint32 endPage)
+{
+	for (VMCachePagesTree::Iterator it
+				= cache->pages.GetIterator(firstPage, true, true);
+			vm_page* page = it.Next();) {
+		if (page->cache_offset >= endPage)
+			break;
+
+		if (page->State() == PAGE_STATE_CACHED && !page->busy
+			&& !page->modified && !page->IsMapped()) {
+			DEBUG_PAGE_ACCESS_START(page);
+			cache->RemovePage(page);
+			vm_page_set_state(page, PAGE_STATE_FREE);
+		}
+	}
+}
+
+
 static void
 reserve_pages(file_cache_ref* ref, vm_page_reservation* reservation,
 	size_t reservePages, bool isWrite)
@@ -936,6 +1127,31 @@ file_cache_control(const char* subsystem, uint32 function, void* buffer,
 }
 
 
+/*!	Reverts what file_cache_map_pages() did to the \a page, and releases the
+	reference to its cache.
+*/
+static void
+unwire_page(vm_page* page)
+{
+	VMCache* cache = page->Cache();
+	cache->Lock();
+
+	page->DecrementWiredCount();
+	if (!page->IsMapped()) {
+		atomic_add(&gMappedPagesCount, -1);
+
+		if (!page->busy && page->State() == PAGE_STATE_ACTIVE) {
+			DEBUG_PAGE_ACCESS_START(page);
+			vm_page_set_state(page, page->modified
+				? PAGE_STATE_MODIFIED : PAGE_STATE_CACHED);
+			DEBUG_PAGE_ACCESS_END(page);
+		}
+	}
+
+	cache->ReleaseRefAndUnlock();
+}
+
+
 //	#pragma mark - private kernel API
 
 
@@ -969,71 +1185,259 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 		return;
 	}
 
-	size_t bytesToRead = 0;
-	off_t lastOffset = offset;
-
 	vm_page_reservation reservation;
 	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
 
 	cache->Lock();
+	read_ahead(ref, offset, size, &reservation);
+	cache->ReleaseRefAndUnlock();
+	vm_page_unreserve_pages(&reservation);
+}
 
-	while (true) {
-		// check if this page is already in memory
-		if (size > 0) {
-			vm_page* page = cache->LookupPage(offset);
 
-			offset += B_PAGE_SIZE;
-			size -= B_PAGE_SIZE;
+extern "C" void
+cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+{
+	// ToDo: schedule prefetch
+
+	TRACE(("cache_prefetch(vnode %ld:%Ld)\n", mountID, vnodeID));
 
+	// get the vnode for the object, this also grabs a ref to it
+	struct vnode* vnode;
+	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
+		return;
+
+	cache_prefetch_vnode(vnode, offset, size);
+	vfs_put_vnode(vnode);
+}
+
+
+/*!	Maps the pages of the given file range into the kernel address space,
+	after they have been read into the file cache, if necessary. The pages
+	are wired until file_cache_unmap_page() has been called for each of the
+	returned mappings.
+	This allows to pass the contents of the file cache on without copying
+	them, for example to the network stack.
+
+	\a _count must be set to the number of entries in \a mappings, and is set
+	to the number of mappings returned on exit. It's not an error if less
+	than the requested range has been mapped.
+	Returns \c B_NOT_SUPPORTED if the file is not accessed via a file cache,
+	and \c B_BUSY if no page could be mapped, because the pages have been
+	stolen again every time after they have been read in. That is, no mappings
+	are only returned at the end of the file.
+*/
+extern "C" status_t
+file_cache_map_pages(struct vnode* vnode, void* cookie, off_t offset,
+	size_t size, file_cache_mapping* mappings, uint32* _count)
+{
+	uint32 maxCount = *_count;
+	*_count = 0;
+
+	VMCache* cache;
+	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
+		return B_NOT_SUPPORTED;
+
+	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	if (ref == NULL || ref->disabled_count > 0) {
+		cache->ReleaseRef();
+		return B_NOT_SUPPORTED;
+	}
+
+	off_t fileSize = cache->virtual_end;
+	if (offset < 0 || offset >= fileSize || maxCount == 0) {
+		cache->ReleaseRef();
+		return offset < 0 ? B_BAD_VALUE : B_OK;
+	}
+
+	if ((off_t)(offset + size) > fileSize)
+		size = fileSize - offset;
+	size = min_c(size, maxCount * B_PAGE_SIZE - (offset % B_PAGE_SIZE));
+
+	// read in what is missing -- no copying is done without a buffer -- and
+	// wire the pages, so that they cannot go away. If the first page has
+	// already been stolen again before we could wire it, try again.
+
+	status_t status;
+	uint32 count = 0;
+	for (int32 tries = 0; count == 0; tries++) {
+		if (tries == kMaxMapPagesTries) {
+			cache->ReleaseRef();
+			return B_BUSY;
+		}
+
+		size_t bytesRead = size;
+		status = cache_io(ref, cookie, offset, 0, &bytesRead, false);
+		if (status != B_OK) {
+			cache->ReleaseRef();
+			return status;
+		}
+
+		AutoLocker<VMCache> locker(cache);
+
+		while (size > 0 && count < maxCount) {
+			uint32 pageOffset = offset % B_PAGE_SIZE;
+			vm_page* page = cache->LookupPage(offset - pageOffset);
 			if (page == NULL) {
-				bytesToRead += B_PAGE_SIZE;
+				// the page has been stolen already, leave it to the next call
+				break;
+			}
+			if (page->busy) {
+				cache->WaitForPageEvents(page, PAGE_EVENT_NOT_BUSY, true);
 				continue;
 			}
+
+			DEBUG_PAGE_ACCESS_START(page);
+
+			if (!page->IsMapped())
+				atomic_add(&gMappedPagesCount, 1);
+			page->IncrementWiredCount();
+
+			// cached pages must not be mapped
+			if (page->State() == PAGE_STATE_CACHED)
+				vm_page_set_state(page, PAGE_STATE_ACTIVE);
+
+			DEBUG_PAGE_ACCESS_END(page);
+
+			cache->AcquireRefLocked();
+
+			size_t length = min_c(size, B_PAGE_SIZE - pageOffset);
+			mappings[count].address = (void*)(addr_t)pageOffset;
+			mappings[count].length = length;
+			mappings[count].cookie = page;
+			count++;
+
+			offset += length;
+			size -= length;
 		}
-		if (bytesToRead != 0) {
-			// read the part before the current page (or the end of the request)
-			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
-				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
-				delete io;
-				break;
-			}
+	}
 
-			// we must not have the cache locked during I/O
-			cache->Unlock();
-			io->ReadAsync();
-			cache->Lock();
+	cache->ReleaseRef();
 
-			bytesToRead = 0;
+	// map them
+
+	for (uint32 i = 0; i < count; i++) {
+		vm_page* page = (vm_page*)mappings[i].cookie;
+
+		addr_t address;
+		void* handle;
+		status = vm_get_physical_page(
+			(phys_addr_t)page->physical_page_number * B_PAGE_SIZE, &address,
+			&handle);
+		if (status == B_OK) {
+			mapped_page* mapped = new(std::nothrow) mapped_page;
+			if (mapped != NULL) {
+				mapped->page = page;
+				mapped->address = address;
+				mapped->handle = handle;
+
+				mappings[i].address = (uint8*)address
+					+ (addr_t)mappings[i].address;
+				mappings[i].cookie = mapped;
+				continue;
+			}
+
+			vm_put_physical_page(address, handle);
 		}
 
-		if (size == 0) {
-			// we have reached the end of the request
-			break;
+		// unwire the rest of the pages
+		for (uint32 j = i; j < count; j++)
+			unwire_page((vm_page*)mappings[j].cookie);
+
+		count = i;
+		break;
+	}
+
+	*_count = count;
+	return count > 0 ? B_OK : status;
+}
+
+
+/*!	Applies the posix_fadvise() \a advice to the file \a cache belongs to.
+	The access pattern advices apply to the whole file, the others only to
+	the given range; a \a length of 0 means up to the end of the file.
+	Caches that are not file caches are ignored, as the advice is only a
+	hint.
+*/
+extern "C" status_t
+file_cache_advise(VMCache* cache, off_t offset, off_t length, int advice)
+{
+	if (cache->type != CACHE_TYPE_VNODE)
+		return B_OK;
+
+	file_cache_ref* ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	if (ref == NULL)
+		return B_OK;
+
+	AutoLocker<VMCache> locker(cache);
+
+	off_t fileSize = cache->virtual_end;
+	if (offset >= fileSize)
+		length = 0;
+	else if (length == 0 || length > fileSize - offset)
+		length = fileSize - offset;
+
+	uint32 firstPage = offset >> PAGE_SHIFT;
+	uint32 endPage = PAGE_ALIGN(offset + length) >> PAGE_SHIFT;
+
+	switch (advice) {
+		case POSIX_FADV_NORMAL:
+		case POSIX_FADV_SEQUENTIAL:
+		case POSIX_FADV_RANDOM:
+			ref->advice = advice;
+			ref->read_ahead_pages = 0;
+			return B_OK;
+
+		case POSIX_FADV_WILLNEED:
+		{
+			// don't let a single call take more than half of the free memory
+			uint32 pages = min_c(endPage - firstPage,
+				vm_page_num_unused_pages() / 2);
+			if (pages == 0)
+				return B_OK;
+
+			locker.Unlock();
+
+			vm_page_reservation reservation;
+			vm_page_reserve_pages(&reservation, pages, VM_PRIORITY_USER);
+
+			locker.Lock();
+			read_ahead(ref, (off_t)firstPage << PAGE_SHIFT,
+				(size_t)pages << PAGE_SHIFT, &reservation);
+			locker.Unlock();
+
+			vm_page_unreserve_pages(&reservation);
+			return B_OK;
 		}
 
-		lastOffset = offset;
+		case POSIX_FADV_DONTNEED:
+			// start writing back the modified pages, and get rid of the
+			// others
+			if (endPage > firstPage) {
+				vm_page_schedule_write_page_range(cache, firstPage, endPage);
+				free_clean_pages(cache, firstPage, endPage);
+			}
+			return B_OK;
+
+		case POSIX_FADV_NOREUSE:
+			return B_OK;
 	}
 
-	cache->ReleaseRefAndUnlock();
-	vm_page_unreserve_pages(&reservation);
+	return B_BAD_VALUE;
 }
 
 
+/*!	Releases a mapping returned by file_cache_map_pages().
+*/
 extern "C" void
-cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+file_cache_unmap_page(void* cookie)
 {
-	// ToDo: schedule prefetch
+	mapped_page* mapped = (mapped_page*)cookie;
 
-	TRACE(("cache_prefetch(vnode %ld:%Ld)\n", mountID, vnodeID));
+	vm_put_physical_page(mapped->address, mapped->handle);
+	unwire_page(mapped->page);
 
-	// get the vnode for the object, this also grabs a ref to it
-	struct vnode* vnode;
-	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
-		return;
-
-	cache_prefetch_vnode(vnode, offset, size);
-	vfs_put_vnode(vnode);
+	delete mapped;
 }
 
 
@@ -1133,6 +1537,12 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	ref->advice = POSIX_FADV_NORMAL;
+	ref->next_read = 0;
+	ref->read_ahead_end = 0;
+	ref->read_ahead_pages = 0;
+	ref->next_write = 0;
+	ref->write_behind_start = 0;
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1299,7 +1709,12 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+	if (status == B_OK && *_size > 0)
+		read_ahead_if_sequential(ref, offset, *_size);
+
+	return status;
 }
 
 
@@ -1345,6 +1760,8 @@ file_cache_write(void* _cacheRef, void* cookie, off_t offset,
 
 	status_t status = cache_io(ref, cookie, offset,
 		(addr_t)const_cast<void*>(buffer), _size, true);
+	if (status == B_OK && *_size > 0)
+		write_behind_if_sequential(ref, offset, *_size);
 
 	TRACE(("file_cache_write(ref = %p, offset = %Ld, buffer = %p, size = %lu)"
 		" = %ld\n", ref, offset, buffer, *_size, status));
@@ -145,6 +145,8 @@ cpu_preboot_init_percpu(kernel_args *args, int curr_cpu)
 	// we can use it for get_current_cpu
 	memset(&gCPU[curr_cpu], 0, sizeof(gCPU[curr_cpu]));
 	gCPU[curr_cpu].cpu_num = curr_cpu;
+	if (args->num_memory_nodes > 1)
+		gCPU[curr_cpu].memory_node = args->cpu_memory_node[curr_cpu];
 
 	list_init(&gCPU[curr_cpu].irqs);
 	B_INITIALIZE_SPINLOCK(&gCPU[curr_cpu].irqs_lock);
@@ -13,6 +13,7 @@
 #include <debug.h>
 #include <heap.h>
 #include <kernel.h>
+#include <smp.h>
 #include <team.h>
 #include <thread.h>
 #include <util/AutoLock.h>
@@ -697,6 +698,7 @@ IOOperation::Dump() const
 
 IORequest::IORequest()
 	:
+	fScheduledTime(0),
 	fIsNotified(false),
 	fFinishedCallback(NULL),
 	fFinishedCookie(NULL),
@@ -762,6 +764,7 @@ IORequest::Init(off_t offset, generic_size_t firstVecOffset,
 	Thread* thread = thread_get_current_thread();
 	fTeam = thread->team->id;
 	fThread = thread->id;
+	fIssuingCPU = smp_get_current_cpu();
 	fIsWrite = write;
 	fPartialTransfer = false;
 	fSuppressChildNotifications = false;
@@ -827,6 +830,7 @@ IORequest::CreateSubRequest(off_t parentOffset, off_t offset,
 	subRequest->fRelativeParentOffset = parentOffset - fOffset;
 	subRequest->fTeam = fTeam;
 	subRequest->fThread = fThread;
+	subRequest->fIssuingCPU = fIssuingCPU;
 
 	_subRequest = subRequest;
 	subRequest->SetParent(this);
@@ -1073,6 +1077,18 @@ IORequest::SetUnfinished()
 }
 
 
+/*!	Returns whether the request has been set unfinished, and none of its
+	operations or sub-requests are pending anymore, ie. whether nothing but
+	its scheduler will continue it.
+*/
+bool
+IORequest::IsUnfinished()
+{
+	MutexLocker _(fLock);
+	return fStatus == 1 && fPendingChildren == 0;
+}
+
+
 void
 IORequest::SetTransferredBytes(bool partialTransfer,
 	generic_size_t transferredBytes)
@@ -1406,6 +1422,7 @@ IORequest::Dump() const
 	kprintf("  flags:             %#" B_PRIx32 "\n", fFlags);
 	kprintf("  team:              %" B_PRId32 "\n", fTeam);
 	kprintf("  thread:            %" B_PRId32 "\n", fThread);
+	kprintf("  issuing CPU:       %" B_PRId32 "\n", fIssuingCPU);
 	kprintf("  r/w:               %s\n", fIsWrite ? "write" : "read");
 	kprintf("  partial transfer:  %s\n", fPartialTransfer ? "yes" : "no");
 	kprintf("  finished cvar:     %p\n", &fFinishedCondition);
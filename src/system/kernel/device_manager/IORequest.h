@@ -231,6 +231,11 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 									{ fOwner = owner; }
 			IORequestOwner*		Owner() const	{ return fOwner; }
 
+			void				SetScheduledTime(bigtime_t time)
+									{ fScheduledTime = time; }
+			bigtime_t			ScheduledTime() const
+									{ return fScheduledTime; }
+
 			status_t			CreateSubRequest(off_t parentOffset,
 									off_t offset, generic_size_t length,
 									IORequest*& subRequest);
@@ -261,6 +266,7 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 									status_t status, bool partialTransfer,
 									generic_size_t transferEndOffset);
 			void				SetUnfinished();
+			bool				IsUnfinished();
 
 			generic_size_t		RemainingBytes() const
 									{ return fRemainingBytes; }
@@ -279,6 +285,7 @@ struct IORequest : IORequestChunk, DoublyLinkedListLinkImpl<IORequest> {
 			bool				IsRead() const	{ return !fIsWrite; }
 			team_id				TeamID() const		{ return fTeam; }
 			thread_id			ThreadID() const	{ return fThread; }
+			int32				IssuingCPU() const	{ return fIssuingCPU; }
 			uint32				Flags() const	{ return fFlags; }
 
 			IOBuffer*			Buffer() const	{ return fBuffer; }
@@ -327,6 +334,9 @@ private:
 
 			mutex				fLock;
 			IORequestOwner*		fOwner;
+			bigtime_t			fScheduledTime;
+									// when the request has been passed to
+									// the I/O scheduler
 			IOBuffer*			fBuffer;
 			off_t				fOffset;
 			generic_size_t		fLength;
@@ -343,6 +353,8 @@ private:
 			uint32				fFlags;
 			team_id				fTeam;
 			thread_id			fThread;
+			int32				fIssuingCPU;
+									// the CPU the request was created on
 			bool				fIsWrite;
 			bool				fPartialTransfer;
 			bool				fSuppressChildNotifications;
@@ -72,3 +72,11 @@ void
 IOScheduler::MediaChanged()
 {
 }
+
+
+void
+IOScheduler::DumpLatencies() const
+{
+	kprintf("I/O scheduler %" B_PRId32 " \"%s\" at %p does not keep latency "
+		"statistics\n", fID, fName, this);
+}
@@ -60,6 +60,7 @@ public:
 									// for some reason
 
 	virtual	void				Dump() const = 0;
+	virtual	void				DumpLatencies() const;
 
 protected:
 			DMAResource*		fDMAResource;
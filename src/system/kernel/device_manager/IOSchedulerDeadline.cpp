@@ -0,0 +1,947 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	An I/O scheduler that keeps the read latency low under mixed workloads.
+
+	Requests are sorted into one of three priority classes depending on the
+	I/O priority of their thread (or the hint of their team). Every class has
+	a queue for reads, and one for writes, both sorted by offset. The
+	scheduler always serves the highest priority class that has requests,
+	and prefers reads over writes, as these usually have someone waiting for
+	them. Writes are collected into larger batches instead, and are served
+	after a number of read batches at the latest.
+	To avoid starvation, every request gets a deadline depending on its class
+	and direction. As soon as the oldest request of a queue has passed its
+	deadline, that queue is served next.
+	Within a batch, requests are passed to the driver in the order of their
+	offsets, continuing where the last batch stopped. A batch may exceed its
+	size as long as the following requests are adjacent to the previous
+	ones, so that a sequential stream is not split up.
+*/
+
+
+#include "IOSchedulerDeadline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lock.h>
+#include <thread_types.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+
+#include "IOSchedulerRoster.h"
+
+
+//#define TRACE_IO_SCHEDULER
+#ifdef TRACE_IO_SCHEDULER
+#	define TRACE(x...) dprintf(x)
+#else
+#	define TRACE(x...) ;
+#endif
+
+
+enum {
+	READ_QUEUE	= 0,
+	WRITE_QUEUE	= 1
+};
+
+static const bigtime_t kReadDeadlines[] = { 10000, 50000, 500000 };
+static const bigtime_t kWriteDeadlines[] = { 250000, 1000000, 5000000 };
+	// per priority class
+
+static const int32 kMaxStarvedWrites = 2;
+	// number of read batches before a pending write batch has to be served
+
+static const char* const kPriorityClassNames[] = { "high", "normal", "low" };
+
+
+//	#pragma mark - LatencyHistogram
+
+
+void
+IOSchedulerDeadline::LatencyHistogram::Add(bigtime_t latency)
+{
+	// the first bucket counts everything below 64 us, every following one
+	// twice as much as the previous one
+	int32 bucket = 0;
+	for (bigtime_t limit = 64; latency >= limit
+			&& bucket < LATENCY_BUCKET_COUNT - 1; limit *= 2) {
+		bucket++;
+	}
+
+	counts[bucket]++;
+	count++;
+	total += latency;
+	if (latency > max)
+		max = latency;
+}
+
+
+void
+IOSchedulerDeadline::LatencyHistogram::Dump(const char* name) const
+{
+	if (count == 0)
+		return;
+
+	kprintf("  %s: %" B_PRId64 " requests, average %" B_PRId64 " us, "
+		"max %" B_PRId64 " us\n", name, count, total / count, max);
+
+	bigtime_t limit = 64;
+	for (int32 i = 0; i < LATENCY_BUCKET_COUNT; i++, limit *= 2) {
+		if (counts[i] == 0)
+			continue;
+
+		if (i < LATENCY_BUCKET_COUNT - 1)
+			kprintf("    < %10" B_PRId64 " us:", limit);
+		else
+			kprintf("    >=%10" B_PRId64 " us:", limit / 2);
+
+		kprintf(" %10" B_PRId64 " (%3" B_PRId64 "%%)\n", counts[i],
+			counts[i] * 100 / count);
+	}
+}
+
+
+//	#pragma mark - IOSchedulerDeadline
+
+
+IOSchedulerDeadline::IOSchedulerDeadline(DMAResource* resource)
+	:
+	IOScheduler(resource),
+	fSchedulerThread(-1),
+	fRequestNotifierThread(-1),
+	fBlockSize(0),
+	fPendingOperations(0),
+	fStarvedWrites(0),
+	fLastOffset(0),
+	fTerminating(false)
+{
+	mutex_init(&fLock, "I/O deadline scheduler");
+	B_INITIALIZE_SPINLOCK(&fFinisherLock);
+
+	fNewRequestCondition.Init(this, "I/O new request");
+	fFinishedOperationCondition.Init(this, "I/O finished operation");
+	fFinishedRequestCondition.Init(this, "I/O finished request");
+
+	for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+		for (int32 j = 0; j < 2; j++) {
+			IORequestOwner& queue = fQueues[i][j];
+			queue.team = -1;
+			queue.thread = -1;
+			queue.priority = i;
+			queue.hash_link = NULL;
+		}
+	}
+
+	memset(fLatencies, 0, sizeof(fLatencies));
+}
+
+
+IOSchedulerDeadline::~IOSchedulerDeadline()
+{
+	// shutdown threads
+	MutexLocker locker(fLock);
+	InterruptsSpinLocker finisherLocker(fFinisherLock);
+	fTerminating = true;
+
+	fNewRequestCondition.NotifyAll();
+	fFinishedOperationCondition.NotifyAll();
+	fFinishedRequestCondition.NotifyAll();
+
+	finisherLocker.Unlock();
+	locker.Unlock();
+
+	if (fSchedulerThread >= 0)
+		wait_for_thread(fSchedulerThread, NULL);
+
+	if (fRequestNotifierThread >= 0)
+		wait_for_thread(fRequestNotifierThread, NULL);
+
+	// destroy our belongings
+	mutex_lock(&fLock);
+	mutex_destroy(&fLock);
+
+	while (IOOperation* operation = fUnusedOperations.RemoveHead())
+		delete operation;
+}
+
+
+status_t
+IOSchedulerDeadline::Init(const char* name)
+{
+	status_t error = IOScheduler::Init(name);
+	if (error != B_OK)
+		return error;
+
+	size_t count = fDMAResource != NULL ? fDMAResource->BufferCount() : 16;
+	for (size_t i = 0; i < count; i++) {
+		IOOperation* operation = new(std::nothrow) IOOperation;
+		if (operation == NULL)
+			return B_NO_MEMORY;
+
+		fUnusedOperations.Add(operation);
+	}
+
+	if (fDMAResource != NULL)
+		fBlockSize = fDMAResource->BlockSize();
+	if (fBlockSize == 0)
+		fBlockSize = 512;
+
+	// The batch sizes only determine how long one queue is served before the
+	// others get their turn; the latency is bounded by the deadlines, which
+	// don't depend on the speed of the device.
+	fReadBatchBandwidth = fBlockSize * 1024;
+	fWriteBatchBandwidth = fBlockSize * 4096;
+
+	// start threads
+	char buffer[B_OS_NAME_LENGTH];
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " scheduler ", sizeof(buffer));
+	size_t nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fSchedulerThread = spawn_kernel_thread(&_SchedulerThread, buffer,
+		B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fSchedulerThread < B_OK)
+		return fSchedulerThread;
+
+	strlcpy(buffer, name, sizeof(buffer));
+	strlcat(buffer, " notifier ", sizeof(buffer));
+	nameLength = strlen(buffer);
+	snprintf(buffer + nameLength, sizeof(buffer) - nameLength, "%" B_PRId32,
+		fID);
+	fRequestNotifierThread = spawn_kernel_thread(&_RequestNotifierThread,
+		buffer, B_NORMAL_PRIORITY + 2, (void *)this);
+	if (fRequestNotifierThread < B_OK)
+		return fRequestNotifierThread;
+
+	resume_thread(fSchedulerThread);
+	resume_thread(fRequestNotifierThread);
+
+	return B_OK;
+}
+
+
+status_t
+IOSchedulerDeadline::ScheduleRequest(IORequest* request)
+{
+	TRACE("%p->IOSchedulerDeadline::ScheduleRequest(%p)\n", this, request);
+
+	IOBuffer* buffer = request->Buffer();
+
+	if (buffer->IsVirtual()) {
+		status_t status = buffer->LockMemory(request->TeamID(),
+			request->IsWrite());
+		if (status != B_OK) {
+			request->SetStatusAndNotify(status);
+			return status;
+		}
+	}
+
+	// this also takes the I/O priority hint of the team into account
+	int32 priority = thread_get_io_priority(request->ThreadID());
+	if (priority < 0)
+		priority = B_NORMAL_PRIORITY;
+
+	MutexLocker locker(fLock);
+
+	IORequestOwner* queue = &fQueues[_PriorityClass(priority)]
+		[request->IsWrite() ? WRITE_QUEUE : READ_QUEUE];
+	request->SetOwner(queue);
+	request->SetScheduledTime(system_time());
+	_InsertRequest(queue, request);
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_SCHEDULED, this,
+		request);
+
+	fNewRequestCondition.NotifyAll();
+
+	return B_OK;
+}
+
+
+/*!	Removes \a request from its queue, and finishes it with \a status.
+	Operations of the request that have already been passed to the driver
+	cannot be taken back, though. If there are any, the request is only
+	prevented from being continued, and finishes as a partial transfer once
+	they are done. Without pending operations, a partially transferred
+	request is finished right away.
+	Must not be called with \c fLock held.
+*/
+void
+IOSchedulerDeadline::AbortRequest(IORequest* request, status_t status)
+{
+	MutexLocker locker(fLock);
+
+	IORequestOwner* queue = request->Owner();
+	if (queue == NULL || !queue->requests.Contains(request)) {
+		// either not scheduled by us, or completely passed to the driver
+		return;
+	}
+
+	if (request->RemainingBytes() < request->Length()) {
+		if (!request->IsUnfinished()) {
+			// _Finisher() will finish it with what has been transferred
+			queue->requests.Remove(request);
+			queue->completed_requests.Add(request);
+			return;
+		}
+
+		// all of its operations are done already
+		request->SetTransferredBytes(true, request->TransferredBytes());
+	}
+
+	queue->requests.Remove(request);
+	request->SetOwner(NULL);
+	locker.Unlock();
+
+	IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED, this,
+		request);
+	request->SetStatusAndNotify(status);
+}
+
+
+void
+IOSchedulerDeadline::OperationCompleted(IOOperation* operation,
+	status_t status, generic_size_t transferredBytes)
+{
+	InterruptsSpinLocker _(fFinisherLock);
+
+	// finish operation only once
+	if (operation->Status() <= 0)
+		return;
+
+	operation->SetStatus(status);
+
+	// set the bytes transferred (of the net data)
+	generic_size_t partialBegin
+		= operation->OriginalOffset() - operation->Offset();
+	operation->SetTransferredBytes(
+		transferredBytes > partialBegin ? transferredBytes - partialBegin : 0);
+
+	fCompletedOperations.Add(operation);
+	fFinishedOperationCondition.NotifyAll();
+}
+
+
+void
+IOSchedulerDeadline::Dump() const
+{
+	kprintf("IOSchedulerDeadline at %p\n", this);
+	kprintf("  DMA resource:   %p\n", fDMAResource);
+	kprintf("  last offset:    %" B_PRIdOFF "\n", fLastOffset);
+	kprintf("  starved writes: %" B_PRId32 "\n", fStarvedWrites);
+
+	for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+		kprintf("  %s priority queues: read %p, write %p\n",
+			kPriorityClassNames[i], &fQueues[i][READ_QUEUE],
+			&fQueues[i][WRITE_QUEUE]);
+	}
+}
+
+
+void
+IOSchedulerDeadline::DumpLatencies() const
+{
+	kprintf("I/O scheduler %" B_PRId32 " \"%s\" at %p, latencies:\n", fID,
+		fName, this);
+
+	for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "%s priority reads",
+			kPriorityClassNames[i]);
+		fLatencies[i][READ_QUEUE].Dump(name);
+
+		snprintf(name, sizeof(name), "%s priority writes",
+			kPriorityClassNames[i]);
+		fLatencies[i][WRITE_QUEUE].Dump(name);
+	}
+}
+
+
+/*!	Must not be called with the fLock held. */
+void
+IOSchedulerDeadline::_Finisher()
+{
+	while (true) {
+		InterruptsSpinLocker locker(fFinisherLock);
+		IOOperation* operation = fCompletedOperations.RemoveHead();
+		if (operation == NULL)
+			return;
+
+		locker.Unlock();
+
+		TRACE("IOSchedulerDeadline::_Finisher(): operation: %p\n", operation);
+
+		bool operationFinished = operation->Finish();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_FINISHED,
+			this, operation->Parent(), operation);
+			// Notify for every time the operation is passed to the I/O hook,
+			// not only when it is fully finished.
+
+		if (!operationFinished) {
+			TRACE("  operation: %p not finished yet\n", operation);
+			MutexLocker _(fLock);
+			operation->SetTransferredBytes(0);
+			operation->Parent()->Owner()->operations.Add(operation);
+			fPendingOperations--;
+			continue;
+		}
+
+		// notify request and remove operation
+		IORequest* request = operation->Parent();
+
+		generic_size_t operationOffset
+			= operation->OriginalOffset() - request->Offset();
+		request->OperationFinished(operation, operation->Status(),
+			operation->TransferredBytes() < operation->OriginalLength(),
+			operation->Status() == B_OK
+				? operationOffset + operation->OriginalLength()
+				: operationOffset);
+
+		// recycle the operation
+		MutexLocker _(fLock);
+		if (fDMAResource != NULL)
+			fDMAResource->RecycleBuffer(operation->Buffer());
+
+		fPendingOperations--;
+		fUnusedOperations.Add(operation);
+
+		// If the request is done, we need to perform its notifications.
+		if (!request->IsFinished())
+			continue;
+
+		bool completed
+			= request->Owner()->completed_requests.Contains(request);
+		if (request->Status() == B_OK && request->RemainingBytes() > 0) {
+			if (!completed) {
+				// The request has been processed OK so far, but it isn't
+				// really finished yet.
+				request->SetUnfinished();
+				continue;
+			}
+
+			// The rest of the request could not be prepared, see
+			// _PrepareBatch().
+			request->SetTransferredBytes(true, request->TransferredBytes());
+		}
+
+		_RemoveRequest(request);
+
+		if (request->HasCallbacks()) {
+			// The request has callbacks that may take some time to perform,
+			// so we hand it over to the request notifier.
+			fFinishedRequests.Add(request);
+			fFinishedRequestCondition.NotifyAll();
+		} else {
+			// No callbacks -- finish the request right now.
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+				this, request);
+			request->NotifyFinished();
+		}
+	}
+}
+
+
+/*!	Called with \c fFinisherLock held.
+*/
+bool
+IOSchedulerDeadline::_FinisherWorkPending()
+{
+	return !fCompletedOperations.IsEmpty();
+}
+
+
+/*!	Returns the queue the next batch should be taken from, or \c NULL if
+	there are no requests. \a _expired is set when the queue has been chosen
+	because one of its requests has passed its deadline.
+	Called with \c fLock held.
+*/
+IORequestOwner*
+IOSchedulerDeadline::_NextQueue(bool& _expired)
+{
+	_expired = false;
+
+	// Operations that have to be passed to the driver again belong to
+	// requests that are in progress already, they come first.
+	for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+		for (int32 j = 0; j < 2; j++) {
+			if (!fQueues[i][j].operations.IsEmpty())
+				return &fQueues[i][j];
+		}
+	}
+
+	// Then any queue whose oldest request has passed its deadline, reads
+	// before writes.
+	bigtime_t now = system_time();
+	for (int32 j = 0; j < 2; j++) {
+		const bigtime_t* deadlines
+			= j == READ_QUEUE ? kReadDeadlines : kWriteDeadlines;
+		for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+			IORequest* oldest = _OldestRequest(&fQueues[i][j]);
+			if (oldest != NULL
+				&& oldest->ScheduledTime() + deadlines[i] <= now) {
+				if (j == WRITE_QUEUE)
+					fStarvedWrites = 0;
+				_expired = true;
+				return &fQueues[i][j];
+			}
+		}
+	}
+
+	// Otherwise the highest priority class with requests is served. Reads
+	// are preferred, but only as long as the writes of the class have not
+	// been passed over too often.
+	for (int32 i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+		IORequestOwner* reads = &fQueues[i][READ_QUEUE];
+		IORequestOwner* writes = &fQueues[i][WRITE_QUEUE];
+
+		if (!reads->requests.IsEmpty()
+			&& (writes->requests.IsEmpty()
+				|| fStarvedWrites < kMaxStarvedWrites)) {
+			if (!writes->requests.IsEmpty())
+				fStarvedWrites++;
+			return reads;
+		}
+
+		if (!writes->requests.IsEmpty()) {
+			fStarvedWrites = 0;
+			return writes;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*!	Waits until there is a queue to take the next batch from, and returns
+	it. Returns \c NULL only when the scheduler is being terminated.
+	Called with \c fLock held, which is temporarily released while waiting.
+*/
+IORequestOwner*
+IOSchedulerDeadline::_WaitForQueue(bool& _expired)
+{
+	while (true) {
+		if (fTerminating)
+			return NULL;
+
+		IORequestOwner* queue = _NextQueue(_expired);
+		if (queue != NULL)
+			return queue;
+
+		// Wait for new requests. First check whether any finisher work has
+		// to be done.
+		InterruptsSpinLocker finisherLocker(fFinisherLock);
+		if (_FinisherWorkPending()) {
+			finisherLocker.Unlock();
+			mutex_unlock(&fLock);
+			_Finisher();
+			mutex_lock(&fLock);
+			continue;
+		}
+
+		ConditionVariableEntry entry;
+		fNewRequestCondition.Add(&entry);
+
+		finisherLocker.Unlock();
+		mutex_unlock(&fLock);
+
+		entry.Wait(B_CAN_INTERRUPT);
+		_Finisher();
+		mutex_lock(&fLock);
+	}
+}
+
+
+/*!	The queues are sorted by offset, so the oldest request has to be looked
+	up. They rarely contain more than a few dozen requests, though.
+*/
+IORequest*
+IOSchedulerDeadline::_OldestRequest(IORequestOwner* queue) const
+{
+	IORequest* oldest = NULL;
+	for (IORequestList::Iterator it = queue->requests.GetIterator();
+			IORequest* request = it.Next();) {
+		if (oldest == NULL
+			|| request->ScheduledTime() < oldest->ScheduledTime()) {
+			oldest = request;
+		}
+	}
+
+	return oldest;
+}
+
+
+/*!	Returns the request of \a queue the next batch starts with: a request
+	that has only partially been passed to the driver yet, the oldest one if
+	the deadline of the queue has \a expired, or else the first one after
+	where the last batch stopped.
+*/
+IORequest*
+IOSchedulerDeadline::_FirstBatchRequest(IORequestOwner* queue,
+	bool expired) const
+{
+	IORequest* first = NULL;
+	for (IORequestList::Iterator it = queue->requests.GetIterator();
+			IORequest* request = it.Next();) {
+		if (request->RemainingBytes() < request->Length())
+			return request;
+		if (first == NULL && request->Offset() >= fLastOffset)
+			first = request;
+	}
+
+	if (expired)
+		return _OldestRequest(queue);
+
+	return first != NULL ? first : queue->requests.Head();
+}
+
+
+void
+IOSchedulerDeadline::_InsertRequest(IORequestOwner* queue,
+	IORequest* request)
+{
+	// Sequential requests usually come in ascending order, so we start
+	// looking at the end.
+	IORequest* before = queue->requests.Tail();
+	while (before != NULL && before->Offset() > request->Offset())
+		before = queue->requests.GetPrevious(before);
+
+	queue->requests.InsertBefore(
+		before != NULL ? queue->requests.GetNext(before)
+			: queue->requests.Head(),
+		request);
+}
+
+
+/*!	Prepares the operations for the next batch of requests from \a queue.
+	Returns \c false if the DMA resource ran out of buffers before anything
+	could be prepared.
+	If a request could not be prepared at all, it is removed from the queue
+	and returned in \a _abortedRequest; the caller has to notify it with
+	\a _abortStatus after having released \c fLock.
+	Called with \c fLock held.
+*/
+bool
+IOSchedulerDeadline::_PrepareBatch(IORequestOwner* queue, bool expired,
+	IOOperationList& operations, int32& operationCount,
+	IORequest*& _abortedRequest, status_t& _abortStatus)
+{
+	_abortedRequest = NULL;
+
+	off_t batchSize = queue == &fQueues[queue->priority][WRITE_QUEUE]
+		? fWriteBatchBandwidth : fReadBatchBandwidth;
+	off_t used = 0;
+
+	// There might still be unfinished operations.
+	while (IOOperation* operation = queue->operations.RemoveHead()) {
+		operations.Add(operation);
+		operationCount++;
+		used += operation->Length();
+	}
+
+	IORequest* request = _FirstBatchRequest(queue, expired);
+	IORequest* previous = NULL;
+
+	while (request != NULL) {
+		off_t quantum = batchSize - used;
+		if (quantum < (off_t)fBlockSize) {
+			// The batch is full, but adjacent requests are still added, up to
+			// twice its size.
+			if (previous == NULL
+				|| previous->Offset() + (off_t)previous->Length()
+					!= request->Offset()) {
+				break;
+			}
+
+			quantum = 2 * batchSize - used;
+			if (quantum < (off_t)fBlockSize)
+				break;
+		}
+
+		off_t bandwidth = 0;
+		status_t status = B_OK;
+		bool resourcesAvailable = _PrepareRequestOperations(request,
+			operations, operationCount, quantum, bandwidth, status);
+		used += bandwidth;
+
+		IORequest* next = queue->requests.GetNext(request);
+
+		if (status != B_OK) {
+			// Check whether there are operations of the request left that
+			// are to be passed to the driver.
+			bool inProgress = false;
+			for (IOOperationList::Iterator it = operations.GetIterator();
+					IOOperation* operation = it.Next();) {
+				if (operation->Parent() == request) {
+					inProgress = true;
+					break;
+				}
+			}
+
+			queue->requests.Remove(request);
+
+			if (inProgress) {
+				// the request will be finished with what could be prepared
+				queue->completed_requests.Add(request);
+			} else {
+				request->SetOwner(NULL);
+				_abortedRequest = request;
+				_abortStatus = status;
+			}
+			break;
+		}
+
+		if (request->RemainingBytes() == 0) {
+			// If the request has been completed, move it to the completed
+			// list, so we don't pick it up again.
+			queue->requests.Remove(request);
+			queue->completed_requests.Add(request);
+		}
+
+		if (!resourcesAvailable || request->RemainingBytes() > 0)
+			break;
+
+		previous = request;
+		request = next;
+	}
+
+	if (IOOperation* last = operations.Tail())
+		fLastOffset = last->Offset() + last->Length();
+
+	return !operations.IsEmpty() || _abortedRequest != NULL;
+}
+
+
+bool
+IOSchedulerDeadline::_PrepareRequestOperations(IORequest* request,
+	IOOperationList& operations, int32& operationsPrepared, off_t quantum,
+	off_t& usedBandwidth, status_t& _status)
+{
+	usedBandwidth = 0;
+
+	if (fDMAResource != NULL) {
+		while (quantum >= (off_t)fBlockSize && request->RemainingBytes() > 0) {
+			IOOperation* operation = fUnusedOperations.RemoveHead();
+			if (operation == NULL)
+				return false;
+
+			status_t status = fDMAResource->TranslateNext(request, operation,
+				quantum);
+			if (status != B_OK) {
+				operation->SetParent(NULL);
+				fUnusedOperations.Add(operation);
+
+				// B_BUSY means some resource (DMABuffers or
+				// DMABounceBuffers) was temporarily unavailable. That's OK,
+				// we'll retry later.
+				if (status == B_BUSY)
+					return false;
+
+				_status = status;
+				return true;
+			}
+
+			off_t bandwidth = operation->Length();
+			quantum -= bandwidth;
+			usedBandwidth += bandwidth;
+
+			operations.Add(operation);
+			operationsPrepared++;
+		}
+	} else {
+		// Without a DMA resource, the driver has no restrictions, and takes
+		// the request as a whole.
+		IOOperation* operation = fUnusedOperations.RemoveHead();
+		if (operation == NULL)
+			return false;
+
+		status_t status = operation->Prepare(request);
+		if (status != B_OK) {
+			operation->SetParent(NULL);
+			fUnusedOperations.Add(operation);
+			_status = status;
+			return true;
+		}
+
+		operation->SetOriginalRange(request->Offset(), request->Length());
+		request->Advance(request->Length());
+
+		off_t bandwidth = operation->Length();
+		quantum -= bandwidth;
+		usedBandwidth += bandwidth;
+
+		operations.Add(operation);
+		operationsPrepared++;
+	}
+
+	return true;
+}
+
+
+/*!	Removes the finished \a request from its queue, and adds its latency to
+	the statistics.
+	Called with \c fLock held.
+*/
+void
+IOSchedulerDeadline::_RemoveRequest(IORequest* request)
+{
+	IORequestOwner* queue = request->Owner();
+	if (queue->completed_requests.Contains(request))
+		queue->completed_requests.Remove(request);
+	else
+		queue->requests.Remove(request);
+	request->SetOwner(NULL);
+
+	fLatencies[queue->priority][request->IsWrite() ? WRITE_QUEUE : READ_QUEUE]
+		.Add(system_time() - request->ScheduledTime());
+}
+
+
+status_t
+IOSchedulerDeadline::_Scheduler()
+{
+	while (!fTerminating) {
+		MutexLocker locker(fLock);
+
+		bool expired;
+		IORequestOwner* queue = _WaitForQueue(expired);
+		if (queue == NULL) {
+			// we've been asked to terminate
+			return B_OK;
+		}
+
+		IOOperationList operations;
+		int32 operationCount = 0;
+		IORequest* abortedRequest;
+		status_t abortStatus;
+		if (!_PrepareBatch(queue, expired, operations, operationCount,
+				abortedRequest, abortStatus)) {
+			continue;
+		}
+
+		fPendingOperations = operationCount;
+
+		locker.Unlock();
+
+		if (abortedRequest != NULL) {
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+				this, abortedRequest);
+			abortedRequest->SetStatusAndNotify(abortStatus);
+		}
+
+		// execute the operations
+#ifdef TRACE_IO_SCHEDULER
+		int32 i = 0;
+#endif
+		while (IOOperation* operation = operations.RemoveHead()) {
+			TRACE("IOSchedulerDeadline::_Scheduler(): calling callback for "
+				"operation %ld: %p\n", i++, operation);
+
+			IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_OPERATION_STARTED,
+				this, operation->Parent(), operation);
+
+			fIOCallback(fIOCallbackData, operation);
+
+			_Finisher();
+		}
+
+		// wait for all operations to finish
+		while (!fTerminating) {
+			locker.Lock();
+
+			if (fPendingOperations == 0)
+				break;
+
+			// Before waiting first check whether any finisher work has to be
+			// done.
+			InterruptsSpinLocker finisherLocker(fFinisherLock);
+			if (_FinisherWorkPending()) {
+				finisherLocker.Unlock();
+				locker.Unlock();
+				_Finisher();
+				continue;
+			}
+
+			// wait for finished operations
+			ConditionVariableEntry entry;
+			fFinishedOperationCondition.Add(&entry);
+
+			finisherLocker.Unlock();
+			locker.Unlock();
+
+			entry.Wait(B_CAN_INTERRUPT);
+			_Finisher();
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_SchedulerThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline *)_self;
+	return self->_Scheduler();
+}
+
+
+status_t
+IOSchedulerDeadline::_RequestNotifier()
+{
+	while (true) {
+		MutexLocker locker(fLock);
+
+		// get a request
+		IORequest* request = fFinishedRequests.RemoveHead();
+
+		if (request == NULL) {
+			if (fTerminating)
+				return B_OK;
+
+			ConditionVariableEntry entry;
+			fFinishedRequestCondition.Add(&entry);
+
+			locker.Unlock();
+
+			entry.Wait();
+			continue;
+		}
+
+		locker.Unlock();
+
+		IOSchedulerRoster::Default()->Notify(IO_SCHEDULER_REQUEST_FINISHED,
+			this, request);
+
+		// notify the request
+		request->NotifyFinished();
+	}
+
+	// never can get here
+	return B_OK;
+}
+
+
+/*static*/ status_t
+IOSchedulerDeadline::_RequestNotifierThread(void *_self)
+{
+	IOSchedulerDeadline *self = (IOSchedulerDeadline*)_self;
+	return self->_RequestNotifier();
+}
+
+
+/*static*/ int32
+IOSchedulerDeadline::_PriorityClass(int32 priority)
+{
+	if (priority >= B_URGENT_DISPLAY_PRIORITY)
+		return 0;
+	if (priority > B_LOW_PRIORITY)
+		return 1;
+	return 2;
+}
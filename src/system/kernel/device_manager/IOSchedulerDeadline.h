@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef IO_SCHEDULER_DEADLINE_H
+#define IO_SCHEDULER_DEADLINE_H
+
+
+#include <KernelExport.h>
+
+#include <condition_variable.h>
+#include <lock.h>
+
+#include "dma_resources.h"
+#include "IOScheduler.h"
+
+
+class IOSchedulerDeadline : public IOScheduler {
+public:
+								IOSchedulerDeadline(DMAResource* resource);
+	virtual						~IOSchedulerDeadline();
+
+	virtual	status_t			Init(const char* name);
+
+	virtual	status_t			ScheduleRequest(IORequest* request);
+
+	virtual	void				AbortRequest(IORequest* request,
+									status_t status = B_CANCELED);
+	virtual	void				OperationCompleted(IOOperation* operation,
+									status_t status,
+									generic_size_t transferredBytes);
+									// called by the driver when the operation
+									// has been completed successfully or failed
+									// for some reason
+
+	virtual	void				Dump() const;
+	virtual	void				DumpLatencies() const;
+
+private:
+			enum {
+				PRIORITY_CLASS_COUNT	= 3,
+				LATENCY_BUCKET_COUNT	= 20
+			};
+
+			struct LatencyHistogram {
+				int64			counts[LATENCY_BUCKET_COUNT];
+				int64			count;
+				bigtime_t		total;
+				bigtime_t		max;
+
+				void			Add(bigtime_t latency);
+				void			Dump(const char* name) const;
+			};
+
+			void				_Finisher();
+			bool				_FinisherWorkPending();
+			IORequestOwner*		_NextQueue(bool& _expired);
+			IORequestOwner*		_WaitForQueue(bool& _expired);
+			IORequest*			_OldestRequest(IORequestOwner* queue) const;
+			IORequest*			_FirstBatchRequest(IORequestOwner* queue,
+									bool expired) const;
+			void				_InsertRequest(IORequestOwner* queue,
+									IORequest* request);
+			bool				_PrepareBatch(IORequestOwner* queue,
+									bool expired, IOOperationList& operations,
+									int32& operationCount,
+									IORequest*& _abortedRequest,
+									status_t& _abortStatus);
+			bool				_PrepareRequestOperations(IORequest* request,
+									IOOperationList& operations,
+									int32& operationsPrepared, off_t quantum,
+									off_t& usedBandwidth, status_t& _status);
+			void				_RemoveRequest(IORequest* request);
+			status_t			_Scheduler();
+	static	status_t			_SchedulerThread(void* self);
+			status_t			_RequestNotifier();
+	static	status_t			_RequestNotifierThread(void* self);
+
+	static	int32				_PriorityClass(int32 priority);
+
+private:
+			spinlock			fFinisherLock;
+			mutex				fLock;
+			thread_id			fSchedulerThread;
+			thread_id			fRequestNotifierThread;
+			IORequestList		fFinishedRequests;
+			ConditionVariable	fNewRequestCondition;
+			ConditionVariable	fFinishedOperationCondition;
+			ConditionVariable	fFinishedRequestCondition;
+			IOOperationList		fUnusedOperations;
+			IOOperationList		fCompletedOperations;
+			IORequestOwner		fQueues[PRIORITY_CLASS_COUNT][2];
+									// sorted by offset, one for reads, and
+									// one for writes per priority class
+			LatencyHistogram	fLatencies[PRIORITY_CLASS_COUNT][2];
+			generic_size_t		fBlockSize;
+			int32				fPendingOperations;
+			int32				fStarvedWrites;
+			off_t				fLastOffset;
+			off_t				fReadBatchBandwidth;
+			off_t				fWriteBatchBandwidth;
+	volatile bool				fTerminating;
+};
+
+
+#endif	// IO_SCHEDULER_DEADLINE_H
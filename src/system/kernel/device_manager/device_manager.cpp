@@ -302,6 +302,29 @@ dump_io_scheduler(int argc, char** argv)
 }
 
 
+static int
+dump_io_latencies(int argc, char** argv)
+{
+	if (argc > 2) {
+		print_debugger_command_usage(argv[0]);
+		return 0;
+	}
+
+	if (argc == 2) {
+		IOScheduler* scheduler = (IOScheduler*)parse_expression(argv[1]);
+		scheduler->DumpLatencies();
+		return 0;
+	}
+
+	IOSchedulerList::ConstIterator iterator
+		= IOSchedulerRoster::Default()->SchedulerList().GetIterator();
+	while (IOScheduler* scheduler = iterator.Next())
+		scheduler->DumpLatencies();
+
+	return 0;
+}
+
+
 static int
 dump_io_request_owner(int argc, char** argv)
 {
@@ -1560,6 +1583,9 @@ device_node::_GetNextDriverPath(void*& cookie, KPath& _path)
 						_AddPath(*stack, "busses", "ata");
 						_AddPath(*stack, "busses", "ide");
 						break;
+					case PCI_nvm:
+						_AddPath(*stack, "drivers", "disk");
+						break;
 					default:
 						_AddPath(*stack, "busses");
 						break;
@@ -2286,6 +2312,12 @@ device_manager_init(struct kernel_args* args)
 		"Dump an I/O scheduler",
 		"<scheduler>\n"
 		"Dumps I/O scheduler at address <scheduler>.\n", 0);
+	add_debugger_command_etc("io_latency", &dump_io_latencies,
+		"Dump the request latencies of the I/O schedulers",
+		"[ <scheduler> ]\n"
+		"Prints histograms of the time the requests of the I/O scheduler at\n"
+		"address <scheduler> took to complete, or those of all I/O\n"
+		"schedulers.\n", 0);
 	add_debugger_command_etc("io_request_owner", &dump_io_request_owner,
 		"Dump an I/O request owner",
 		"<owner>\n"
@@ -0,0 +1,722 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Event queues keep the objects they watch selected between waits, unlike
+	select(), poll(), and wait_for_objects(), which select and deselect every
+	object each time they are called.
+
+	Every object added to a queue has an entry which contains a select_info
+	and a select_sync of its own. The object notifies the entry like any other
+	select_info, but instead of releasing a semaphore, notify_select_events()
+	puts the entry into the queue's ready list. Waiting only needs to look at
+	that list, so its cost only depends on the number of objects that actually
+	had events.
+
+	Since objects keep references to the select_sync of the entry, the entry
+	is only freed when its last reference is gone. Every entry also keeps a
+	reference to its queue.
+*/
+
+
+#include <event_queue.h>
+
+#include <new>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <AutoDeleter.h>
+#include <Referenceable.h>
+
+#include <condition_variable.h>
+#include <fs/fd.h>
+#include <kernel.h>
+#include <lock.h>
+#include <port.h>
+#include <sem.h>
+#include <syscall_restart.h>
+#include <thread.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+#include <vfs.h>
+#include <wait_for_objects.h>
+
+
+#define EVENT_QUEUE_FLAGS	(B_EVENT_LEVEL_TRIGGERED | B_EVENT_ONE_SHOT)
+
+static const int32 kMaxWaitInfos = 1024;
+static const int32 kSelectInfoChunk = 32;
+
+
+struct EventQueueEntry {
+	select_info			info;
+		// must be first, notify_select_events() only knows the info
+	select_sync			sync;
+
+	int32				object;
+	uint16				type;
+	uint16				events;
+	uint16				flags;
+	bool				queued;
+	bool				removed;
+	bool				reselect;
+	void*				user_data;
+
+	DoublyLinkedListLink<EventQueueEntry> ready_link;
+	EventQueueEntry*	hash_link;
+	EventQueueEntry*	next_reselect;
+};
+
+typedef DoublyLinkedList<EventQueueEntry,
+	DoublyLinkedListMemberGetLink<EventQueueEntry,
+		&EventQueueEntry::ready_link> > EventQueueEntryList;
+
+
+struct EventQueueEntryKey {
+	int32	object;
+	uint16	type;
+
+	EventQueueEntryKey(int32 object, uint16 type)
+		:
+		object(object),
+		type(type)
+	{
+	}
+};
+
+
+struct EventQueueEntryHashDefinition {
+	typedef EventQueueEntryKey	KeyType;
+	typedef	EventQueueEntry		ValueType;
+
+	size_t HashKey(const EventQueueEntryKey& key) const
+	{
+		return key.object ^ ((size_t)key.type << 24);
+	}
+
+	size_t Hash(EventQueueEntry* value) const
+	{
+		return HashKey(EventQueueEntryKey(value->object, value->type));
+	}
+
+	bool Compare(const EventQueueEntryKey& key, EventQueueEntry* value) const
+	{
+		return value->object == key.object && value->type == key.type;
+	}
+
+	EventQueueEntry*& GetLink(EventQueueEntry* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+typedef BOpenHashTable<EventQueueEntryHashDefinition> EventQueueEntryTable;
+
+
+struct EventQueue : BReferenceable {
+public:
+								EventQueue(bool kernel);
+	virtual						~EventQueue();
+
+			status_t			Init();
+
+			status_t			Select(int32 object, uint16 type,
+									uint16 events, void* userData);
+			ssize_t				Wait(event_wait_info* infos, int numInfos,
+									uint32 flags, bigtime_t timeout);
+			void				Close();
+
+			status_t			Notify(EventQueueEntry* entry, uint16 events);
+
+private:
+			ssize_t				_Harvest(event_wait_info* infos,
+									int numInfos);
+			status_t			_SelectObject(EventQueueEntry* entry);
+			void				_DeselectObject(EventQueueEntry* entry);
+			status_t			_Reselect(EventQueueEntry* entry);
+			void				_Remove(EventQueueEntry* entry);
+			void				_Discard(EventQueueEntry* entry);
+			void				_Unqueue(EventQueueEntry* entry);
+
+private:
+			mutex				fLock;
+				// protects the entries, and serializes selecting objects
+			spinlock			fReadyLock;
+			EventQueueEntryTable fEntries;
+			EventQueueEntryList	fReady;
+			ConditionVariable	fReadyCondition;
+			bool				fKernel;
+			bool				fClosed;
+};
+
+
+EventQueue::EventQueue(bool kernel)
+	:
+	fKernel(kernel),
+	fClosed(false)
+{
+	mutex_init(&fLock, "event queue");
+	B_INITIALIZE_SPINLOCK(&fReadyLock);
+	fReadyCondition.Init(this, "event queue");
+}
+
+
+EventQueue::~EventQueue()
+{
+	mutex_destroy(&fLock);
+}
+
+
+status_t
+EventQueue::Init()
+{
+	return fEntries.Init();
+}
+
+
+/*!	Adds the object to the queue, or changes the events it's watched for.
+	If \a events doesn't contain any events, the object is removed from the
+	queue.
+*/
+status_t
+EventQueue::Select(int32 object, uint16 type, uint16 events, void* userData)
+{
+	MutexLocker locker(fLock);
+
+	if (fClosed)
+		return B_FILE_ERROR;
+
+	EventQueueEntry* entry = fEntries.Lookup(EventQueueEntryKey(object, type));
+
+	if ((events & ~EVENT_QUEUE_FLAGS) == 0) {
+		if (entry == NULL)
+			return B_ENTRY_NOT_FOUND;
+
+		_Remove(entry);
+		return B_OK;
+	}
+
+	if (entry != NULL) {
+		// update the existing entry
+		entry->events = events & ~EVENT_QUEUE_FLAGS;
+		entry->flags = events & EVENT_QUEUE_FLAGS;
+		entry->user_data = userData;
+
+		status_t status = _Reselect(entry);
+		if (status != B_OK)
+			_Remove(entry);
+
+		return status;
+	}
+
+	entry = new(std::nothrow) EventQueueEntry;
+	if (entry == NULL)
+		return B_NO_MEMORY;
+
+	entry->object = object;
+	entry->type = type;
+	entry->events = events & ~EVENT_QUEUE_FLAGS;
+	entry->flags = events & EVENT_QUEUE_FLAGS;
+	entry->queued = false;
+	entry->removed = false;
+	entry->reselect = false;
+	entry->user_data = userData;
+
+	entry->info.next = NULL;
+	entry->info.sync = &entry->sync;
+
+	// the queue's reference
+	entry->sync.ref_count = 1;
+	entry->sync.sem = -1;
+	entry->sync.count = 1;
+	entry->sync.set = &entry->info;
+	entry->sync.queue = this;
+	AcquireReference();
+
+	status_t status = _SelectObject(entry);
+	if (status != B_OK) {
+		_Discard(entry);
+		return status;
+	}
+
+	fEntries.InsertUnchecked(entry);
+	return B_OK;
+}
+
+
+/*!	Waits for events to occur, and returns up to \a numInfos objects that
+	had events.
+	Level triggered objects are selected again after their events have been
+	reported, so that they are put back into the queue when their condition
+	still holds.
+*/
+ssize_t
+EventQueue::Wait(event_wait_info* infos, int numInfos, uint32 flags,
+	bigtime_t timeout)
+{
+	if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT
+		&& timeout > 0) {
+		// we might have to wait more than once
+		timeout += system_time();
+		flags = (flags & ~B_RELATIVE_TIMEOUT) | B_ABSOLUTE_TIMEOUT;
+	}
+
+	while (true) {
+		InterruptsSpinLocker readyLocker(fReadyLock);
+
+		if (fReady.IsEmpty()) {
+			if (fClosed)
+				return B_FILE_ERROR;
+
+			ConditionVariableEntry waitEntry;
+			fReadyCondition.Add(&waitEntry);
+			readyLocker.Unlock();
+
+			status_t status = waitEntry.Wait(B_CAN_INTERRUPT | flags, timeout);
+			if (status != B_OK)
+				return status;
+
+			continue;
+		}
+
+		readyLocker.Unlock();
+
+		ssize_t count = _Harvest(infos, numInfos);
+		if (count != 0)
+			return count;
+
+		// all events had been reported before
+	}
+}
+
+
+/*!	Removes all objects from the queue, and wakes up everyone waiting.
+	The queue can't be used afterwards, it's only kept until the last object
+	has dropped its reference to it.
+*/
+void
+EventQueue::Close()
+{
+	MutexLocker locker(fLock);
+
+	fClosed = true;
+
+	EventQueueEntry* entry = fEntries.Clear(true);
+	while (entry != NULL) {
+		EventQueueEntry* next = entry->hash_link;
+
+		// Objects that are gone must not be deselected anymore; this also
+		// happens when all descriptors of an I/O context are closed, see
+		// deselect_all_fds().
+		if ((entry->info.events & B_EVENT_INVALID) == 0)
+			_DeselectObject(entry);
+		_Discard(entry);
+
+		entry = next;
+	}
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	fReadyCondition.NotifyAll();
+}
+
+
+/*!	Called by notify_select_events() for the entries of this queue. This may
+	be called in any context, including with interrupts disabled.
+*/
+status_t
+EventQueue::Notify(EventQueueEntry* entry, uint16 events)
+{
+	atomic_or(&entry->info.events, events);
+
+	if ((entry->info.selected_events & events) == 0)
+		return B_OK;
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+
+	if (entry->queued || entry->removed)
+		return B_OK;
+
+	entry->queued = true;
+	fReady.Add(entry);
+	fReadyCondition.NotifyOne();
+
+	return B_OK;
+}
+
+
+ssize_t
+EventQueue::_Harvest(event_wait_info* infos, int numInfos)
+{
+	MutexLocker locker(fLock);
+
+	EventQueueEntry* reselect = NULL;
+	ssize_t count = 0;
+
+	while (count < numInfos) {
+		InterruptsSpinLocker readyLocker(fReadyLock);
+
+		EventQueueEntry* entry = fReady.RemoveHead();
+		if (entry == NULL)
+			break;
+
+		entry->queued = false;
+		readyLocker.Unlock();
+
+		uint16 events = atomic_get_and_set(&entry->info.events, 0)
+			& entry->info.selected_events;
+		if (events == 0 || entry->reselect) {
+			// An entry that is going to be selected again has been reported
+			// already; selecting it will report whatever still holds.
+			continue;
+		}
+
+		infos[count].object = entry->object;
+		infos[count].type = entry->type;
+		infos[count].events = events;
+		infos[count].user_data = entry->user_data;
+		count++;
+
+		if ((events & B_EVENT_INVALID) != 0
+			|| (entry->flags & B_EVENT_ONE_SHOT) != 0) {
+			_Remove(entry);
+		} else if ((entry->flags & B_EVENT_LEVEL_TRIGGERED) != 0) {
+			// selecting it right away would put it back into the list we're
+			// just emptying
+			entry->reselect = true;
+			entry->next_reselect = reselect;
+			reselect = entry;
+		}
+	}
+
+	while (reselect != NULL) {
+		EventQueueEntry* entry = reselect;
+		reselect = entry->next_reselect;
+		entry->reselect = false;
+
+		if (_Reselect(entry) != B_OK) {
+			// the object is gone, report that on the next wait
+			Notify(entry, B_EVENT_INVALID);
+		}
+	}
+
+	// let the next waiter have what we couldn't take
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	if (!fReady.IsEmpty())
+		fReadyCondition.NotifyOne();
+
+	return count;
+}
+
+
+status_t
+EventQueue::_SelectObject(EventQueueEntry* entry)
+{
+	entry->info.events = 0;
+	entry->info.selected_events = entry->events
+		| B_EVENT_INVALID | B_EVENT_ERROR | B_EVENT_DISCONNECTED;
+
+	switch (entry->type) {
+		case B_OBJECT_TYPE_FD:
+			return select_fd(entry->object, &entry->info, fKernel);
+		case B_OBJECT_TYPE_SEMAPHORE:
+			return select_sem(entry->object, &entry->info, fKernel);
+		case B_OBJECT_TYPE_PORT:
+			return select_port(entry->object, &entry->info, fKernel);
+		case B_OBJECT_TYPE_THREAD:
+			return select_thread(entry->object, &entry->info, fKernel);
+	}
+
+	return B_BAD_VALUE;
+}
+
+
+void
+EventQueue::_DeselectObject(EventQueueEntry* entry)
+{
+	switch (entry->type) {
+		case B_OBJECT_TYPE_FD:
+			deselect_fd(entry->object, &entry->info, fKernel);
+			break;
+		case B_OBJECT_TYPE_SEMAPHORE:
+			deselect_sem(entry->object, &entry->info, fKernel);
+			break;
+		case B_OBJECT_TYPE_PORT:
+			deselect_port(entry->object, &entry->info, fKernel);
+			break;
+		case B_OBJECT_TYPE_THREAD:
+			deselect_thread(entry->object, &entry->info, fKernel);
+			break;
+	}
+}
+
+
+/*!	Selects the object of the \a entry again, which reports the events whose
+	conditions currently hold.
+	The caller must hold the queue lock.
+*/
+status_t
+EventQueue::_Reselect(EventQueueEntry* entry)
+{
+	_DeselectObject(entry);
+
+	// anything reported until now is outdated
+	_Unqueue(entry);
+
+	return _SelectObject(entry);
+}
+
+
+/*!	Removes the \a entry from the queue, and drops the queue's reference to
+	it. The caller must hold the queue lock.
+*/
+void
+EventQueue::_Remove(EventQueueEntry* entry)
+{
+	fEntries.RemoveUnchecked(entry);
+
+	_DeselectObject(entry);
+	_Discard(entry);
+}
+
+
+/*!	Drops the queue's reference to the \a entry, after making sure that it
+	won't be put into the ready list anymore. The object might still have a
+	reference to the entry, and notify it until it releases it.
+*/
+void
+EventQueue::_Discard(EventQueueEntry* entry)
+{
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	if (entry->queued) {
+		fReady.Remove(entry);
+		entry->queued = false;
+	}
+	entry->removed = true;
+	readyLocker.Unlock();
+
+	put_select_sync(&entry->sync);
+}
+
+
+void
+EventQueue::_Unqueue(EventQueueEntry* entry)
+{
+	InterruptsSpinLocker readyLocker(fReadyLock);
+
+	if (entry->queued) {
+		fReady.Remove(entry);
+		entry->queued = false;
+	}
+	entry->info.events = 0;
+}
+
+
+//	#pragma mark - file descriptor
+
+
+static status_t
+event_queue_close(file_descriptor* descriptor)
+{
+	((EventQueue*)descriptor->cookie)->Close();
+	return B_OK;
+}
+
+
+static void
+event_queue_free(file_descriptor* descriptor)
+{
+	((EventQueue*)descriptor->cookie)->ReleaseReference();
+}
+
+
+static struct fd_ops sEventQueueFDOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	NULL,	// fd_select
+	NULL,	// fd_deselect
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&event_queue_close,
+	&event_queue_free
+};
+
+
+static EventQueue*
+get_event_queue(int fd, bool kernel, file_descriptor*& _descriptor)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(kernel), fd);
+	if (descriptor == NULL)
+		return NULL;
+
+	if (descriptor->type != FDTYPE_EVENT_QUEUE) {
+		put_fd(descriptor);
+		return NULL;
+	}
+
+	_descriptor = descriptor;
+	return (EventQueue*)descriptor->cookie;
+}
+
+
+//	#pragma mark - kernel private
+
+
+status_t
+event_queue_notify(select_info* info, uint16 events)
+{
+	EventQueueEntry* entry = (EventQueueEntry*)info;
+	return entry->sync.queue->Notify(entry, events);
+}
+
+
+/*!	Called by put_select_sync() when the last reference to the sync object of
+	an entry is gone.
+*/
+void
+event_queue_free_sync(select_sync* sync)
+{
+	EventQueueEntry* entry = (EventQueueEntry*)sync->set;
+	EventQueue* queue = sync->queue;
+
+	delete entry;
+	queue->ReleaseReference();
+}
+
+
+//	#pragma mark - syscalls
+
+
+int
+_user_create_event_queue(uint32 openFlags)
+{
+	EventQueue* queue = new(std::nothrow) EventQueue(false);
+	if (queue == NULL)
+		return B_NO_MEMORY;
+	BReference<EventQueue> queueReference(queue, true);
+
+	status_t status = queue->Init();
+	if (status != B_OK)
+		return status;
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL)
+		return B_NO_MEMORY;
+
+	descriptor->type = FDTYPE_EVENT_QUEUE;
+	descriptor->ops = &sEventQueueFDOps;
+	descriptor->cookie = queue;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* context = get_current_io_context(false);
+	int fd = new_fd(context, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		return fd;
+	}
+
+	queueReference.Detach();
+
+	mutex_lock(&context->io_mutex);
+	fd_set_close_on_exec(context, fd, (openFlags & O_CLOEXEC) != 0);
+	mutex_unlock(&context->io_mutex);
+
+	return fd;
+}
+
+
+/*!	Objects that could not be added to the queue get B_EVENT_INVALID as their
+	events, and the error of the first one is returned.
+*/
+status_t
+_user_event_queue_select(int fd, event_wait_info* userInfos, int numInfos)
+{
+	if (numInfos < 0)
+		return B_BAD_VALUE;
+	if (numInfos > 0 && (userInfos == NULL || !IS_USER_ADDRESS(userInfos)))
+		return B_BAD_ADDRESS;
+
+	file_descriptor* descriptor;
+	EventQueue* queue = get_event_queue(fd, false, descriptor);
+	if (queue == NULL)
+		return B_FILE_ERROR;
+	CObjectDeleter<file_descriptor> descriptorPutter(descriptor, put_fd);
+
+	status_t result = B_OK;
+	event_wait_info infos[kSelectInfoChunk];
+
+	for (int first = 0; first < numInfos; first += kSelectInfoChunk) {
+		int count = min_c(numInfos - first, kSelectInfoChunk);
+		size_t bytes = count * sizeof(event_wait_info);
+		if (user_memcpy(infos, userInfos + first, bytes) != B_OK)
+			return B_BAD_ADDRESS;
+
+		bool failed = false;
+		for (int i = 0; i < count; i++) {
+			status_t status = queue->Select(infos[i].object, infos[i].type,
+				infos[i].events, infos[i].user_data);
+			if (status == B_OK)
+				continue;
+
+			infos[i].events = B_EVENT_INVALID;
+			if (result == B_OK)
+				result = status;
+			failed = true;
+		}
+
+		if (failed && user_memcpy(userInfos + first, infos, bytes) != B_OK)
+			return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
+
+
+ssize_t
+_user_event_queue_wait(int fd, event_wait_info* userInfos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	// the rest is left for the next call
+	if (numInfos > kMaxWaitInfos)
+		numInfos = kMaxWaitInfos;
+
+	file_descriptor* descriptor;
+	EventQueue* queue = get_event_queue(fd, false, descriptor);
+	if (queue == NULL)
+		return B_FILE_ERROR;
+	CObjectDeleter<file_descriptor> descriptorPutter(descriptor, put_fd);
+
+	event_wait_info* infos = (event_wait_info*)malloc(
+		sizeof(event_wait_info) * numInfos);
+	if (infos == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter infosDeleter(infos);
+
+	ssize_t result = queue->Wait(infos, numInfos, flags, timeout);
+
+	if (result > 0) {
+		if (user_memcpy(userInfos, infos, sizeof(event_wait_info) * result)
+				!= B_OK) {
+			return B_BAD_ADDRESS;
+		}
+	} else
+		syscall_restart_handle_timeout_post(result, timeout);
+
+	return result;
+}
@@ -8,6 +8,10 @@
 
 #include <new>
 
+#include <cpu.h>
+#include <debug.h>
+#include <smp.h>
+
 
 static const int32 kEntriesPerGeneration = 1024;
 
@@ -15,6 +19,19 @@ static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
 
 
+/*!	The lookup statistics are kept per CPU, so that lookups running in
+	parallel don't have to share a cache line for them. They are updated
+	without atomic operations; a thread being rescheduled to another CPU
+	while incrementing one may rarely lose an update, which is acceptable.
+*/
+struct EntryCacheStatistics {
+	int64	hits;
+	int64	missing_hits;
+	int64	complete_directory_hits;
+	int64	misses;
+} CACHE_LINE_ALIGN;
+
+
 // #pragma mark - EntryCacheGeneration
 
 
@@ -50,11 +67,14 @@ EntryCacheGeneration::Init()
 
 EntryCache::EntryCache()
 	:
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fStatistics(NULL),
+	fInvalidations(0)
 {
 	rw_lock_init(&fLock, "entry cache");
 
 	new(&fEntries) EntryTable;
+	new(&fCompleteDirectories) DirectoryTable;
 }
 
 
@@ -68,6 +88,15 @@ EntryCache::~EntryCache()
 		entry = next;
 	}
 
+	EntryCacheDirectory* directory = fCompleteDirectories.Clear(true);
+	while (directory != NULL) {
+		EntryCacheDirectory* next = directory->hash_link;
+		free(directory);
+		directory = next;
+	}
+
+	free(fStatistics);
+
 	rw_lock_destroy(&fLock);
 }
 
@@ -79,80 +108,140 @@ EntryCache::Init()
 	if (error != B_OK)
 		return error;
 
+	error = fCompleteDirectories.Init();
+	if (error != B_OK)
+		return error;
+
 	for (int32 i = 0; i < kGenerationCount; i++) {
 		error = fGenerations[i].Init();
 		if (error != B_OK)
 			return error;
 	}
 
+	int32 cpuCount = smp_get_num_cpus();
+	fStatistics = (EntryCacheStatistics*)memalign(CACHE_LINE_SIZE,
+		sizeof(EntryCacheStatistics) * cpuCount);
+	if (fStatistics == NULL)
+		return B_NO_MEMORY;
+
+	memset(fStatistics, 0, sizeof(EntryCacheStatistics) * cpuCount);
+
 	return B_OK;
 }
 
 
 status_t
 EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
+{
+	WriteLocker _(fLock);
+
+	return _Add(dirID, name, nodeID, missing);
+}
+
+
+status_t
+EntryCache::Remove(ino_t dirID, const char* name)
 {
 	EntryCacheKey key(dirID, name);
 
-	WriteLocker _(fLock);
+	WriteLocker writeLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry != NULL) {
-		entry->node_id = nodeID;
-		entry->missing = missing;
-		if (entry->generation != fCurrentGeneration) {
-			if (entry->index >= 0) {
-				fGenerations[entry->generation].entries[entry->index] = NULL;
-				_AddEntryToCurrentGeneration(entry);
-			}
-		}
-		return B_OK;
-	}
-
-	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
 	if (entry == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	_RemoveEntry(entry);
+	return B_OK;
+}
+
+
+/*!	Adds all entries of the given directory, and remembers that the directory
+	has no other entries. Until the directory is changed, or one of its entries
+	is evicted from the cache, the lookup of any other name in it will then
+	fail without asking the file system.
+	The entries are added at once, so that none of them can be evicted before
+	the directory is marked complete.
+*/
+status_t
+EntryCache::AddCompleteDirectory(ino_t dirID, const char* const* names,
+	const ino_t* nodeIDs, int32 count)
+{
+	if (count > kEntriesPerGeneration)
+		return B_BAD_VALUE;
+
+	WriteLocker _(fLock);
+
+	if (fCompleteDirectories.Lookup(dirID) == NULL
+		&& (int32)fCompleteDirectories.CountElements()
+			>= kMaxCompleteDirectories) {
 		return B_NO_MEMORY;
+	}
 
-	entry->node_id = nodeID;
-	entry->dir_id = dirID;
-	entry->missing = missing;
-	entry->generation = fCurrentGeneration;
-	entry->index = kEntryNotInArray;
-	strcpy(entry->name, name);
+	for (int32 i = 0; i < count; i++) {
+		status_t error = _Add(dirID, names[i], nodeIDs[i], false);
+		if (error != B_OK) {
+			_RemoveDirectory(dirID);
+			return error;
+		}
+	}
 
-	fEntries.Insert(entry);
+	if (fCompleteDirectories.Lookup(dirID) != NULL)
+		return B_OK;
 
-	_AddEntryToCurrentGeneration(entry);
+	EntryCacheDirectory* directory
+		= (EntryCacheDirectory*)malloc(sizeof(EntryCacheDirectory));
+	if (directory == NULL)
+		return B_NO_MEMORY;
+
+	directory->dir_id = dirID;
+	fCompleteDirectories.Insert(directory);
 
 	return B_OK;
 }
 
 
-status_t
-EntryCache::Remove(ino_t dirID, const char* name)
+/*!	Called when an entry has been created. A negative entry for it is removed,
+	and the directory is no longer considered complete, as the file system
+	might not have added the new entry.
+*/
+void
+EntryCache::EntryCreated(ino_t dirID, const char* name)
 {
 	EntryCacheKey key(dirID, name);
 
-	WriteLocker writeLocker(fLock);
+	WriteLocker _(fLock);
+
+	_RemoveDirectory(dirID);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
-		return B_ENTRY_NOT_FOUND;
+	if (entry == NULL || !entry->missing)
+		return;
 
-	fEntries.Remove(entry);
+	fInvalidations++;
+	_RemoveEntry(entry);
+}
 
-	if (entry->index >= 0) {
-		// remove the entry from its generation and delete it
-		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
-	} else {
-		// We can't free it, since another thread is about to try to move it
-		// to another generation. We mark it removed and the other thread will
-		// take care of deleting it.
-		entry->index = kEntryRemoved;
-	}
 
-	return B_OK;
+/*!	Called when an entry has been removed. The entry is removed, unless the
+	file system has already replaced it with one for another node. If the entry
+	referred to a complete directory, that one is forgotten as well, since its
+	ID might be reused.
+*/
+void
+EntryCache::EntryRemoved(ino_t dirID, const char* name, ino_t nodeID)
+{
+	EntryCacheKey key(dirID, name);
+
+	WriteLocker _(fLock);
+
+	_RemoveDirectory(nodeID);
+
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry == NULL || (!entry->missing && entry->node_id != nodeID))
+		return;
+
+	fInvalidations++;
+	_RemoveEntry(entry);
 }
 
 
@@ -164,9 +253,28 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 
 	ReadLocker readLocker(fLock);
 
+	EntryCacheStatistics& statistics = fStatistics[smp_get_current_cpu()];
+
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
+	if (entry == NULL) {
+		// In a complete directory, an unknown name does not exist -- save for
+		// "." and "..", which the file systems don't need to add.
+		if (fCompleteDirectories.CountElements() != 0
+			&& strcmp(name, ".") != 0 && strcmp(name, "..") != 0
+			&& fCompleteDirectories.Lookup(dirID) != NULL) {
+			statistics.complete_directory_hits++;
+			_missing = true;
+			return true;
+		}
+
+		statistics.misses++;
 		return false;
+	}
+
+	if (entry->missing)
+		statistics.missing_hits++;
+	else
+		statistics.hits++;
 
 	int32 oldGeneration = atomic_get_and_set(&entry->generation,
 			fCurrentGeneration);
@@ -183,7 +291,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 	entry->index = kEntryNotInArray;
 
 	// add to the current generation
-	int32 index = atomic_add(&fGenerations[oldGeneration].next_index, 1);
+	int32 index = atomic_add(&fGenerations[fCurrentGeneration].next_index, 1);
 	if (index < kEntriesPerGeneration) {
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->index = index;
@@ -227,6 +335,74 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 }
 
 
+void
+EntryCache::Dump()
+{
+	EntryCacheStatistics total;
+	memset(&total, 0, sizeof(total));
+
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		total.hits += fStatistics[i].hits;
+		total.missing_hits += fStatistics[i].missing_hits;
+		total.complete_directory_hits += fStatistics[i].complete_directory_hits;
+		total.misses += fStatistics[i].misses;
+	}
+
+	int64 lookups = total.hits + total.missing_hits
+		+ total.complete_directory_hits + total.misses;
+
+	kprintf("  entries:              %" B_PRIuSIZE "\n",
+		fEntries.CountElements());
+	kprintf("  complete directories: %" B_PRIuSIZE "\n",
+		fCompleteDirectories.CountElements());
+	kprintf("  lookups:              %" B_PRId64 "\n", lookups);
+	kprintf("  hits:                 %" B_PRId64 "\n", total.hits);
+	kprintf("  negative hits:        %" B_PRId64 "\n", total.missing_hits);
+	kprintf("  complete dir hits:    %" B_PRId64 "\n",
+		total.complete_directory_hits);
+	kprintf("  misses:               %" B_PRId64 " (%" B_PRId64 "%%)\n",
+		total.misses, lookups > 0 ? total.misses * 100 / lookups : 0);
+	kprintf("  invalidations:        %" B_PRId64 "\n", fInvalidations);
+}
+
+
+status_t
+EntryCache::_Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
+{
+	EntryCacheKey key(dirID, name);
+
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry != NULL) {
+		entry->node_id = nodeID;
+		entry->missing = missing;
+		if (entry->generation != fCurrentGeneration) {
+			if (entry->index >= 0) {
+				fGenerations[entry->generation].entries[entry->index] = NULL;
+				_AddEntryToCurrentGeneration(entry);
+			}
+		}
+		return B_OK;
+	}
+
+	entry = (EntryCacheEntry*)malloc(sizeof(EntryCacheEntry) + strlen(name));
+	if (entry == NULL)
+		return B_NO_MEMORY;
+
+	entry->node_id = nodeID;
+	entry->dir_id = dirID;
+	entry->missing = missing;
+	entry->generation = fCurrentGeneration;
+	entry->index = kEntryNotInArray;
+	strcpy(entry->name, name);
+
+	fEntries.Insert(entry);
+
+	_AddEntryToCurrentGeneration(entry);
+
+	return B_OK;
+}
+
+
 void
 EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
@@ -246,6 +422,10 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 		if (otherEntry == NULL)
 			continue;
 
+		// a directory is no longer complete when one of its entries goes
+		if (!otherEntry->missing && fCompleteDirectories.CountElements() != 0)
+			_RemoveDirectory(otherEntry->dir_id);
+
 		fGenerations[newGeneration].entries[i] = NULL;
 		fEntries.Remove(otherEntry);
 		free(otherEntry);
@@ -258,3 +438,33 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+void
+EntryCache::_RemoveEntry(EntryCacheEntry* entry)
+{
+	fEntries.Remove(entry);
+
+	if (entry->index >= 0) {
+		// remove the entry from its generation and delete it
+		fGenerations[entry->generation].entries[entry->index] = NULL;
+		free(entry);
+	} else {
+		// We can't free it, since another thread is about to try to move it
+		// to another generation. We mark it removed and the other thread will
+		// take care of deleting it.
+		entry->index = kEntryRemoved;
+	}
+}
+
+
+void
+EntryCache::_RemoveDirectory(ino_t dirID)
+{
+	EntryCacheDirectory* directory = fCompleteDirectories.Lookup(dirID);
+	if (directory == NULL)
+		return;
+
+	fCompleteDirectories.Remove(directory);
+	free(directory);
+}
@@ -41,6 +41,15 @@ struct EntryCacheEntry {
 };
 
 
+struct EntryCacheDirectory {
+			EntryCacheDirectory* hash_link;
+			ino_t				dir_id;
+};
+
+
+struct EntryCacheStatistics;
+
+
 struct EntryCacheGeneration {
 			int32				next_index;
 			EntryCacheEntry**	entries;
@@ -80,6 +89,32 @@ struct EntryCacheHashDefinition {
 };
 
 
+struct EntryCacheDirectoryHashDefinition {
+	typedef ino_t				KeyType;
+	typedef EntryCacheDirectory	ValueType;
+
+	size_t HashKey(ino_t key) const
+	{
+		return (uint32)key ^ (uint32)(key >> 32);
+	}
+
+	size_t Hash(const EntryCacheDirectory* value) const
+	{
+		return HashKey(value->dir_id);
+	}
+
+	bool Compare(ino_t key, const EntryCacheDirectory* value) const
+	{
+		return value->dir_id == key;
+	}
+
+	EntryCacheDirectory*& GetLink(EntryCacheDirectory* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+
 class EntryCache {
 public:
 								EntryCache();
@@ -92,26 +127,47 @@ public:
 
 			status_t			Remove(ino_t dirID, const char* name);
 
+			status_t			AddCompleteDirectory(ino_t dirID,
+									const char* const* names,
+									const ino_t* nodeIDs, int32 count);
+
+			void				EntryCreated(ino_t dirID, const char* name);
+			void				EntryRemoved(ino_t dirID, const char* name,
+									ino_t nodeID);
+
 			bool				Lookup(ino_t dirID, const char* name,
 									ino_t& nodeID, bool& missing);
 
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
+			void				Dump();
 
 private:
 	static	const int32			kGenerationCount = 8;
+	static	const int32			kMaxCompleteDirectories = 256;
 
 			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
+			typedef BOpenHashTable<EntryCacheDirectoryHashDefinition>
+				DirectoryTable;
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
 
 private:
+			status_t			_Add(ino_t dirID, const char* name,
+									ino_t nodeID, bool missing);
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			void				_RemoveEntry(EntryCacheEntry* entry);
+			void				_RemoveDirectory(ino_t dirID);
 
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
+			DirectoryTable		fCompleteDirectories;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+
+			EntryCacheStatistics* fStatistics;
+				// one per CPU
+			int64				fInvalidations;
 };
 
 
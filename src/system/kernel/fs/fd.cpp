@@ -548,6 +548,25 @@ deselect_select_infos(file_descriptor* descriptor, select_info* infos,
 }
 
 
+/*!	Deselects everything that is still selected in the \a context. Event
+	queues keep descriptors selected between waits, and must not deselect
+	them anymore while the descriptors of the context are being closed.
+	The context's I/O lock must be held.
+*/
+void
+deselect_all_fds(struct io_context* context)
+{
+	for (uint32 i = 0; i < context->table_size; i++) {
+		select_info* infos = context->select_infos[i];
+		if (infos == NULL || context->fds[i] == NULL)
+			continue;
+
+		context->select_infos[i] = NULL;
+		deselect_select_infos(context->fds[i], infos, true);
+	}
+}
+
+
 status_t
 select_fd(int32 fd, struct select_info* info, bool kernel)
 {
@@ -1154,6 +1154,8 @@ status_t
 notify_entry_created(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_created(device, directory, name);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_CREATED,
 		device, directory, name, node);
 }
@@ -1172,6 +1174,8 @@ status_t
 notify_entry_removed(dev_t device, ino_t directory, const char *name,
 	ino_t node)
 {
+	vfs_entry_removed(device, directory, name, node);
+
 	return sNodeMonitorService.NotifyEntryCreatedOrRemoved(B_ENTRY_REMOVED,
 		device, directory, name, node);
 }
@@ -1193,6 +1197,9 @@ notify_entry_moved(dev_t device, ino_t fromDirectory,
 	const char *fromName, ino_t toDirectory, const char *toName,
 	ino_t node)
 {
+	vfs_entry_removed(device, fromDirectory, fromName, node);
+	vfs_entry_created(device, toDirectory, toName);
+
 	return sNodeMonitorService.NotifyEntryMoved(device, fromDirectory,
 		fromName, toDirectory, toName, node);
 }
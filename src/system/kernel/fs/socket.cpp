@@ -9,6 +9,7 @@
 #include <sys/socket.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 
 #include <module.h>
@@ -18,12 +19,14 @@
 #include <syscall_utils.h>
 
 #include <fd.h>
+#include <file_cache.h>
 #include <kernel.h>
 #include <lock.h>
 #include <syscall_restart.h>
 #include <util/AutoLock.h>
 #include <vfs.h>
 
+#include <net_buffer.h>
 #include <net_stack_interface.h>
 #include <net_stat.h>
 
@@ -31,6 +34,8 @@
 #define MAX_SOCKET_ADDRESS_LENGTH	(sizeof(sockaddr_storage))
 #define MAX_SOCKET_OPTION_LENGTH	128
 #define MAX_ANCILLARY_DATA_LENGTH	1024
+#define MAX_SENDFILE_MAPPINGS		16
+#define SENDFILE_BUFFER_SIZE		(16 * 1024)
 
 #define GET_SOCKET_FD_OR_RETURN(fd, kernel, descriptor)	\
 	do {												\
@@ -636,6 +641,137 @@ common_socketpair(int family, int type, int protocol, int fds[2], bool kernel)
 }
 
 
+/*!	Sends the file contents directly from the file cache, without copying
+	them. Returns \c B_NOT_SUPPORTED if that's not possible for this file.
+*/
+static ssize_t
+sendfile_from_cache(file_descriptor* socket, file_descriptor* file, off_t pos,
+	size_t count)
+{
+	struct vnode* vnode = fd_vnode(file);
+	file_cache_mapping mappings[MAX_SENDFILE_MAPPINGS];
+	net_external_data data[MAX_SENDFILE_MAPPINGS];
+	size_t bytesSent = 0;
+
+	while (bytesSent < count) {
+		uint32 mappingCount = MAX_SENDFILE_MAPPINGS;
+		status_t status = file_cache_map_pages(vnode, file->cookie,
+			pos + bytesSent, count - bytesSent, mappings, &mappingCount);
+		if (status != B_OK) {
+			if (bytesSent > 0)
+				return (ssize_t)bytesSent;
+
+			// let the caller copy the data instead, if the file cache is too
+			// busy to keep the pages around
+			return status == B_BUSY ? B_NOT_SUPPORTED : status;
+		}
+		if (mappingCount == 0)
+			break;
+
+		size_t size = 0;
+		for (uint32 i = 0; i < mappingCount; i++) {
+			data[i].data = mappings[i].address;
+			data[i].size = mappings[i].length;
+			data[i].free = &file_cache_unmap_page;
+			data[i].cookie = mappings[i].cookie;
+			size += mappings[i].length;
+		}
+
+		// the stack takes over the mappings, even on error
+		ssize_t bytesWritten = sStackInterface->send_external(
+			socket->u.socket, data, mappingCount, 0);
+		if (bytesWritten < 0)
+			return bytesSent > 0 ? (ssize_t)bytesSent : bytesWritten;
+
+		bytesSent += bytesWritten;
+		if ((size_t)bytesWritten < size)
+			break;
+	}
+
+	return bytesSent;
+}
+
+
+/*!	Copies the file contents via a kernel buffer, for files that are not
+	accessed via the file cache, or sockets that cannot take external data.
+*/
+static ssize_t
+sendfile_copy(file_descriptor* socket, file_descriptor* file, off_t pos,
+	size_t count)
+{
+	size_t bufferSize = min_c(count, SENDFILE_BUFFER_SIZE);
+	void* buffer = malloc(bufferSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter bufferDeleter(buffer);
+
+	size_t bytesSent = 0;
+
+	while (bytesSent < count) {
+		size_t length = min_c(count - bytesSent, bufferSize);
+		status_t status = file->ops->fd_read(file, pos + bytesSent, buffer,
+			&length);
+		if (status != B_OK)
+			return bytesSent > 0 ? (ssize_t)bytesSent : status;
+		if (length == 0)
+			break;
+
+		ssize_t bytesWritten = sStackInterface->send(socket->u.socket, buffer,
+			length, 0);
+		if (bytesWritten < 0)
+			return bytesSent > 0 ? (ssize_t)bytesSent : bytesWritten;
+
+		bytesSent += bytesWritten;
+		if ((size_t)bytesWritten < length)
+			break;
+	}
+
+	return bytesSent;
+}
+
+
+static ssize_t
+common_sendfile(int socketFD, int fileFD, off_t* _pos, size_t count,
+	bool kernel)
+{
+	file_descriptor* descriptor;
+	GET_SOCKET_FD_OR_RETURN(socketFD, kernel, descriptor);
+	FDPutter _(descriptor);
+
+	file_descriptor* file = get_fd(get_current_io_context(kernel), fileFD);
+	if (file == NULL)
+		return B_FILE_ERROR;
+	FDPutter filePutter(file);
+
+	if ((file->open_mode & O_RWMASK) == O_WRONLY)
+		return B_FILE_ERROR;
+	if (file->type != FDTYPE_FILE || file->ops->fd_read == NULL)
+		return B_BAD_VALUE;
+
+	off_t pos = _pos != NULL ? *_pos : file->pos;
+	if (pos < 0)
+		return B_BAD_VALUE;
+
+	if (count > SSIZE_MAX)
+		count = SSIZE_MAX;
+	if (count == 0)
+		return 0;
+
+	ssize_t bytesSent = sendfile_from_cache(descriptor, file, pos, count);
+	if (bytesSent == B_NOT_SUPPORTED)
+		bytesSent = sendfile_copy(descriptor, file, pos, count);
+
+	if (bytesSent > 0) {
+		if (_pos != NULL)
+			*_pos = pos + bytesSent;
+		else
+			file->pos = pos + bytesSent;
+	}
+
+	return bytesSent;
+}
+
+
 static status_t
 common_get_next_socket_stat(int family, uint32 *cookie, struct net_stat *stat)
 {
@@ -1106,6 +1242,30 @@ _user_sendmsg(int socket, const struct msghdr *userMessage, int flags)
 }
 
 
+ssize_t
+_user_sendfile(int socket, int fd, off_t* userPos, size_t count)
+{
+	off_t pos;
+	if (userPos != NULL) {
+		if (!IS_USER_ADDRESS(userPos)
+				|| user_memcpy(&pos, userPos, sizeof(off_t)) != B_OK) {
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	SyscallRestartWrapper<ssize_t> result;
+	result = common_sendfile(socket, fd, userPos != NULL ? &pos : NULL, count,
+		false);
+
+	if (result > 0 && userPos != NULL
+			&& user_memcpy(userPos, &pos, sizeof(off_t)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
+
+
 status_t
 _user_getsockopt(int socket, int level, int option, void *userValue,
 	socklen_t *_length)
@@ -232,6 +232,10 @@ static recursive_lock sMountOpLock;
 	The holder is allowed read/write access to sVnodeTable and to
 	any unbusy vnode in that table, save to the immutable fields (device, id,
 	private_node, mount) to which only read-only access is allowed.
+	A read lock suffices to look up and insert vnodes, since the table's shards
+	are also protected by their own locks (cf. VnodeTable). Removing vnodes from
+	the table requires the write lock, though, so that a read lock keeps any
+	vnode found in the table alive.
 	The mutable fields advisory_locking, mandatory_locked_by, and ref_count, as
 	well as the busy, removed, unused flags, and the vnode's type can also be
 	write accessed when holding a read lock to sVnodeLock *and* having the vnode
@@ -255,6 +259,12 @@ static mutex sIOContextRootLock = MUTEX_INITIALIZER("io_context::root lock");
 
 namespace {
 
+static const uint32 kVnodeTableShardShift = 4;
+static const uint32 kVnodeTableShards = 1 << kVnodeTableShardShift;
+
+#define VHASH(mountid, vnodeid) \
+	(((uint32)((vnodeid) >> 32) + (uint32)(vnodeid)) ^ (uint32)(mountid))
+
 struct vnode_hash_key {
 	dev_t	device;
 	ino_t	vnode;
@@ -264,21 +274,17 @@ struct VnodeHash {
 	typedef vnode_hash_key	KeyType;
 	typedef	struct vnode	ValueType;
 
-#define VHASH(mountid, vnodeid) \
-	(((uint32)((vnodeid) >> 32) + (uint32)(vnodeid)) ^ (uint32)(mountid))
-
+	// the lowest bits of the hash select the shard
 	size_t HashKey(KeyType key) const
 	{
-		return VHASH(key.device, key.vnode);
+		return VHASH(key.device, key.vnode) >> kVnodeTableShardShift;
 	}
 
 	size_t Hash(ValueType* vnode) const
 	{
-		return VHASH(vnode->device, vnode->id);
+		return VHASH(vnode->device, vnode->id) >> kVnodeTableShardShift;
 	}
 
-#undef VHASH
-
 	bool Compare(KeyType key, ValueType* vnode) const
 	{
 		return vnode->device == key.device && vnode->id == key.vnode;
@@ -290,7 +296,81 @@ struct VnodeHash {
 	}
 };
 
-typedef BOpenHashTable<VnodeHash> VnodeTable;
+typedef BOpenHashTable<VnodeHash> VnodeShardTable;
+
+
+/*!	The hash table of all vnodes, split into shards that are each protected by
+	their own read/write lock, in addition to sVnodeLock.
+	Looking up and inserting vnodes only requires sVnodeLock to be read locked,
+	the shard is locked by the table itself. Removing vnodes requires
+	sVnodeLock to be write locked; the table must only be iterated with the
+	write lock held, too (or in the kernel debugger).
+*/
+class VnodeTable {
+public:
+								VnodeTable();
+								~VnodeTable();
+
+			status_t			Init(size_t initialSize);
+
+			struct vnode*		Lookup(vnode_hash_key key);
+			struct vnode*		DebugLookup(vnode_hash_key key);
+			struct vnode*		InsertUnlessExists(struct vnode* vnode);
+			void				Remove(struct vnode* vnode);
+
+			size_t				CountElements() const;
+
+	class Iterator {
+	public:
+		Iterator(VnodeTable* table)
+			:
+			fTable(table),
+			fShard(0),
+			fIterator(&table->fShards[0].table)
+		{
+			_Skip();
+		}
+
+		bool HasNext() const
+		{
+			return fIterator.HasNext();
+		}
+
+		struct vnode* Next()
+		{
+			struct vnode* vnode = fIterator.Next();
+			_Skip();
+			return vnode;
+		}
+
+	private:
+		void _Skip()
+		{
+			while (!fIterator.HasNext() && ++fShard < kVnodeTableShards) {
+				fIterator = VnodeShardTable::Iterator(
+					&fTable->fShards[fShard].table);
+			}
+		}
+
+	private:
+		VnodeTable*					fTable;
+		uint32						fShard;
+		VnodeShardTable::Iterator	fIterator;
+	};
+
+private:
+	friend class Iterator;
+
+	struct Shard {
+		rw_lock					lock;
+		VnodeShardTable			table;
+	};
+
+	inline	Shard&				_ShardFor(dev_t device, ino_t id);
+
+private:
+			Shard				fShards[kVnodeTableShards];
+};
 
 
 struct MountHash {
@@ -320,6 +400,111 @@ struct MountHash {
 
 typedef BOpenHashTable<MountHash> MountTable;
 
+
+VnodeTable::VnodeTable()
+{
+	for (uint32 i = 0; i < kVnodeTableShards; i++)
+		rw_lock_init(&fShards[i].lock, "vfs vnode table shard");
+}
+
+
+VnodeTable::~VnodeTable()
+{
+	for (uint32 i = 0; i < kVnodeTableShards; i++)
+		rw_lock_destroy(&fShards[i].lock);
+}
+
+
+inline VnodeTable::Shard&
+VnodeTable::_ShardFor(dev_t device, ino_t id)
+{
+	return fShards[VHASH(device, id) & (kVnodeTableShards - 1)];
+}
+
+
+status_t
+VnodeTable::Init(size_t initialSize)
+{
+	initialSize /= kVnodeTableShards;
+
+	for (uint32 i = 0; i < kVnodeTableShards; i++) {
+		status_t status = fShards[i].table.Init(initialSize);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+/*!	sVnodeLock must be read locked at least. */
+struct vnode*
+VnodeTable::Lookup(vnode_hash_key key)
+{
+	Shard& shard = _ShardFor(key.device, key.vnode);
+	ReadLocker locker(shard.lock);
+
+	return shard.table.Lookup(key);
+}
+
+
+/*!	Like Lookup(), but doesn't lock the shard, as that could deadlock when
+	the kernel debugger was entered while a shard lock was held.
+	Must only be used in the kernel debugger.
+*/
+struct vnode*
+VnodeTable::DebugLookup(vnode_hash_key key)
+{
+	return _ShardFor(key.device, key.vnode).table.Lookup(key);
+}
+
+
+/*!	Inserts the vnode into the table, unless another one with the same ID is
+	already there, in which case that one is returned instead.
+	sVnodeLock must be read locked at least.
+*/
+struct vnode*
+VnodeTable::InsertUnlessExists(struct vnode* vnode)
+{
+	Shard& shard = _ShardFor(vnode->device, vnode->id);
+	WriteLocker locker(shard.lock);
+
+	vnode_hash_key key;
+	key.device = vnode->device;
+	key.vnode = vnode->id;
+
+	struct vnode* existingVnode = shard.table.Lookup(key);
+	if (existingVnode != NULL)
+		return existingVnode;
+
+	shard.table.Insert(vnode);
+	return NULL;
+}
+
+
+/*!	sVnodeLock must be write locked. */
+void
+VnodeTable::Remove(struct vnode* vnode)
+{
+	Shard& shard = _ShardFor(vnode->device, vnode->id);
+	WriteLocker locker(shard.lock);
+
+	shard.table.Remove(vnode);
+}
+
+
+size_t
+VnodeTable::CountElements() const
+{
+	size_t count = 0;
+	for (uint32 i = 0; i < kVnodeTableShards; i++)
+		count += fShards[i].table.CountElements();
+
+	return count;
+}
+
+#undef VHASH
+
 } // namespace
 
 
@@ -899,6 +1084,22 @@ lookup_vnode(dev_t mountID, ino_t vnodeID)
 }
 
 
+/*!	\brief Looks up a vnode by mount and node ID without any locking.
+
+	Must only be called from within the kernel debugger.
+*/
+static struct vnode*
+debug_lookup_vnode(dev_t mountID, ino_t vnodeID)
+{
+	struct vnode_hash_key key;
+
+	key.device = mountID;
+	key.vnode = vnodeID;
+
+	return sVnodeTable->DebugLookup(key);
+}
+
+
 /*!	\brief Checks whether or not a busy vnode should be waited for (again).
 
 	This will also wait for BUSY_VNODE_DELAY before returning if one should
@@ -932,13 +1133,15 @@ retry_busy_vnode(int32& tries, dev_t mountID, ino_t vnodeID)
 	\param _nodeCreated Will be set to \c true when the returned vnode has
 		been newly created, \c false when it already existed. Will not be
 		changed on error.
+	\param writeLock If \c false, \c sVnodeLock is only read locked, which
+		does not keep other threads from walking paths in the mean time.
 	\return \c B_OK, when the vnode was successfully created and inserted or
 		a node with the given ID was found, \c B_NO_MEMORY or
 		\c B_ENTRY_NOT_FOUND on error.
 */
 static status_t
 create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
-	bool& _nodeCreated)
+	bool& _nodeCreated, bool writeLock = true)
 {
 	FUNCTION(("create_new_vnode_and_lock()\n"));
 
@@ -955,7 +1158,11 @@ create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
 
 	// look up the node -- it might have been added by someone else in the
 	// meantime
-	rw_lock_write_lock(&sVnodeLock);
+	if (writeLock)
+		rw_lock_write_lock(&sVnodeLock);
+	else
+		rw_lock_read_lock(&sVnodeLock);
+
 	struct vnode* existingVnode = lookup_vnode(mountID, vnodeID);
 	if (existingVnode != NULL) {
 		free(vnode);
@@ -969,13 +1176,25 @@ create_new_vnode_and_lock(dev_t mountID, ino_t vnodeID, struct vnode*& _vnode,
 	vnode->mount = find_mount(mountID);
 	if (!vnode->mount || vnode->mount->unmounting) {
 		mutex_unlock(&sMountMutex);
-		rw_lock_write_unlock(&sVnodeLock);
+		if (writeLock)
+			rw_lock_write_unlock(&sVnodeLock);
+		else
+			rw_lock_read_unlock(&sVnodeLock);
 		free(vnode);
 		return B_ENTRY_NOT_FOUND;
 	}
 
-	// add the vnode to the mount's node list and the hash table
-	sVnodeTable->Insert(vnode);
+	// add the vnode to the hash table and the mount's node list -- with only
+	// the read lock, someone else might have been faster, though
+	existingVnode = sVnodeTable->InsertUnlessExists(vnode);
+	if (existingVnode != NULL) {
+		mutex_unlock(&sMountMutex);
+		free(vnode);
+		_vnode = existingVnode;
+		_nodeCreated = false;
+		return B_OK;
+	}
+
 	add_vnode_to_mount_list(vnode, vnode->mount);
 
 	mutex_unlock(&sMountMutex);
@@ -1067,6 +1286,18 @@ free_vnode(struct vnode* vnode, bool reenter)
 static status_t
 dec_vnode_ref_count(struct vnode* vnode, bool alwaysFree, bool reenter)
 {
+	// Unless this is the last reference, nothing but the reference count
+	// changes, and we don't need to lock anything.
+	int32 refCount = atomic_get(&vnode->ref_count);
+	while (refCount > 1) {
+		int32 previous = atomic_test_and_set(&vnode->ref_count, refCount - 1,
+			refCount);
+		if (previous == refCount)
+			return B_OK;
+
+		refCount = previous;
+	}
+
 	ReadLocker locker(sVnodeLock);
 	AutoLocker<Vnode> nodeLocker(vnode);
 
@@ -1132,6 +1363,48 @@ inc_vnode_ref_count(struct vnode* vnode)
 }
 
 
+/*!	\brief Increments the reference counter of the given vnode, if it is in
+	use and not busy.
+
+	Unlike get_vnode() this does not lock the vnode, and is therefore the way
+	to get a reference to frequently used nodes, like the directories of
+	commonly walked paths. Since the reference count is only changed when it
+	is not 0, the node can neither be unused nor just being freed, and the
+	caller can rely on the 0 -> 1 transition being handled with the node
+	locked.
+	The caller must hold \c sVnodeLock read locked at least, which keeps the
+	node from being freed.
+
+	This is as far as the path walk gets without locking nodes. A walk that
+	does not take references at all, and validates what it saw with sequence
+	counts, would need freeing vnodes and entry cache entries to be deferred.
+	The only grace period the kernel offers for that is the one the route
+	table uses, call_all_cpus_sync(), and it only protects readers that run
+	with interrupts disabled. vnode_path_to_vnode() calls the file system's
+	access() hook for every directory it passes, and that hook may block, so
+	the walk needs a real reference at every step anyway.
+
+	\param vnode the vnode.
+	\return \c true, if a reference has been acquired, \c false if the caller
+		has to fall back to locking the node.
+*/
+static bool
+try_inc_vnode_ref_count(struct vnode* vnode)
+{
+	int32 refCount = atomic_get(&vnode->ref_count);
+	while (refCount > 0 && !vnode->IsBusy()) {
+		int32 previous = atomic_test_and_set(&vnode->ref_count, refCount + 1,
+			refCount);
+		if (previous == refCount)
+			return true;
+
+		refCount = previous;
+	}
+
+	return false;
+}
+
+
 static bool
 is_special_node_type(int type)
 {
@@ -1176,6 +1449,12 @@ get_vnode(dev_t mountID, ino_t vnodeID, struct vnode** _vnode, bool canWait,
 	int32 tries = BUSY_VNODE_RETRIES;
 restart:
 	struct vnode* vnode = lookup_vnode(mountID, vnodeID);
+	if (vnode != NULL && try_inc_vnode_ref_count(vnode)) {
+		rw_lock_read_unlock(&sVnodeLock);
+		*_vnode = vnode;
+		return B_OK;
+	}
+
 	AutoLocker<Vnode> nodeLocker(vnode);
 
 	if (vnode && vnode->IsBusy()) {
@@ -1209,20 +1488,17 @@ restart:
 	} else {
 		// we need to create a new vnode and read it in
 		rw_lock_read_unlock(&sVnodeLock);
-			// unlock -- create_new_vnode_and_lock() write-locks on success
+			// unlock -- create_new_vnode_and_lock() read-locks on success
 		bool nodeCreated;
 		status = create_new_vnode_and_lock(mountID, vnodeID, vnode,
-			nodeCreated);
+			nodeCreated, false);
 		if (status != B_OK)
 			return status;
 
-		if (!nodeCreated) {
-			rw_lock_read_lock(&sVnodeLock);
-			rw_lock_write_unlock(&sVnodeLock);
+		if (!nodeCreated)
 			goto restart;
-		}
 
-		rw_lock_write_unlock(&sVnodeLock);
+		rw_lock_read_unlock(&sVnodeLock);
 
 		int type;
 		uint32 flags;
@@ -3112,7 +3388,7 @@ debug_resolve_vnode_path(struct vnode* vnode, char* buffer, size_t bufferSize,
 		}
 
 		// resolve the directory node
-		struct vnode* nextVnode = lookup_vnode(vnode->mount->id, dirID);
+		struct vnode* nextVnode = debug_lookup_vnode(vnode->mount->id, dirID);
 		if (nextVnode == NULL) {
 			_truncated = !debug_prepend_vnode_id_to_path(buffer, bufferSize,
 				vnode->mount->id, dirID);
@@ -3259,15 +3535,13 @@ dump_vnode(int argc, char** argv)
 	dev_t device = parse_expression(argv[argi]);
 	ino_t id = parse_expression(argv[argi + 1]);
 
-	VnodeTable::Iterator iterator(sVnodeTable);
-	while (iterator.HasNext()) {
-		vnode = iterator.Next();
-		if (vnode->id != id || vnode->device != device)
-			continue;
-
-		_dump_vnode(vnode, printPath);
+	vnode = debug_lookup_vnode(device, id);
+	if (vnode == NULL) {
+		kprintf("vnode %" B_PRIdDEV ":%" B_PRIdINO " not found\n", device, id);
+		return 0;
 	}
 
+	_dump_vnode(vnode, printPath);
 	return 0;
 }
 
@@ -3401,6 +3675,33 @@ dump_io_context(int argc, char** argv)
 }
 
 
+static int
+dump_entry_caches(int argc, char** argv)
+{
+	if (argc > 2 || (argc == 2 && !strcmp(argv[1], "--help"))) {
+		kprintf("usage: %s [id]\n", argv[0]);
+		return 0;
+	}
+
+	dev_t device = -1;
+	if (argc == 2)
+		device = parse_expression(argv[1]);
+
+	MountTable::Iterator iterator(sMountsTable);
+	while (iterator.HasNext()) {
+		struct fs_mount* mount = iterator.Next();
+		if (device != -1 && mount->id != device)
+			continue;
+
+		kprintf("mount %" B_PRIdDEV " (%s):\n", mount->id,
+			mount->volume->file_system_name);
+		mount->entry_cache.Dump();
+	}
+
+	return 0;
+}
+
+
 int
 dump_vnode_usage(int argc, char** argv)
 {
@@ -3642,6 +3943,8 @@ free_io_context(io_context* context)
 
 	mutex_lock(&context->io_mutex);
 
+	deselect_all_fds(context);
+
 	for (i = 0; i < context->table_size; i++) {
 		if (struct file_descriptor* descriptor = context->fds[i]) {
 			close_fd(descriptor);
@@ -4145,10 +4448,69 @@ entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 }
 
 
+/*!	Adds all entries of a directory to the entry cache at once, and marks the
+	directory complete, so that the lookup of any other name in it fails without
+	calling the file system. The file system must make sure that the directory
+	does not change while it collects the entries, and it must send entry
+	created/removed/moved notifications for any later change, which keep the
+	entry cache up-to-date.
+	Only worth it for small directories in which many lookups fail.
+*/
+extern "C" status_t
+entry_cache_add_complete_directory(dev_t mountID, ino_t dirID,
+	const char* const* names, const ino_t* nodeIDs, int32 count)
+{
+	// lookup mount -- the caller is required to make sure that the mount
+	// won't go away
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return B_BAD_VALUE;
+	locker.Unlock();
+
+	return mount->entry_cache.AddCompleteDirectory(dirID, names, nodeIDs,
+		count);
+}
+
+
 //	#pragma mark - private VFS API
 //	Functions the VFS exports for other parts of the kernel
 
 
+/*!	Called by the node monitor, when a file system announced a new entry.
+	Drops a negative entry cache entry for it, so that file systems don't have
+	to do that themselves.
+*/
+void
+vfs_entry_created(dev_t mountID, ino_t directoryID, const char* name)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.EntryCreated(directoryID, name);
+}
+
+
+/*!	Called by the node monitor, when a file system announced that an entry has
+	been removed. Drops the respective entry cache entry.
+*/
+void
+vfs_entry_removed(dev_t mountID, ino_t directoryID, const char* name,
+	ino_t nodeID)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.EntryRemoved(directoryID, name, nodeID);
+}
+
+
 /*! Acquires another reference to the vnode that has to be released
 	by calling vfs_put_vnode().
 */
@@ -5305,6 +5667,8 @@ vfs_init(kernel_args* args)
 		"info about the I/O context");
 	add_debugger_command("vnode_usage", &dump_vnode_usage,
 		"info about vnode usage");
+	add_debugger_command("entry_caches", &dump_entry_caches,
+		"entry cache statistics (of the specified fs_mount)");
 #endif
 
 	register_low_resource_handler(&vnode_low_resource_handler, NULL,
@@ -9092,6 +9456,45 @@ _user_fsync(int fd)
 }
 
 
+status_t
+_user_file_advice(int fd, off_t offset, off_t length, int advice)
+{
+	if (offset < 0 || length < 0)
+		return B_BAD_VALUE;
+
+	switch (advice) {
+		case POSIX_FADV_NORMAL:
+		case POSIX_FADV_RANDOM:
+		case POSIX_FADV_SEQUENTIAL:
+		case POSIX_FADV_WILLNEED:
+		case POSIX_FADV_DONTNEED:
+		case POSIX_FADV_NOREUSE:
+			break;
+
+		default:
+			return B_BAD_VALUE;
+	}
+
+	struct vnode* vnode;
+	struct file_descriptor* descriptor = get_fd_and_vnode(fd, &vnode, false);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	// Files without a cache ignore the advice, it's only a hint anyway.
+	status_t status = B_OK;
+	VMCache* cache;
+	if (S_ISFIFO(vnode->Type()))
+		status = ESPIPE;
+	else if (vfs_get_vnode_cache(vnode, &cache, false) == B_OK) {
+		status = file_cache_advise(cache, offset, length, advice);
+		cache->ReleaseRef();
+	}
+
+	put_fd(descriptor);
+	return status;
+}
+
+
 status_t
 _user_flock(int fd, int operation)
 {
@@ -1028,6 +1028,13 @@ object_cache_get_usage(object_cache* cache, size_t* _allocatedMemory)
 }
 
 
+status_t
+_user_get_object_cache_stats(object_cache_stats* stats, uint32* _count)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 void
 slab_init(kernel_args* args)
 {
@@ -18,12 +18,17 @@
 
 #include <OS.h>
 
+#include <cpu.h>
 #include <debug.h>
+#include <generic_syscall.h>
 #include <int.h>
 #include <kernel.h>
 #include <listeners.h>
+#include <lock_contention.h>
 #include <scheduling_analysis.h>
+#include <smp.h>
 #include <thread.h>
+#include <user_mutex.h>
 #include <util/AutoLock.h>
 
 #include <__external_threading>
@@ -46,6 +51,52 @@ struct rw_lock_waiter {
 
 #define RW_LOCK_FLAG_OWNS_NAME	RW_LOCK_FLAG_CLONE_NAME
 
+// The number of times a thread polls a lock whose holder is running, before
+// it gives up and blocks anyway.
+static const int32 kMaxSpinCount = 500;
+
+static lock_contention_info sContentionInfo;
+
+
+/*!	Returns the CPU the thread with ID \a holder is currently running on, and
+	that thread in \a _holderThread. Returns \c NULL, if the thread isn't
+	running, or if spinning doesn't make sense for other reasons.
+	Since nothing is locked, the result is only a hint.
+*/
+static cpu_ent*
+running_lock_holder_cpu(thread_id holder, Thread*& _holderThread)
+{
+	if (holder < 0 || holder == thread_get_current_thread_id()
+		|| gKernelStartup || !are_interrupts_enabled()) {
+		return NULL;
+	}
+
+	int32 cpuCount = smp_get_num_cpus();
+	if (cpuCount < 2)
+		return NULL;
+
+	for (int32 i = 0; i < cpuCount; i++) {
+		Thread* thread = gCPU[i].running_thread;
+		if (thread != NULL && thread->id == holder) {
+			_holderThread = thread;
+			return &gCPU[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+static inline void
+count_contention(lock_contention_stats& stats, bool spun, bool blocked)
+{
+	atomic_add64(&stats.contended, 1);
+	if (blocked)
+		atomic_add64(&stats.blocked, 1);
+	else if (spun)
+		atomic_add64(&stats.spin_acquired, 1);
+}
+
 
 int32
 recursive_lock_get_recursion(recursive_lock *lock)
@@ -149,6 +200,39 @@ recursive_lock_unlock(recursive_lock *lock)
 //	#pragma mark -
 
 
+/*!	Spins as long as the thread holding the write lock is running, since it
+	is likely to release the lock soon. Returns whether the write lock has
+	been released in the meantime.
+*/
+static bool
+rw_lock_spin(rw_lock* lock, bool writer)
+{
+	thread_id holder = atomic_get(&lock->holder);
+	Thread* holderThread;
+	cpu_ent* cpu = running_lock_holder_cpu(holder, holderThread);
+	if (cpu == NULL)
+		return false;
+
+	for (int32 i = 0; i < kMaxSpinCount; i++) {
+		// if others are waiting already, they will get the lock first
+		if (*(rw_lock_waiter* volatile*)&lock->waiters != NULL)
+			return false;
+
+		if (writer ? atomic_get(&lock->count) == 0
+				: atomic_get(&lock->holder) != holder) {
+			return true;
+		}
+
+		if (cpu->running_thread != holderThread)
+			return false;
+
+		cpu_pause();
+	}
+
+	return false;
+}
+
+
 static status_t
 rw_lock_wait(rw_lock* lock, bool writer, InterruptsSpinLocker& locker)
 {
@@ -306,6 +390,8 @@ rw_lock_destroy(rw_lock* lock)
 status_t
 _rw_lock_read_lock(rw_lock* lock)
 {
+	bool spun = rw_lock_spin(lock, false);
+
 	InterruptsSpinLocker locker(lock->lock);
 
 	// We might be the writer ourselves.
@@ -324,12 +410,14 @@ _rw_lock_read_lock(rw_lock* lock)
 		if (lock->count >= RW_LOCK_WRITER_COUNT_BASE)
 			lock->active_readers++;
 
+		count_contention(sContentionInfo.rw_locks, spun, false);
 		return B_OK;
 	}
 
 	ASSERT(lock->count >= RW_LOCK_WRITER_COUNT_BASE);
 
 	// we need to wait
+	count_contention(sContentionInfo.rw_locks, spun, true);
 	return rw_lock_wait(lock, false, locker);
 }
 
@@ -338,6 +426,8 @@ status_t
 _rw_lock_read_lock_with_timeout(rw_lock* lock, uint32 timeoutFlags,
 	bigtime_t timeout)
 {
+	bool spun = rw_lock_spin(lock, false);
+
 	InterruptsSpinLocker locker(lock->lock);
 
 	// We might be the writer ourselves.
@@ -356,12 +446,14 @@ _rw_lock_read_lock_with_timeout(rw_lock* lock, uint32 timeoutFlags,
 		if (lock->count >= RW_LOCK_WRITER_COUNT_BASE)
 			lock->active_readers++;
 
+		count_contention(sContentionInfo.rw_locks, spun, false);
 		return B_OK;
 	}
 
 	ASSERT(lock->count >= RW_LOCK_WRITER_COUNT_BASE);
 
 	// we need to wait
+	count_contention(sContentionInfo.rw_locks, spun, true);
 
 	// enqueue in waiter list
 	rw_lock_waiter waiter;
@@ -450,6 +542,12 @@ _rw_lock_read_unlock(rw_lock* lock)
 status_t
 rw_lock_write_lock(rw_lock* lock)
 {
+	// If another writer holds the lock, give it a chance to release it before
+	// we start to wait.
+	bool spun = false;
+	if (atomic_get(&lock->count) != 0)
+		spun = rw_lock_spin(lock, true);
+
 	InterruptsSpinLocker locker(lock->lock);
 
 	// If we're already the lock holder, we just need to increment the owner
@@ -467,9 +565,13 @@ rw_lock_write_lock(rw_lock* lock)
 		// No-one else held a read or write lock, so it's ours now.
 		lock->holder = thread;
 		lock->owner_count = RW_LOCK_WRITER_COUNT_BASE;
+		if (spun)
+			count_contention(sContentionInfo.rw_locks, true, false);
 		return B_OK;
 	}
 
+	count_contention(sContentionInfo.rw_locks, spun, true);
+
 	// We have to wait. If we're the first writer, note the current reader
 	// count.
 	if (oldCount < RW_LOCK_WRITER_COUNT_BASE)
@@ -576,9 +678,8 @@ mutex_init(mutex* lock, const char *name)
 	lock->name = name;
 	lock->waiters = NULL;
 	B_INITIALIZE_SPINLOCK(&lock->lock);
-#if KDEBUG
 	lock->holder = -1;
-#else
+#if !KDEBUG
 	lock->count = 0;
 	lock->ignore_unlock_count = 0;
 #endif
@@ -595,9 +696,8 @@ mutex_init_etc(mutex* lock, const char *name, uint32 flags)
 	lock->name = (flags & MUTEX_FLAG_CLONE_NAME) != 0 ? strdup(name) : name;
 	lock->waiters = NULL;
 	B_INITIALIZE_SPINLOCK(&lock->lock);
-#if KDEBUG
 	lock->holder = -1;
-#else
+#if !KDEBUG
 	lock->count = 0;
 	lock->ignore_unlock_count = 0;
 #endif
@@ -644,6 +744,42 @@ mutex_destroy(mutex* lock)
 }
 
 
+/*!	Spins as long as the mutex holder is running, since it is likely to
+	release the lock soon. Returns whether the lock has been released in the
+	meantime.
+*/
+static bool
+mutex_spin(mutex* lock)
+{
+	Thread* holderThread;
+	cpu_ent* cpu = running_lock_holder_cpu(atomic_get(&lock->holder),
+		holderThread);
+	if (cpu == NULL)
+		return false;
+
+	for (int32 i = 0; i < kMaxSpinCount; i++) {
+		// if others are waiting already, they will get the lock first
+		if (*(mutex_waiter* volatile*)&lock->waiters != NULL)
+			return false;
+
+#if KDEBUG
+		if (atomic_get(&lock->holder) < 0)
+			return true;
+#else
+		if ((*(volatile uint8*)&lock->flags & MUTEX_FLAG_RELEASED) != 0)
+			return true;
+#endif
+
+		if (cpu->running_thread != holderThread)
+			return false;
+
+		cpu_pause();
+	}
+
+	return false;
+}
+
+
 static inline status_t
 mutex_lock_threads_locked(mutex* lock, InterruptsSpinLocker* locker)
 {
@@ -652,6 +788,7 @@ mutex_lock_threads_locked(mutex* lock, InterruptsSpinLocker* locker)
 #else
 	if (atomic_add(&lock->count, -1) < 0)
 		return _mutex_lock(lock, locker);
+	lock->holder = thread_get_current_thread_id();
 	return B_OK;
 #endif
 }
@@ -663,6 +800,7 @@ mutex_switch_lock(mutex* from, mutex* to)
 	InterruptsSpinLocker locker(to->lock);
 
 #if !KDEBUG
+	from->holder = -1;
 	if (atomic_add(&from->count, 1) < -1)
 #endif
 		_mutex_unlock(from);
@@ -702,8 +840,12 @@ _mutex_lock(mutex* lock, void* _locker)
 	InterruptsSpinLocker* locker
 		= reinterpret_cast<InterruptsSpinLocker*>(_locker);
 
+	// If the caller already holds the mutex' spinlock, we must not spin, since
+	// the holder couldn't release the mutex in the meantime.
+	bool spun = false;
 	InterruptsSpinLocker lockLocker;
 	if (locker == NULL) {
+		spun = mutex_spin(lock);
 		lockLocker.SetTo(lock->lock, false);
 		locker = &lockLocker;
 	}
@@ -713,6 +855,8 @@ _mutex_lock(mutex* lock, void* _locker)
 #if KDEBUG
 	if (lock->holder < 0) {
 		lock->holder = thread_get_current_thread_id();
+		if (spun)
+			count_contention(sContentionInfo.mutexes, true, false);
 		return B_OK;
 	} else if (lock->holder == thread_get_current_thread_id()) {
 		panic("_mutex_lock(): double lock of %p by thread %" B_PRId32, lock,
@@ -722,10 +866,14 @@ _mutex_lock(mutex* lock, void* _locker)
 #else
 	if ((lock->flags & MUTEX_FLAG_RELEASED) != 0) {
 		lock->flags &= ~MUTEX_FLAG_RELEASED;
+		lock->holder = thread_get_current_thread_id();
+		count_contention(sContentionInfo.mutexes, spun, false);
 		return B_OK;
 	}
 #endif
 
+	count_contention(sContentionInfo.mutexes, spun, true);
+
 	// enqueue in waiter list
 	mutex_waiter waiter;
 	waiter.thread = thread_get_current_thread();
@@ -743,10 +891,8 @@ _mutex_lock(mutex* lock, void* _locker)
 	locker->Unlock();
 
 	status_t error = thread_block();
-#if KDEBUG
 	if (error == B_OK)
 		atomic_set(&lock->holder, waiter.thread->id);
-#endif
 	return error;
 }
 
@@ -776,20 +922,16 @@ _mutex_unlock(mutex* lock)
 		lock->waiters = waiter->next;
 		if (lock->waiters != NULL)
 			lock->waiters->last = waiter->last;
-#if KDEBUG
 		thread_id unblockedThread = waiter->thread->id;
-#endif
 
 		// unblock thread
 		thread_unblock(waiter->thread, B_OK);
 
-#if KDEBUG
 		// Already set the holder to the unblocked thread. Besides that this
 		// actually reflects the current situation, setting it to -1 would
 		// cause a race condition, since another locker could think the lock
 		// is not held by anyone.
 		lock->holder = unblockedThread;
-#endif
 	} else {
 		// We've acquired the spinlock before the locker that is going to wait.
 		// Just mark the lock as released.
@@ -827,6 +969,8 @@ _mutex_lock_with_timeout(mutex* lock, uint32 timeoutFlags, bigtime_t timeout)
 	}
 #endif
 
+	bool spun = mutex_spin(lock);
+
 	InterruptsSpinLocker locker(lock->lock);
 
 	// Might have been released after we decremented the count, but before
@@ -834,6 +978,8 @@ _mutex_lock_with_timeout(mutex* lock, uint32 timeoutFlags, bigtime_t timeout)
 #if KDEBUG
 	if (lock->holder < 0) {
 		lock->holder = thread_get_current_thread_id();
+		if (spun)
+			count_contention(sContentionInfo.mutexes, true, false);
 		return B_OK;
 	} else if (lock->holder == thread_get_current_thread_id()) {
 		panic("_mutex_lock(): double lock of %p by thread %" B_PRId32, lock,
@@ -843,10 +989,14 @@ _mutex_lock_with_timeout(mutex* lock, uint32 timeoutFlags, bigtime_t timeout)
 #else
 	if ((lock->flags & MUTEX_FLAG_RELEASED) != 0) {
 		lock->flags &= ~MUTEX_FLAG_RELEASED;
+		lock->holder = thread_get_current_thread_id();
+		count_contention(sContentionInfo.mutexes, spun, false);
 		return B_OK;
 	}
 #endif
 
+	count_contention(sContentionInfo.mutexes, spun, true);
+
 	// enqueue in waiter list
 	mutex_waiter waiter;
 	waiter.thread = thread_get_current_thread();
@@ -866,9 +1016,7 @@ _mutex_lock_with_timeout(mutex* lock, uint32 timeoutFlags, bigtime_t timeout)
 	status_t error = thread_block_with_timeout(timeoutFlags, timeout);
 
 	if (error == B_OK) {
-#if KDEBUG
 		lock->holder = waiter.thread->id;
-#endif
 	} else {
 		locker.Lock();
 
@@ -930,9 +1078,8 @@ dump_mutex_info(int argc, char** argv)
 	kprintf("mutex %p:\n", lock);
 	kprintf("  name:            %s\n", lock->name);
 	kprintf("  flags:           0x%x\n", lock->flags);
-#if KDEBUG
 	kprintf("  holder:          %" B_PRId32 "\n", lock->holder);
-#else
+#if !KDEBUG
 	kprintf("  count:           %" B_PRId32 "\n", lock->count);
 #endif
 
@@ -948,6 +1095,28 @@ dump_mutex_info(int argc, char** argv)
 }
 
 
+static status_t
+lock_contention_syscall(const char* subsystem, uint32 function,
+	void* buffer, size_t bufferSize)
+{
+	if (function != GET_LOCK_CONTENTION_INFO)
+		return B_BAD_VALUE;
+
+	if (bufferSize < sizeof(lock_contention_info))
+		return B_BAD_VALUE;
+
+	lock_contention_info info = sContentionInfo;
+	user_mutex_get_contention_stats(&info.user_mutexes);
+
+	if (!IS_USER_ADDRESS(buffer)
+		|| user_memcpy(buffer, &info, sizeof(info)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return B_OK;
+}
+
+
 // #pragma mark -
 
 
@@ -966,6 +1135,14 @@ lock_debug_init()
 		"  <lock>  - pointer to the rw lock to print the info for.\n", 0);
 }
 
+
+status_t
+lock_init_post_generic_syscalls()
+{
+	return register_generic_syscall(LOCK_CONTENTION, &lock_contention_syscall,
+		0, 0);
+}
+
 _LIBCPP_BEGIN_NAMESPACE_STD
 
 int __libcpp_recursive_mutex_init(__libcpp_recursive_mutex_t *__m) {
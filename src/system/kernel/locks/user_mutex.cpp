@@ -10,10 +10,13 @@
 #include <user_mutex_defs.h>
 
 #include <condition_variable.h>
+#include <cpu.h>
 #include <kernel.h>
 #include <lock.h>
+#include <lock_contention.h>
 #include <smp.h>
 #include <syscall_restart.h>
+#include <thread.h>
 #include <util/AutoLock.h>
 #include <util/OpenHashTable.h>
 #include <vm/vm.h>
@@ -59,8 +62,13 @@ struct UserMutexHashDefinition {
 typedef BOpenHashTable<UserMutexHashDefinition> UserMutexTable;
 
 
+// The number of times a thread polls a contended mutex, before it gives up
+// and blocks.
+static const int32 kMaxSpinCount = 500;
+
 static UserMutexTable sUserMutexTable;
 static mutex sUserMutexTableLock = MUTEX_INITIALIZER("user mutex table");
+static lock_contention_stats sContentionStats;
 
 
 static void
@@ -100,6 +108,70 @@ remove_user_mutex_entry(UserMutexEntry* entry)
 }
 
 
+/*!	Returns whether another thread of the current team is running. We don't
+	know which thread holds a user mutex, but unless the mutex is shared
+	between teams, this is a precondition for its holder to be running.
+*/
+static bool
+other_team_thread_running()
+{
+	int32 cpuCount = smp_get_num_cpus();
+	if (cpuCount < 2)
+		return false;
+
+	Thread* currentThread = thread_get_current_thread();
+	for (int32 i = 0; i < cpuCount; i++) {
+		Thread* thread = gCPU[i].running_thread;
+		if (thread != NULL && thread != currentThread
+			&& thread->team == currentThread->team) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*!	Spins on the user mutex for a while, if its holder might be running, and
+	grabs it when it is released. This is only possible as long as no other
+	thread is waiting for the mutex, since that one has to be woken up first.
+	The page of the mutex must be wired.
+*/
+static bool
+user_mutex_spin(int32* mutex)
+{
+	if (!other_team_thread_running())
+		return false;
+
+	for (int32 i = 0; i < kMaxSpinCount; i++) {
+		set_ac();
+		int32 oldValue = atomic_get(mutex);
+		clear_ac();
+
+		if ((oldValue & (B_USER_MUTEX_WAITING | B_USER_MUTEX_DISABLED)) != 0)
+			return false;
+
+		if ((oldValue & B_USER_MUTEX_LOCKED) == 0) {
+			set_ac();
+			int32 value = atomic_test_and_set(mutex,
+				oldValue | B_USER_MUTEX_LOCKED, oldValue);
+			clear_ac();
+			if (value == oldValue)
+				return true;
+			continue;
+		}
+
+		// check every now and then whether it's still worth it
+		if (i % 64 == 63 && !other_team_thread_running())
+			return false;
+
+		cpu_pause();
+	}
+
+	return false;
+}
+
+
 static status_t
 user_mutex_wait_locked(int32* mutex, addr_t physicalAddress, const char* name,
 	uint32 flags, bigtime_t timeout, MutexLocker& locker, bool& lastWaiter)
@@ -154,6 +226,9 @@ user_mutex_lock_locked(int32* mutex, addr_t physicalAddress,
 		return B_OK;
 	}
 
+	atomic_add64(&sContentionStats.contended, 1);
+	atomic_add64(&sContentionStats.blocked, 1);
+
 	bool lastWaiter;
 	status_t error = user_mutex_wait_locked(mutex, physicalAddress, name,
 		flags, timeout, locker, lastWaiter);
@@ -291,8 +366,11 @@ user_mutex_lock(int32* mutex, const char* name, uint32 flags, bigtime_t timeout)
 	if (error != B_OK)
 		return error;
 
-	// get the lock
-	{
+	// get the lock -- its holder might release it soon
+	if (user_mutex_spin(mutex)) {
+		atomic_add64(&sContentionStats.contended, 1);
+		atomic_add64(&sContentionStats.spin_acquired, 1);
+	} else {
 		MutexLocker locker(sUserMutexTableLock);
 		error = user_mutex_lock_locked(mutex, wiringInfo.physicalAddress, name,
 			flags, timeout, locker);
@@ -352,6 +430,13 @@ user_mutex_init()
 }
 
 
+void
+user_mutex_get_contention_stats(lock_contention_stats* stats)
+{
+	*stats = sContentionStats;
+}
+
+
 // #pragma mark - syscalls
 
 
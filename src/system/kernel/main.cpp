@@ -186,6 +186,7 @@ _start(kernel_args *bootKernelArgs, int currentCPU)
 		TRACE("init generic syscall\n");
 		generic_syscall_init();
 		smp_init_post_generic_syscalls();
+		lock_init_post_generic_syscalls();
 		TRACE("init scheduler\n");
 		scheduler_init();
 		TRACE("init threads\n");
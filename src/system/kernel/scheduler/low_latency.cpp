@@ -44,20 +44,36 @@ has_cache_expired(const ThreadData* threadData)
 
 
 static CoreEntry*
-choose_core(const ThreadData* /* threadData */)
+choose_idle_core(int32 memoryNode)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
 	// wake new package
-	PackageEntry* package = gIdlePackageList.Last();
+	PackageEntry* package = PackageEntry::GetIdlePackage(memoryNode);
 	if (package == NULL) {
 		// wake new core
-		package = PackageEntry::GetMostIdlePackage();
+		package = PackageEntry::GetMostIdlePackage(memoryNode);
 	}
 
-	CoreEntry* core = NULL;
 	if (package != NULL)
-		core = package->GetIdleCore();
+		return package->GetIdleCore();
+
+	return NULL;
+}
+
+
+static CoreEntry*
+choose_core(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = NULL;
+
+	// prefer idle cores close to the thread's memory
+	if (gMemoryNodeCount > 1)
+		core = choose_idle_core(threadData->MemoryNode());
+	if (core == NULL)
+		core = choose_idle_core(-1);
 
 	if (core == NULL) {
 		ReadSpinLocker coreLocker(gCoreHeapsLock);
@@ -88,16 +104,24 @@ rebalance(const ThreadData* threadData)
 	coreLocker.Unlock();
 	ASSERT(other != NULL);
 
+	// Moving the thread away from its memory node makes all its memory
+	// accesses remote, so that has to pay off twice as much.
+	int32 loadDifference = kLoadDifference;
+	if (other->MemoryNode() != threadData->MemoryNode()
+		&& core->MemoryNode() == threadData->MemoryNode()) {
+		loadDifference *= 2;
+	}
+
 	// Check if the least loaded core is significantly less loaded than
 	// the current one.
 	int32 coreLoad = core->GetLoad();
 	int32 otherLoad = other->GetLoad();
-	if (other == core || otherLoad + kLoadDifference >= coreLoad)
+	if (other == core || otherLoad + loadDifference >= coreLoad)
 		return core;
 
 	// Check whether migrating the current thread would result in both core
 	// loads become closer to the average.
-	int32 difference = coreLoad - otherLoad - kLoadDifference;
+	int32 difference = coreLoad - otherLoad - loadDifference;
 	ASSERT(difference > 0);
 
 	int32 threadLoad = threadData->GetLoad() / core->CPUCount();
@@ -161,6 +185,8 @@ scheduler_mode_operations gSchedulerLowLatencyMode = {
 
 	5000,
 
+	STEAL_FROM_ANY_CORE,
+
 	switch_to_mode,
 	set_cpu_enabled,
 	has_cache_expired,
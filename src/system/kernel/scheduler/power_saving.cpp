@@ -66,14 +66,14 @@ choose_small_task_core()
 
 
 static CoreEntry*
-choose_idle_core()
+choose_idle_core(int32 memoryNode)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
-	PackageEntry* package = PackageEntry::GetLeastIdlePackage();
+	PackageEntry* package = PackageEntry::GetLeastIdlePackage(memoryNode);
 
 	if (package == NULL)
-		package = gIdlePackageList.Last();
+		package = PackageEntry::GetIdlePackage(memoryNode);
 
 	if (package != NULL)
 		return package->GetIdleCore();
@@ -100,7 +100,11 @@ choose_core(const ThreadData* threadData)
 		if (core == NULL) {
 			coreLocker.Unlock();
 
-			core = choose_idle_core();
+			// prefer idle cores close to the thread's memory
+			if (gMemoryNodeCount > 1)
+				core = choose_idle_core(threadData->MemoryNode());
+			if (core == NULL)
+				core = choose_idle_core(-1);
 
 			if (core == NULL) {
 				coreLocker.Lock();
@@ -245,6 +249,8 @@ scheduler_mode_operations gSchedulerPowerSavingMode = {
 
 	20000,
 
+	STEAL_NONE,
+
 	switch_to_mode,
 	set_cpu_enabled,
 	has_cache_expired,
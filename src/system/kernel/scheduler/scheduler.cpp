@@ -66,6 +66,7 @@ spinlock gSchedulerListenersLock = B_SPINLOCK_INITIALIZER;
 static scheduler_mode_operations* sSchedulerModes[] = {
 	&gSchedulerLowLatencyMode,
 	&gSchedulerPowerSavingMode,
+	&gSchedulerThroughputMode,
 };
 
 // Since CPU IDs used internally by the kernel bear no relation to the actual
@@ -92,6 +93,44 @@ scheduler_dump_thread_data(Thread* thread)
 }
 
 
+/*!	Called when a thread has to wait in the run queue of \a core, since all
+	of its CPUs are busy. If the scheduler mode allows idle CPUs to steal
+	threads from that core, one of them is woken up to do so right away,
+	instead of leaving the thread waiting until the end of the current quantum.
+*/
+static void
+wake_up_idle_cpu(CoreEntry* core)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	steal_scope scope = gCurrentMode->idle_steal_scope;
+	if (scope == STEAL_NONE)
+		return;
+
+	CoreEntry* idleCore = core->Package()->GetIdleCore();
+	if (idleCore == NULL && scope >= STEAL_FROM_MEMORY_NODE) {
+		PackageEntry* package
+			= PackageEntry::GetMostIdlePackage(core->MemoryNode());
+		if (package == NULL && scope == STEAL_FROM_ANY_CORE)
+			package = PackageEntry::GetMostIdlePackage();
+		if (package != NULL)
+			idleCore = package->GetIdleCore();
+	}
+
+	if (idleCore == NULL)
+		return;
+
+	CoreCPUHeapLocker locker(idleCore);
+	CPUEntry* cpu = idleCore->CPUHeap()->PeekRoot();
+	if (cpu == NULL || CPUPriorityHeap::GetKey(cpu) != B_IDLE_PRIORITY)
+		return;
+	locker.Unlock();
+
+	smp_send_ici(cpu->ID(), SMP_MSG_RESCHEDULE, 0, 0, 0, NULL,
+		SMP_MSG_FLAG_ASYNC);
+}
+
+
 static void
 enqueue(Thread* thread, bool newOne)
 {
@@ -136,7 +175,8 @@ enqueue(Thread* thread, bool newOne)
 			smp_send_ici(targetCPU->ID(), SMP_MSG_RESCHEDULE, 0, 0, 0,
 				NULL, SMP_MSG_FLAG_ASYNC);
 		}
-	}
+	} else if (!gSingleCore && thread->pinned_to_cpu == 0)
+		wake_up_idle_cpu(targetCore);
 }
 
 
@@ -395,6 +435,19 @@ reschedule(int32 nextState)
 			= cpu->ChooseNextThread(enqueueOldThread ? oldThreadData : NULL,
 				putOldThreadAtBack);
 
+		// rather than going idle, try to take over a thread that is waiting
+		// for another core
+		if (nextThreadData->IsIdle()) {
+			ThreadData* stolenThreadData = cpu->StealThread();
+			if (stolenThreadData != NULL) {
+				// the idle thread has already been removed from the run
+				// queue, unless it is the one currently running
+				if (nextThreadData != oldThreadData)
+					nextThreadData->Enqueue();
+				nextThreadData = stolenThreadData;
+			}
+		}
+
 		// update CPU heap
 		CoreCPUHeapLocker cpuLocker(core);
 		cpu->UpdatePriority(nextThreadData->GetEffectivePriority());
@@ -522,7 +575,8 @@ status_t
 scheduler_set_operation_mode(scheduler_mode mode)
 {
 	if (mode != SCHEDULER_MODE_LOW_LATENCY
-		&& mode != SCHEDULER_MODE_POWER_SAVING) {
+		&& mode != SCHEDULER_MODE_POWER_SAVING
+		&& mode != SCHEDULER_MODE_THROUGHPUT) {
 		return B_BAD_VALUE;
 	}
 
@@ -692,11 +746,14 @@ init()
 		CoreEntry* core = &gCoreEntries[sCPUToCore[i]];
 		PackageEntry* package = &gPackageEntries[sCPUToPackage[i]];
 
-		package->Init(sCPUToPackage[i]);
+		package->Init(sCPUToPackage[i], gCPU[i].memory_node);
 		core->Init(sCPUToCore[i], package);
 		gCPUEntries[i].Init(i, core);
 
 		core->AddCPU(&gCPUEntries[i]);
+
+		gMemoryNodeCount = std::max(gMemoryNodeCount,
+			gCPU[i].memory_node + 1);
 	}
 
 	packageEntriesDeleter.Detach();
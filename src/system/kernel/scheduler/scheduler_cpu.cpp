@@ -29,6 +29,8 @@ IdlePackageList gIdlePackageList;
 rw_spinlock gIdlePackageLock = B_RW_SPINLOCK_INITIALIZER;
 int32 gPackageCount;
 
+int32 gMemoryNodeCount = 1;
+
 
 }	// namespace Scheduler
 
@@ -255,6 +257,54 @@ CPUEntry::ChooseNextThread(ThreadData* oldThread, bool putAtBack)
 }
 
 
+/*!	Called when the CPU would go idle otherwise. Takes the thread with the
+	highest priority from the run queue of a busy core, and moves it to the
+	core of this CPU. Cores in the same package are preferred, as they share
+	at least the last level cache, then cores on the same memory node, and
+	finally all other cores, as far as the current scheduler mode allows.
+	Returns \c NULL, if there was no thread that could be stolen.
+*/
+ThreadData*
+CPUEntry::StealThread()
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	steal_scope maxScope = gCurrentMode->idle_steal_scope;
+	if (gSingleCore || maxScope == STEAL_NONE)
+		return NULL;
+
+	for (int32 scope = STEAL_FROM_PACKAGE; scope <= maxScope; scope++) {
+		CoreEntry* victim = _ChooseStealVictim((steal_scope)scope);
+		if (victim == NULL)
+			continue;
+
+		CoreRunQueueLocker locker(victim);
+		ThreadData* threadData = victim->PeekThread();
+		if (threadData == NULL)
+			continue;
+
+		// The thread lock has to be acquired before the run queue lock, so we
+		// can only try to get it here. If that fails, someone else is dealing
+		// with the thread right now, anyway.
+		Thread* thread = threadData->GetThread();
+		if (!try_acquire_spinlock(&thread->scheduler_lock))
+			continue;
+
+		victim->Remove(threadData);
+		locker.Unlock();
+
+		CoreEntry* core = fCore;
+		CPUEntry* cpu = this;
+		threadData->ChooseCoreAndCPU(core, cpu);
+
+		release_spinlock(&thread->scheduler_lock);
+		return threadData;
+	}
+
+	return NULL;
+}
+
+
 void
 CPUEntry::TrackActivity(ThreadData* oldThreadData, ThreadData* nextThreadData)
 {
@@ -345,6 +395,43 @@ CPUEntry::_RequestPerformanceLevel(ThreadData* threadData)
 }
 
 
+/*!	Returns the core with the most threads waiting in its run queue among the
+	cores at exactly the given distance to this CPU's core. Cores that have an
+	idle CPU are skipped, since they will run their threads themselves.
+*/
+CoreEntry*
+CPUEntry::_ChooseStealVictim(steal_scope scope) const
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* victim = NULL;
+	int32 victimThreadCount = 0;
+
+	for (int32 i = 0; i < gCoreCount; i++) {
+		CoreEntry* core = &gCoreEntries[i];
+		if (core == fCore || core->CPUCount() == 0)
+			continue;
+
+		steal_scope distance = STEAL_FROM_ANY_CORE;
+		if (core->Package() == fCore->Package())
+			distance = STEAL_FROM_PACKAGE;
+		else if (core->MemoryNode() == fCore->MemoryNode())
+			distance = STEAL_FROM_MEMORY_NODE;
+		if (distance != scope)
+			continue;
+
+		int32 threadCount = core->QueuedThreadCount();
+		if (core->IdleCPUCount() > 0 || threadCount <= victimThreadCount)
+			continue;
+
+		victim = core;
+		victimThreadCount = threadCount;
+	}
+
+	return victim;
+}
+
+
 /* static */ int32
 CPUEntry::_RescheduleEvent(timer* /* unused */)
 {
@@ -650,9 +737,10 @@ PackageEntry::PackageEntry()
 
 
 void
-PackageEntry::Init(int32 id)
+PackageEntry::Init(int32 id, int32 memoryNode)
 {
 	fPackageID = id;
+	fMemoryNode = memoryNode;
 }
 
 
@@ -78,6 +78,7 @@ public:
 
 						ThreadData*		ChooseNextThread(ThreadData* oldThread,
 											bool putAtBack);
+						ThreadData*		StealThread();
 
 						void			TrackActivity(ThreadData* oldThreadData,
 											ThreadData* nextThreadData);
@@ -91,6 +92,9 @@ private:
 						void			_RequestPerformanceLevel(
 											ThreadData* threadData);
 
+						CoreEntry*		_ChooseStealVictim(
+											steal_scope scope) const;
+
 	static				int32			_RescheduleEvent(timer* /* unused */);
 	static				int32			_UpdateLoadEvent(timer* /* unused */);
 
@@ -129,6 +133,7 @@ public:
 
 	inline				int32			ID() const	{ return fCoreID; }
 	inline				PackageEntry*	Package() const	{ return fPackage; }
+	inline				int32			MemoryNode() const;
 	inline				int32			CPUCount() const
 											{ return fCPUCount; }
 
@@ -138,6 +143,10 @@ public:
 	inline				CPUPriorityHeap*	CPUHeap();
 
 	inline				int32			ThreadCount() const;
+	inline				int32			QueuedThreadCount() const
+											{ return fThreadCount; }
+	inline				int32			IdleCPUCount() const
+											{ return fIdleCPUCount; }
 
 	inline				void			LockRunQueue();
 	inline				void			UnlockRunQueue();
@@ -224,7 +233,10 @@ class PackageEntry : public DoublyLinkedListLinkImpl<PackageEntry> {
 public:
 											PackageEntry();
 
-						void				Init(int32 id);
+						void				Init(int32 id, int32 memoryNode);
+
+	inline				int32				MemoryNode() const
+												{ return fMemoryNode; }
 
 	inline				void				CoreGoesIdle(CoreEntry* core);
 	inline				void				CoreWakesUp(CoreEntry* core);
@@ -234,11 +246,16 @@ public:
 						void				AddIdleCore(CoreEntry* core);
 						void				RemoveIdleCore(CoreEntry* core);
 
-	static inline		PackageEntry*		GetMostIdlePackage();
-	static inline		PackageEntry*		GetLeastIdlePackage();
+	static inline		PackageEntry*		GetIdlePackage(
+												int32 memoryNode = -1);
+	static inline		PackageEntry*		GetMostIdlePackage(
+												int32 memoryNode = -1);
+	static inline		PackageEntry*		GetLeastIdlePackage(
+												int32 memoryNode = -1);
 
 private:
 						int32				fPackageID;
+						int32				fMemoryNode;
 
 						DoublyLinkedList<CoreEntry>	fIdleCores;
 						int32				fIdleCoreCount;
@@ -262,6 +279,8 @@ extern IdlePackageList gIdlePackageList;
 extern rw_spinlock gIdlePackageLock;
 extern int32 gPackageCount;
 
+extern int32 gMemoryNodeCount;
+
 
 inline void
 CPUEntry::EnterScheduler()
@@ -537,6 +556,13 @@ CoreEntry::GetCore(int32 cpu)
 }
 
 
+inline int32
+CoreEntry::MemoryNode() const
+{
+	return fPackage->MemoryNode();
+}
+
+
 inline CoreEntry*
 PackageEntry::GetIdleCore() const
 {
@@ -545,18 +571,47 @@ PackageEntry::GetIdleCore() const
 }
 
 
+/*!	Returns a package all cores of which are idle. If \a memoryNode is not
+	negative, only packages on that memory node are considered.
+*/
+/* static */ inline PackageEntry*
+PackageEntry::GetIdlePackage(int32 memoryNode)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	if (memoryNode < 0)
+		return gIdlePackageList.Last();
+
+	ReadSpinLocker _(gIdlePackageLock);
+	IdlePackageList::ReverseIterator iterator
+		= gIdlePackageList.GetReverseIterator();
+	while (PackageEntry* package = iterator.Next()) {
+		if (package->fMemoryNode == memoryNode)
+			return package;
+	}
+
+	return NULL;
+}
+
+
 /* static */ inline PackageEntry*
-PackageEntry::GetMostIdlePackage()
+PackageEntry::GetMostIdlePackage(int32 memoryNode)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
-	PackageEntry* current = &gPackageEntries[0];
-	for (int32 i = 1; i < gPackageCount; i++) {
-		if (gPackageEntries[i].fIdleCoreCount > current->fIdleCoreCount)
-			current = &gPackageEntries[i];
+	PackageEntry* current = NULL;
+	for (int32 i = 0; i < gPackageCount; i++) {
+		PackageEntry* package = &gPackageEntries[i];
+		if (memoryNode >= 0 && package->fMemoryNode != memoryNode)
+			continue;
+
+		if (current == NULL
+			|| package->fIdleCoreCount > current->fIdleCoreCount) {
+			current = package;
+		}
 	}
 
-	if (current->fIdleCoreCount == 0)
+	if (current == NULL || current->fIdleCoreCount == 0)
 		return NULL;
 
 	return current;
@@ -564,7 +619,7 @@ PackageEntry::GetMostIdlePackage()
 
 
 /* static */ inline PackageEntry*
-PackageEntry::GetLeastIdlePackage()
+PackageEntry::GetLeastIdlePackage(int32 memoryNode)
 {
 	SCHEDULER_ENTER_FUNCTION();
 
@@ -572,6 +627,8 @@ PackageEntry::GetLeastIdlePackage()
 
 	for (int32 i = 0; i < gPackageCount; i++) {
 		PackageEntry* current = &gPackageEntries[i];
+		if (memoryNode >= 0 && current->fMemoryNode != memoryNode)
+			continue;
 
 		int32 currentIdleCoreCount = current->fIdleCoreCount;
 		if (currentIdleCoreCount != 0 && (package == NULL
@@ -10,6 +10,16 @@
 #include <thread_types.h>
 
 
+// How far an idle CPU may look for a thread waiting on another core (see
+// CPUEntry::StealThread()). SMT siblings share the run queue of their core, so
+// they never have to steal from each other.
+enum steal_scope {
+	STEAL_NONE,
+	STEAL_FROM_PACKAGE,
+	STEAL_FROM_MEMORY_NODE,
+	STEAL_FROM_ANY_CORE
+};
+
 struct scheduler_mode_operations {
 	const char*				name;
 
@@ -19,6 +29,8 @@ struct scheduler_mode_operations {
 
 	bigtime_t				maximum_latency;
 
+	steal_scope				idle_steal_scope;
+
 	void					(*switch_to_mode)();
 	void					(*set_cpu_enabled)(int32 cpu, bool enabled);
 	bool					(*has_cache_expired)(
@@ -32,6 +44,7 @@ struct scheduler_mode_operations {
 
 extern struct scheduler_mode_operations gSchedulerLowLatencyMode;
 extern struct scheduler_mode_operations gSchedulerPowerSavingMode;
+extern struct scheduler_mode_operations gSchedulerThroughputMode;
 
 
 namespace Scheduler {
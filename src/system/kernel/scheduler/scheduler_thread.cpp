@@ -98,6 +98,8 @@ ThreadData::Init()
 	Thread* currentThread = thread_get_current_thread();
 	ThreadData* currentThreadData = currentThread->scheduler_data;
 	fNeededLoad = currentThreadData->fNeededLoad;
+	fMemoryNode = currentThreadData->fMemoryNode;
+	fMemoryNodeChosen = false;
 
 	if (!IsRealTime()) {
 		fPriorityPenalty = std::min(currentThreadData->fPriorityPenalty,
@@ -115,6 +117,8 @@ ThreadData::Init(CoreEntry* core)
 	_InitBase();
 
 	fCore = core;
+	fMemoryNode = core->MemoryNode();
+	fMemoryNodeChosen = true;
 	fReady = true;
 	fNeededLoad = 0;
 }
@@ -140,6 +144,7 @@ ThreadData::Dump() const
 	kprintf("\twent_sleep_active:\t%" B_PRId64 "\n", fWentSleepActive);
 	kprintf("\tcore:\t\t\t%" B_PRId32 "\n",
 		fCore != NULL ? fCore->ID() : -1);
+	kprintf("\tmemory_node:\t\t%" B_PRId32 "\n", fMemoryNode);
 	if (fCore != NULL && HasCacheExpired())
 		kprintf("\tcache affinity has expired\n");
 }
@@ -164,6 +169,13 @@ ThreadData::ChooseCoreAndCPU(CoreEntry*& targetCore, CPUEntry*& targetCPU)
 	ASSERT(targetCore != NULL);
 	ASSERT(targetCPU != NULL);
 
+	// The memory of a new thread will be allocated on the memory node of
+	// the core it runs on first. Until then, it prefers its parent's node.
+	if (!fMemoryNodeChosen) {
+		fMemoryNode = targetCore->MemoryNode();
+		fMemoryNodeChosen = true;
+	}
+
 	if (fCore != targetCore) {
 		fLoadMeasurementEpoch = targetCore->LoadMeasurementEpoch() - 1;
 		if (fReady) {
@@ -87,6 +87,8 @@ public:
 	inline	CoreEntry*	Core() const	{ return fCore; }
 			void		UnassignCore(bool running = false);
 
+	inline	int32		MemoryNode() const	{ return fMemoryNode; }
+
 	static	void		ComputeQuantumLengths();
 
 private:
@@ -129,6 +131,8 @@ private:
 			uint32		fLoadMeasurementEpoch;
 
 			CoreEntry*	fCore;
+			int32		fMemoryNode;
+			bool		fMemoryNodeChosen;
 };
 
 class ThreadProcessing {
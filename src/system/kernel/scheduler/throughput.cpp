@@ -0,0 +1,194 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A scheduler mode for batch workloads, e.g. build servers. Quanta are
+	longer than in low latency mode and threads stay on their core longer,
+	since idle CPUs steal any waiting threads anyway.
+*/
+
+
+#include <util/AutoLock.h>
+
+#include "scheduler_common.h"
+#include "scheduler_cpu.h"
+#include "scheduler_modes.h"
+#include "scheduler_profiler.h"
+#include "scheduler_thread.h"
+
+
+using namespace Scheduler;
+
+
+const bigtime_t kCacheExpire = 250000;
+
+
+static void
+switch_to_mode()
+{
+}
+
+
+static void
+set_cpu_enabled(int32 /* cpu */, bool /* enabled */)
+{
+}
+
+
+static bool
+has_cache_expired(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+	if (threadData->WentSleepActive() == 0)
+		return false;
+	CoreEntry* core = threadData->Core();
+	bigtime_t activeTime = core->GetActiveTime();
+	return activeTime - threadData->WentSleepActive() > kCacheExpire;
+}
+
+
+static CoreEntry*
+choose_idle_core(int32 memoryNode)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	// spread the threads over as many packages as possible, so that they have
+	// as much cache as possible for themselves
+	PackageEntry* package = PackageEntry::GetIdlePackage(memoryNode);
+	if (package == NULL)
+		package = PackageEntry::GetMostIdlePackage(memoryNode);
+
+	if (package != NULL)
+		return package->GetIdleCore();
+
+	return NULL;
+}
+
+
+static CoreEntry*
+choose_core(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = NULL;
+
+	// prefer idle cores close to the thread's memory
+	if (gMemoryNodeCount > 1)
+		core = choose_idle_core(threadData->MemoryNode());
+	if (core == NULL)
+		core = choose_idle_core(-1);
+
+	if (core == NULL) {
+		ReadSpinLocker coreLocker(gCoreHeapsLock);
+		// no idle cores, use least occupied core
+		core = gCoreLoadHeap.PeekMinimum();
+		if (core == NULL)
+			core = gCoreHighLoadHeap.PeekMinimum();
+	}
+
+	ASSERT(core != NULL);
+	return core;
+}
+
+
+static CoreEntry*
+rebalance(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = threadData->Core();
+	ASSERT(core != NULL);
+
+	ReadSpinLocker coreLocker(gCoreHeapsLock);
+	CoreEntry* other = gCoreLoadHeap.PeekMinimum();
+	if (other == NULL)
+		other = gCoreHighLoadHeap.PeekMinimum();
+	coreLocker.Unlock();
+	ASSERT(other != NULL);
+
+	// Idle CPUs take care of short term imbalances, so only migrate the thread
+	// and lose its cache contents if the difference is persistent and large.
+	int32 loadDifference = kLoadDifference * 2;
+	if (other->MemoryNode() != threadData->MemoryNode()
+		&& core->MemoryNode() == threadData->MemoryNode()) {
+		loadDifference *= 2;
+	}
+
+	int32 coreLoad = core->GetLoad();
+	int32 otherLoad = other->GetLoad();
+	if (other == core || otherLoad + loadDifference >= coreLoad)
+		return core;
+
+	int32 difference = coreLoad - otherLoad - loadDifference;
+	ASSERT(difference > 0);
+
+	int32 threadLoad = threadData->GetLoad() / core->CPUCount();
+	return difference >= threadLoad ? other : core;
+}
+
+
+static void
+rebalance_irqs(bool idle)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	if (idle)
+		return;
+
+	cpu_ent* cpu = get_cpu_struct();
+	SpinLocker locker(cpu->irqs_lock);
+
+	irq_assignment* chosen = NULL;
+	irq_assignment* irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
+
+	int32 totalLoad = 0;
+	while (irq != NULL) {
+		if (chosen == NULL || chosen->load < irq->load)
+			chosen = irq;
+		totalLoad += irq->load;
+		irq = (irq_assignment*)list_get_next_item(&cpu->irqs, irq);
+	}
+
+	locker.Unlock();
+
+	if (chosen == NULL || totalLoad < kLowLoad)
+		return;
+
+	ReadSpinLocker coreLocker(gCoreHeapsLock);
+	CoreEntry* other = gCoreLoadHeap.PeekMinimum();
+	if (other == NULL)
+		other = gCoreHighLoadHeap.PeekMinimum();
+	coreLocker.Unlock();
+	ASSERT(other != NULL);
+
+	CoreEntry* core = CoreEntry::GetCore(cpu->cpu_num);
+	if (other == core)
+		return;
+	if (other->GetLoad() + kLoadDifference >= core->GetLoad())
+		return;
+
+	int32 newCPU = other->CPUHeap()->PeekRoot()->ID();
+	assign_io_interrupt_to_cpu(chosen->irq, newCPU);
+}
+
+
+scheduler_mode_operations gSchedulerThroughputMode = {
+	"throughput",
+
+	5000,
+	1000,
+	{ 2, 4 },
+
+	50000,
+
+	STEAL_FROM_ANY_CORE,
+
+	switch_to_mode,
+	set_cpu_enabled,
+	has_cache_expired,
+	choose_core,
+	rebalance,
+	rebalance_irqs,
+};
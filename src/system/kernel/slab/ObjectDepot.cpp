@@ -11,8 +11,12 @@
 
 #include <algorithm>
 
+#include <string.h>
+
+#include <cpu.h>
 #include <int.h>
 #include <slab/Slab.h>
+#include <slab_defs.h>
 #include <smp.h>
 #include <util/AutoLock.h>
 
@@ -39,11 +43,42 @@ public:
 };
 
 
+/*!	The per-CPU magazines of a depot. A store is only ever accessed by its
+	own CPU with interrupts disabled, so that no locking is needed. Anybody
+	else (i.e. object_depot_make_empty()) has to run on the respective CPU
+	via call_all_cpus_sync() to get at it.
+*/
 struct depot_cpu_store {
 	DepotMagazine*	loaded;
 	DepotMagazine*	previous;
+
+	// statistics
+	uint64			alloc_hits;
+	uint64			alloc_misses;
+	uint64			free_hits;
+	uint64			free_misses;
+};
+
+
+struct depot_collect_cookie {
+	object_depot*	depot;
+	DepotMagazine*	magazines;
+};
+
+
+#if PARANOID_KERNEL_FREE
+
+struct depot_contains_cookie {
+	object_depot*	depot;
+	void*			object;
+	bool			found;
 };
 
+#endif
+
+
+static const size_t kMaxDepotGrowthFactor = 8;
+
 
 RANGE_MARKER_FUNCTION_BEGIN(SlabObjectDepot)
 
@@ -131,21 +166,55 @@ empty_magazine(object_depot* depot, DepotMagazine* magazine, uint32 flags)
 }
 
 
+/*!	Acquires the depot's lock, counting the acquisitions that had to wait.
+	Interrupts must be disabled.
+	Unlike acquire_spinlock(), this doesn't process ICIs while spinning: the
+	callers are in the middle of manipulating their CPU's store, which
+	collect_cpu_store_magazines() must not get to see. This is safe, since
+	the lock is never held while waiting for anything.
+*/
+static inline void
+lock_depot(object_depot* depot)
+{
+	if (try_acquire_spinlock(&depot->inner_lock))
+		return;
+
+	while (!try_acquire_spinlock(&depot->inner_lock)) {
+		while (B_SPINLOCK_IS_LOCKED(&depot->inner_lock))
+			cpu_pause();
+	}
+
+	depot->contention_count++;
+}
+
+
+static inline void
+unlock_depot(object_depot* depot)
+{
+	release_spinlock(&depot->inner_lock);
+}
+
+
 static bool
 exchange_with_full(object_depot* depot, DepotMagazine*& magazine)
 {
 	ASSERT(magazine->IsEmpty());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
-	if (depot->full == NULL)
+	if (depot->full == NULL) {
+		depot->recent_misses++;
+		unlock_depot(depot);
 		return false;
+	}
 
 	depot->full_count--;
 	depot->empty_count++;
 
 	_push(depot->empty, magazine);
 	magazine = _pop(depot->full);
+
+	unlock_depot(depot);
 	return true;
 }
 
@@ -156,14 +225,30 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 {
 	ASSERT(magazine == NULL || magazine->IsFull());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
-	if (depot->empty == NULL)
+	if (depot->empty == NULL) {
+		unlock_depot(depot);
 		return false;
+	}
 
 	depot->empty_count--;
 
 	if (magazine != NULL) {
+		if (depot->full_count >= depot->max_count) {
+			// The depot overflows. If allocations have recently run it dry,
+			// the working set is obviously larger than the depot, and we
+			// let it grow. Otherwise we slowly shrink it back again.
+			if (depot->recent_misses > 0) {
+				if (depot->max_count
+						< depot->min_max_count * kMaxDepotGrowthFactor) {
+					depot->max_count++;
+				}
+				depot->recent_misses = 0;
+			} else if (depot->max_count > depot->min_max_count)
+				depot->max_count--;
+		}
+
 		if (depot->full_count < depot->max_count) {
 			_push(depot->full, magazine);
 			depot->full_count++;
@@ -173,6 +258,8 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 	}
 
 	magazine = _pop(depot->empty);
+
+	unlock_depot(depot);
 	return true;
 }
 
@@ -180,10 +267,12 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 static void
 push_empty_magazine(object_depot* depot, DepotMagazine* magazine)
 {
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
 
 	_push(depot->empty, magazine);
 	depot->empty_count++;
+
+	unlock_depot(depot);
 }
 
 
@@ -194,6 +283,48 @@ object_depot_cpu(object_depot* depot)
 }
 
 
+static void
+collect_cpu_store_magazines(void* _cookie, int cpu)
+{
+	depot_collect_cookie* cookie = (depot_collect_cookie*)_cookie;
+	depot_cpu_store& store = cookie->depot->stores[cpu];
+
+	lock_depot(cookie->depot);
+
+	if (store.loaded != NULL) {
+		_push(cookie->magazines, store.loaded);
+		store.loaded = NULL;
+	}
+
+	if (store.previous != NULL) {
+		_push(cookie->magazines, store.previous);
+		store.previous = NULL;
+	}
+
+	unlock_depot(cookie->depot);
+}
+
+
+#if PARANOID_KERNEL_FREE
+
+static void
+cpu_store_contains_object(void* _cookie, int cpu)
+{
+	depot_contains_cookie* cookie = (depot_contains_cookie*)_cookie;
+	depot_cpu_store& store = cookie->depot->stores[cpu];
+
+	bool found = (store.loaded != NULL
+			&& store.loaded->ContainsObject(cookie->object))
+		|| (store.previous != NULL
+			&& store.previous->ContainsObject(cookie->object));
+
+	if (found)
+		cookie->found = true;
+}
+
+#endif	// PARANOID_KERNEL_FREE
+
+
 // #pragma mark - public API
 
 
@@ -206,23 +337,20 @@ object_depot_init(object_depot* depot, size_t capacity, size_t maxCount,
 	depot->empty = NULL;
 	depot->full_count = depot->empty_count = 0;
 	depot->max_count = maxCount;
+	depot->min_max_count = maxCount;
+	depot->recent_misses = 0;
 	depot->magazine_capacity = capacity;
+	depot->contention_count = 0;
 
-	rw_lock_init(&depot->outer_lock, "object depot");
 	B_INITIALIZE_SPINLOCK(&depot->inner_lock);
 
 	int cpuCount = smp_get_num_cpus();
 	depot->stores = (depot_cpu_store*)slab_internal_alloc(
 		sizeof(depot_cpu_store) * cpuCount, flags);
-	if (depot->stores == NULL) {
-		rw_lock_destroy(&depot->outer_lock);
+	if (depot->stores == NULL)
 		return B_NO_MEMORY;
-	}
 
-	for (int i = 0; i < cpuCount; i++) {
-		depot->stores[i].loaded = NULL;
-		depot->stores[i].previous = NULL;
-	}
+	memset(depot->stores, 0, sizeof(depot_cpu_store) * cpuCount);
 
 	depot->cookie = cookie;
 	depot->return_object = return_object;
@@ -237,15 +365,13 @@ object_depot_destroy(object_depot* depot, uint32 flags)
 	object_depot_make_empty(depot, flags);
 
 	slab_internal_free(depot->stores, flags);
-
-	rw_lock_destroy(&depot->outer_lock);
 }
 
 
 void*
 object_depot_obtain(object_depot* depot)
 {
-	ReadLocker readLocker(depot->outer_lock);
+	// Disabling interrupts is all it takes to protect the CPU's store.
 	InterruptsLocker interruptsLocker;
 
 	depot_cpu_store* store = object_depot_cpu(depot);
@@ -257,19 +383,25 @@ object_depot_obtain(object_depot* depot)
 	// if it's not empty, or from the previous magazine if it's full
 	// and finally from the Slab if the magazine depot has no full magazines.
 
-	if (store->loaded == NULL)
+	if (store->loaded == NULL) {
+		store->alloc_misses++;
 		return NULL;
+	}
 
 	while (true) {
-		if (!store->loaded->IsEmpty())
+		if (!store->loaded->IsEmpty()) {
+			store->alloc_hits++;
 			return store->loaded->Pop();
+		}
 
 		if (store->previous
 			&& (store->previous->IsFull()
 				|| exchange_with_full(depot, store->previous))) {
 			std::swap(store->previous, store->loaded);
-		} else
+		} else {
+			store->alloc_misses++;
 			return NULL;
+		}
 	}
 }
 
@@ -277,7 +409,6 @@ object_depot_obtain(object_depot* depot)
 void
 object_depot_store(object_depot* depot, void* object, uint32 flags)
 {
-	ReadLocker readLocker(depot->outer_lock);
 	InterruptsLocker interruptsLocker;
 
 	depot_cpu_store* store = object_depot_cpu(depot);
@@ -288,8 +419,10 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 	// we return the object directly to the slab.
 
 	while (true) {
-		if (store->loaded != NULL && store->loaded->Push(object))
+		if (store->loaded != NULL && store->loaded->Push(object)) {
+			store->free_hits++;
 			return;
+		}
 
 		DepotMagazine* freeMagazine = NULL;
 		if ((store->previous != NULL && store->previous->IsEmpty())
@@ -299,11 +432,9 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 			if (freeMagazine != NULL) {
 				// Free the magazine that didn't have space in the list
 				interruptsLocker.Unlock();
-				readLocker.Unlock();
 
 				empty_magazine(depot, freeMagazine, flags);
 
-				readLocker.Lock();
 				interruptsLocker.Lock();
 
 				store = object_depot_cpu(depot);
@@ -311,15 +442,17 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 		} else {
 			// allocate a new empty magazine
 			interruptsLocker.Unlock();
-			readLocker.Unlock();
 
 			DepotMagazine* magazine = alloc_magazine(depot, flags);
 			if (magazine == NULL) {
+				interruptsLocker.Lock();
+				object_depot_cpu(depot)->free_misses++;
+				interruptsLocker.Unlock();
+
 				depot->return_object(depot, depot->cookie, object, flags);
 				return;
 			}
 
-			readLocker.Lock();
 			interruptsLocker.Lock();
 
 			push_empty_magazine(depot, magazine);
@@ -332,36 +465,34 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 void
 object_depot_make_empty(object_depot* depot, uint32 flags)
 {
-	WriteLocker writeLocker(depot->outer_lock);
+	// collect the store magazines -- each CPU has to hand over its own
 
-	// collect the store magazines
+	depot_collect_cookie cookie;
+	cookie.depot = depot;
+	cookie.magazines = NULL;
+	call_all_cpus_sync(&collect_cpu_store_magazines, &cookie);
 
-	DepotMagazine* storeMagazines = NULL;
+	DepotMagazine* storeMagazines = cookie.magazines;
 
-	int cpuCount = smp_get_num_cpus();
-	for (int i = 0; i < cpuCount; i++) {
-		depot_cpu_store& store = depot->stores[i];
+	// detach the depot's full and empty magazines, and shrink it back to its
+	// initial size
 
-		if (store.loaded) {
-			_push(storeMagazines, store.loaded);
-			store.loaded = NULL;
-		}
-
-		if (store.previous) {
-			_push(storeMagazines, store.previous);
-			store.previous = NULL;
-		}
-	}
-
-	// detach the depot's full and empty magazines
+	InterruptsLocker interruptsLocker;
+	lock_depot(depot);
 
 	DepotMagazine* fullMagazines = depot->full;
 	depot->full = NULL;
+	depot->full_count = 0;
 
 	DepotMagazine* emptyMagazines = depot->empty;
 	depot->empty = NULL;
+	depot->empty_count = 0;
 
-	writeLocker.Unlock();
+	depot->max_count = depot->min_max_count;
+	depot->recent_misses = 0;
+
+	unlock_depot(depot);
+	interruptsLocker.Unlock();
 
 	// free all magazines
 
@@ -381,35 +512,55 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 bool
 object_depot_contains_object(object_depot* depot, void* object)
 {
-	WriteLocker writeLocker(depot->outer_lock);
-
-	int cpuCount = smp_get_num_cpus();
-	for (int i = 0; i < cpuCount; i++) {
-		depot_cpu_store& store = depot->stores[i];
+	depot_contains_cookie cookie;
+	cookie.depot = depot;
+	cookie.object = object;
+	cookie.found = false;
+	call_all_cpus_sync(&cpu_store_contains_object, &cookie);
 
-		if (store.loaded != NULL && !store.loaded->IsEmpty()) {
-			if (store.loaded->ContainsObject(object))
-				return true;
-		}
+	if (cookie.found)
+		return true;
 
-		if (store.previous != NULL && !store.previous->IsEmpty()) {
-			if (store.previous->ContainsObject(object))
-				return true;
-		}
-	}
+	InterruptsLocker _;
+	lock_depot(depot);
 
 	for (DepotMagazine* magazine = depot->full; magazine != NULL;
 			magazine = magazine->next) {
-		if (magazine->ContainsObject(object))
+		if (magazine->ContainsObject(object)) {
+			unlock_depot(depot);
 			return true;
+		}
 	}
 
+	unlock_depot(depot);
 	return false;
 }
 
 #endif // PARANOID_KERNEL_FREE
 
 
+/*!	Adds the depot's statistics to the given \a stats. The counters are
+	read without any locking, so they are only approximately consistent.
+*/
+void
+object_depot_get_stats(object_depot* depot, object_cache_stats* stats)
+{
+	int cpuCount = smp_get_num_cpus();
+	for (int i = 0; i < cpuCount; i++) {
+		depot_cpu_store& store = depot->stores[i];
+		stats->alloc_hits += store.alloc_hits;
+		stats->alloc_misses += store.alloc_misses;
+		stats->free_hits += store.free_hits;
+		stats->free_misses += store.free_misses;
+	}
+
+	stats->depot_contention += depot->contention_count;
+	stats->full_magazines = depot->full_count;
+	stats->max_full_magazines = depot->max_count;
+	stats->magazine_capacity = depot->magazine_capacity;
+}
+
+
 // #pragma mark - private kernel API
 
 
@@ -418,15 +569,22 @@ dump_object_depot(object_depot* depot)
 {
 	kprintf("  full:     %p, count %lu\n", depot->full, depot->full_count);
 	kprintf("  empty:    %p, count %lu\n", depot->empty, depot->empty_count);
-	kprintf("  max full: %lu\n", depot->max_count);
+	kprintf("  max full: %lu (initially %lu)\n", depot->max_count,
+		depot->min_max_count);
 	kprintf("  capacity: %lu\n", depot->magazine_capacity);
+	kprintf("  contention: %" B_PRIu64 "\n", depot->contention_count);
 	kprintf("  stores:\n");
 
 	int cpuCount = smp_get_num_cpus();
 
 	for (int i = 0; i < cpuCount; i++) {
-		kprintf("  [%d] loaded:   %p\n", i, depot->stores[i].loaded);
-		kprintf("      previous: %p\n", depot->stores[i].previous);
+		depot_cpu_store& store = depot->stores[i];
+		kprintf("  [%d] loaded:   %p\n", i, store.loaded);
+		kprintf("      previous: %p\n", store.previous);
+		kprintf("      alloc hits/misses: %" B_PRIu64 "/%" B_PRIu64 ", "
+			"free hits/misses: %" B_PRIu64 "/%" B_PRIu64 "\n",
+			store.alloc_hits, store.alloc_misses, store.free_hits,
+			store.free_misses);
 	}
 }
 
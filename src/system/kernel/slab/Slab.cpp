@@ -17,10 +17,12 @@
 #include <KernelExport.h>
 
 #include <condition_variable.h>
+#include <debug.h>
 #include <elf.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
 #include <slab/ObjectDepot.h>
+#include <slab_defs.h>
 #include <smp.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -254,9 +256,58 @@ dump_slab(::slab* slab)
 }
 
 
+static void
+get_object_cache_stats(ObjectCache* cache, object_cache_stats* stats)
+{
+	memset(stats, 0, sizeof(object_cache_stats));
+	strlcpy(stats->name, cache->name, sizeof(stats->name));
+	stats->object_size = cache->object_size;
+	stats->usage = cache->usage;
+	stats->total_objects = cache->total_objects;
+	stats->used_objects = cache->used_count;
+
+	if ((cache->flags & CACHE_NO_DEPOT) == 0)
+		object_depot_get_stats(&cache->depot, stats);
+}
+
+
+static int
+dump_slab_stats()
+{
+	kprintf("%*s %22s %10s %10s %10s %10s %8s %9s\n",
+		B_PRINTF_POINTER_WIDTH + 2, "address", "name", "alloc hit",
+		"alloc miss", "free hit", "free miss", "contend", "magazines");
+
+	ObjectCacheList::Iterator it = sObjectCaches.GetIterator();
+
+	while (it.HasNext()) {
+		ObjectCache* cache = it.Next();
+
+		object_cache_stats stats;
+		get_object_cache_stats(cache, &stats);
+
+		kprintf("%p %22s %10" B_PRIu64 " %10" B_PRIu64 " %10" B_PRIu64
+			" %10" B_PRIu64 " %8" B_PRIu64 " %4" B_PRIu32 "/%-4" B_PRIu32
+			"\n", cache, cache->name, stats.alloc_hits, stats.alloc_misses,
+			stats.free_hits, stats.free_misses, stats.depot_contention,
+			stats.full_magazines, stats.max_full_magazines);
+	}
+
+	return 0;
+}
+
+
 static int
 dump_slabs(int argc, char* argv[])
 {
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "-s") != 0)) {
+		print_debugger_command_usage(argv[0]);
+		return 0;
+	}
+
+	if (argc == 2)
+		return dump_slab_stats();
+
 	kprintf("%*s %22s %8s %8s %8s %6s %8s %8s %8s\n",
 		B_PRINTF_POINTER_WIDTH + 2, "address", "name", "objsize", "align",
 		"usage", "empty", "usedobj", "total", "flags");
@@ -1339,6 +1390,76 @@ object_cache_get_usage(object_cache* cache, size_t* _allocatedMemory)
 }
 
 
+status_t
+_user_get_object_cache_stats(object_cache_stats* userStats, uint32* _count)
+{
+	if (_count == NULL || !IS_USER_ADDRESS(_count))
+		return B_BAD_ADDRESS;
+
+	uint32 userCount = 0;
+	if (userStats != NULL) {
+		if (!IS_USER_ADDRESS(userStats)
+			|| user_memcpy(&userCount, _count, sizeof(uint32)) != B_OK) {
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	object_cache_stats* stats = NULL;
+	if (userCount > 0) {
+		// Don't let userland choose how much memory we allocate: there can't
+		// be more entries than there are caches. Caches created in the mean
+		// time are just counted.
+		MutexLocker locker(sObjectCacheListLock);
+		uint32 cacheCount = 0;
+		ObjectCacheList::Iterator it = sObjectCaches.GetIterator();
+		while (it.Next() != NULL)
+			cacheCount++;
+		locker.Unlock();
+
+		userCount = std::min(userCount, cacheCount);
+		if (userCount > SIZE_MAX / sizeof(object_cache_stats))
+			return B_BAD_VALUE;
+	}
+
+	if (userCount > 0) {
+		stats = (object_cache_stats*)malloc(
+			sizeof(object_cache_stats) * userCount);
+		if (stats == NULL)
+			return B_NO_MEMORY;
+	}
+
+	// The counters are gathered without locking the caches -- they are
+	// statistics only.
+	MutexLocker locker(sObjectCacheListLock);
+
+	uint32 count = 0;
+	ObjectCacheList::Iterator it = sObjectCaches.GetIterator();
+	while (ObjectCache* cache = it.Next()) {
+		if (count < userCount)
+			get_object_cache_stats(cache, &stats[count]);
+		count++;
+	}
+
+	locker.Unlock();
+
+	if (userStats == NULL)
+		return user_memcpy(_count, &count, sizeof(uint32));
+
+	count = std::min(count, userCount);
+	status_t error = B_OK;
+	if (count > 0) {
+		error = user_memcpy(userStats, stats,
+			sizeof(object_cache_stats) * count);
+	}
+	free(stats);
+
+	if (error != B_OK)
+		return error;
+
+	return user_memcpy(_count, &count, sizeof(uint32));
+}
+
+
 void
 slab_init(kernel_args* args)
 {
@@ -1355,7 +1476,11 @@ slab_init_post_area()
 {
 	MemoryManager::InitPostArea();
 
-	add_debugger_command("slabs", dump_slabs, "list all object caches");
+	add_debugger_command_etc("slabs", dump_slabs, "list all object caches",
+		"[ -s ]\n"
+		"Lists all object caches. If \"-s\" is given, the magazine depot\n"
+		"statistics (hits, misses, and lock contention) are printed instead.\n",
+		0);
 	add_debugger_command("slab_cache", dump_cache_info,
 		"dump information about a specific object cache");
 	add_debugger_command("slab_depot", dump_object_depot,
@@ -449,6 +449,7 @@ Team::Team(team_id id, bool kernel)
 	loading_info = NULL;
 	state = TEAM_STATE_BIRTH;
 	flags = 0;
+	io_priority = -1;
 	death_entry = NULL;
 	user_data_area = -1;
 	user_data = 0;
@@ -1728,6 +1729,7 @@ load_image_internal(char**& _flatArgs, size_t flatArgsSize, int32 argCount,
 
 	// inherit the parent's user/group
 	inherit_parent_user_and_group(team, parent);
+	team->io_priority = parent->io_priority;
 
 	// get a reference to the parent's I/O context -- we need it to create ours
 	parentIOContext = parent->io_context;
@@ -2074,6 +2076,7 @@ fork_team(void)
 
 	// Inherit the parent's user/group.
 	inherit_parent_user_and_group(team, parentTeam);
+	team->io_priority = parentTeam->io_priority;
 
 	// inherit signal handlers
 	team->InheritSignalActions(parentTeam);
@@ -4357,6 +4360,33 @@ _user_get_team_usage_info(team_id team, int32 who, team_usage_info* userInfo,
 }
 
 
+/*!	Sets the I/O priority hint of the team, which is used for all of its
+	threads that don't have an I/O priority of their own. A negative
+	\a priority removes the hint again.
+*/
+status_t
+_user_set_team_io_priority(team_id id, int32 priority)
+{
+	if (priority > B_REAL_TIME_DISPLAY_PRIORITY)
+		return B_BAD_VALUE;
+	if (priority < 0)
+		priority = -1;
+
+	Team* team = Team::GetAndLock(id);
+	if (team == NULL)
+		return B_BAD_TEAM_ID;
+	BReference<Team> teamReference(team, true);
+	TeamLocker teamLocker(team, true);
+
+	uid_t uid = geteuid();
+	if (uid != 0 && uid != team->effective_uid)
+		return B_NOT_ALLOWED;
+
+	team->io_priority = priority;
+	return B_OK;
+}
+
+
 status_t
 _user_get_extended_team_info(team_id teamID, uint32 flags, void* buffer,
 	size_t size, size_t* _sizeNeeded)
@@ -2636,8 +2636,11 @@ thread_get_io_priority(thread_id id)
 
 	int32 priority = thread->io_priority;
 	if (priority < 0) {
-		// negative I/O priority means using the (CPU) priority
-		priority = thread->priority;
+		// negative I/O priority means using the team's hint, if any, or else
+		// the (CPU) priority
+		priority = thread->team->io_priority;
+		if (priority < 0)
+			priority = thread->priority;
 	}
 
 	return priority;
@@ -23,14 +23,47 @@
 #include <smp.h>
 #include <thread.h>
 #include <util/AutoLock.h>
-
+#include <util/BitUtils.h>
+
+
+// The timers of each CPU are kept in a hierarchical timing wheel: level 0 has
+// a slot for each tick, every level above a slot for each rotation of the
+// level below. When the wheel reaches a slot of a higher level, its timers
+// are cascaded down, so that they end up in level 0 before they expire. That
+// makes adding and removing a timer O(1), as opposed to a sorted list.
+// Since the timer structure only has a single link, a timer is found by
+// looking at the slots it can be in according to its schedule time.
+static const int32 kTickShift = 6;
+	// one tick is 64 us
+static const int32 kLevelShift = 6;
+static const int32 kSlotsPerLevel = 1 << kLevelShift;
+static const int32 kSlotMask = kSlotsPerLevel - 1;
+static const int32 kLevelCount = 5;
+	// The wheel covers about 19 hours, later timers are kept in an overflow
+	// list until they come into range.
+
+// The hardware timer may fire up to this much later than the earliest timer,
+// so that timers with close schedule times expire with a single interrupt.
+static const bigtime_t kMaxTimerSlack = 500;
+
+struct timer_wheel_level {
+	uint64			pending;
+		// bitmap of the non-empty slots
+	timer*			slots[kSlotsPerLevel];
+};
 
 struct per_cpu_timer_data {
-	spinlock		lock;
-	timer* volatile	events;
-	timer* volatile	current_event;
-	int32			current_event_in_progress;
-	bigtime_t		real_time_offset;
+	spinlock			lock;
+	timer_wheel_level	levels[kLevelCount];
+	timer*				overflow;
+	timer*				expired;
+		// timers that are due, sorted by schedule time
+	int64				current_tick;
+	bigtime_t			next_event_time;
+		// the time the hardware timer has been set for
+	timer* volatile		current_event;
+	int32				current_event_in_progress;
+	bigtime_t			real_time_offset;
 };
 
 static per_cpu_timer_data sPerCPU[SMP_MAX_CPUS];
@@ -46,13 +79,30 @@ static per_cpu_timer_data sPerCPU[SMP_MAX_CPUS];
 
 /*!	Sets the hardware timer to the given absolute time.
 
+	Unless the timer has to fire very soon, it doesn't need to be exact. To
+	reduce the number of interrupts, the time is rounded up to a multiple of
+	a power of two of up to 1/64th of the remaining time (but at most
+	kMaxTimerSlack), so that timers scheduled close to each other, even on
+	different CPUs, expire together.
+
 	\param scheduleTime The absolute system time for the timer expiration.
 	\param now The current system time.
 */
 static void
 set_hardware_timer(bigtime_t scheduleTime, bigtime_t now)
 {
-	arch_timer_set_hardware_timer(scheduleTime > now ? scheduleTime - now : 0);
+	if (scheduleTime <= now) {
+		arch_timer_set_hardware_timer(0);
+		return;
+	}
+
+	bigtime_t slack = min_c((scheduleTime - now) >> 6, kMaxTimerSlack);
+	if (slack > 1 && scheduleTime < B_INFINITE_TIMEOUT - kMaxTimerSlack) {
+		bigtime_t granularity = (bigtime_t)1 << log2((uint32)slack);
+		scheduleTime = (scheduleTime + granularity - 1) & ~(granularity - 1);
+	}
+
+	arch_timer_set_hardware_timer(scheduleTime - now);
 }
 
 
@@ -67,9 +117,28 @@ set_hardware_timer(bigtime_t scheduleTime)
 }
 
 
+static inline int32
+lowest_bit(uint64 bits)
+{
+	uint32 low = (uint32)bits;
+	if (low != 0)
+		return log2(low & ~(low - 1));
+
+	uint32 high = (uint32)(bits >> 32);
+	return 32 + log2(high & ~(high - 1));
+}
+
+
+static inline int64
+schedule_tick(const timer* event)
+{
+	return event->schedule_time > 0 ? event->schedule_time >> kTickShift : 0;
+}
+
+
 /*! NOTE: expects interrupts to be off */
 static void
-add_event_to_list(timer* event, timer* volatile* list)
+add_event_to_list(timer* event, timer** list)
 {
 	timer* next;
 	timer* last = NULL;
@@ -90,24 +159,286 @@ add_event_to_list(timer* event, timer* volatile* list)
 }
 
 
+static bool
+remove_event_from_list(timer* event, timer** list)
+{
+	for (timer** it = list; *it != NULL; it = &(*it)->next) {
+		if (*it == event) {
+			*it = event->next;
+			event->next = NULL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+static inline bool
+wheel_is_empty(const per_cpu_timer_data& cpuData)
+{
+	for (int32 level = 0; level < kLevelCount; level++) {
+		if (cpuData.levels[level].pending != 0)
+			return false;
+	}
+
+	return cpuData.overflow == NULL;
+}
+
+
+/*!	Puts the timer into the slot of the wheel it belongs to relative to the
+	current tick. Timers that are already due go into the current slot.
+*/
 static void
-per_cpu_real_time_clock_changed(void*, int cpu)
+insert_timer(per_cpu_timer_data& cpuData, timer* event)
 {
-	per_cpu_timer_data& cpuData = sPerCPU[cpu];
-	SpinLocker cpuDataLocker(cpuData.lock);
+	int64 tick = schedule_tick(event);
+	int64 delta = tick - cpuData.current_tick;
+	if (delta >= (int64)1 << (kLevelCount * kLevelShift)) {
+		event->next = cpuData.overflow;
+		cpuData.overflow = event;
+		return;
+	}
 
-	bigtime_t realTimeOffset = rtc_boot_time();
-	if (realTimeOffset == cpuData.real_time_offset)
+	if (delta < 0)
+		tick = cpuData.current_tick;
+
+	int32 level = 0;
+	while (delta >= (int64)kSlotsPerLevel << (level * kLevelShift))
+		level++;
+
+	int32 slot = (tick >> (level * kLevelShift)) & kSlotMask;
+	timer_wheel_level& wheelLevel = cpuData.levels[level];
+	event->next = wheelLevel.slots[slot];
+	wheelLevel.slots[slot] = event;
+	wheelLevel.pending |= (uint64)1 << slot;
+}
+
+
+static bool
+remove_timer_from_slot(per_cpu_timer_data& cpuData, timer* event, int32 level,
+	int32 slot)
+{
+	timer_wheel_level& wheelLevel = cpuData.levels[level];
+	if ((wheelLevel.pending & ((uint64)1 << slot)) == 0
+		|| !remove_event_from_list(event, &wheelLevel.slots[slot])) {
+		return false;
+	}
+
+	if (wheelLevel.slots[slot] == NULL)
+		wheelLevel.pending &= ~((uint64)1 << slot);
+	return true;
+}
+
+
+/*!	Removes the timer from wherever it is queued. Returns \c false, if it
+	isn't queued at all.
+*/
+static bool
+remove_timer(per_cpu_timer_data& cpuData, timer* event)
+{
+	int64 tick = schedule_tick(event);
+	for (int32 level = 0; level < kLevelCount; level++) {
+		int32 slot = (tick >> (level * kLevelShift)) & kSlotMask;
+		if (remove_timer_from_slot(cpuData, event, level, slot))
+			return true;
+	}
+
+	// timers that were already due when they were added wait in the current
+	// slot
+	return remove_timer_from_slot(cpuData, event, 0,
+			cpuData.current_tick & kSlotMask)
+		|| remove_event_from_list(event, &cpuData.expired)
+		|| remove_event_from_list(event, &cpuData.overflow);
+}
+
+
+static void
+cascade_slot(per_cpu_timer_data& cpuData, int32 level, int32 slot)
+{
+	timer_wheel_level& wheelLevel = cpuData.levels[level];
+	timer* event = wheelLevel.slots[slot];
+	wheelLevel.slots[slot] = NULL;
+	wheelLevel.pending &= ~((uint64)1 << slot);
+
+	while (event != NULL) {
+		timer* next = event->next;
+		insert_timer(cpuData, event);
+		event = next;
+	}
+}
+
+
+/*!	Moves the wheel forward to the given tick. The caller must make sure that
+	no timers are due in between, see next_wheel_event().
+*/
+static void
+advance_wheel(per_cpu_timer_data& cpuData, int64 tick)
+{
+	cpuData.current_tick = tick;
+
+	// cascade the slots of the higher levels that begin with this tick
+	for (int32 level = 1; level < kLevelCount; level++) {
+		int32 shift = level * kLevelShift;
+		if ((tick & (((int64)1 << shift) - 1)) != 0)
+			return;
+
+		cascade_slot(cpuData, level, (tick >> shift) & kSlotMask);
+	}
+
+	// a new slot of the top level has been reached -- the overflow timers
+	// might be in range now
+	timer* event = cpuData.overflow;
+	cpuData.overflow = NULL;
+
+	while (event != NULL) {
+		timer* next = event->next;
+		insert_timer(cpuData, event);
+		event = next;
+	}
+}
+
+
+/*!	Returns the next tick after the current one, at which the wheel has
+	anything to do, i.e. a level 0 slot that has timers, or a slot of a higher
+	level that needs to be cascaded. Returns -1, if there are no timers.
+*/
+static int64
+next_wheel_event(const per_cpu_timer_data& cpuData)
+{
+	int64 tick = cpuData.current_tick;
+
+	for (int32 level = 0; level < kLevelCount; level++) {
+		uint64 pending = cpuData.levels[level].pending;
+		if (pending == 0)
+			continue;
+
+		int32 shift = level * kLevelShift;
+		int32 index = (tick >> shift) & kSlotMask;
+		int64 rotationStart = tick & ~(((int64)1 << (shift + kLevelShift)) - 1);
+
+		uint64 later = index < kSlotMask
+			? pending & (~(uint64)0 << (index + 1)) : 0;
+		if (later != 0)
+			return rotationStart + ((int64)lowest_bit(later) << shift);
+
+		// there are only timers for the next rotation of this level
+		return rotationStart + ((int64)1 << (shift + kLevelShift));
+	}
+
+	if (cpuData.overflow != NULL) {
+		int32 shift = (kLevelCount - 1) * kLevelShift;
+		return ((tick >> shift) + 1) << shift;
+	}
+
+	return -1;
+}
+
+
+/*!	Moves the timers of the current slot that are due to the list of expired
+	timers.
+*/
+static void
+expire_current_slot(per_cpu_timer_data& cpuData, bigtime_t now)
+{
+	int32 slot = cpuData.current_tick & kSlotMask;
+	timer_wheel_level& wheelLevel = cpuData.levels[0];
+	if ((wheelLevel.pending & ((uint64)1 << slot)) == 0)
 		return;
 
-	// The real time offset has changed. We need to update all affected
-	// timers. First find and dequeue them.
-	bigtime_t timeDiff = cpuData.real_time_offset - realTimeOffset;
-	cpuData.real_time_offset = realTimeOffset;
+	timer** it = &wheelLevel.slots[slot];
+	while (timer* event = *it) {
+		if (event->schedule_time <= now) {
+			*it = event->next;
+			add_event_to_list(event, &cpuData.expired);
+		} else
+			it = &event->next;
+	}
 
-	timer* affectedTimers = NULL;
-	timer* volatile* it = &cpuData.events;
-	timer* firstEvent = *it;
+	if (wheelLevel.slots[slot] == NULL)
+		wheelLevel.pending &= ~((uint64)1 << slot);
+}
+
+
+/*!	Advances the wheel up to the given time, and collects all timers that are
+	due in the list of expired timers.
+*/
+static void
+collect_expired_timers(per_cpu_timer_data& cpuData, bigtime_t now)
+{
+	int64 nowTick = now >> kTickShift;
+
+	while (true) {
+		expire_current_slot(cpuData, now);
+		if (cpuData.current_tick >= nowTick)
+			return;
+
+		int64 tick = next_wheel_event(cpuData);
+		advance_wheel(cpuData, tick < 0 || tick > nowTick ? nowTick : tick);
+	}
+}
+
+
+/*!	Returns the earliest schedule time of all timers of the CPU, or
+	\c B_INFINITE_TIMEOUT, if there are none.
+*/
+static bigtime_t
+earliest_schedule_time(const per_cpu_timer_data& cpuData)
+{
+	if (cpuData.expired != NULL)
+		return cpuData.expired->schedule_time;
+
+	bigtime_t earliest = B_INFINITE_TIMEOUT;
+
+	// The slots of each level are ordered by time, starting with the one
+	// after the current one (for level 0 with the current one). So only the
+	// first non-empty slot of each level needs to be looked at.
+	for (int32 level = 0; level < kLevelCount; level++) {
+		uint64 pending = cpuData.levels[level].pending;
+		if (pending == 0)
+			continue;
+
+		int32 first = (cpuData.current_tick >> (level * kLevelShift))
+			& kSlotMask;
+		if (level > 0)
+			first++;
+
+		uint64 later = first < kSlotsPerLevel
+			? pending & (~(uint64)0 << first) : 0;
+		int32 slot = lowest_bit(later != 0 ? later : pending);
+
+		for (timer* event = cpuData.levels[level].slots[slot]; event != NULL;
+				event = event->next) {
+			if (event->schedule_time < earliest)
+				earliest = event->schedule_time;
+		}
+	}
+
+	for (timer* event = cpuData.overflow; event != NULL; event = event->next) {
+		if (event->schedule_time < earliest)
+			earliest = event->schedule_time;
+	}
+
+	return earliest;
+}
+
+
+/*!	Programs the hardware timer for the earliest timer of the current CPU. */
+static void
+update_hardware_timer(per_cpu_timer_data& cpuData)
+{
+	cpuData.next_event_time = earliest_schedule_time(cpuData);
+	if (cpuData.next_event_time == B_INFINITE_TIMEOUT)
+		arch_timer_clear_hardware_timer();
+	else
+		set_hardware_timer(cpuData.next_event_time);
+}
+
+
+static void
+collect_real_time_timers(timer** list, timer*& affectedTimers)
+{
+	timer** it = list;
 	while (timer* event = *it) {
 		// check whether it's an absolute real-time timer
 		uint32 flags = event->flags;
@@ -123,11 +454,44 @@ per_cpu_real_time_clock_changed(void*, int cpu)
 		event->next = affectedTimers;
 		affectedTimers = event;
 	}
+}
 
-	// update and requeue the affected timers
-	bool firstEventChanged = cpuData.events != firstEvent;
-	firstEvent = cpuData.events;
 
+static void
+per_cpu_real_time_clock_changed(void*, int cpu)
+{
+	per_cpu_timer_data& cpuData = sPerCPU[cpu];
+	SpinLocker cpuDataLocker(cpuData.lock);
+
+	bigtime_t realTimeOffset = rtc_boot_time();
+	if (realTimeOffset == cpuData.real_time_offset)
+		return;
+
+	// The real time offset has changed. We need to update all affected
+	// timers. First find and dequeue them.
+	bigtime_t timeDiff = cpuData.real_time_offset - realTimeOffset;
+	cpuData.real_time_offset = realTimeOffset;
+
+	timer* affectedTimers = NULL;
+	collect_real_time_timers(&cpuData.expired, affectedTimers);
+	collect_real_time_timers(&cpuData.overflow, affectedTimers);
+
+	for (int32 level = 0; level < kLevelCount; level++) {
+		timer_wheel_level& wheelLevel = cpuData.levels[level];
+		for (int32 slot = 0; slot < kSlotsPerLevel; slot++) {
+			if ((wheelLevel.pending & ((uint64)1 << slot)) == 0)
+				continue;
+
+			collect_real_time_timers(&wheelLevel.slots[slot], affectedTimers);
+			if (wheelLevel.slots[slot] == NULL)
+				wheelLevel.pending &= ~((uint64)1 << slot);
+		}
+	}
+
+	if (affectedTimers == NULL)
+		return;
+
+	// update and requeue the affected timers
 	while (affectedTimers != NULL) {
 		timer* event = affectedTimers;
 		affectedTimers = event->next;
@@ -144,58 +508,80 @@ per_cpu_real_time_clock_changed(void*, int cpu)
 				event->schedule_time = 0;
 		}
 
-		add_event_to_list(event, &cpuData.events);
+		insert_timer(cpuData, event);
 	}
 
-	firstEventChanged |= cpuData.events != firstEvent;
-
-	// If the first event has changed, reset the hardware timer.
-	if (firstEventChanged)
-		set_hardware_timer(cpuData.events->schedule_time);
+	update_hardware_timer(cpuData);
 }
 
 
 // #pragma mark - debugging
 
 
+static void
+dump_timer(timer* event)
+{
+	kprintf("  [%9lld] %p: ", (long long)event->schedule_time, event);
+	if ((event->flags & ~B_TIMER_FLAGS) == B_PERIODIC_TIMER)
+		kprintf("periodic %9lld, ", (long long)event->period);
+	else
+		kprintf("one shot,           ");
+
+	kprintf("flags: %#x, user data: %p, callback: %p  ",
+		event->flags, event->user_data, event->hook);
+
+	// look up and print the hook function symbol
+	const char* symbol;
+	const char* imageName;
+	bool exactMatch;
+
+	status_t error = elf_debug_lookup_symbol_address(
+		(addr_t)event->hook, NULL, &symbol, &imageName, &exactMatch);
+	if (error == B_OK && exactMatch) {
+		if (const char* slash = strchr(imageName, '/'))
+			imageName = slash + 1;
+
+		kprintf("   %s:%s", imageName, symbol);
+	}
+
+	kprintf("\n");
+}
+
+
 static int
 dump_timers(int argc, char** argv)
 {
 	int32 cpuCount = smp_get_num_cpus();
 	for (int32 i = 0; i < cpuCount; i++) {
+		per_cpu_timer_data& cpuData = sPerCPU[i];
 		kprintf("CPU %" B_PRId32 ":\n", i);
 
-		if (sPerCPU[i].events == NULL) {
+		if (cpuData.expired == NULL && wheel_is_empty(cpuData)) {
 			kprintf("  no timers scheduled\n");
 			continue;
 		}
 
-		for (timer* event = sPerCPU[i].events; event != NULL;
+		for (timer* event = cpuData.expired; event != NULL;
 				event = event->next) {
-			kprintf("  [%9lld] %p: ", (long long)event->schedule_time, event);
-			if ((event->flags & ~B_TIMER_FLAGS) == B_PERIODIC_TIMER)
-				kprintf("periodic %9lld, ", (long long)event->period);
-			else
-				kprintf("one shot,           ");
-
-			kprintf("flags: %#x, user data: %p, callback: %p  ",
-				event->flags, event->user_data, event->hook);
-
-			// look up and print the hook function symbol
-			const char* symbol;
-			const char* imageName;
-			bool exactMatch;
-
-			status_t error = elf_debug_lookup_symbol_address(
-				(addr_t)event->hook, NULL, &symbol, &imageName, &exactMatch);
-			if (error == B_OK && exactMatch) {
-				if (const char* slash = strchr(imageName, '/'))
-					imageName = slash + 1;
-
-				kprintf("   %s:%s", imageName, symbol);
+			dump_timer(event);
+		}
+
+		// print the timers roughly in the order they expire
+		for (int32 level = 0; level < kLevelCount; level++) {
+			int32 first = (cpuData.current_tick >> (level * kLevelShift))
+				& kSlotMask;
+			for (int32 j = 0; j < kSlotsPerLevel; j++) {
+				int32 slot = (first + j) & kSlotMask;
+				for (timer* event = cpuData.levels[level].slots[slot];
+						event != NULL; event = event->next) {
+					dump_timer(event);
+				}
 			}
+		}
 
-			kprintf("\n");
+		for (timer* event = cpuData.overflow; event != NULL;
+				event = event->next) {
+			dump_timer(event);
 		}
 	}
 
@@ -216,6 +602,9 @@ timer_init(kernel_args* args)
 	if (arch_init_timer(args) != B_OK)
 		panic("arch_init_timer() failed");
 
+	for (int32 i = 0; i < SMP_MAX_CPUS; i++)
+		sPerCPU[i].next_event_time = B_INFINITE_TIMEOUT;
+
 	add_debugger_command_etc("timers", &dump_timers, "List all timers",
 		"\n"
 		"Prints a list of all scheduled timers.\n", 0);
@@ -245,7 +634,6 @@ timer_real_time_clock_changed()
 int32
 timer_interrupt()
 {
-	timer* event;
 	spinlock* spinlock;
 	per_cpu_timer_data& cpuData = sPerCPU[smp_get_current_cpu()];
 	int32 rc = B_HANDLED_INTERRUPT;
@@ -257,12 +645,13 @@ timer_interrupt()
 
 	acquire_spinlock(spinlock);
 
-	event = cpuData.events;
-	while (event != NULL && ((bigtime_t)event->schedule_time < system_time())) {
+	collect_expired_timers(cpuData, system_time());
+
+	while (timer* event = cpuData.expired) {
 		// this event needs to happen
 		int mode = event->flags;
 
-		cpuData.events = (timer*)event->next;
+		cpuData.expired = event->next;
 		cpuData.current_event = event;
 		atomic_set(&cpuData.current_event_in_progress, 1);
 
@@ -283,7 +672,7 @@ timer_interrupt()
 
 		if ((mode & ~B_TIMER_FLAGS) == B_PERIODIC_TIMER
 			&& cpuData.current_event != NULL) {
-			// we need to adjust it and add it back to the list
+			// we need to adjust it and add it back to the wheel
 			event->schedule_time += event->period;
 
 			// If the new schedule time is a full interval or more in the past,
@@ -295,17 +684,20 @@ timer_interrupt()
 					- (now - event->schedule_time) % event->period;
 			}
 
-			add_event_to_list(event, &cpuData.events);
+			insert_timer(cpuData, event);
 		}
 
 		cpuData.current_event = NULL;
 
-		event = cpuData.events;
+		// more timers might have become due in the meantime
+		if (cpuData.expired == NULL)
+			collect_expired_timers(cpuData, system_time());
 	}
 
 	// setup the next hardware timer
-	if (cpuData.events != NULL)
-		set_hardware_timer(cpuData.events->schedule_time);
+	cpuData.next_event_time = earliest_schedule_time(cpuData);
+	if (cpuData.next_event_time != B_INFINITE_TIMEOUT)
+		set_hardware_timer(cpuData.next_event_time);
 
 	release_spinlock(spinlock);
 
@@ -328,12 +720,8 @@ add_timer(timer* event, timer_hook hook, bigtime_t period, int32 flags)
 	TRACE(("add_timer: event %p\n", event));
 
 	// compute the schedule time
-	bigtime_t scheduleTime;
-	if ((flags & B_TIMER_USE_TIMER_STRUCT_TIMES) != 0) {
-		scheduleTime = event->schedule_time;
-		period = event->period;
-	} else {
-		scheduleTime = period;
+	if ((flags & B_TIMER_USE_TIMER_STRUCT_TIMES) == 0) {
+		bigtime_t scheduleTime = period;
 		if ((flags & ~B_TIMER_FLAGS) != B_ONE_SHOT_ABSOLUTE_TIMER)
 			scheduleTime += currentTime;
 		event->schedule_time = (int64)scheduleTime;
@@ -358,12 +746,20 @@ add_timer(timer* event, timer_hook hook, bigtime_t period, int32 flags)
 			event->schedule_time = 0;
 	}
 
-	add_event_to_list(event, &cpuData.events);
+	// If the wheel is empty, it doesn't need to catch up with the current
+	// time by itself.
+	int64 currentTick = currentTime >> kTickShift;
+	if (currentTick > cpuData.current_tick && wheel_is_empty(cpuData))
+		cpuData.current_tick = currentTick;
+
+	insert_timer(cpuData, event);
 	event->cpu = currentCPU;
 
-	// if we were stuck at the head of the list, set the hardware timer
-	if (event == cpuData.events)
-		set_hardware_timer(scheduleTime, currentTime);
+	// if it's the first timer to expire now, set the hardware timer
+	if (event->schedule_time < cpuData.next_event_time) {
+		cpuData.next_event_time = event->schedule_time;
+		set_hardware_timer(event->schedule_time, currentTime);
+	}
 
 	release_spinlock(&cpuData.lock);
 	restore_interrupts(state);
@@ -398,39 +794,20 @@ cancel_timer(timer* event)
 	per_cpu_timer_data& cpuData = sPerCPU[cpu];
 
 	if (event != cpuData.current_event) {
-		// The timer hook is not yet being executed.
-		timer* current = cpuData.events;
-		timer* last = NULL;
-
-		while (current != NULL) {
-			if (current == event) {
-				// we found it
-				if (last == NULL)
-					cpuData.events = current->next;
-				else
-					last->next = current->next;
-				current->next = NULL;
-				// break out of the whole thing
-				break;
-			}
-			last = current;
-			current = current->next;
-		}
-
-		// If not found, we assume this was a one-shot timer and has already
-		// fired.
-		if (current == NULL)
+		// The timer hook is not yet being executed. If the timer isn't
+		// queued, we assume this was a one-shot timer and has already fired.
+		if (!remove_timer(cpuData, event))
 			return true;
 
 		// invalidate CPU field
 		event->cpu = 0xffff;
 
-		// If on the current CPU, also reset the hardware timer.
-		if (cpu == smp_get_current_cpu()) {
-			if (cpuData.events == NULL)
-				arch_timer_clear_hardware_timer();
-			else
-				set_hardware_timer(cpuData.events->schedule_time);
+		// If on the current CPU, also reset the hardware timer, if this was
+		// the timer it was set for. Other CPUs will just get an interrupt
+		// with nothing to do.
+		if (cpu == smp_get_current_cpu()
+			&& event->schedule_time <= cpuData.next_event_time) {
+			update_hardware_timer(cpuData);
 		}
 
 		return false;
@@ -503,58 +503,18 @@ status_t
 VMAnonymousCache::Resize(off_t newSize, int priority)
 {
 	// If the cache size shrinks, drop all swap pages beyond the new size.
-	if (fAllocatedSwapSize > 0) {
-		off_t oldPageCount = (virtual_end + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-		swap_block* swapBlock = NULL;
+	if (newSize < virtual_end)
+		_FreeSwapPageRange(newSize, virtual_end);
 
-		for (off_t pageIndex = (newSize + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
-			pageIndex < oldPageCount && fAllocatedSwapSize > 0; pageIndex++) {
-
-			WriteLocker locker(sSwapHashLock);
-
-			// Get the swap slot index for the page.
-			swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
-			if (swapBlock == NULL || blockIndex == 0) {
-				swap_hash_key key = { this, pageIndex };
-				swapBlock = sSwapHashTable.Lookup(key);
+	return VMCache::Resize(newSize, priority);
+}
 
-				if (swapBlock == NULL) {
-					pageIndex = ROUNDUP(pageIndex + 1, SWAP_BLOCK_PAGES);
-					continue;
-				}
-			}
 
-			swap_addr_t slotIndex = swapBlock->swap_slots[blockIndex];
-			vm_page* page;
-			if (slotIndex != SWAP_SLOT_NONE
-				&& ((page = LookupPage((off_t)pageIndex * B_PAGE_SIZE)) == NULL
-					|| !page->busy)) {
-					// TODO: We skip (i.e. leak) swap space of busy pages, since
-					// there could be I/O going on (paging in/out). Waiting is
-					// not an option as 1. unlocking the cache means that new
-					// swap pages could be added in a range we've already
-					// cleared (since the cache still has the old size) and 2.
-					// we'd risk a deadlock in case we come from the file cache
-					// and the FS holds the node's write-lock. We should mark
-					// the page invalid and let the one responsible clean up.
-					// There's just no such mechanism yet.
-				swap_slot_dealloc(slotIndex, 1);
-				fAllocatedSwapSize -= B_PAGE_SIZE;
-
-				swapBlock->swap_slots[blockIndex] = SWAP_SLOT_NONE;
-				if (--swapBlock->used == 0) {
-					// All swap pages have been freed -- we can discard the swap
-					// block.
-					sSwapHashTable.RemoveUnchecked(swapBlock);
-					object_cache_free(sSwapBlockCache, swapBlock,
-						CACHE_DONT_WAIT_FOR_MEMORY
-							| CACHE_DONT_LOCK_KERNEL_SPACE);
-				}
-			}
-		}
-	}
-
-	return VMCache::Resize(newSize, priority);
+status_t
+VMAnonymousCache::Discard(off_t offset, off_t size)
+{
+	_FreeSwapPageRange(offset, offset + size);
+	return VMCache::Discard(offset, size);
 }
 
 
@@ -1052,6 +1012,67 @@ VMAnonymousCache::_Commit(off_t size, int priority)
 }
 
 
+/*!	Frees the swap space of all pages in the range [\a fromOffset,
+	\a toOffset). Pages that are busy are skipped.
+	The cache must be locked.
+*/
+void
+VMAnonymousCache::_FreeSwapPageRange(off_t fromOffset, off_t toOffset)
+{
+	if (fAllocatedSwapSize == 0)
+		return;
+
+	off_t endPageIndex = (toOffset + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	swap_block* swapBlock = NULL;
+
+	for (off_t pageIndex = (fromOffset + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+		pageIndex < endPageIndex && fAllocatedSwapSize > 0; pageIndex++) {
+
+		WriteLocker locker(sSwapHashLock);
+
+		// Get the swap slot index for the page.
+		swap_addr_t blockIndex = pageIndex & SWAP_BLOCK_MASK;
+		if (swapBlock == NULL || blockIndex == 0) {
+			swap_hash_key key = { this, pageIndex };
+			swapBlock = sSwapHashTable.Lookup(key);
+
+			if (swapBlock == NULL) {
+				pageIndex = ROUNDUP(pageIndex + 1, SWAP_BLOCK_PAGES);
+				continue;
+			}
+		}
+
+		swap_addr_t slotIndex = swapBlock->swap_slots[blockIndex];
+		vm_page* page;
+		if (slotIndex != SWAP_SLOT_NONE
+			&& ((page = LookupPage((off_t)pageIndex * B_PAGE_SIZE)) == NULL
+				|| !page->busy)) {
+				// TODO: We skip (i.e. leak) swap space of busy pages, since
+				// there could be I/O going on (paging in/out). Waiting is
+				// not an option as 1. unlocking the cache means that new
+				// swap pages could be added in a range we've already
+				// cleared (since the cache still has the old size) and 2.
+				// we'd risk a deadlock in case we come from the file cache
+				// and the FS holds the node's write-lock. We should mark
+				// the page invalid and let the one responsible clean up.
+				// There's just no such mechanism yet.
+			swap_slot_dealloc(slotIndex, 1);
+			fAllocatedSwapSize -= B_PAGE_SIZE;
+
+			swapBlock->swap_slots[blockIndex] = SWAP_SLOT_NONE;
+			if (--swapBlock->used == 0) {
+				// All swap pages have been freed -- we can discard the swap
+				// block.
+				sSwapHashTable.RemoveUnchecked(swapBlock);
+				object_cache_free(sSwapBlockCache, swapBlock,
+					CACHE_DONT_WAIT_FOR_MEMORY
+						| CACHE_DONT_LOCK_KERNEL_SPACE);
+			}
+		}
+	}
+}
+
+
 void
 VMAnonymousCache::_MergePagesSmallerSource(VMAnonymousCache* source)
 {
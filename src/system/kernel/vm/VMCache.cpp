@@ -1104,37 +1104,7 @@ VMCache::Resize(off_t newSize, int priority)
 	if (newPageCount < oldPageCount) {
 		// we need to remove all pages in the cache outside of the new virtual
 		// size
-		for (VMCachePagesTree::Iterator it
-					= pages.GetIterator(newPageCount, true, true);
-				vm_page* page = it.Next();) {
-			if (page->busy) {
-				if (page->busy_writing) {
-					// We cannot wait for the page to become available
-					// as we might cause a deadlock this way
-					page->busy_writing = false;
-						// this will notify the writer to free the page
-				} else {
-					// wait for page to become unbusy
-					WaitForPageEvents(page, PAGE_EVENT_NOT_BUSY, true);
-
-					// restart from the start of the list
-					it = pages.GetIterator(newPageCount, true, true);
-				}
-				continue;
-			}
-
-			// remove the page and put it into the free queue
-			DEBUG_PAGE_ACCESS_START(page);
-			vm_remove_all_page_mappings(page);
-			ASSERT(page->WiredCount() == 0);
-				// TODO: Find a real solution! If the page is wired
-				// temporarily (e.g. by lock_memory()), we actually must not
-				// unmap it!
-			RemovePage(page);
-			vm_page_free(this, page);
-				// Note: When iterating through a IteratableSplayTree
-				// removing the current node is safe.
-		}
+		_FreePageRange(newPageCount, oldPageCount);
 	}
 
 	virtual_end = newSize;
@@ -1142,6 +1112,26 @@ VMCache::Resize(off_t newSize, int priority)
 }
 
 
+/*!	Frees all pages in the given range, so that they will read as zeros (or
+	whatever the source caches contain) the next time they are accessed.
+	The pages are unmapped from all areas. The cache's commitment remains
+	unchanged.
+	The cache must be locked; the lock may be released temporarily.
+	\param offset The start of the range, page aligned.
+	\param size The size of the range.
+*/
+status_t
+VMCache::Discard(off_t offset, off_t size)
+{
+	AssertLocked();
+
+	_FreePageRange(offset >> PAGE_SHIFT,
+		(offset + size + B_PAGE_SIZE - 1) >> PAGE_SHIFT);
+
+	return B_OK;
+}
+
+
 /*!	You have to call this function with the VMCache lock held. */
 status_t
 VMCache::FlushAndRemoveAllPages()
@@ -1454,6 +1444,51 @@ VMCache::_RemoveConsumer(VMCache* consumer)
 }
 
 
+/*!	Removes all pages in the range [\a firstPage, \a endPage) from the cache
+	and frees them. Busy pages are waited for, unless they are being written,
+	in which case the writer is told to free them.
+	The cache must be locked; the lock may be released temporarily.
+*/
+void
+VMCache::_FreePageRange(page_num_t firstPage, page_num_t endPage)
+{
+	for (VMCachePagesTree::Iterator it
+				= pages.GetIterator(firstPage, true, true);
+			vm_page* page = it.Next();) {
+		if (page->cache_offset >= endPage)
+			break;
+
+		if (page->busy) {
+			if (page->busy_writing) {
+				// We cannot wait for the page to become available
+				// as we might cause a deadlock this way
+				page->busy_writing = false;
+					// this will notify the writer to free the page
+			} else {
+				// wait for page to become unbusy
+				WaitForPageEvents(page, PAGE_EVENT_NOT_BUSY, true);
+
+				// restart from the start of the list
+				it = pages.GetIterator(firstPage, true, true);
+			}
+			continue;
+		}
+
+		// remove the page and put it into the free queue
+		DEBUG_PAGE_ACCESS_START(page);
+		vm_remove_all_page_mappings(page);
+		ASSERT(page->WiredCount() == 0);
+			// TODO: Find a real solution! If the page is wired
+			// temporarily (e.g. by lock_memory()), we actually must not
+			// unmap it!
+		RemovePage(page);
+		vm_page_free(this, page);
+			// Note: When iterating through a IteratableSplayTree
+			// removing the current node is safe.
+	}
+}
+
+
 // #pragma mark - VMCacheFactory
 	// TODO: Move to own source file!
 
@@ -31,6 +31,34 @@ VMTranslationMap::~VMTranslationMap()
 }
 
 
+/*!	Returns the size of the large pages MapLargePage() can map, or \c 0, if
+	the implementation doesn't support large pages.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Maps a physically contiguous range of LargePageSize() bytes with a single
+	large page. Both the virtual and the physical address must be aligned to
+	the large page size.
+	Callers have to be prepared for the mapping to be split up into normal
+	pages again at any time, i.e. all other methods continue to work on a
+	per-page basis.
+	The caller must have reserved at least MaxPagesNeededToMap() pages for
+	the range.
+*/
+status_t
+VMTranslationMap::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 status_t
 VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -11,6 +11,7 @@
 #include <vm/vm.h>
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -1384,6 +1385,22 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 		&& wait_if_address_range_is_wired(addressSpace,
 			(addr_t)virtualAddressRestrictions->address, size, &locker));
 
+	// Areas that shall be backed by large pages need to be aligned
+	// accordingly.
+	virtual_address_restrictions largePageAddressRestrictions;
+	if ((protection & B_LARGE_PAGES) != 0
+		&& virtualAddressRestrictions->alignment == 0
+		&& virtualAddressRestrictions->address_specification
+			!= B_EXACT_ADDRESS) {
+		size_t largePageSize
+			= addressSpace->TranslationMap()->LargePageSize();
+		if (largePageSize != 0 && size >= largePageSize) {
+			largePageAddressRestrictions = *virtualAddressRestrictions;
+			largePageAddressRestrictions.alignment = largePageSize;
+			virtualAddressRestrictions = &largePageAddressRestrictions;
+		}
+	}
+
 	// create an anonymous cache
 	// if it's a stack, make sure that two pages are available at least
 	status = VMCacheFactory::CreateAnonymousCache(cache, canOvercommit,
@@ -4560,6 +4577,125 @@ fault_get_page(PageFaultContext& context)
 }
 
 
+/*!	Tries to resolve a page fault in an area that asked for large pages
+	(\c B_LARGE_PAGES) by populating the whole large page range around the
+	faulting address with a physically contiguous run of fresh pages, mapped
+	by a single large page.
+	Only ranges of the area's top cache that don't have any pages yet
+	qualify. The address space and the top cache must be locked.
+	\return \c true, if the fault has been resolved, \c false, if the page
+		shall be mapped the normal way.
+*/
+static bool
+fault_map_large_page(PageFaultContext& context, VMArea* area, addr_t address,
+	uint32 protection)
+{
+	VMTranslationMap* map = context.map;
+	size_t largePageSize = map->LargePageSize();
+	if (largePageSize == 0 || (area->protection & B_LARGE_PAGES) == 0
+		|| area->wiring != B_NO_LOCK || area->page_protections != NULL) {
+		return false;
+	}
+
+	addr_t base = ROUNDDOWN(address, largePageSize);
+	if (base < area->Base()
+		|| base + (largePageSize - 1) > area->Base() + (area->Size() - 1)) {
+		return false;
+	}
+
+	// Only fully committed anonymous caches without a source qualify --
+	// otherwise we would have to look for pages in the source caches, too.
+	VMCache* cache = context.topCache;
+	if (cache->type != CACHE_TYPE_RAM || !cache->temporary
+		|| cache->source != NULL
+		|| cache->committed_size < cache->virtual_end - cache->virtual_base) {
+		return false;
+	}
+
+	off_t cacheOffset = base - area->Base() + area->cache_offset;
+	page_num_t firstPage = cacheOffset / B_PAGE_SIZE;
+	page_num_t pageCount = largePageSize / B_PAGE_SIZE;
+
+	vm_page* page = cache->pages.GetIterator(firstPage, true, true).Next();
+	if (page != NULL && page->cache_offset < firstPage + pageCount)
+		return false;
+
+	for (page_num_t i = 0; i < pageCount; i++) {
+		if (cache->HasPage(cacheOffset + i * B_PAGE_SIZE))
+			return false;
+	}
+
+	// Allocate all mapping objects upfront, so we won't have to back out
+	// later.
+	bool isKernelSpace = area->address_space == VMAddressSpace::Kernel();
+	uint32 allocationFlags = CACHE_DONT_WAIT_FOR_MEMORY
+		| (isKernelSpace ? CACHE_DONT_LOCK_KERNEL_SPACE : 0);
+
+	VMAreaMappings mappings;
+	for (page_num_t i = 0; i < pageCount; i++) {
+		vm_page_mapping* mapping = (vm_page_mapping*)object_cache_alloc(
+			gPageMappingsObjectCache, allocationFlags);
+		if (mapping == NULL)
+			break;
+		mappings.Add(mapping);
+	}
+
+	vm_page* pages = NULL;
+	if (mappings.Count() == (int32)pageCount) {
+		pages = vm_page_allocate_large_page(
+			PAGE_STATE_ACTIVE | VM_PAGE_ALLOC_CLEAR, pageCount,
+			isKernelSpace ? VM_PRIORITY_SYSTEM : VM_PRIORITY_USER);
+	}
+
+	if (pages == NULL) {
+		while (vm_page_mapping* mapping = mappings.RemoveHead())
+			object_cache_free(gPageMappingsObjectCache, mapping,
+				allocationFlags);
+		return false;
+	}
+
+	for (page_num_t i = 0; i < pageCount; i++)
+		cache->InsertPage(&pages[i], cacheOffset + i * B_PAGE_SIZE);
+
+	map->Lock();
+
+	status_t status = map->MapLargePage(base,
+		pages->physical_page_number * B_PAGE_SIZE, protection,
+		area->MemoryType(), &context.reservation);
+	if (status != B_OK) {
+		// the range is still covered by a page table in use
+		map->Unlock();
+
+		for (page_num_t i = 0; i < pageCount; i++) {
+			cache->RemovePage(&pages[i]);
+			vm_page_set_state(&pages[i], PAGE_STATE_FREE);
+		}
+
+		while (vm_page_mapping* mapping = mappings.RemoveHead())
+			object_cache_free(gPageMappingsObjectCache, mapping,
+				allocationFlags);
+		return false;
+	}
+
+	for (page_num_t i = 0; i < pageCount; i++) {
+		vm_page_mapping* mapping = mappings.RemoveHead();
+		mapping->page = &pages[i];
+		mapping->area = area;
+
+		pages[i].mappings.Add(mapping);
+		area->mappings.Add(mapping);
+
+		DEBUG_PAGE_ACCESS_END(&pages[i]);
+	}
+
+	atomic_add(&gMappedPagesCount, pageCount);
+
+	map->Unlock();
+
+	return true;
+}
+
+
 /*!	Makes sure the address in the given address space is mapped.
 
 	\param addressSpace The address space.
@@ -4665,6 +4801,14 @@ vm_soft_fault(VMAddressSpace* addressSpace, addr_t originalAddress,
 				break;
 		}
 
+		// Areas that asked for large pages get the complete large page range
+		// populated at once, if possible.
+		if (wirePage == NULL
+			&& fault_map_large_page(context, area, address, protection)) {
+			status = B_OK;
+			break;
+		}
+
 		// The top most cache has no fault handler, so let's see if the cache or
 		// its sources already have the page we're searching for (we're going
 		// from top to bottom).
@@ -6247,7 +6391,7 @@ _user_get_next_area_info(team_id team, ssize_t* userCookie, area_info* userInfo)
 status_t
 _user_set_area_protection(area_id area, uint32 newProtection)
 {
-	if ((newProtection & ~B_USER_PROTECTION) != 0)
+	if ((newProtection & ~(B_USER_PROTECTION | B_LARGE_PAGES)) != 0)
 		return B_BAD_VALUE;
 
 	return vm_set_area_protection(VMAddressSpace::CurrentID(), area,
@@ -6690,14 +6834,149 @@ _user_sync_memory(void* _address, size_t size, uint32 flags)
 }
 
 
-status_t
-_user_memory_advice(void* address, size_t size, uint32 advice)
+/*!	Implements MADV_FREE: the pages in the given range of the current team's
+	address space are unmapped and freed, together with any swap space they
+	occupy. Subsequent accesses fault in zeroed pages.
+	Only private anonymous memory is discarded; other areas in the range are
+	left alone, as the advice is only a hint.
+*/
+static status_t
+discard_memory(addr_t address, size_t size)
+{
+	AddressSpaceReadLocker locker;
+	status_t status = locker.SetTo(team_get_current_team_id());
+	if (status != B_OK)
+		return status;
+
+	addr_t currentAddress = address;
+	size_t sizeLeft = size;
+	while (sizeLeft > 0) {
+		VMArea* area = locker.AddressSpace()->LookupArea(currentAddress);
+		if (area == NULL)
+			return B_NO_MEMORY;
+
+		addr_t offset = currentAddress - area->Base();
+		size_t rangeSize = min_c(area->Size() - offset, sizeLeft);
+
+		currentAddress += rangeSize;
+		sizeLeft -= rangeSize;
+
+		if (area->wiring != B_NO_LOCK
+			|| (area->protection & B_KERNEL_AREA) != 0) {
+			continue;
+		}
+
+		VMCache* cache = vm_area_get_locked_cache(area);
+
+		// The cache must not be shared with anyone else -- neither with other
+		// areas nor with copy-on-write consumers or sources.
+		if (cache->type == CACHE_TYPE_RAM && cache->source == NULL
+			&& cache->consumers.IsEmpty() && cache->areas == area
+			&& area->cache_next == NULL
+			&& !area->IsWired(area->Base() + offset, rangeSize)) {
+			unmap_pages(area, area->Base() + offset, rangeSize);
+			cache->Discard(area->cache_offset + offset, rangeSize);
+		}
+
+		vm_area_put_locked_cache(cache);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Passes the \a advice on to the file caches that back the given range of
+	the current team's address space. Other areas in the range are left
+	alone, as the advice is only a hint.
+*/
+static status_t
+advise_file_caches(addr_t address, size_t size, int advice)
 {
-	// TODO: Implement!
+	addr_t currentAddress = address;
+	size_t sizeLeft = size;
+	while (sizeLeft > 0) {
+		AddressSpaceReadLocker locker;
+		status_t status = locker.SetTo(team_get_current_team_id());
+		if (status != B_OK)
+			return status;
+
+		VMArea* area = locker.AddressSpace()->LookupArea(currentAddress);
+		if (area == NULL)
+			return B_NO_MEMORY;
+
+		addr_t offset = currentAddress - area->Base();
+		size_t rangeSize = min_c(area->Size() - offset, sizeLeft);
+
+		currentAddress += rangeSize;
+		sizeLeft -= rangeSize;
+
+		// Private file mappings have an anonymous cache on top of the file's
+		// one; both use the same offsets.
+		VMCache* cache = vm_area_get_locked_cache(area);
+		VMCache* fileCache = cache;
+		if (fileCache->type != CACHE_TYPE_VNODE)
+			fileCache = fileCache->source;
+
+		if (fileCache == NULL || fileCache->type != CACHE_TYPE_VNODE) {
+			vm_area_put_locked_cache(cache);
+			continue;
+		}
+
+		fileCache->AcquireRef();
+		off_t fileOffset = area->cache_offset + offset;
+
+		vm_area_put_locked_cache(cache);
+		locker.Unlock();
+
+		status = file_cache_advise(fileCache, fileOffset, rangeSize, advice);
+		fileCache->ReleaseRef();
+
+		if (status != B_OK)
+			return status;
+	}
+
 	return B_OK;
 }
 
 
+status_t
+_user_memory_advice(void* _address, size_t size, uint32 advice)
+{
+	// check address range
+	addr_t address = (addr_t)_address;
+	size = PAGE_ALIGN(size);
+
+	if ((address % B_PAGE_SIZE) != 0)
+		return B_BAD_VALUE;
+	if (address + size < address || !IS_USER_ADDRESS(address)
+		|| !IS_USER_ADDRESS(address + size)) {
+		return B_BAD_ADDRESS;
+	}
+
+	switch (advice) {
+		case POSIX_MADV_NORMAL:
+			return advise_file_caches(address, size, POSIX_FADV_NORMAL);
+		case POSIX_MADV_SEQUENTIAL:
+			return advise_file_caches(address, size, POSIX_FADV_SEQUENTIAL);
+		case POSIX_MADV_RANDOM:
+			return advise_file_caches(address, size, POSIX_FADV_RANDOM);
+		case POSIX_MADV_WILLNEED:
+			return advise_file_caches(address, size, POSIX_FADV_WILLNEED);
+
+		case POSIX_MADV_DONTNEED:
+			// TODO: Pass this on to the cache! Mapped pages would have to be
+			// unmapped first, though.
+			return B_OK;
+
+		case MADV_FREE:
+			return discard_memory(address, size);
+
+		default:
+			return B_BAD_VALUE;
+	}
+}
+
+
 status_t
 _user_get_memory_properties(team_id teamID, const void* address,
 	uint32* _protected, uint32* _lock)
@@ -23,10 +23,12 @@
 #include <block_cache.h>
 #include <boot/kernel_args.h>
 #include <condition_variable.h>
+#include <cpu.h>
 #include <elf.h>
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -66,6 +68,12 @@
 #define SCRUB_SIZE 16
 	// this many pages will be cleared at once in the page scrubber thread
 
+#define PAGE_CPU_CACHE_SIZE		64
+	// maximum number of free pages kept in each CPU's page cache
+#define PAGE_CPU_CACHE_BATCH	16
+	// this many pages are moved between a CPU's page cache and the free queue
+	// at once
+
 #define MAX_PAGE_WRITER_IO_PRIORITY				B_URGENT_DISPLAY_PRIORITY
 	// maximum I/O priority of the page writer
 #define MAX_PAGE_WRITER_IO_PRIORITY_THRESHOLD	10000
@@ -104,13 +112,29 @@ int32 gMappedPagesCount;
 
 static VMPageQueue sPageQueues[PAGE_STATE_COUNT];
 
-static VMPageQueue& sFreePageQueue = sPageQueues[PAGE_STATE_FREE];
-static VMPageQueue& sClearPageQueue = sPageQueues[PAGE_STATE_CLEAR];
 static VMPageQueue& sModifiedPageQueue = sPageQueues[PAGE_STATE_MODIFIED];
 static VMPageQueue& sInactivePageQueue = sPageQueues[PAGE_STATE_INACTIVE];
 static VMPageQueue& sActivePageQueue = sPageQueues[PAGE_STATE_ACTIVE];
 static VMPageQueue& sCachedPageQueue = sPageQueues[PAGE_STATE_CACHED];
 
+// The free and clear pages are kept in one queue pair per memory node. Unless
+// the boot loader found NUMA information, there is only node 0.
+static VMPageQueue sFreePageQueues[MAX_MEMORY_NODES];
+static VMPageQueue sClearPageQueues[MAX_MEMORY_NODES];
+
+struct memory_node_page_range {
+	page_num_t	start;
+	page_num_t	end;
+	int32		node;
+};
+
+static int32 sMemoryNodeCount = 1;
+static memory_node_page_range sMemoryNodeRanges[MAX_MEMORY_NODE_RANGES];
+static uint32 sMemoryNodeRangeCount = 0;
+static int32 sMemoryNodeFallbackOrder[MAX_MEMORY_NODES][MAX_MEMORY_NODES];
+	// for each node all nodes ordered by increasing distance, starting with
+	// the node itself
+
 static vm_page *sPages;
 static page_num_t sPhysicalPageOffset;
 static page_num_t sNumPages;
@@ -135,6 +159,30 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+// Each CPU keeps a small stack of free pages in front of the free page queue,
+// so that most allocations and frees don't have to touch the queue's spinlock.
+// The pages are still in PAGE_STATE_FREE and are accounted for in
+// sUnreservedFreePages; they just aren't in the queue (vm_page::cpu_cached is
+// set instead). A CPU page cache is only changed with interrupts disabled,
+// while holding its spinlock and at least a read lock on sFreePageQueuesLock.
+// Thus holding the write lock and draining all caches makes all free pages
+// visible in the free queue again.
+struct page_cpu_cache {
+	spinlock	lock;
+	int32		node;
+		// the CPU's memory node; only pages of that node are cached
+	uint32		count;
+	vm_page*	pages[PAGE_CPU_CACHE_SIZE];
+} CACHE_LINE_ALIGN;
+
+static page_cpu_cache sPageCPUCaches[SMP_MAX_CPUS];
+static bool sPageCPUCachesEnabled = false;
+
+// vm_page_allocate_large_page() only looks at that many aligned runs, starting
+// with the one after the last one it looked at
+static const page_num_t kMaxLargePageCandidates = 64;
+static page_num_t sLargePageSearchRun = 0;
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -774,8 +822,6 @@ find_page(int argc, char **argv)
 		const char*	name;
 		VMPageQueue*	queue;
 	} pageQueueInfos[] = {
-		{ "free",		&sFreePageQueue },
-		{ "clear",		&sClearPageQueue },
 		{ "modified",	&sModifiedPageQueue },
 		{ "active",		&sActivePageQueue },
 		{ "inactive",	&sInactivePageQueue },
@@ -805,6 +851,30 @@ find_page(int argc, char **argv)
 		}
 	}
 
+	for (i = 0; i < sMemoryNodeCount; i++) {
+		VMPageQueue* queues[] = { &sFreePageQueues[i], &sClearPageQueues[i] };
+		for (int32 j = 0; j < 2; j++) {
+			VMPageQueue::Iterator it = queues[j]->GetIterator();
+			while (vm_page* p = it.Next()) {
+				if (p == page) {
+					kprintf("found page %p in queue %p (%s, node %d)\n", page,
+						queues[j], j == 0 ? "free" : "clear", i);
+					return 0;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		for (uint32 j = 0; j < cache.count; j++) {
+			if (cache.pages[j] == page) {
+				kprintf("found page %p in page cache of CPU %d\n", page, i);
+				return 0;
+			}
+		}
+	}
+
 	kprintf("page %p isn't in any queue\n", page);
 
 	return 0;
@@ -915,6 +985,7 @@ dump_page(int argc, char **argv)
 	kprintf("busy_writing:    %d\n", page->busy_writing);
 	kprintf("accessed:        %d\n", page->accessed);
 	kprintf("modified:        %d\n", page->modified);
+	kprintf("cpu_cached:      %d\n", page->cpu_cached);
 	#if DEBUG_PAGE_QUEUE
 		kprintf("queue:           %p\n", page->queue);
 	#endif
@@ -980,9 +1051,9 @@ dump_page_queue(int argc, char **argv)
 	if (strlen(argv[1]) >= 2 && argv[1][0] == '0' && argv[1][1] == 'x')
 		queue = (VMPageQueue*)strtoul(argv[1], NULL, 16);
 	else if (!strcmp(argv[1], "free"))
-		queue = &sFreePageQueue;
+		queue = &sFreePageQueues[0];
 	else if (!strcmp(argv[1], "clear"))
-		queue = &sClearPageQueue;
+		queue = &sClearPageQueues[0];
 	else if (!strcmp(argv[1], "modified"))
 		queue = &sModifiedPageQueue;
 	else if (!strcmp(argv[1], "active"))
@@ -1115,10 +1186,17 @@ dump_page_stats(int argc, char **argv)
 			waiter->missing, waiter->dontTouch);
 	}
 
-	kprintf("\nfree queue: %p, count = %" B_PRIuPHYSADDR "\n", &sFreePageQueue,
-		sFreePageQueue.Count());
-	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
-		sClearPageQueue.Count());
+	kprintf("\n");
+	for (int32 i = 0; i < sMemoryNodeCount; i++) {
+		kprintf("node %" B_PRId32 " free queue: %p, count = %" B_PRIuPHYSADDR
+			"\n", i, &sFreePageQueues[i], sFreePageQueues[i].Count());
+		kprintf("node %" B_PRId32 " clear queue: %p, count = %" B_PRIuPHYSADDR
+			"\n", i, &sClearPageQueues[i], sClearPageQueues[i].Count());
+	}
+	kprintf("CPU page caches:");
+	for (int32 i = 0; i < smp_get_num_cpus(); i++)
+		kprintf(" %" B_PRIu32, sPageCPUCaches[i].count);
+	kprintf("\n");
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1463,6 +1541,218 @@ unreserve_pages(uint32 count)
 }
 
 
+/*!	Returns the memory node the given page belongs to.
+*/
+static inline int32
+page_memory_node(const vm_page* page)
+{
+	if (sMemoryNodeCount == 1)
+		return 0;
+
+	page_num_t pageNumber = page->physical_page_number;
+	for (uint32 i = 0; i < sMemoryNodeRangeCount; i++) {
+		if (pageNumber >= sMemoryNodeRanges[i].start
+			&& pageNumber < sMemoryNodeRanges[i].end) {
+			return sMemoryNodeRanges[i].node;
+		}
+	}
+
+	return 0;
+}
+
+
+/*!	Returns the memory node of the CPU the current thread is running on.
+	Since the thread might be migrated at any time, the result is only a hint.
+*/
+static inline int32
+current_memory_node()
+{
+	if (sMemoryNodeCount == 1 || !sPageCPUCachesEnabled)
+		return 0;
+
+	return sPageCPUCaches[smp_get_current_cpu()].node;
+}
+
+
+/*!	Moves the \a count oldest pages of the given CPU page cache to the free
+	queue of the cache's memory node.
+	Interrupts must be disabled, and the caller must hold the cache's spinlock
+	and a read lock on \c sFreePageQueuesLock.
+	\return \c true, if the free queue thereby crossed the threshold at which
+		the page scrubber should be woken up.
+*/
+static bool
+page_cpu_cache_flush(page_cpu_cache& cache, uint32 count)
+{
+	VMPageQueue& freeQueue = sFreePageQueues[cache.node];
+	SpinLocker queueLocker(freeQueue.GetLock());
+
+	phys_addr_t previousCount = freeQueue.Count();
+
+	for (uint32 i = 0; i < count; i++) {
+		vm_page* page = cache.pages[i];
+		page->cpu_cached = false;
+		freeQueue.Prepend(page);
+	}
+
+	queueLocker.Unlock();
+
+	cache.count -= count;
+	memmove(cache.pages, cache.pages + count, cache.count * sizeof(vm_page*));
+
+	return previousCount < SCRUB_SIZE && previousCount + count >= SCRUB_SIZE;
+}
+
+
+/*!	Takes a free page from the current CPU's page cache, refilling the cache
+	with a batch of pages from the free queue of the CPU's memory node, if it
+	is empty.
+	The caller must hold a read lock on \c sFreePageQueuesLock.
+	\return The page, or \c NULL, if neither the cache nor the free queue
+		contained any pages.
+*/
+static vm_page*
+page_cpu_cache_allocate()
+{
+	if (!sPageCPUCachesEnabled)
+		return sFreePageQueues[0].RemoveHeadUnlocked();
+
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	SpinLocker locker(cache.lock);
+
+	if (cache.count == 0) {
+		VMPageQueue& freeQueue = sFreePageQueues[cache.node];
+		SpinLocker queueLocker(freeQueue.GetLock());
+
+		uint32 count = std::min((phys_addr_t)PAGE_CPU_CACHE_BATCH,
+			freeQueue.Count());
+		if (count == 0)
+			return NULL;
+
+		// Fill the cache top down, so that the most recently freed page of
+		// the batch ends up on top of the stack.
+		for (uint32 i = count; i > 0; i--) {
+			vm_page* page = freeQueue.RemoveHead();
+			page->cpu_cached = true;
+			cache.pages[i - 1] = page;
+		}
+
+		cache.count = count;
+	}
+
+	vm_page* page = cache.pages[--cache.count];
+	page->cpu_cached = false;
+	return page;
+}
+
+
+/*!	Puts the given page into the current CPU's page cache and sets its state
+	to \c PAGE_STATE_FREE, if the page belongs to the CPU's memory node. If the
+	cache is full, a batch of its oldest pages is moved to the free queue
+	first.
+	The caller must hold a read lock on \c sFreePageQueuesLock.
+	\param page The page to be freed.
+	\param node The memory node of the page.
+	\param _crossedThreshold Set to \c true, if the free queue crossed the
+		threshold at which the page scrubber should be woken up.
+	\return \c true, if the page has been cached, \c false, if it belongs to
+		a different memory node and the caller needs to free it to its
+		node's free queue.
+*/
+static bool
+page_cpu_cache_free(vm_page* page, int32 node, bool& _crossedThreshold)
+{
+	InterruptsLocker interruptsLocker;
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	if (cache.node != node)
+		return false;
+
+	SpinLocker locker(cache.lock);
+
+	_crossedThreshold = false;
+	if (cache.count == PAGE_CPU_CACHE_SIZE)
+		_crossedThreshold = page_cpu_cache_flush(cache, PAGE_CPU_CACHE_BATCH);
+
+	page->SetState(PAGE_STATE_FREE);
+	page->cpu_cached = true;
+	cache.pages[cache.count++] = page;
+
+	return true;
+}
+
+
+/*!	Removes a free or clear page from the queues. Pages of the memory node of
+	the current CPU are preferred, then the other nodes are tried in order of
+	increasing distance. Free pages of the current node are taken from the
+	CPU's page cache.
+	The caller must hold a read lock on \c sFreePageQueuesLock.
+	\param clear Whether clear pages shall be preferred over free ones.
+	\return The page, or \c NULL, if no free or clear pages are left.
+*/
+static vm_page*
+remove_free_or_clear_page(bool clear)
+{
+	int32 node = current_memory_node();
+
+	for (int32 i = 0; i < sMemoryNodeCount; i++) {
+		int32 candidate = sMemoryNodeFallbackOrder[node][i];
+
+		vm_page* page = NULL;
+		if (clear)
+			page = sClearPageQueues[candidate].RemoveHeadUnlocked();
+
+		if (page == NULL) {
+			if (candidate == node)
+				page = page_cpu_cache_allocate();
+			if (page == NULL)
+				page = sFreePageQueues[candidate].RemoveHeadUnlocked();
+		}
+
+		if (page == NULL && !clear)
+			page = sClearPageQueues[candidate].RemoveHeadUnlocked();
+
+		if (page != NULL)
+			return page;
+	}
+
+	return NULL;
+}
+
+
+/*!	Returns the pages of all CPU page caches to the free queue.
+	The caller must hold a write lock on \c sFreePageQueuesLock. Until it is
+	released, no page will be in a CPU page cache.
+*/
+static void
+page_cpu_caches_drain()
+{
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+
+		InterruptsSpinLocker locker(cache.lock);
+		if (cache.count > 0)
+			page_cpu_cache_flush(cache, cache.count);
+	}
+}
+
+
+/*!	Returns the number of pages currently held by all CPU page caches.
+	No locking is involved, so the value is only a snapshot.
+*/
+static page_num_t
+page_cpu_caches_count()
+{
+	page_num_t count = 0;
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++)
+		count += sPageCPUCaches[i].count;
+
+	return count;
+}
+
+
 static void
 free_page(vm_page* page, bool clear)
 {
@@ -1519,14 +1809,23 @@ free_page(vm_page* page, bool clear)
 
 	DEBUG_PAGE_ACCESS_END(page);
 
+	int32 node = page_memory_node(page);
+	bool crossedThreshold;
+
 	if (clear) {
 		page->SetState(PAGE_STATE_CLEAR);
-		sClearPageQueue.PrependUnlocked(page);
+		sClearPageQueues[node].PrependUnlocked(page);
+	} else if (sPageCPUCachesEnabled
+		&& page_cpu_cache_free(page, node, crossedThreshold)) {
+		// Notify condition only when we cross the threshold
+		notifyFreePageCondition = crossedThreshold
+			&& atomic_get(&sUnreservedFreePages) >= (int32)sFreePagesTarget;
 	} else {
 		page->SetState(PAGE_STATE_FREE);
-		InterruptsSpinLocker queueLocker(sFreePageQueue.GetLock());
-		sFreePageQueue.Prepend(page);
-		if(sFreePageQueue.Count() == SCRUB_SIZE &&
+		VMPageQueue& freeQueue = sFreePageQueues[node];
+		InterruptsSpinLocker queueLocker(freeQueue.GetLock());
+		freeQueue.Prepend(page);
+		if(freeQueue.Count() == SCRUB_SIZE &&
 			atomic_get(&sUnreservedFreePages) >= (int32)sFreePagesTarget)
 		{
 			// Notify condition only when we cross the threshold
@@ -1702,6 +2001,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 	}
 
 	WriteLocker locker(sFreePageQueuesLock);
+	page_cpu_caches_drain();
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1713,8 +2013,9 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 // the free/clear queues without having reserved them before. This should happen
 // in the early boot process only, though.
 				DEBUG_PAGE_ACCESS_START(page);
+				int32 node = page_memory_node(page);
 				VMPageQueue& queue = page->State() == PAGE_STATE_FREE
-					? sFreePageQueue : sClearPageQueue;
+					? sFreePageQueues[node] : sClearPageQueues[node];
 				queue.Remove(page);
 				page->SetState(wired ? PAGE_STATE_WIRED : PAGE_STATE_UNUSED);
 				page->busy = false;
@@ -1755,10 +2056,19 @@ page_scrubber(void *unused)
 	TRACE(("page_scrubber starting...\n"));
 
 	for (;;) {
+		// scrub the memory node with the most free pages
+		int32 node = 0;
+		for (int32 i = 1; i < sMemoryNodeCount; i++) {
+			if (sFreePageQueues[i].Count() > sFreePageQueues[node].Count())
+				node = i;
+		}
+
+		VMPageQueue& freeQueue = sFreePageQueues[node];
+
 		{
-			InterruptsSpinLocker lockerForFreeQueue(sFreePageQueue.GetLock());
+			InterruptsSpinLocker lockerForFreeQueue(freeQueue.GetLock());
 
-			if (sFreePageQueue.Count() < SCRUB_SIZE
+			if (freeQueue.Count() < SCRUB_SIZE
 					|| atomic_get(&sUnreservedFreePages) < (int32)sFreePagesTarget)
 			{
 				ConditionVariableEntry entry;
@@ -1789,7 +2099,7 @@ page_scrubber(void *unused)
 		vm_page *page[SCRUB_SIZE];
 		int32 scrubCount = 0;
 		for (int32 i = 0; i < reserved; i++) {
-			page[i] = sFreePageQueue.RemoveHeadUnlocked();
+			page[i] = freeQueue.RemoveHeadUnlocked();
 			if (page[i] == NULL)
 				break;
 
@@ -1822,7 +2132,7 @@ page_scrubber(void *unused)
 			page[i]->SetState(PAGE_STATE_CLEAR);
 			page[i]->busy = false;
 			DEBUG_PAGE_ACCESS_END(page[i]);
-			sClearPageQueue.PrependUnlocked(page[i]);
+			sClearPageQueues[node].PrependUnlocked(page[i]);
 		}
 
 		locker.Unlock();
@@ -2604,7 +2914,7 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 			ReadLocker locker(sFreePageQueuesLock);
 			page->SetState(PAGE_STATE_FREE);
 			DEBUG_PAGE_ACCESS_END(page);
-			sFreePageQueue.PrependUnlocked(page);
+			sFreePageQueues[page_memory_node(page)].PrependUnlocked(page);
 			locker.Unlock();
 
 			TA(StolenPage());
@@ -3282,6 +3592,56 @@ vm_page_init_num_pages(kernel_args *args)
 }
 
 
+/*!	Sets up the memory node ranges and the node fallback order from the
+	locality information the boot loader passed in.
+*/
+static void
+init_memory_nodes(kernel_args* args)
+{
+	sMemoryNodeCount = 1;
+	sMemoryNodeRangeCount = 0;
+
+	if (args->num_memory_nodes > 1) {
+		sMemoryNodeCount = std::min(args->num_memory_nodes,
+			(uint32)MAX_MEMORY_NODES);
+
+		for (uint32 i = 0; i < args->num_memory_node_ranges; i++) {
+			const memory_node_range& range = args->memory_node_range[i];
+			if ((int32)range.node >= sMemoryNodeCount)
+				continue;
+
+			memory_node_page_range& pageRange
+				= sMemoryNodeRanges[sMemoryNodeRangeCount++];
+			pageRange.start = range.range.start / B_PAGE_SIZE;
+			pageRange.end = (range.range.start + range.range.size)
+				/ B_PAGE_SIZE;
+			pageRange.node = range.node;
+		}
+
+		dprintf("vm_page: %" B_PRId32 " memory nodes\n", sMemoryNodeCount);
+	}
+
+	// Sort the nodes by distance for each node. Simple insertion sort, there
+	// aren't many of them.
+	for (int32 node = 0; node < sMemoryNodeCount; node++) {
+		int32* order = sMemoryNodeFallbackOrder[node];
+		for (int32 i = 0; i < sMemoryNodeCount; i++) {
+			int32 j = i;
+			for (; j > 0; j--) {
+				int32 distance = i == node
+					? 0 : args->memory_node_distance[node][i];
+				int32 otherDistance = order[j - 1] == node
+					? 0 : args->memory_node_distance[node][order[j - 1]];
+				if (otherDistance <= distance)
+					break;
+				order[j] = order[j - 1];
+			}
+			order[j] = i;
+		}
+	}
+}
+
+
 status_t
 vm_page_init(kernel_args *args)
 {
@@ -3292,8 +3652,12 @@ vm_page_init(kernel_args *args)
 	sInactivePageQueue.Init("inactive pages queue");
 	sActivePageQueue.Init("active pages queue");
 	sCachedPageQueue.Init("cached pages queue");
-	sFreePageQueue.Init("free pages queue");
-	sClearPageQueue.Init("clear pages queue");
+	for (int32 i = 0; i < MAX_MEMORY_NODES; i++) {
+		sFreePageQueues[i].Init("free pages queue");
+		sClearPageQueues[i].Init("clear pages queue");
+	}
+
+	init_memory_nodes(args);
 
 	new (&sPageReservationWaiters) PageReservationWaiterList;
 
@@ -3308,7 +3672,7 @@ vm_page_init(kernel_args *args)
 	// initialize the free page table
 	for (uint32 i = 0; i < sNumPages; i++) {
 		sPages[i].Init(sPhysicalPageOffset + i);
-		sFreePageQueue.Append(&sPages[i]);
+		sFreePageQueues[page_memory_node(&sPages[i])].Append(&sPages[i]);
 
 #if VM_PAGE_ALLOCATION_TRACKING_AVAILABLE
 		sPages[i].allocation_tracking_info.Clear();
@@ -3317,6 +3681,12 @@ vm_page_init(kernel_args *args)
 
 	sUnreservedFreePages = sNumPages;
 
+	for (int32 i = 0; i < SMP_MAX_CPUS; i++) {
+		B_INITIALIZE_SPINLOCK(&sPageCPUCaches[i].lock);
+		sPageCPUCaches[i].node = 0;
+		sPageCPUCaches[i].count = 0;
+	}
+
 	TRACE(("initialized table\n"));
 
 	// mark the ranges between usable physical memory unused
@@ -3432,10 +3802,17 @@ status_t
 vm_page_init_post_thread(kernel_args *args)
 {
 	new (&sPageScrubberCond) ConditionVariable();
-	sPageScrubberCond.Init(&sFreePageQueue, "page_scrubber");
+	sPageScrubberCond.Init(&sFreePageQueues[0], "page_scrubber");
 
 	new (&sFreePageCondition) ConditionVariable();
-	sFreePageCondition.Publish(&sFreePageQueue, "free page");
+	sFreePageCondition.Publish(&sFreePageQueues[0], "free page");
+
+	// From now on the current CPU can be determined reliably.
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		if (gCPU[i].memory_node < sMemoryNodeCount)
+			sPageCPUCaches[i].node = gCPU[i].memory_node;
+	}
+	sPageCPUCachesEnabled = true;
 
 	// create a kernel thread to clear out pages
 
@@ -3547,44 +3924,28 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
-
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
 
 	ReadLocker locker(sFreePageQueuesLock);
 
-	vm_page* page = queue->RemoveHeadUnlocked();
+	vm_page* page = remove_free_or_clear_page(clear);
 	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		// Unlikely, but possible: the page we have reserved has moved
+		// between the queues after we checked them, or it sits in another
+		// CPU's page cache. Grab the write locker and drain the CPU page
+		// caches to make sure this doesn't happen again.
+		locker.Unlock();
+		WriteLocker writeLocker(sFreePageQueuesLock);
+		page_cpu_caches_drain();
 
+		page = remove_free_or_clear_page(clear);
 		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
-
-			page = queue->RemoveHead();
-			if (page == NULL)
-				otherQueue->RemoveHead();
-
-			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
-			}
-
-			// downgrade to read lock
-			locker.Lock();
+			panic("Had reserved page, but there is none!");
+			return NULL;
 		}
+
+		// downgrade to read lock
+		locker.Lock();
 	}
 
 	if (page->CacheRef() != NULL)
@@ -3628,14 +3989,14 @@ allocate_page_run_cleanup(VMPageQueue::PageList& freePages,
 		page->busy = false;
 		page->SetState(PAGE_STATE_FREE);
 		DEBUG_PAGE_ACCESS_END(page);
-		sFreePageQueue.PrependUnlocked(page);
+		sFreePageQueues[page_memory_node(page)].PrependUnlocked(page);
 	}
 
 	while (vm_page* page = clearPages.RemoveHead()) {
 		page->busy = false;
 		page->SetState(PAGE_STATE_CLEAR);
 		DEBUG_PAGE_ACCESS_END(page);
-		sClearPageQueue.PrependUnlocked(page);
+		sClearPageQueues[page_memory_node(page)].PrependUnlocked(page);
 	}
 }
 
@@ -3682,12 +4043,14 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 		switch (page.State()) {
 			case PAGE_STATE_CLEAR:
 				DEBUG_PAGE_ACCESS_START(&page);
-				sClearPageQueue.Remove(&page);
+				sClearPageQueues[page_memory_node(&page)].Remove(&page);
 				clearPages.Add(&page);
 				break;
 			case PAGE_STATE_FREE:
+				// the caller has drained the CPU page caches
+				PAGE_ASSERT(&page, !page.cpu_cached);
 				DEBUG_PAGE_ACCESS_START(&page);
-				sFreePageQueue.Remove(&page);
+				sFreePageQueues[page_memory_node(&page)].Remove(&page);
 				freePages.Add(&page);
 				break;
 			case PAGE_STATE_CACHED:
@@ -3868,6 +4231,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 	vm_page_reserve_pages(&reservation, length, priority);
 
 	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
+	page_cpu_caches_drain();
 
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
@@ -3933,6 +4297,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 			// apparently a cached page couldn't be allocated -- skip it and
 			// continue
 			freeClearQueueLocker.Lock();
+			page_cpu_caches_drain();
 		}
 
 		start += i + 1;
@@ -3940,6 +4305,166 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 }
 
 
+/*!	Returns whether all pages of the given run are free or clear.
+	Without a write lock on \c sFreePageQueuesLock the result is only a hint.
+*/
+static bool
+is_free_page_run(page_num_t start, page_num_t length)
+{
+	for (page_num_t i = 0; i < length; i++) {
+		uint32 pageState = sPages[start + i].State();
+		if (pageState != PAGE_STATE_FREE && pageState != PAGE_STATE_CLEAR)
+			return false;
+	}
+
+	return true;
+}
+
+
+/*!	Moves those pages of the given run that are in a CPU page cache to the
+	free queue, so that allocate_page_run() can take them. All other cached
+	pages stay where they are.
+	The caller must hold a write lock on \c sFreePageQueuesLock.
+*/
+static void
+page_cpu_caches_release_run(page_num_t start, page_num_t length)
+{
+	bool cached = false;
+	for (page_num_t i = 0; i < length; i++) {
+		if (sPages[start + i].cpu_cached) {
+			cached = true;
+			break;
+		}
+	}
+
+	if (!cached)
+		return;
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+
+		InterruptsSpinLocker locker(cache.lock);
+		VMPageQueue& freeQueue = sFreePageQueues[cache.node];
+
+		uint32 kept = 0;
+		for (uint32 j = 0; j < cache.count; j++) {
+			vm_page* page = cache.pages[j];
+			page_num_t index = page - sPages;
+			if (index < start || index >= start + length) {
+				cache.pages[kept++] = page;
+				continue;
+			}
+
+			page->cpu_cached = false;
+			freeQueue.PrependUnlocked(page);
+		}
+
+		cache.count = kept;
+	}
+}
+
+
+/*!	Allocates a physically contiguous run of pages that is aligned to its own
+	size, as needed for backing a large page mapping.
+
+	Unlike vm_page_allocate_page_run() the function neither waits for pages
+	to become available nor does it steal cached pages. It is meant to be
+	used opportunistically by callers that can fall back to normal pages, so
+	it gives up quickly: only a few aligned runs are looked at, without any
+	locking, continuing where the previous call stopped. The free/clear page
+	queues are only locked when a run looked free, and the CPU page caches
+	are not drained; only the pages of the run are taken out of them.
+	Runs on the memory node of the current CPU are preferred.
+
+	\param flags Page allocation flags. Encodes the state the function shall
+		set the allocated pages to, whether the pages shall be marked busy
+		(VM_PAGE_ALLOC_BUSY), and whether the pages shall be cleared
+		(VM_PAGE_ALLOC_CLEAR).
+	\param length The number of pages to allocate. Must be a power of two.
+	\param priority The page reservation priority (as passed to
+		vm_page_reserve_pages()).
+	\return The first page of the allocated page run on success; \c NULL
+		when no suitable run was available.
+*/
+vm_page*
+vm_page_allocate_large_page(uint32 flags, page_num_t length, int priority)
+{
+	ASSERT(length > 0 && (length & (length - 1)) == 0);
+
+	// the first aligned run completely within our page range
+	page_num_t firstStart = ROUNDUP(sPhysicalPageOffset, length)
+		- sPhysicalPageOffset;
+	if (firstStart + length > sNumPages)
+		return NULL;
+
+	page_num_t runCount = (sNumPages - firstStart) / length;
+
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, length, priority))
+		return NULL;
+
+	// look for a run that seems to be free
+	int32 node = current_memory_node();
+	page_num_t run = sLargePageSearchRun % runCount;
+	page_num_t localRun = runCount;
+	page_num_t remoteRun = runCount;
+	page_num_t candidates = std::min(runCount, kMaxLargePageCandidates);
+
+	for (page_num_t i = 0; i < candidates; i++) {
+		page_num_t start = firstStart + run * length;
+		if (is_free_page_run(start, length)) {
+			if (sMemoryNodeCount == 1
+				|| page_memory_node(&sPages[start]) == node) {
+				localRun = run;
+				break;
+			}
+			if (remoteRun == runCount)
+				remoteRun = run;
+		}
+
+		if (++run == runCount)
+			run = 0;
+	}
+
+	sLargePageSearchRun = run;
+
+	if (localRun != runCount)
+		run = localRun;
+	else if (remoteRun != runCount)
+		run = remoteRun;
+	else {
+		vm_page_unreserve_pages(&reservation);
+		return NULL;
+	}
+
+	page_num_t start = firstStart + run * length;
+
+	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
+
+	// with the write lock held, no page can become or stop being free
+	if (!is_free_page_run(start, length)) {
+		freeClearQueueLocker.Unlock();
+		vm_page_unreserve_pages(&reservation);
+		return NULL;
+	}
+
+	page_cpu_caches_release_run(start, length);
+
+	page_num_t allocated = allocate_page_run(start, length, flags,
+		freeClearQueueLocker);
+	if (allocated == length)
+		return &sPages[start];
+
+	// Can't really happen, since we held the write lock and the run contained
+	// free and clear pages only.
+	panic("vm_page_allocate_large_page(): failed to allocate run at "
+		"%" B_PRIuPHYSADDR, start + sPhysicalPageOffset);
+	vm_page_unreserve_pages(&reservation);
+	return NULL;
+}
+
+
 vm_page *
 vm_page_at_index(int32 index)
 {
@@ -4128,8 +4653,10 @@ vm_page_get_stats(system_info *info)
 	//	active + inactive + unused + wired + modified + cached + free + clear
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
-	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+	uint32 subtractPages = info->cached_pages + page_cpu_caches_count();
+	for (int32 i = 0; i < sMemoryNodeCount; i++)
+		subtractPages += sFreePageQueues[i].Count()
+			+ sClearPageQueues[i].Count();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -20,6 +20,7 @@
 
 #include <AutoDeleter.h>
 
+#include <event_queue.h>
 #include <fs/fd.h>
 #include <port.h>
 #include <sem.h>
@@ -398,6 +399,7 @@ create_select_sync(int numFDs, select_sync*& _sync)
 
 	sync->count = numFDs;
 	sync->ref_count = 1;
+	sync->queue = NULL;
 
 	for (int i = 0; i < numFDs; i++) {
 		sync->set[i].next = NULL;
@@ -418,6 +420,11 @@ put_select_sync(select_sync* sync)
 	FUNCTION(("put_select_sync(%p): -> %ld\n", sync, sync->ref_count - 1));
 
 	if (atomic_add(&sync->ref_count, -1) == 1) {
+		if (sync->queue != NULL) {
+			event_queue_free_sync(sync);
+			return;
+		}
+
 		delete_sem(sync->sem);
 		delete[] sync->set;
 		delete sync;
@@ -696,9 +703,15 @@ notify_select_events(select_info* info, uint16 events)
 	FUNCTION(("notify_select_events(%p (%p), 0x%x)\n", info, info->sync,
 		events));
 
-	if (info == NULL
-		|| info->sync == NULL
-		|| info->sync->sem < B_OK)
+	if (info == NULL || info->sync == NULL)
+		return B_BAD_VALUE;
+
+	if (info->sync->queue != NULL) {
+		// the event queue takes care of everything
+		return event_queue_notify(info, events);
+	}
+
+	if (info->sync->sem < B_OK)
 		return B_BAD_VALUE;
 
 	atomic_or(&info->events, events);
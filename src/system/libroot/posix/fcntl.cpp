@@ -75,3 +75,11 @@ fcntl(int fd, int op, ...)
 
 	RETURN_AND_SET_ERRNO(error);
 }
+
+
+int
+posix_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+	// the error is returned, errno is not touched
+	return _kern_file_advice(fd, offset, length, advice);
+}
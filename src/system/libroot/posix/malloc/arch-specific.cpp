@@ -19,6 +19,7 @@
 
 #include "arch-specific.h"
 #include "heap.h"
+#include "threadcache.h"
 
 #include <OS.h>
 #include <Debug.h>
@@ -27,6 +28,7 @@
 #include <libroot_private.h>
 
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 //#define TRACE_CHUNKS
@@ -51,6 +53,9 @@ static const size_t kInitialHeapSize = 64 * B_PAGE_SIZE;
 static const size_t kHeapIncrement = 16 * B_PAGE_SIZE;
 	// the steps in which to increase the heap size (must be a power of 2)
 
+static const size_t kMinDecommitSize = 16 * B_PAGE_SIZE;
+	// free chunks at least this large don't keep their memory committed
+
 #if B_HAIKU_64_BIT
 static const addr_t kHeapReservationBase = 0x1000000000;
 static const addr_t kHeapReservationSize = 0x1000000000;
@@ -86,6 +91,9 @@ extern "C" status_t
 __init_heap(void)
 {
 	hoardHeap::initNumProcs();
+#if USE_THREAD_CACHE
+	threadCache::init();
+#endif
 
 	// This will locate the heap base at 384 MB and reserve the next 1152 MB
 	// for it. They may get reclaimed by other areas, though, but the maximum
@@ -293,6 +301,12 @@ hoardUnsbrk(void *ptr, long size)
 {
 	CTRACE(("unsbrk: %p, %ld!\n", ptr, size));
 
+	// Give the pages of larger chunks back to the system; this has to be done
+	// before the chunk is put into the free list, as it might be reused
+	// right away.
+	if ((size_t)size >= kMinDecommitSize)
+		hoardDecommit((free_chunk *)ptr + 1, size - sizeof(free_chunk));
+
 	hoardLock(sHeapLock);
 
 	// TODO: hoard always allocates and frees in typical sizes, so we could
@@ -349,6 +363,23 @@ hoardUnsbrk(void *ptr, long size)
 }
 
 
+/*!	Tells the system that the contents of all pages that lie completely
+	within the given range are no longer needed. The memory stays mapped, and
+	reads as zeroes when it is accessed again.
+*/
+void
+hoardDecommit(void *ptr, size_t size)
+{
+	addr_t start = ((addr_t)ptr + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1);
+	addr_t end = ((addr_t)ptr + size) & ~(B_PAGE_SIZE - 1);
+	if (start >= end)
+		return;
+
+	CTRACE(("decommit: %p, %ld\n", (void *)start, end - start));
+	_kern_memory_advice((void *)start, end - start, MADV_FREE);
+}
+
+
 void
 hoardLockInit(hoardLockType &lock, const char *name)
 {
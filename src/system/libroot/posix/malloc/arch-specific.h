@@ -46,6 +46,7 @@ void hoardUnlock(hoardLockType &lock);
 
 void *hoardSbrk(long size);
 void hoardUnsbrk(void *ptr, long size);
+void hoardDecommit(void *ptr, size_t size);
 
 ///// Other.
 
@@ -29,6 +29,10 @@
 
 #define HEAP_LOG 0		// If non-zero, keep a log of heap accesses.
 
+#ifndef USE_THREAD_CACHE
+#	define USE_THREAD_CACHE 1	// Keep small blocks in per-thread caches.
+#endif
+
 
 ///// You should not change anything below here. /////
 
@@ -62,6 +66,12 @@ enum { SUPERBLOCK_FULLNESS_GROUP = 9 };
 #define HEAP_LEAK_CHECK 0
 #define HEAP_CALL_STACK_SIZE 8
 
+// The leak checker links the allocated blocks itself.
+#if HEAP_LEAK_CHECK
+#	undef USE_THREAD_CACHE
+#	define USE_THREAD_CACHE 0
+#endif
+
 // A simple wall checker
 #define HEAP_WALL 0
 #define HEAP_WALL_SIZE 32
@@ -28,12 +28,17 @@ using namespace BPrivate;
 // NB: Use maketable.cpp to update this
 //     if SIZE_CLASSES, ALIGNMENT, SIZE_CLASS_BASE, MAX_EMPTY_SUPERBLOCKS,
 //     or SUPERBLOCK_SIZE changes.
+//
+// For MAX_INTERNAL_FRAGMENTATION == 2, the classes up to 256 bytes do not
+// follow SIZE_CLASS_BASE, but use exact 16 byte steps (8 byte steps below
+// 64 bytes) instead; those are the sizes the thread caches hand out.
 
 #if (MAX_INTERNAL_FRAGMENTATION == 2)
 
 size_t hoardHeap::_sizeTable[hoardHeap::SIZE_CLASSES] = {
-	8UL, 16UL, 24UL, 32UL, 40UL, 48UL, 56UL, 72UL, 80UL, 96UL, 120UL, 144UL,
-	168UL, 200UL, 240UL, 288UL, 344UL, 416UL, 496UL, 592UL, 712UL, 856UL,
+	8UL, 16UL, 24UL, 32UL, 40UL, 48UL, 56UL, 64UL, 80UL, 96UL, 112UL, 128UL,
+	144UL, 160UL, 176UL, 192UL, 208UL, 224UL, 240UL, 256UL, 288UL, 344UL,
+	416UL, 496UL, 592UL, 712UL, 856UL,
 	1024UL, 1232UL, 1472UL, 1768UL, 2120UL, 2544UL, 3048UL, 3664UL,
 	4392UL, 5272UL, 6320UL, 7584UL, 9104UL, 10928UL, 13112UL, 15728UL,
 	18872UL, 22648UL, 27176UL, 32616UL, 39136UL, 46960UL, 56352UL,
@@ -50,8 +55,9 @@ size_t hoardHeap::_sizeTable[hoardHeap::SIZE_CLASSES] = {
 };
 
 size_t hoardHeap::_threshold[hoardHeap::SIZE_CLASSES] = {
-	4096UL, 2048UL, 1364UL, 1024UL, 816UL, 680UL, 584UL, 452UL, 408UL,
-	340UL, 272UL, 224UL, 192UL, 160UL, 136UL, 112UL, 92UL, 76UL, 64UL,
+	4096UL, 2048UL, 1364UL, 1024UL, 816UL, 680UL, 584UL, 512UL, 408UL,
+	340UL, 292UL, 256UL, 224UL, 204UL, 184UL, 168UL, 156UL, 144UL, 136UL,
+	128UL, 112UL, 92UL, 76UL, 64UL,
 	52UL, 44UL, 36UL, 32UL, 24UL, 20UL, 16UL, 12UL, 12UL, 8UL, 8UL, 4UL,
 	4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL,
 	4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL, 4UL,
@@ -127,7 +133,8 @@ lg(int num)
 
 hoardHeap::hoardHeap(void)
 	:
-	_index(0), _reusableSuperblocks(NULL), _reusableSuperblocksCount(0)
+	_index(0), _reusableSuperblocks(NULL), _reusableSuperblocksCount(0),
+	_decommittedSuperblocks(NULL)
 #if HEAP_DEBUG
 	, _magic(HEAP_MAGIC)
 #endif
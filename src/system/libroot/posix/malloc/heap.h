@@ -189,6 +189,10 @@ class hoardHeap {
 		superblock *_reusableSuperblocks;
 		int _reusableSuperblocksCount;
 
+		// Empty superblocks beyond MAX_EMPTY_SUPERBLOCKS, whose memory has
+		// been given back to the system.
+		superblock *_decommittedSuperblocks;
+
 		// Lists of superblocks.
 		superblock *_superblocks[SUPERBLOCK_FULLNESS_GROUP][SIZE_CLASSES];
 
@@ -488,6 +492,17 @@ hoardHeap::recycle(superblock *sb)
 	assert(sb->getNext() == NULL);
 	assert(sb->getPrev() == NULL);
 	assert(hoardHeap::numBlocks(sb->getBlockSizeClass()) > 1);
+
+	if (_reusableSuperblocksCount >= MAX_EMPTY_SUPERBLOCKS) {
+		// We already keep enough empty superblocks around; release the
+		// memory of this one, but keep its header, so that it can still
+		// be reused later on.
+		hoardDecommit(sb + 1, SUPERBLOCK_SIZE - sizeof(superblock));
+		sb->insertBefore(_decommittedSuperblocks);
+		_decommittedSuperblocks = sb;
+		return;
+	}
+
 	sb->insertBefore(_reusableSuperblocks);
 	_reusableSuperblocks = sb;
 	++_reusableSuperblocksCount;
@@ -498,7 +513,7 @@ hoardHeap::recycle(superblock *sb)
 superblock *
 hoardHeap::reuse(int sizeclass)
 {
-	if (_reusableSuperblocks == NULL)
+	if (_reusableSuperblocks == NULL && _decommittedSuperblocks == NULL)
 		return NULL;
 
 	// Make sure that we aren't using a sizeclass
@@ -506,16 +521,26 @@ hoardHeap::reuse(int sizeclass)
 	if (hoardHeap::numBlocks(sizeclass) <= 1)
 		return NULL;
 
-	// Pop off a superblock from the reusable-superblock list.
-	assert(_reusableSuperblocksCount > 0);
-	superblock *sb = _reusableSuperblocks;
-	_reusableSuperblocks = sb->getNext();
-	sb->remove();
+	superblock *sb;
+	bool decommitted = false;
+	if (_reusableSuperblocks != NULL) {
+		// Pop off a superblock from the reusable-superblock list.
+		assert(_reusableSuperblocksCount > 0);
+		sb = _reusableSuperblocks;
+		_reusableSuperblocks = sb->getNext();
+		sb->remove();
+		--_reusableSuperblocksCount;
+	} else {
+		// Take a decommitted one instead; its blocks are gone.
+		sb = _decommittedSuperblocks;
+		_decommittedSuperblocks = sb->getNext();
+		sb->remove();
+		decommitted = true;
+	}
 	assert(sb->getNumBlocks() > 1);
-	--_reusableSuperblocksCount;
 
 	// Reformat the superblock if necessary.
-	if (sb->getBlockSizeClass() != sizeclass) {
+	if (decommitted || sb->getBlockSizeClass() != sizeclass) {
 		decStats(sb->getBlockSizeClass(),
 			sb->getNumBlocks() - sb->getNumAvailable(),
 			sb->getNumBlocks());
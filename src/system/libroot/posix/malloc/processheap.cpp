@@ -153,6 +153,29 @@ processHeap::setDeallocated(int requestedSize, int actualSize)
 #endif	// HEAP_FRAG_STATS
 
 
+// lockOwner (sb):
+//   returns: the heap that owns the superblock, locked.
+//   This eventually pins the superblock down in one heap,
+//   so the loop is guaranteed to terminate.
+//   (It should generally take no more than two iterations.)
+
+static inline hoardHeap *
+lockOwner(superblock *sb)
+{
+	while (1) {
+		hoardHeap *owner = sb->getOwner();
+		owner->lock();
+		if (owner == sb->getOwner())
+			return owner;
+
+		owner->unlock();
+
+		// Suspend to allow ownership to quiesce.
+		hoardYield();
+	}
+}
+
+
 // free (ptr, pheap):
 //   inputs: a pointer to an object allocated by malloc().
 //   side effects: returns the block to the object's superblock;
@@ -193,25 +216,10 @@ processHeap::free(void *ptr)
 	// and update its statistics.
 	//
 
-	hoardHeap *owner;
-
 	// By acquiring the up lock on the superblock,
 	// we prevent it from moving to the global heap.
-	// This eventually pins it down in one heap,
-	// so this loop is guaranteed to terminate.
-	// (It should generally take no more than two iterations.)
 	sb->upLock();
-	while (1) {
-		owner = sb->getOwner();
-		owner->lock();
-		if (owner == sb->getOwner()) {
-			break;
-		} else {
-			owner->unlock();
-		}
-		// Suspend to allow ownership to quiesce.
-		hoardYield();
-	}
+	hoardHeap *owner = lockOwner(sb);
 
 #if HEAP_LOG
 	MemoryRequest m;
@@ -228,3 +236,60 @@ processHeap::free(void *ptr)
 	if (!sbUnmapped)
 		sb->upUnlock();
 }
+
+
+// freeBlocks (list):
+//   inputs: a list of allocated blocks, linked via their next pointers
+//           (as returned by threadHeap::mallocBlocks()).
+//   side effects: like free() for each block, but blocks of the same
+//                 superblock that follow each other in the list are
+//                 returned while holding the locks only once.
+
+void
+processHeap::freeBlocks(block *list)
+{
+	block *b = list;
+	while (b != NULL) {
+		superblock *sb = b->getSuperblock();
+		assert(sb);
+		assert(sb->isValid());
+
+		const int sizeclass = sb->getBlockSizeClass();
+
+		// Pin down the superblock and lock its owner, see free().
+		sb->upLock();
+		hoardHeap *owner = lockOwner(sb);
+
+		int sbUnmapped = 0;
+		while (b != NULL && b->getSuperblock() == sb) {
+			block *next = b->getNext();
+			b->markFree();
+
+#if HEAP_LOG
+			MemoryRequest m;
+			m.free((void *)(b + 1));
+			getLog(owner->getIndex()).append(m);
+#endif
+#if HEAP_FRAG_STATS
+			setDeallocated(b->getRequestedSize(), 0);
+#endif
+
+			sbUnmapped = owner->freeBlock(b, sb, sizeclass, this);
+			b = next;
+
+			if (sbUnmapped)
+				break;
+
+			// freeBlock() might have released the superblock to the
+			// process heap.
+			if (owner != sb->getOwner()) {
+				owner->unlock();
+				owner = lockOwner(sb);
+			}
+		}
+
+		owner->unlock();
+		if (!sbUnmapped)
+			sb->upUnlock();
+	}
+}
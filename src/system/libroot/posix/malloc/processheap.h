@@ -60,6 +60,7 @@ class processHeap : public hoardHeap {
 		}
 		// Memory deallocation routines.
 		void free(void *ptr);
+		void freeBlocks(block *list);
 
 		// Print out statistics information.
 		void stats(void);
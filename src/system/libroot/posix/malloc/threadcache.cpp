@@ -0,0 +1,100 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "threadcache.h"
+
+#include "processheap.h"
+#include "threadheap.h"
+
+
+using namespace BPrivate;
+
+
+int threadCache::_cachedClasses = 0;
+int8 threadCache::_sizeClasses[threadCache::SIZE_INDEX_COUNT];
+
+
+threadCache::threadCache(processHeap *pHeap)
+	:
+	_pHeap(pHeap)
+{
+	for (int i = 0; i < _cachedClasses; i++) {
+		_bins[i].list = NULL;
+		_bins[i].count = 0;
+
+		// Keep about a page worth of blocks, but at least two batches.
+		_bins[i].maxCount = max_c(2 * BATCH_SIZE,
+			(int)(B_PAGE_SIZE / hoardHeap::sizeFromClass(i)));
+	}
+}
+
+
+/*static*/ void
+threadCache::init(void)
+{
+	for (int i = 0; i < SIZE_INDEX_COUNT; i++)
+		_sizeClasses[i] = hoardHeap::sizeClass(i * SIZE_STEP);
+
+	_cachedClasses = hoardHeap::sizeClass(MAX_CACHED_SIZE) + 1;
+	assert(_cachedClasses <= MAX_CACHED_CLASSES);
+}
+
+
+void
+threadCache::flush(void)
+{
+	for (int i = 0; i < _cachedClasses; i++) {
+		if (_bins[i].count > 0)
+			release(_bins[i], _bins[i].count);
+	}
+}
+
+
+/*!	Gets a batch of blocks from the thread's heap, and returns the first
+	one of them.
+*/
+void *
+threadCache::refill(int sizeclass)
+{
+	bin &b = _bins[sizeclass];
+
+	threadHeap &heap = _pHeap->getHeap(_pHeap->getHeapIndex());
+	b.count = heap.mallocBlocks(sizeclass, b.list, BATCH_SIZE);
+	if (b.count == 0)
+		return NULL;
+
+	block *first = b.list;
+	b.list = first->getNext();
+	b.count--;
+
+#if HEAP_DEBUG
+	for (block *cached = b.list; cached != NULL; cached = cached->getNext())
+		cached->markFree();
+#endif
+
+	return (void *)(first + 1);
+}
+
+
+/*!	Returns the given number of blocks from the bin to their heaps. */
+void
+threadCache::release(bin &b, int count)
+{
+	// processHeap::freeBlocks() expects allocated blocks
+	block *list = b.list;
+	block *last = list;
+	last->markAllocated();
+	for (int i = 1; i < count; i++) {
+		last = last->getNext();
+		last->markAllocated();
+	}
+
+	b.list = last->getNext();
+	b.count -= count;
+
+	last->setNext(NULL);
+	_pHeap->freeBlocks(list);
+}
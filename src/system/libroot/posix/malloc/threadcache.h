@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _THREADCACHE_H_
+#define _THREADCACHE_H_
+
+
+#include "config.h"
+
+#include "heap.h"
+
+
+namespace BPrivate {
+
+class processHeap;
+
+//
+// A threadCache keeps recently freed small blocks of a single thread, so that
+// they can be handed out again without taking any locks. Blocks are taken
+// from and returned to the heaps in batches.
+//
+
+class threadCache {
+	public:
+		// Only blocks up to this size are cached.
+		enum { MAX_CACHED_SIZE = 256 };
+
+		// The number of blocks moved between the cache and the heaps at once.
+		enum { BATCH_SIZE = 16 };
+
+		threadCache(processHeap *pHeap);
+
+		// Set up the size lookup table; must be called before any cache
+		// is used.
+		static void init(void);
+
+		// Allocate a block of the given size. Returns NULL if the size
+		// isn't cached, or if we're out of memory.
+		inline void *malloc(size_t size);
+
+		// Put the block into the cache. Returns false if the block can't
+		// be cached, and has to be freed normally.
+		inline bool free(void *ptr);
+
+		// Return all cached blocks to their heaps.
+		void flush(void);
+
+	private:
+		// The granularity of the size lookup table; this is the size of
+		// the smallest size class.
+		enum { SIZE_STEP = 8 };
+		enum { SIZE_INDEX_COUNT = MAX_CACHED_SIZE / SIZE_STEP + 1 };
+		enum { MAX_CACHED_CLASSES = SIZE_INDEX_COUNT };
+
+		struct bin {
+			block	*list;
+			int		count;
+			int		maxCount;
+		};
+
+		void *refill(int sizeclass);
+		void release(bin &b, int count);
+
+		processHeap *_pHeap;
+		bin _bins[MAX_CACHED_CLASSES];
+
+		// The number of size classes that are cached.
+		static int _cachedClasses;
+
+		// Maps (size + SIZE_STEP - 1) / SIZE_STEP to the size class, so
+		// that the linear search of hoardHeap::sizeClass() is avoided for
+		// small sizes.
+		static int8 _sizeClasses[SIZE_INDEX_COUNT];
+};
+
+
+void *
+threadCache::malloc(size_t size)
+{
+	if (size > MAX_CACHED_SIZE)
+		return NULL;
+
+	const int sizeclass = _sizeClasses[(size + SIZE_STEP - 1) / SIZE_STEP];
+	bin &b = _bins[sizeclass];
+	if (b.count == 0)
+		return refill(sizeclass);
+
+	block *first = b.list;
+	b.list = first->getNext();
+	b.count--;
+
+	first->markAllocated();
+	return (void *)(first + 1);
+}
+
+
+bool
+threadCache::free(void *ptr)
+{
+	block *first = (block *)ptr - 1;
+
+	// Blocks from memalign() point to their real block header; we leave
+	// those to the heap.
+	if (((unsigned long)first->getNext() & 1) != 0)
+		return false;
+
+	assert(first->isValid());
+
+	const int sizeclass = first->getSuperblock()->getBlockSizeClass();
+	if (sizeclass >= _cachedClasses)
+		return false;
+
+	// Cached blocks are marked free, so that freeing a block twice is
+	// caught here (with HEAP_DEBUG) instead of corrupting the bin.
+	first->markFree();
+
+	bin &b = _bins[sizeclass];
+	first->setNext(b.list);
+	b.list = first;
+
+	if (++b.count > b.maxCount)
+		release(b, BATCH_SIZE);
+
+	return true;
+}
+
+}	// namespace BPrivate
+
+#endif	// _THREADCACHE_H_
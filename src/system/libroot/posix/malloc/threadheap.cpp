@@ -52,10 +52,77 @@ threadHeap::malloc(const size_t size)
 #endif
 
 	const int sizeclass = sizeClass(size);
-	block *b = NULL;
 
 	lock();
 
+	block *b = allocateBlock(sizeclass);
+	if (b == NULL) {
+		// We're out of memory!
+		unlock();
+		return NULL;
+	}
+
+#if HEAP_LOG
+	MemoryRequest m;
+	m.malloc((void *)(b + 1), align(size));
+	_pHeap->getLog(getIndex()).append(m);
+#endif
+#if HEAP_FRAG_STATS
+	b->setRequestedSize(align(size));
+	_pHeap->setAllocated(align(size), 0);
+#endif
+
+	unlock();
+
+	// Skip past the block header and return the pointer.
+	return (void *)(b + 1);
+}
+
+
+// mallocBlocks (sizeclass, list, count):
+//   inputs: the size class of the blocks to be allocated, and how many.
+//   returns: the number of blocks actually allocated; they are linked
+//            via their next pointers and returned in list.
+//   side effects: like malloc(), but only acquires the heap lock once.
+
+int
+threadHeap::mallocBlocks(int sizeclass, block *&list, int count)
+{
+	list = NULL;
+
+	lock();
+
+	int allocated = 0;
+	for (; allocated < count; allocated++) {
+		block *b = allocateBlock(sizeclass);
+		if (b == NULL)
+			break;
+
+#if HEAP_FRAG_STATS
+		b->setRequestedSize(sizeFromClass(sizeclass));
+		_pHeap->setAllocated(sizeFromClass(sizeclass), 0);
+#endif
+
+		b->setNext(list);
+		list = b;
+	}
+
+	unlock();
+
+	return allocated;
+}
+
+
+// allocateBlock (sizeclass):
+//   returns: an allocated block of the given size class, or NULL if we
+//            are out of memory.
+//   The heap lock must be held when this procedure is called.
+
+block *
+threadHeap::allocateBlock(int sizeclass)
+{
+	block *b = NULL;
+
 	// Look for a free block.
 	// We usually have memory locally so we first look for space in the
 	// superblock list.
@@ -72,11 +139,8 @@ threadHeap::malloc(const size_t size)
 		// we'll have to allocate our own superblock.
 		if (sb == NULL) {
 			sb = superblock::makeSuperblock(sizeclass, _pHeap);
-			if (sb == NULL) {
-				// We're out of memory!
-				unlock();
+			if (sb == NULL)
 				return NULL;
-			}
 #if HEAP_LOG
 			// Record the memory allocation.
 			MemoryRequest m;
@@ -102,19 +166,5 @@ threadHeap::malloc(const size_t size)
 	assert(sb->isValid());
 
 	b->markAllocated();
-
-#if HEAP_LOG
-	MemoryRequest m;
-	m.malloc((void *)(b + 1), align(size));
-	_pHeap->getLog(getIndex()).append(m);
-#endif
-#if HEAP_FRAG_STATS
-	b->setRequestedSize(align(size));
-	_pHeap->setAllocated(align(size), 0);
-#endif
-
-	unlock();
-
-	// Skip past the block header and return the pointer.
-	return (void *)(b + 1);
+	return b;
 }
@@ -42,6 +42,9 @@ class threadHeap : public hoardHeap {
 		void *malloc(const size_t sz);
 		inline void *memalign(size_t alignment, size_t sz);
 
+		// Allocate up to count blocks of the given size class at once.
+		int mallocBlocks(int sizeclass, block *&list, int count);
+
 		// Find out how large an allocated object is.
 		inline static size_t objectSize(void *ptr);
 
@@ -49,6 +52,9 @@ class threadHeap : public hoardHeap {
 		inline void setpHeap(processHeap *p);
 
 	private:
+		// Get a block; the heap lock must be held.
+		block *allocateBlock(int sizeclass);
+
 		// Prevent copying and assignment.
 		threadHeap(const threadHeap &);
 		const threadHeap &operator=(const threadHeap &);
@@ -21,6 +21,7 @@
 
 #include "config.h"
 #include "threadheap.h"
+#include "threadcache.h"
 #include "processheap.h"
 #include "arch-specific.h"
 
@@ -30,6 +31,7 @@
 #include <string.h>
 
 #include <errno_private.h>
+#include <tls.h>
 #include <user_thread.h>
 
 #include "tracing_config.h"
@@ -256,6 +258,66 @@ getAllocator(void)
 }
 
 
+#if USE_THREAD_CACHE
+
+static threadCache *const kThreadCacheDisabled = (threadCache *)1;
+	// set once the thread is exiting
+
+
+/*!	Returns the calling thread's cache, creating it if necessary. Signals
+	must be deferred.
+*/
+static inline threadCache *
+get_thread_cache(processHeap *pHeap)
+{
+	threadCache *cache = (threadCache *)tls_get(TLS_MALLOC_CACHE_SLOT);
+	if (cache == NULL) {
+		void *buffer = pHeap->getHeap(pHeap->getHeapIndex()).malloc(
+			sizeof(threadCache));
+		if (buffer == NULL)
+			return NULL;
+
+		cache = new(buffer) threadCache(pHeap);
+		tls_set(TLS_MALLOC_CACHE_SLOT, cache);
+	} else if (cache == kThreadCacheDisabled)
+		return NULL;
+
+	return cache;
+}
+
+#endif	// USE_THREAD_CACHE
+
+
+static inline void *
+heap_malloc(processHeap *pHeap, size_t size)
+{
+#if USE_THREAD_CACHE
+	if (size <= threadCache::MAX_CACHED_SIZE) {
+		threadCache *cache = get_thread_cache(pHeap);
+		if (cache != NULL)
+			return cache->malloc(size);
+	}
+#endif
+
+	return pHeap->getHeap(pHeap->getHeapIndex()).malloc(size);
+}
+
+
+static inline void
+heap_free(processHeap *pHeap, void *ptr)
+{
+#if USE_THREAD_CACHE
+	if (ptr != NULL) {
+		threadCache *cache = get_thread_cache(pHeap);
+		if (cache != NULL && cache->free(ptr))
+			return;
+	}
+#endif
+
+	pHeap->free(ptr);
+}
+
+
 extern "C" void
 __heap_before_fork(void)
 {
@@ -285,6 +347,27 @@ __heap_after_fork_parent(void)
 }
 
 
+extern "C" void
+__heap_thread_exit(void)
+{
+#if USE_THREAD_CACHE
+	static processHeap *pHeap = getAllocator();
+
+	defer_signals();
+
+	threadCache *cache = (threadCache *)tls_get(TLS_MALLOC_CACHE_SLOT);
+	tls_set(TLS_MALLOC_CACHE_SLOT, kThreadCacheDisabled);
+
+	if (cache != NULL && cache != kThreadCacheDisabled) {
+		cache->flush();
+		pHeap->free(cache);
+	}
+
+	undefer_signals();
+#endif
+}
+
+
 //	#pragma mark - public functions
 
 
@@ -299,7 +382,7 @@ malloc(size_t size)
 
 	defer_signals();
 
-	void *addr = pHeap->getHeap(pHeap->getHeapIndex()).malloc(size);
+	void *addr = heap_malloc(pHeap, size);
 	if (addr == NULL) {
 		undefer_signals();
 		__set_errno(B_NO_MEMORY);
@@ -345,7 +428,7 @@ calloc(size_t nelem, size_t elsize)
 ok:
 	defer_signals();
 
-	ptr = pHeap->getHeap(pHeap->getHeapIndex()).malloc(size);
+	ptr = heap_malloc(pHeap, size);
 	if (ptr == NULL) {
 		undefer_signals();
 	nomem:
@@ -392,7 +475,7 @@ free(void *ptr)
 	if (ptr != NULL)
 		remove_address(ptr);
 #endif
-	pHeap->free(ptr);
+	heap_free(pHeap, ptr);
 
 	undefer_signals();
 }
@@ -214,3 +214,253 @@ memset(void* ptr, int chr, size_t length)
 	return ptr;
 }
 
+
+
+// #pragma mark - memmove
+
+
+/*!	Copies up to 16 bytes. All bytes are loaded before any of them is stored,
+	so that the ranges may overlap.
+*/
+static inline void
+move_small(uint8_t* destination, const uint8_t* source, size_t length)
+{
+	if (length >= 8) {
+		uint64_t head = *reinterpret_cast<const uint64_t*>(source);
+		uint64_t tail
+			= *reinterpret_cast<const uint64_t*>(source + length - 8);
+		*reinterpret_cast<uint64_t*>(destination) = head;
+		*reinterpret_cast<uint64_t*>(destination + length - 8) = tail;
+	} else if (length >= 4) {
+		uint32_t head = *reinterpret_cast<const uint32_t*>(source);
+		uint32_t tail
+			= *reinterpret_cast<const uint32_t*>(source + length - 4);
+		*reinterpret_cast<uint32_t*>(destination) = head;
+		*reinterpret_cast<uint32_t*>(destination + length - 4) = tail;
+	} else if (length > 0) {
+		uint8_t head = source[0];
+		uint8_t middle = source[length / 2];
+		uint8_t tail = source[length - 1];
+		destination[0] = head;
+		destination[length / 2] = middle;
+		destination[length - 1] = tail;
+	}
+}
+
+
+extern "C" void*
+memmove(void* destination, const void* source, size_t length)
+{
+	auto to = static_cast<uint8_t*>(destination);
+	auto from = static_cast<const uint8_t*>(source);
+
+	if (length <= 16) {
+		move_small(to, from, length);
+		return destination;
+	}
+
+	uintptr_t distance = reinterpret_cast<uintptr_t>(to)
+		- reinterpret_cast<uintptr_t>(from);
+	if (distance >= length && -distance >= length)
+		return memcpy(destination, source, length);
+
+	if (distance >= length) {
+		// The destination lies before the source, copy forwards. The last
+		// block may be overwritten by the loop, so load it in advance.
+		auto tail = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(from + length - 16));
+		uint8_t* tailTo = to + length - 16;
+		while (length > 16) {
+			auto temp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to), temp);
+			to += 16;
+			from += 16;
+			length -= 16;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(tailTo), tail);
+	} else {
+		// The destination lies behind the source, copy backwards.
+		auto head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+		uint8_t* headTo = to;
+		while (length > 16) {
+			length -= 16;
+			auto temp = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(from + length));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(to + length), temp);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(headTo), head);
+	}
+
+	return destination;
+}
+
+
+// #pragma mark - searching
+
+
+/*!	Returns a bit mask with a bit set for each byte of the 16 byte block at
+	\a address that equals the corresponding byte in \a value.
+*/
+static inline uint32_t
+match_mask(const uint8_t* address, __m128i value)
+{
+	auto block = _mm_load_si128(reinterpret_cast<const __m128i*>(address));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(block, value));
+}
+
+
+// The functions below read whole aligned 16 byte blocks, possibly beyond the
+// end of the string or buffer. Since such a block never crosses a page
+// boundary, this is safe.
+
+
+extern "C" size_t
+strlen(const char* string)
+{
+	auto zero = _mm_setzero_si128();
+	auto offset = reinterpret_cast<uintptr_t>(string) % 16;
+	auto block = reinterpret_cast<const uint8_t*>(string) - offset;
+
+	uint32_t mask = match_mask(block, zero) >> offset;
+	if (mask != 0)
+		return __builtin_ctz(mask);
+
+	do {
+		block += 16;
+		mask = match_mask(block, zero);
+	} while (mask == 0);
+
+	return block + __builtin_ctz(mask)
+		- reinterpret_cast<const uint8_t*>(string);
+}
+
+
+extern "C" char*
+strchr(const char* string, int character)
+{
+	auto zero = _mm_setzero_si128();
+	auto value = _mm_set1_epi8(static_cast<char>(character));
+	auto offset = reinterpret_cast<uintptr_t>(string) % 16;
+	auto block = reinterpret_cast<const uint8_t*>(string) - offset;
+
+	uint32_t mask = (match_mask(block, value) | match_mask(block, zero))
+		>> offset << offset;
+	while (mask == 0) {
+		block += 16;
+		mask = match_mask(block, value) | match_mask(block, zero);
+	}
+
+	auto found = block + __builtin_ctz(mask);
+	if (*found != static_cast<uint8_t>(character))
+		return NULL;
+	return reinterpret_cast<char*>(const_cast<uint8_t*>(found));
+}
+
+
+extern "C" void*
+memchr(const void* buffer, int character, size_t length)
+{
+	if (length == 0)
+		return NULL;
+
+	auto value = _mm_set1_epi8(static_cast<char>(character));
+	auto offset = reinterpret_cast<uintptr_t>(buffer) % 16;
+	auto block = static_cast<const uint8_t*>(buffer) - offset;
+
+	// the length as seen from the start of the first block
+	length = length > SIZE_MAX - offset ? SIZE_MAX : length + offset;
+
+	uint32_t mask = match_mask(block, value) >> offset << offset;
+	while (true) {
+		if (mask != 0) {
+			size_t index = __builtin_ctz(mask);
+			if (index >= length)
+				return NULL;
+			return const_cast<uint8_t*>(block + index);
+		}
+
+		if (length <= 16)
+			return NULL;
+
+		block += 16;
+		length -= 16;
+		mask = match_mask(block, value);
+	}
+}
+
+
+// #pragma mark - comparing
+
+
+extern "C" int
+memcmp(const void* _first, const void* _second, size_t length)
+{
+	auto first = static_cast<const uint8_t*>(_first);
+	auto second = static_cast<const uint8_t*>(_second);
+
+	while (length >= 16) {
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second));
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff;
+		if (mask != 0) {
+			auto index = __builtin_ctz(mask);
+			return first[index] - second[index];
+		}
+
+		first += 16;
+		second += 16;
+		length -= 16;
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		if (first[i] != second[i])
+			return first[i] - second[i];
+	}
+
+	return 0;
+}
+
+
+/*!	Returns whether a 16 byte load from \a address could cross a page
+	boundary.
+*/
+static inline bool
+crosses_page(const uint8_t* address)
+{
+	const uintptr_t kPageSize = 4096;
+	return (reinterpret_cast<uintptr_t>(address) & (kPageSize - 1))
+		> kPageSize - 16;
+}
+
+
+extern "C" int
+strcmp(const char* _first, const char* _second)
+{
+	auto first = reinterpret_cast<const uint8_t*>(_first);
+	auto second = reinterpret_cast<const uint8_t*>(_second);
+	auto zero = _mm_setzero_si128();
+
+	while (true) {
+		if (crosses_page(first) || crosses_page(second)) {
+			// compare byte by byte until we're past the page boundary
+			if (*first != *second || *first == '\0')
+				return *first - *second;
+
+			first++;
+			second++;
+			continue;
+		}
+
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second));
+		uint32_t mask = (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff)
+			| _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero));
+		if (mask != 0) {
+			auto index = __builtin_ctz(mask);
+			return first[index] - second[index];
+		}
+
+		first += 16;
+		second += 16;
+	}
+}
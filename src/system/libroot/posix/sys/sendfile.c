@@ -0,0 +1,25 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <sys/sendfile.h>
+
+#include <errno.h>
+
+#include <errno_private.h>
+#include <syscalls.h>
+
+
+ssize_t
+sendfile(int socket, int fd, off_t *offset, size_t count)
+{
+	ssize_t bytes = _kern_sendfile(socket, fd, offset, count);
+	if (bytes < 0) {
+		__set_errno(bytes);
+		return -1;
+	}
+
+	return bytes;
+}
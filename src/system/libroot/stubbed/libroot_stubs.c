@@ -849,6 +849,7 @@ void __heap_after_fork_child() {}
 void __heap_after_fork_parent() {}
 void __heap_before_fork() {}
 void __heap_terminate_after() {}
+void __heap_thread_exit() {}
 void __hypot() {}
 void __hypotf() {}
 void __hypotl() {}
@@ -1366,6 +1367,7 @@ void _kern_create_area() {}
 void _kern_create_child_partition() {}
 void _kern_create_dir() {}
 void _kern_create_dir_entry_ref() {}
+void _kern_create_event_queue() {}
 void _kern_create_fifo() {}
 void _kern_create_index() {}
 void _kern_create_link() {}
@@ -1388,10 +1390,13 @@ void _kern_dup() {}
 void _kern_dup2() {}
 void _kern_entry_ref_to_path() {}
 void _kern_estimate_max_scheduling_latency() {}
+void _kern_event_queue_select() {}
+void _kern_event_queue_wait() {}
 void _kern_exec() {}
 void _kern_exit_team() {}
 void _kern_exit_thread() {}
 void _kern_fcntl() {}
+void _kern_file_advice() {}
 void _kern_find_area() {}
 void _kern_find_disk_device() {}
 void _kern_find_disk_system() {}
@@ -1426,6 +1431,7 @@ void _kern_get_next_sem_info() {}
 void _kern_get_next_socket_stat() {}
 void _kern_get_next_team_info() {}
 void _kern_get_next_thread_info() {}
+void _kern_get_object_cache_stats() {}
 void _kern_get_port_info() {}
 void _kern_get_port_message_info_etc() {}
 void _kern_get_real_time_clock_is_gmt() {}
@@ -1532,6 +1538,7 @@ void _kern_send() {}
 void _kern_send_data() {}
 void _kern_send_signal() {}
 void _kern_sendmsg() {}
+void _kern_sendfile() {}
 void _kern_sendto() {}
 void _kern_set_area_protection() {}
 void _kern_set_clock() {}
@@ -1550,6 +1557,7 @@ void _kern_set_scheduler_mode() {}
 void _kern_set_sem_owner() {}
 void _kern_set_signal_mask() {}
 void _kern_set_signal_stack() {}
+void _kern_set_team_io_priority() {}
 void _kern_set_thread_priority() {}
 void _kern_set_timer() {}
 void _kern_set_timezone() {}
@@ -1832,6 +1840,7 @@ void crealf() {}
 void creall() {}
 void creat() {}
 void create_area() {}
+void create_event_queue() {}
 void create_port() {}
 void create_sem() {}
 void crypt() {}
@@ -1897,6 +1906,8 @@ void erfcl() {}
 void erff() {}
 void erfl() {}
 void estimate_max_scheduling_latency() {}
+void event_queue_select() {}
+void event_queue_wait() {}
 void execl() {}
 void execle() {}
 void execlp() {}
@@ -1277,6 +1277,7 @@ void _kern_create_area() {}
 void _kern_create_child_partition() {}
 void _kern_create_dir() {}
 void _kern_create_dir_entry_ref() {}
+void _kern_create_event_queue() {}
 void _kern_create_fifo() {}
 void _kern_create_index() {}
 void _kern_create_link() {}
@@ -1299,10 +1300,13 @@ void _kern_dup() {}
 void _kern_dup2() {}
 void _kern_entry_ref_to_path() {}
 void _kern_estimate_max_scheduling_latency() {}
+void _kern_event_queue_select() {}
+void _kern_event_queue_wait() {}
 void _kern_exec() {}
 void _kern_exit_team() {}
 void _kern_exit_thread() {}
 void _kern_fcntl() {}
+void _kern_file_advice() {}
 void _kern_find_area() {}
 void _kern_find_disk_device() {}
 void _kern_find_disk_system() {}
@@ -1337,6 +1341,7 @@ void _kern_get_next_sem_info() {}
 void _kern_get_next_socket_stat() {}
 void _kern_get_next_team_info() {}
 void _kern_get_next_thread_info() {}
+void _kern_get_object_cache_stats() {}
 void _kern_get_port_info() {}
 void _kern_get_port_message_info_etc() {}
 void _kern_get_real_time_clock_is_gmt() {}
@@ -1443,6 +1448,7 @@ void _kern_send() {}
 void _kern_send_data() {}
 void _kern_send_signal() {}
 void _kern_sendmsg() {}
+void _kern_sendfile() {}
 void _kern_sendto() {}
 void _kern_set_area_protection() {}
 void _kern_set_clock() {}
@@ -1461,6 +1467,7 @@ void _kern_set_scheduler_mode() {}
 void _kern_set_sem_owner() {}
 void _kern_set_signal_mask() {}
 void _kern_set_signal_stack() {}
+void _kern_set_team_io_priority() {}
 void _kern_set_thread_priority() {}
 void _kern_set_timer() {}
 void _kern_set_timezone() {}
@@ -1761,6 +1768,7 @@ void crealf() {}
 void creall() {}
 void creat() {}
 void create_area() {}
+void create_event_queue() {}
 void create_port() {}
 void create_sem() {}
 void crypt() {}
@@ -1831,6 +1839,8 @@ void erfcl() {}
 void erff() {}
 void erfl() {}
 void estimate_max_scheduling_latency() {}
+void event_queue_select() {}
+void event_queue_wait() {}
 void execl() {}
 void execle() {}
 void execlp() {}
@@ -12,6 +12,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "images.h"
+
+
+extern "C" void arch_lazy_binding_entry();
+
 
 static status_t
 relocate_rela(image_t* rootImage, image_t* image, Elf64_Rela* rel,
@@ -81,6 +86,78 @@ relocate_rela(image_t* rootImage, image_t* image, Elf64_Rela* rel,
 }
 
 
+static bool
+use_lazy_binding(image_t* image)
+{
+	if ((image->flags & RFLAG_BIND_NOW) != 0 || image->pltgot == NULL)
+		return false;
+
+	// The GOT must remain writable, so it must not be part of the RELRO
+	// segment. The linker only puts it there when linking with "-z now", which
+	// also sets DF_BIND_NOW, but better be safe.
+	if (image->relro_size > 0) {
+		addr_t gotStart = (addr_t)image->pltgot;
+		addr_t gotEnd = gotStart
+			+ (3 + image->pltrel_len / sizeof(Elf64_Rela)) * sizeof(Elf64_Addr);
+		addr_t relroStart = image->regions[0].delta + image->relro_page;
+		addr_t relroEnd = relroStart + image->relro_size;
+		if (gotStart < relroEnd && gotEnd > relroStart)
+			return false;
+	}
+
+	return true;
+}
+
+
+/*!	Prepares the PLT of \a image for lazy binding: the jump slots are left
+	pointing to the second instruction of their PLT entry, which pushes the
+	relocation index and jumps to the first PLT entry. That one in turn pushes
+	GOT[1] and jumps to GOT[2], which we set up to bind the symbol on its first
+	use (see arch_lazy_binding_entry()).
+*/
+static status_t
+prepare_lazy_binding(image_t* rootImage, image_t* image, Elf64_Rela* rel,
+	size_t relLength, SymbolLookupCache* cache)
+{
+	for (size_t i = 0; i < relLength / sizeof(Elf64_Rela); i++) {
+		if (ELF64_R_TYPE(rel[i].r_info) != R_X86_64_JMP_SLOT) {
+			status_t status = relocate_rela(rootImage, image, &rel[i],
+				sizeof(Elf64_Rela), cache);
+			if (status != B_OK)
+				return status;
+			continue;
+		}
+
+		// The slot contains the link time address, so we only need to add
+		// the load delta.
+		Elf64_Addr relocAddr = image->regions[0].delta + rel[i].r_offset;
+		*(Elf64_Addr*)relocAddr += image->regions[0].delta;
+	}
+
+	image->pltgot[1] = (Elf64_Addr)image;
+	image->pltgot[2] = (Elf64_Addr)&arch_lazy_binding_entry;
+
+	return B_OK;
+}
+
+
+/*!	Called by arch_lazy_binding_entry() on the first call through a PLT
+	entry. Resolves the symbol, updates the jump slot, so that any further
+	calls go to the symbol directly, and returns the symbol's address.
+*/
+extern "C" addr_t
+arch_lazy_bind(image_t* image, uint64 relocationIndex)
+{
+	Elf64_Rela* rel = (Elf64_Rela*)image->pltrel + relocationIndex;
+	const Elf_Sym* sym = image->Symbol(ELF64_R_SYM(rel->r_info));
+
+	addr_t address = resolve_lazy_symbol(image, sym) + rel->r_addend;
+	*(Elf64_Addr*)(image->regions[0].delta + rel->r_offset) = address;
+
+	return address;
+}
+
+
 status_t
 arch_relocate_image(image_t* rootImage, image_t* image,
 	SymbolLookupCache* cache)
@@ -98,7 +175,12 @@ arch_relocate_image(image_t* rootImage, image_t* image,
 	}
 
 	// PLT relocations (they are RELA on x86_64).
-	if (image->pltrel) {
+	if (image->pltrel && use_lazy_binding(image)) {
+		status = prepare_lazy_binding(rootImage, image,
+			(Elf64_Rela*)image->pltrel, image->pltrel_len, cache);
+		if (status != B_OK)
+			return status;
+	} else if (image->pltrel) {
 		status = relocate_rela(rootImage, image, (Elf64_Rela*)image->pltrel,
 			image->pltrel_len, cache);
 		if (status != B_OK)
@@ -33,7 +33,6 @@
 
 
 // TODO: implement better locking strategy
-// TODO: implement lazy binding
 
 // a handle returned by load_library() (dlopen())
 #define RLD_GLOBAL_SCOPE	((void*)-2l)
@@ -48,6 +47,7 @@ image_t* gProgramImage;
 
 static image_t** sPreloadedImages = NULL;
 static uint32 sPreloadedImageCount = 0;
+static bool sBindNow = false;
 
 static recursive_lock sLock = RECURSIVE_LOCK_INITIALIZER(kLockName);
 
@@ -199,6 +199,13 @@ load_dependencies(image_t* image)
 static status_t
 relocate_image(image_t *rootImage, image_t *image)
 {
+	// Only the program and its dependencies are bound lazily: their symbols
+	// are always looked up in the global scope, and therefore don't depend on
+	// the state of the load at the time they are resolved. Everything loaded
+	// later on (or preloaded) is bound immediately.
+	if (rootImage != gProgramImage || sBindNow)
+		image->flags |= RFLAG_BIND_NOW;
+
 	SymbolLookupCache cache(image);
 
 	status_t status = arch_relocate_image(rootImage, image, &cache);
@@ -418,6 +425,35 @@ preload_images()
 }
 
 
+/*!	Resolves a symbol referenced by a lazily bound PLT entry of \a image.
+	Called by the architecture specific code on the first call through that
+	entry. If the symbol cannot be resolved, the team is terminated, as there
+	is no way to report the error back to the caller.
+*/
+addr_t
+resolve_lazy_symbol(image_t* image, const Elf_Sym* sym)
+{
+	rld_lock();
+
+	addr_t address;
+	status_t status = resolve_symbol(gProgramImage, image, sym, NULL,
+		&address);
+
+	rld_unlock();
+
+	if (status != B_OK) {
+		// resolve_symbol() only reports to the syslog at this point
+		if (gProgramLoaded) {
+			printf("runtime_loader: %s: Could not resolve symbol '%s'\n",
+				image->path, image->SymbolName(sym));
+		}
+		_kern_exit_team(status);
+	}
+
+	return address;
+}
+
+
 //	#pragma mark - libroot.so exported functions
 
 
@@ -432,6 +468,9 @@ load_program(char const *path, void **_entry)
 	rld_lock();
 		// for now, just do stupid simple global locking
 
+	const char* bindNow = getenv("LD_BIND_NOW");
+	sBindNow = bindNow != NULL && bindNow[0] != '\0';
+
 	preload_images();
 
 	TRACE(("rld: load %s\n", path));
@@ -322,6 +322,13 @@ parse_dynamic_segment(image_t* image)
 			case DT_PLTRELSZ:
 				image->pltrel_len = d[i].d_un.d_val;
 				break;
+			case DT_PLTGOT:
+				image->pltgot = (Elf_Addr*)
+					(d[i].d_un.d_ptr + image->regions[0].delta);
+				break;
+			case DT_BIND_NOW:
+				image->flags |= RFLAG_BIND_NOW;
+				break;
 			case DT_INIT:
 				image->init_routine
 					= (d[i].d_un.d_ptr + image->regions[0].delta);
@@ -366,8 +373,14 @@ parse_dynamic_segment(image_t* image)
 				if((flags & DT_TEXTREL) != 0) {
 					image->flags |= RFLAG_TEXTREL;
 				}
+				if ((flags & DF_BIND_NOW) != 0)
+					image->flags |= RFLAG_BIND_NOW;
 				break;
 			}
+			case DT_FLAGS_1:
+				if ((d[i].d_un.d_val & DF_1_BIND_NOW) != 0)
+					image->flags |= RFLAG_BIND_NOW;
+				break;
 			case DT_INIT_ARRAY:
 				// array of pointers to initialization functions
 				image->init_array = (addr_t*)
@@ -406,7 +419,6 @@ parse_dynamic_segment(image_t* image)
 			// DT_RELAENT: The size of a DT_RELA entry.
 			// DT_SYMENT: The size of a symbol table entry.
 			// DT_PLTREL: The type of the PLT relocation entries (DT_JMPREL).
-			// DT_BIND_NOW/DF_BIND_NOW: No lazy binding allowed.
 			// DT_RUNPATH: Library search path (supersedes DT_RPATH).
 			// DT_TEXTREL/DF_TEXTREL: Indicates whether text relocations are
 			//		required (for optimization purposes only).
@@ -610,7 +610,7 @@ resolve_symbol(image_t* rootImage, image_t* image, const Elf_Sym* sym,
 	uint32 index = sym - image->syms;
 
 	// check the cache first
-	if (cache->IsSymbolValueCached(index)) {
+	if (cache != NULL && cache->IsSymbolValueCached(index)) {
 		*symAddress = cache->SymbolValueAt(index, symbolImage);
 		return B_OK;
 	}
@@ -720,7 +720,8 @@ resolve_symbol(image_t* rootImage, image_t* image, const Elf_Sym* sym,
 		return B_MISSING_SYMBOL;
 	}
 
-	cache->SetSymbolValueAt(index, (addr_t)location, sharedImage);
+	if (cache != NULL)
+		cache->SetSymbolValueAt(index, (addr_t)location, sharedImage);
 
 	if (symbolImage)
 		*symbolImage = sharedImage;
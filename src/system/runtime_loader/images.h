@@ -33,6 +33,7 @@ enum {
 	RFLAG_TEXTREL				= 0x40000,
 	RFLAG_CLEAR_TRAILER			= 0x80000,
 		// temporarily set in the symbol resolution code
+	RFLAG_BIND_NOW				= 0x100000,
 };
 
 
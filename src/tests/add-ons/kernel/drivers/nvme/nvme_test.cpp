@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Writes a pattern to a scratch disk from several threads at once, and
+	reads it back. This is meant to be run on the disk qemu_nvme_test.sh
+	provides; it overwrites the start of the given device!
+*/
+
+
+#include <Drivers.h>
+#include <OS.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+static const size_t kChunkSize = 1024 * 1024;
+static const size_t kTransferSizes[] = { 4096, 65536, kChunkSize };
+static const int32 kThreadCount = 8;
+static const int32 kChunksPerThread = 16;
+static const int32 kPasses = 4;
+
+static int sDevice;
+static int32 sFailed;
+
+
+struct thread_data {
+	int32	index;
+	uint8*	buffer;
+	uint8*	verify;
+};
+
+
+static void
+fill_pattern(uint64* buffer, size_t size, off_t offset, int32 pass)
+{
+	for (size_t i = 0; i < size / sizeof(uint64); i++)
+		buffer[i] = ((uint64)pass << 56) | (offset + i * sizeof(uint64));
+}
+
+
+static void*
+test_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+
+	for (int32 pass = 0; pass < kPasses; pass++) {
+		for (int32 i = 0; i < kChunksPerThread; i++) {
+			// every thread has its own chunks, so that the results don't
+			// depend on the order the controller completes the requests in
+			off_t offset = (off_t)(i * kThreadCount + data->index) * kChunkSize;
+			size_t size = kTransferSizes[(i + pass)
+				% (sizeof(kTransferSizes) / sizeof(kTransferSizes[0]))];
+
+			fill_pattern((uint64*)data->buffer, size, offset, pass);
+
+			ssize_t bytes = pwrite(sDevice, data->buffer, size, offset);
+			if (bytes != (ssize_t)size) {
+				fprintf(stderr, "nvme_test: writing %" B_PRIuSIZE " bytes at "
+					"%" B_PRIdOFF " failed: %s\n", size, offset,
+					strerror(errno));
+				atomic_add(&sFailed, 1);
+				return NULL;
+			}
+
+			memset(data->verify, 0, size);
+			bytes = pread(sDevice, data->verify, size, offset);
+			if (bytes != (ssize_t)size) {
+				fprintf(stderr, "nvme_test: reading %" B_PRIuSIZE " bytes at "
+					"%" B_PRIdOFF " failed: %s\n", size, offset,
+					strerror(errno));
+				atomic_add(&sFailed, 1);
+				return NULL;
+			}
+
+			if (memcmp(data->buffer, data->verify, size) != 0) {
+				fprintf(stderr, "nvme_test: data mismatch in %" B_PRIuSIZE
+					" bytes at %" B_PRIdOFF "\n", size, offset);
+				atomic_add(&sFailed, 1);
+				return NULL;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <scratch device>\n"
+			"The contents of the device will be destroyed!\n", argv[0]);
+		return 1;
+	}
+
+	sDevice = open(argv[1], O_RDWR);
+	if (sDevice < 0) {
+		fprintf(stderr, "nvme_test: could not open %s: %s\n", argv[1],
+			strerror(errno));
+		debug_printf("nvme_test: FAILED\n");
+		return 1;
+	}
+
+	device_geometry geometry;
+	if (ioctl(sDevice, B_GET_GEOMETRY, &geometry, sizeof(geometry)) != 0) {
+		fprintf(stderr, "nvme_test: could not get geometry: %s\n",
+			strerror(errno));
+		debug_printf("nvme_test: FAILED\n");
+		return 1;
+	}
+
+	off_t size = (off_t)geometry.bytes_per_sector
+		* geometry.sectors_per_track * geometry.cylinder_count
+		* geometry.head_count;
+	if (size < (off_t)kThreadCount * kChunksPerThread * kChunkSize) {
+		fprintf(stderr, "nvme_test: device is too small (%" B_PRIdOFF
+			" bytes)\n", size);
+		debug_printf("nvme_test: FAILED\n");
+		return 1;
+	}
+
+	bigtime_t startTime = system_time();
+
+	pthread_t threads[kThreadCount];
+	thread_data data[kThreadCount];
+	for (int32 i = 0; i < kThreadCount; i++) {
+		data[i].index = i;
+		data[i].buffer = (uint8*)malloc(kChunkSize);
+		data[i].verify = (uint8*)malloc(kChunkSize);
+		if (data[i].buffer == NULL || data[i].verify == NULL) {
+			fprintf(stderr, "nvme_test: out of memory\n");
+			return 1;
+		}
+
+		pthread_create(&threads[i], NULL, test_thread, &data[i]);
+	}
+
+	for (int32 i = 0; i < kThreadCount; i++) {
+		pthread_join(threads[i], NULL);
+		free(data[i].buffer);
+		free(data[i].verify);
+	}
+
+	close(sDevice);
+
+	bigtime_t time = system_time() - startTime;
+	printf("nvme_test: %" B_PRId32 " threads, %" B_PRId32 " passes, %"
+		B_PRId64 " ms\n", kThreadCount, kPasses, time / 1000);
+
+	// also report on the serial output, so that the test can be run
+	// unattended
+	if (sFailed != 0) {
+		printf("nvme_test: FAILED\n");
+		debug_printf("nvme_test: FAILED\n");
+		return 1;
+	}
+
+	printf("nvme_test: PASSED\n");
+	debug_printf("nvme_test: PASSED\n");
+	return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Boots the given Haiku image in QEMU with an additional NVMe scratch disk,
+# and waits for nvme_test to report its result on the serial output.
+#
+# The image needs to contain the test, and run it on boot; add this to your
+# UserBuildConfig:
+#
+#	AddFilesToHaikuImage system bin : nvme_test ;
+#	AddFilesToHaikuImage home config settings boot
+#		: <src!tests!add-ons!kernel!drivers!nvme>nvme_test_bootscript
+#		: UserBootscript ;
+#
+# Usage: qemu_nvme_test.sh <haiku image> [<timeout in seconds>]
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 <haiku image> [<timeout in seconds>]" >&2
+	exit 1
+fi
+
+image=$1
+timeout=${2:-300}
+qemu=${QEMU:-qemu-system-x86_64}
+
+testDir=$(mktemp -d /tmp/nvme_test.XXXXXX) || exit 1
+trap 'rm -rf $testDir' EXIT
+
+# the test needs 8 threads times 16 chunks of 1 MB
+truncate -s 256M $testDir/nvme.img || exit 1
+
+acceleration=
+if [ -w /dev/kvm ]; then
+	acceleration=-enable-kvm
+fi
+
+$qemu $acceleration -m 1024 -smp 4 -display none \
+	-serial file:$testDir/serial.log \
+	-drive file=$image,format=raw,snapshot=on \
+	-drive file=$testDir/nvme.img,format=raw,if=none,id=nvme0 \
+	-device nvme,serial=nvme_test,drive=nvme0 &
+qemuPid=$!
+
+result=
+while [ $timeout -gt 0 ]; do
+	result=$(grep -o "nvme_test: \(PASSED\|FAILED\)" $testDir/serial.log \
+		2>/dev/null)
+	if [ -n "$result" ] || ! kill -0 $qemuPid 2>/dev/null; then
+		break
+	fi
+	sleep 1
+	timeout=$((timeout - 1))
+done
+
+kill $qemuPid 2>/dev/null
+wait $qemuPid 2>/dev/null
+
+grep "nvme" $testDir/serial.log
+
+if [ "$result" != "nvme_test: PASSED" ]; then
+	echo "NVMe test failed: ${result:-no result}" >&2
+	exit 1
+fi
+
+echo "NVMe test passed"
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how well BFS commits concurrent transactions, by letting an
+	increasing number of threads create, write, fsync(), and remove small
+	files in a directory of the volume to test. Every thread uses its own
+	subdirectory, so that only the journal is shared between them; with group
+	commit, the number of fsync() calls per second should grow with the
+	number of threads, rather than stay the same.
+	To see the effect of the log size, compare volumes that have been
+	initialized with different "log_size" parameters.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+struct worker_data {
+	char		directory[B_PATH_NAME_LENGTH];
+	int32		files;
+	bool		sync;
+	status_t	status;
+};
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: bfs_fsync_test [options] <directory>\n"
+		"  -t <count>   maximum number of threads, default is 8\n"
+		"  -n <count>   number of files per thread, default is 1000\n"
+		"  -a           don't call fsync(), only measure the transactions\n");
+	exit(exitCode);
+}
+
+
+static status_t
+create_file(const char* path, bool sync)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return errno;
+
+	static const char kData[] = "group commit\n";
+	status_t status = B_OK;
+	if (write(fd, kData, sizeof(kData)) != (ssize_t)sizeof(kData))
+		status = errno;
+	else if (sync && fsync(fd) != 0)
+		status = errno;
+
+	close(fd);
+	return status;
+}
+
+
+static status_t
+worker(void* _data)
+{
+	worker_data* data = (worker_data*)_data;
+
+	for (int32 i = 0; i < data->files; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		snprintf(path, sizeof(path), "%s/file-%" B_PRId32, data->directory,
+			i);
+
+		data->status = create_file(path, data->sync);
+		if (data->status != B_OK)
+			break;
+	}
+
+	for (int32 i = 0; i < data->files; i++) {
+		char path[B_PATH_NAME_LENGTH];
+		snprintf(path, sizeof(path), "%s/file-%" B_PRId32, data->directory,
+			i);
+		unlink(path);
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+run_round(const char* directory, int32 threadCount, int32 files, bool sync)
+{
+	worker_data* data = new worker_data[threadCount];
+	thread_id* threads = new thread_id[threadCount];
+	status_t status = B_OK;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		snprintf(data[i].directory, sizeof(data[i].directory),
+			"%s/bfs_fsync_test-%" B_PRId32, directory, i);
+		data[i].files = files;
+		data[i].sync = sync;
+		data[i].status = B_OK;
+
+		if (mkdir(data[i].directory, 0755) != 0 && errno != EEXIST) {
+			status = errno;
+			threadCount = i;
+			break;
+		}
+	}
+
+	for (int32 i = 0; status == B_OK && i < threadCount; i++) {
+		threads[i] = spawn_thread(worker, "fsync worker", B_NORMAL_PRIORITY,
+			&data[i]);
+		if (threads[i] < 0) {
+			status = threads[i];
+			for (int32 j = 0; j < i; j++)
+				kill_thread(threads[j]);
+		}
+	}
+
+	bigtime_t duration = 1;
+	if (status == B_OK) {
+		bigtime_t start = system_time();
+
+		for (int32 i = 0; i < threadCount; i++)
+			resume_thread(threads[i]);
+
+		for (int32 i = 0; i < threadCount; i++) {
+			status_t result;
+			wait_for_thread(threads[i], &result);
+
+			if (status == B_OK)
+				status = data[i].status;
+		}
+
+		duration = system_time() - start;
+		if (duration <= 0)
+			duration = 1;
+	}
+
+	for (int32 i = 0; i < threadCount; i++)
+		rmdir(data[i].directory);
+
+	delete[] threads;
+	delete[] data;
+
+	if (status != B_OK)
+		return status;
+
+	double operations = (double)threadCount * files;
+	printf("%3" B_PRId32 " threads: %8.1f ms, %10.0f files per second\n",
+		threadCount, duration / 1000.0, operations * 1000000.0 / duration);
+
+	return B_OK;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 8;
+	int32 files = 1000;
+	bool sync = true;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:n:ah")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = strtol(optarg, NULL, 0);
+				break;
+			case 'n':
+				files = strtol(optarg, NULL, 0);
+				break;
+			case 'a':
+				sync = false;
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (optind + 1 != argc || maxThreads < 1 || files < 1)
+		usage(1);
+
+	const char* directory = argv[optind];
+
+	printf("%" B_PRId32 " files per thread%s\n\n", files,
+		sync ? ", with fsync()" : "");
+
+	status_t status = B_OK;
+	for (int32 threads = 1; status == B_OK && threads <= maxThreads;
+			threads *= 2) {
+		status = run_round(directory, threads, files, sync);
+	}
+
+	if (status != B_OK) {
+		fprintf(stderr, "Running the threads failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	return 0;
+}
@@ -14,6 +14,7 @@
 
 #include <KernelExport.h>
 
+#include <generic_syscall.h>
 #include <heap.h>
 
 
@@ -44,3 +45,18 @@ free_etc(void* address, uint32 flags)
 {
 	free(address);
 }
+
+
+status_t
+register_generic_syscall(const char* subsystem, syscall_hook hook,
+	uint32 version, uint32 flags)
+{
+	return B_OK;
+}
+
+
+status_t
+unregister_generic_syscall(const char* subsystem, uint32 version)
+{
+	return B_OK;
+}
@@ -30,3 +30,23 @@ smp_get_current_cpu()
 {
 	return 0;
 }
+
+
+extern "C" cpu_status
+disable_interrupts()
+{
+	return 0;
+}
+
+
+extern "C" void
+restore_interrupts(cpu_status status)
+{
+}
+
+
+extern "C" void
+call_all_cpus_sync(void (*function)(void*, int), void* cookie)
+{
+	function(cookie, 0);
+}
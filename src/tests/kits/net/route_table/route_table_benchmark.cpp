@@ -0,0 +1,269 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the route lookups of the network stack's RouteTable against the
+	linear scan over the route list it replaced, with a large number of
+	random IPv4 routes. It also verifies that both find the same routes.
+*/
+
+
+#include "route_table.h"
+#include "routes.h"
+
+#include <net_device.h>
+
+#include <algorithm>
+#include <net/if.h>
+#include <net/route.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static const int32 kDefaultRouteCount = 100000;
+static const int32 kLookupCount = 1000000;
+static const int32 kLinearLookupCount = 1000;
+
+static uint32 sRandomState = 0x2545f491;
+
+
+// The stack's routes.cpp is not linked in
+net_route_private::net_route_private()
+{
+	destination = mask = gateway = NULL;
+	table_next = NULL;
+}
+
+
+net_route_private::~net_route_private()
+{
+	free(destination);
+	free(mask);
+	free(gateway);
+}
+
+
+static uint32
+random_value()
+{
+	sRandomState ^= sRandomState << 13;
+	sRandomState ^= sRandomState >> 17;
+	sRandomState ^= sRandomState << 5;
+	return sRandomState;
+}
+
+
+static sockaddr*
+new_address(uint32 address)
+{
+	sockaddr_in* in = (sockaddr_in*)calloc(1, sizeof(sockaddr_in));
+	in->sin_len = sizeof(sockaddr_in);
+	in->sin_family = AF_INET;
+	in->sin_addr.s_addr = htonl(address);
+	return (sockaddr*)in;
+}
+
+
+static uint32
+prefix_mask(int32 length)
+{
+	return length == 0 ? 0 : ~(uint32)0 << (32 - length);
+}
+
+
+static int32
+prefix_length(const net_route* route)
+{
+	if (route->mask == NULL)
+		return 32;
+
+	uint32 mask = ntohl(((sockaddr_in*)route->mask)->sin_addr.s_addr);
+	int32 length = 0;
+	while (length < 32 && (mask & (1UL << (31 - length))) != 0)
+		length++;
+
+	return length;
+}
+
+
+static bool
+more_specific(const net_route_private* a, const net_route_private* b)
+{
+	return prefix_length(a) > prefix_length(b);
+}
+
+
+/*!	The lookup as the stack did it before: the first match in the route list
+	that is sorted by the length of the prefix wins.
+*/
+static net_route_private*
+linear_lookup(net_route_private** routes, int32 count, uint32 address)
+{
+	for (int32 i = 0; i < count; i++) {
+		net_route_private* route = routes[i];
+		uint32 mask = route->mask != NULL
+			? ntohl(((sockaddr_in*)route->mask)->sin_addr.s_addr) : ~(uint32)0;
+		if ((address & mask)
+				== ntohl(((sockaddr_in*)route->destination)->sin_addr.s_addr))
+			return route;
+	}
+
+	return NULL;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 count = kDefaultRouteCount;
+	if (argc > 1)
+		count = strtol(argv[1], NULL, 0);
+	if (count < 1) {
+		fprintf(stderr, "Usage: %s [route count]\n", argv[0]);
+		return 1;
+	}
+
+	net_device device;
+	memset(&device, 0, sizeof(device));
+	device.flags = IFF_UP | IFF_LINK;
+
+	net_interface interface;
+	memset(&interface, 0, sizeof(interface));
+	interface.device = &device;
+
+	net_interface_address interfaceAddress;
+	memset(&interfaceAddress, 0, sizeof(interfaceAddress));
+	interfaceAddress.interface = &interface;
+
+	RouteTable table;
+	table.Init(AF_INET);
+
+	net_route_private** routes = new net_route_private*[count];
+
+	// the default route is always there, all other routes are random
+	// prefixes between 8 and 32 bits
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < count; i++) {
+		net_route_private* route = new net_route_private;
+		route->interface_address = &interfaceAddress;
+		route->ref_count = 1;
+
+		if (i == 0) {
+			route->flags = RTF_DEFAULT;
+			route->destination = new_address(0);
+			route->mask = new_address(0);
+		} else {
+			int32 length = 8 + random_value() % 25;
+			route->destination = new_address(random_value()
+				& prefix_mask(length));
+			if (length == 32)
+				route->flags = RTF_HOST;
+			else
+				route->mask = new_address(prefix_mask(length));
+		}
+
+		if (table.Add(route) != B_OK) {
+			fprintf(stderr, "Adding route %" B_PRId32 " failed!\n", i);
+			return 1;
+		}
+		routes[i] = route;
+	}
+
+	bigtime_t addTime = system_time() - start;
+	printf("%" B_PRId32 " routes added in %g ms\n", count, addTime / 1000.0);
+
+	// keep the order the route list had
+	std::stable_sort(routes, routes + count, more_specific);
+
+	uint32* addresses = new uint32[kLookupCount];
+	for (int32 i = 0; i < kLookupCount; i++)
+		addresses[i] = random_value();
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_len = sizeof(address);
+	address.sin_family = AF_INET;
+
+	start = system_time();
+
+	for (int32 i = 0; i < kLookupCount; i++) {
+		address.sin_addr.s_addr = htonl(addresses[i]);
+		if (table.Lookup((sockaddr*)&address) == NULL) {
+			fprintf(stderr, "No route found!\n");
+			return 1;
+		}
+	}
+
+	bigtime_t tableTime = system_time() - start;
+
+	int32 linearCount = min_c(kLinearLookupCount, kLookupCount);
+	start = system_time();
+
+	for (int32 i = 0; i < linearCount; i++) {
+		if (linear_lookup(routes, count, addresses[i]) == NULL) {
+			fprintf(stderr, "No route found!\n");
+			return 1;
+		}
+	}
+
+	bigtime_t linearTime = system_time() - start;
+
+	printf("route table: %10.1f ns per lookup\n",
+		tableTime * 1000.0 / kLookupCount);
+	printf("linear scan: %10.1f ns per lookup\n",
+		linearTime * 1000.0 / linearCount);
+
+	// verify the results, before and after half of the routes are gone
+
+	for (int32 pass = 0; pass < 2; pass++) {
+		for (int32 i = 0; i < linearCount; i++) {
+			address.sin_addr.s_addr = htonl(addresses[i]);
+			net_route_private* expected = linear_lookup(routes, count,
+				addresses[i]);
+			net_route_private* route = table.Lookup((sockaddr*)&address);
+			if (route != expected) {
+				fprintf(stderr, "Lookup of %08" B_PRIx32 " returned a "
+					"different route!\n", addresses[i]);
+				return 1;
+			}
+		}
+
+		if (pass > 0)
+			break;
+
+		start = system_time();
+
+		int32 kept = 0;
+		for (int32 i = 0; i < count; i++) {
+			net_route_private* route = routes[i];
+			if (i % 2 == 1 && (route->flags & RTF_DEFAULT) == 0) {
+				table.Remove(route);
+				delete route;
+			} else
+				routes[kept++] = route;
+		}
+
+		printf("%" B_PRId32 " routes removed in %g ms\n", count - kept,
+			(system_time() - start) / 1000.0);
+		count = kept;
+	}
+
+	printf("All lookups matched.\n");
+
+	for (int32 i = 0; i < count; i++) {
+		table.Remove(routes[i]);
+		delete routes[i];
+	}
+
+	delete[] routes;
+	delete[] addresses;
+	return 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares the TCP congestion control algorithms by transferring data over
+	the loopback interface, with its network emulation configured to mimic a
+	real network path.
+*/
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/sockio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <generic_syscall_defs.h>
+#include <loopback_control.h>
+#include <syscalls.h>
+#include <tcp_control.h>
+
+
+static const char* kDefaultAlgorithms[] = {"newreno", "cubic", "paced", NULL};
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: tcp_congestion_test [options] [algorithm...]\n"
+		"  -d <ms>      one-way delay of the loopback interface\n"
+		"  -j <ms>      jitter of the delay\n"
+		"  -l <ppm>     packet loss, in parts per million\n"
+		"  -r <kB/s>    rate limit of the loopback interface\n"
+		"  -q <count>   queue limit of the loopback interface\n"
+		"  -s <MB>      amount of data to transfer for each algorithm\n"
+		"  -D <name>    set the system wide default algorithm, and exit\n"
+		"Without any algorithm given, all of them are compared.\n");
+	exit(exitCode);
+}
+
+
+static status_t
+loopback_control(int option, loopback_emulation& emulation)
+{
+	int socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (socket < 0)
+		return errno;
+
+	ifreq request;
+	memset(&request, 0, sizeof(request));
+	strlcpy(request.ifr_name, "loop", IF_NAMESIZE);
+	request.ifr_data = (uint8_t*)&emulation;
+
+	status_t status = B_OK;
+	if (ioctl(socket, option, &request, sizeof(request)) < 0)
+		status = errno;
+
+	close(socket);
+	return status;
+}
+
+
+static void
+receive(int listener)
+{
+	int socket = accept(listener, NULL, NULL);
+	if (socket < 0) {
+		fprintf(stderr, "accept() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	char buffer[65536];
+	while (true) {
+		ssize_t bytesRead = read(socket, buffer, sizeof(buffer));
+		if (bytesRead <= 0)
+			break;
+	}
+
+	// tell the sender that everything has arrived
+	write(socket, "", 1);
+	close(socket);
+}
+
+
+static bigtime_t
+transfer(const char* algorithm, size_t size)
+{
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_len = sizeof(address);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof(address);
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, (sockaddr*)&address, addressLength) < 0
+		|| getsockname(listener, (sockaddr*)&address, &addressLength) < 0
+		|| listen(listener, 1) < 0) {
+		fprintf(stderr, "failed to set up listener: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	pid_t child = fork();
+	if (child < 0) {
+		fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	if (child == 0) {
+		receive(listener);
+		exit(0);
+	}
+
+	close(listener);
+
+	int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (socket < 0 || setsockopt(socket, IPPROTO_TCP, TCP_CONGESTION, algorithm,
+			strlen(algorithm)) < 0) {
+		fprintf(stderr, "%s: %s\n", algorithm, strerror(errno));
+		exit(1);
+	}
+
+	if (connect(socket, (sockaddr*)&address, addressLength) < 0) {
+		fprintf(stderr, "connect() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	char buffer[65536];
+	memset(buffer, 0, sizeof(buffer));
+
+	bigtime_t start = system_time();
+
+	size_t left = size;
+	while (left > 0) {
+		ssize_t bytesWritten = write(socket, buffer,
+			left < sizeof(buffer) ? left : sizeof(buffer));
+		if (bytesWritten <= 0) {
+			fprintf(stderr, "write() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+		left -= bytesWritten;
+	}
+
+	shutdown(socket, SHUT_WR);
+	read(socket, buffer, 1);
+
+	bigtime_t duration = system_time() - start;
+
+	close(socket);
+	waitpid(child, NULL, 0);
+
+	return duration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	loopback_emulation emulation;
+	memset(&emulation, 0, sizeof(emulation));
+	size_t size = 16 * 1024 * 1024;
+
+	int option;
+	while ((option = getopt(argc, argv, "d:j:l:r:q:s:D:h")) != -1) {
+		switch (option) {
+			case 'd':
+				emulation.delay = strtoll(optarg, NULL, 0) * 1000;
+				break;
+			case 'j':
+				emulation.jitter = strtoll(optarg, NULL, 0) * 1000;
+				break;
+			case 'l':
+				emulation.loss = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				emulation.rate = strtoul(optarg, NULL, 0) * 1024;
+				break;
+			case 'q':
+				emulation.queue_limit = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				size = strtoul(optarg, NULL, 0) * 1024 * 1024;
+				break;
+			case 'D':
+			{
+				tcp_congestion_control control;
+				strlcpy(control.name, optarg, sizeof(control.name));
+				status_t status = _kern_generic_syscall(TCP_SYSCALLS,
+					TCP_SET_DEFAULT_CONGESTION, &control, sizeof(control));
+				if (status != B_OK) {
+					fprintf(stderr, "Could not set default algorithm: %s\n",
+						strerror(status));
+					return 1;
+				}
+				return 0;
+			}
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	const char** algorithms = kDefaultAlgorithms;
+	if (optind < argc)
+		algorithms = (const char**)argv + optind;
+
+	loopback_emulation previous;
+	status_t status = loopback_control(SIOCGDRVSPEC, previous);
+	if (status == B_OK)
+		status = loopback_control(SIOCSDRVSPEC, emulation);
+	if (status != B_OK) {
+		fprintf(stderr, "Could not configure loopback emulation: %s\n",
+			strerror(status));
+		return 1;
+	}
+
+	tcp_congestion_control control;
+	if (_kern_generic_syscall(TCP_SYSCALLS, TCP_GET_DEFAULT_CONGESTION,
+			&control, sizeof(control)) == B_OK)
+		printf("default algorithm: %s\n", control.name);
+
+	printf("delay %" B_PRIdBIGTIME " ms, jitter %" B_PRIdBIGTIME " ms, "
+		"loss %" B_PRIu32 " ppm, rate %" B_PRIu32 " kB/s\n\n",
+		emulation.delay / 1000, emulation.jitter / 1000, emulation.loss,
+		emulation.rate / 1024);
+
+	for (int32 i = 0; algorithms[i] != NULL; i++) {
+		bigtime_t duration = transfer(algorithms[i], size);
+		printf("%-10s %8.3f s %10.1f kB/s\n", algorithms[i],
+			duration / 1000000.0, size / 1024.0 / (duration / 1000000.0));
+	}
+
+	loopback_control(SIOCSDRVSPEC, previous);
+	return 0;
+}
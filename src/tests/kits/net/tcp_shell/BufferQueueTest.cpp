@@ -74,6 +74,46 @@ dump(const char* text = "")
 }
 
 
+void
+test_sack_info()
+{
+	BufferQueue queue(32768);
+	queue.SetInitialSequence(5000);
+
+	tcp_sack sacks[TCP_MAX_SACK_BLOCKS];
+	queue.Add(create_filled_buffer(100), 5000);
+	ASSERT(queue.PopulateSackInfo(5000, TCP_MAX_SACK_BLOCKS, sacks) == 0);
+
+	queue.Add(create_filled_buffer(100), 5200);
+	queue.Add(create_filled_buffer(100), 5300);
+	queue.Add(create_filled_buffer(50), 5500);
+	queue.Add(create_filled_buffer(10), 5600);
+
+	// the block of the last segment comes first, then the others in order
+	ASSERT(queue.PopulateSackInfo(5500, TCP_MAX_SACK_BLOCKS, sacks) == 3);
+	ASSERT(sacks[0].left_edge == 5500 && sacks[0].right_edge == 5550);
+	ASSERT(sacks[1].left_edge == 5200 && sacks[1].right_edge == 5400);
+	ASSERT(sacks[2].left_edge == 5600 && sacks[2].right_edge == 5610);
+
+	ASSERT(queue.PopulateSackInfo(5650, 2, sacks) == 2);
+	ASSERT(sacks[0].left_edge == 5200 && sacks[0].right_edge == 5400);
+	ASSERT(sacks[1].left_edge == 5500 && sacks[1].right_edge == 5550);
+
+	ASSERT(queue.PopulateSackInfo(5610 - 1, 2, sacks) == 2);
+	ASSERT(sacks[0].left_edge == 5600 && sacks[0].right_edge == 5610);
+	ASSERT(sacks[1].left_edge == 5200 && sacks[1].right_edge == 5400);
+
+	// fill the first hole
+	queue.Add(create_filled_buffer(100), 5100);
+	ASSERT(queue.NextSequence() == 5400);
+	ASSERT(queue.PopulateSackInfo(5100, TCP_MAX_SACK_BLOCKS, sacks) == 2);
+	ASSERT(sacks[0].left_edge == 5500 && sacks[0].right_edge == 5550);
+	ASSERT(sacks[1].left_edge == 5600 && sacks[1].right_edge == 5610);
+
+	printf("SACK info ok.\n");
+}
+
+
 int
 main()
 {
@@ -140,6 +180,8 @@ main()
 	add(500, 1000);
 	dump("added data covered by next");
 
+	test_sack_info();
+
 	put_module(NET_BUFFER_MODULE_NAME);
 	return 0;
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CongestionControl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <debug.h>
+
+
+static const uint32 kSegmentSize = 1000;
+
+
+static void
+test_registry()
+{
+	ASSERT(strcmp(default_congestion_control(), "cubic") == 0);
+
+	CongestionControl* control = create_congestion_control(NULL);
+	ASSERT(control != NULL && strcmp(control->Name(), "cubic") == 0);
+	delete control;
+
+	ASSERT(create_congestion_control("vegas") == NULL);
+	status_t status = set_default_congestion_control("vegas");
+	ASSERT(status == B_NAME_NOT_FOUND);
+
+	status = set_default_congestion_control("paced");
+	ASSERT(status == B_OK);
+	control = create_congestion_control(NULL);
+	ASSERT(control != NULL && strcmp(control->Name(), "paced") == 0);
+	delete control;
+
+	set_default_congestion_control("cubic");
+}
+
+
+static void
+test_new_reno()
+{
+	CongestionControl* control = create_congestion_control("newreno");
+	ASSERT(control != NULL);
+
+	// slow start: one segment per acknowledgement
+	uint32 window = 2 * kSegmentSize;
+	control->Acknowledged(window, 10 * kSegmentSize, 2 * kSegmentSize,
+		kSegmentSize);
+	ASSERT(window == 3 * kSegmentSize);
+
+	// congestion avoidance: about one segment per window
+	window = 10 * kSegmentSize;
+	for (int i = 0; i < 10; i++) {
+		control->Acknowledged(window, 10 * kSegmentSize, kSegmentSize,
+			kSegmentSize);
+	}
+	ASSERT(window > 10 * kSegmentSize && window <= 11 * kSegmentSize);
+
+	ASSERT(control->LossDetected(window, 10 * kSegmentSize, kSegmentSize)
+		== 5 * kSegmentSize);
+	ASSERT(control->LossDetected(window, kSegmentSize, kSegmentSize)
+		== 2 * kSegmentSize);
+	ASSERT(control->PacingRate(window, 10000) == 0);
+
+	delete control;
+}
+
+
+static void
+test_cubic()
+{
+	CongestionControl* control = create_congestion_control("cubic");
+	ASSERT(control != NULL);
+	control->RoundTripTimeSample(10000);
+
+	// the window is reduced by 30% only
+	uint32 window = 100 * kSegmentSize;
+	uint32 threshold = control->LossDetected(window, window, kSegmentSize);
+	ASSERT(threshold == 70 * kSegmentSize);
+
+	// right after the loss, the window grows slowly, but it does grow
+	window = threshold;
+	for (int i = 0; i < 70; i++)
+		control->Acknowledged(window, threshold, kSegmentSize, kSegmentSize);
+	ASSERT(window > threshold && window < 80 * kSegmentSize);
+
+	// never by more than half of what was acknowledged
+	uint32 previous = window;
+	control->Acknowledged(window, threshold, 10 * kSegmentSize,
+		kSegmentSize);
+	ASSERT(window - previous <= 5 * kSegmentSize);
+
+	// fast convergence: a second loss below W_max lowers it further
+	threshold = control->LossDetected(window, window, kSegmentSize);
+	ASSERT(threshold == (uint64)window * 7 / 10);
+
+	delete control;
+}
+
+
+static void
+test_paced()
+{
+	CongestionControl* control = create_congestion_control("paced");
+	ASSERT(control != NULL);
+
+	// without any estimates, there is nothing to pace
+	ASSERT(control->PacingRate(10 * kSegmentSize, 0) == 0);
+
+	// in startup, the rate is 2.89 times of what the window allows
+	ASSERT(control->PacingRate(10 * kSegmentSize, 10000) == 2890000);
+
+	// before there is a bandwidth estimate, losses are handled as usual
+	ASSERT(control->LossDetected(10 * kSegmentSize, 10 * kSegmentSize,
+		kSegmentSize) == 5 * kSegmentSize);
+
+	delete control;
+}
+
+
+int
+main()
+{
+	test_registry();
+	test_new_reno();
+	test_cubic();
+	test_paced();
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "SackScoreboard.h"
+
+#include <stdio.h>
+
+
+static const uint32 kSegmentSize = 1000;
+
+
+static void
+update(SackScoreboard& scoreboard, tcp_sequence unacknowledged,
+	uint32 left, uint32 right)
+{
+	tcp_sack sack;
+	sack.left_edge = left;
+	sack.right_edge = right;
+	scoreboard.Update(unacknowledged, 100000, &sack, 1);
+}
+
+
+static void
+test_merge()
+{
+	SackScoreboard scoreboard;
+	ASSERT(scoreboard.IsEmpty());
+
+	update(scoreboard, 1000, 3000, 4000);
+	update(scoreboard, 1000, 5000, 6000);
+	update(scoreboard, 1000, 4000, 5000);
+		// joins both ranges
+	ASSERT(scoreboard.HighestSacked() == 6000);
+	ASSERT(scoreboard.IsSacked(3000) && scoreboard.IsSacked(5999));
+	ASSERT(!scoreboard.IsSacked(2999) && !scoreboard.IsSacked(6000));
+
+	tcp_sequence start;
+	uint32 length;
+	ASSERT(scoreboard.NextHole(1000, start, length));
+	ASSERT(start == 1000 && length == 2000);
+	ASSERT(!scoreboard.NextHole(3000, start, length));
+
+	// bogus and duplicate blocks are ignored
+	update(scoreboard, 1000, 500, 900);
+	update(scoreboard, 1000, 7000, 6500);
+	update(scoreboard, 1000, 200000, 200100);
+	ASSERT(scoreboard.HighestSacked() == 6000);
+
+	scoreboard.RemoveUntil(3500);
+	ASSERT(!scoreboard.IsSacked(3499) && scoreboard.IsSacked(3500));
+	scoreboard.RemoveUntil(6000);
+	ASSERT(scoreboard.IsEmpty());
+}
+
+
+static void
+test_loss()
+{
+	SackScoreboard scoreboard;
+
+	// one segment SACKed above the hole is not enough
+	update(scoreboard, 1000, 2000, 3000);
+	ASSERT(!scoreboard.IsLost(1000, kSegmentSize));
+
+	// more than (DupThresh - 1) * SMSS bytes are
+	update(scoreboard, 1000, 3000, 4000);
+	ASSERT(!scoreboard.IsLost(1000, kSegmentSize));
+	update(scoreboard, 1000, 4000, 4001);
+	ASSERT(scoreboard.IsLost(1000, kSegmentSize));
+	ASSERT(!scoreboard.IsLost(2000, kSegmentSize));
+	ASSERT(!scoreboard.IsLost(5000, kSegmentSize));
+
+	// and so are DupThresh discontiguous ranges
+	scoreboard.Clear();
+	update(scoreboard, 1000, 2000, 2100);
+	update(scoreboard, 1000, 3000, 3100);
+	ASSERT(!scoreboard.IsLost(1000, kSegmentSize));
+	update(scoreboard, 1000, 4000, 4100);
+	ASSERT(scoreboard.IsLost(1000, kSegmentSize));
+	ASSERT(!scoreboard.IsLost(2100, kSegmentSize));
+}
+
+
+static void
+test_pipe()
+{
+	SackScoreboard scoreboard;
+
+	// nothing SACKed: everything is in flight
+	ASSERT(scoreboard.Pipe(1000, 11000, 1000, kSegmentSize) == 10000);
+
+	// segments 2-5 SACKed, the first one lost
+	update(scoreboard, 1000, 2000, 5000);
+	ASSERT(scoreboard.Pipe(1000, 11000, 1000, kSegmentSize) == 6000);
+
+	// once retransmitted, it counts again
+	ASSERT(scoreboard.Pipe(1000, 11000, 2000, kSegmentSize) == 7000);
+
+	// a hole that is not considered lost yet still counts
+	update(scoreboard, 1000, 6000, 7000);
+	ASSERT(scoreboard.Pipe(1000, 11000, 2000, kSegmentSize) == 6000);
+
+	tcp_sequence start;
+	uint32 length;
+	ASSERT(scoreboard.NextHole(2000, start, length));
+	ASSERT(start == 5000 && length == 1000);
+	ASSERT(!scoreboard.IsLost(start, kSegmentSize));
+}
+
+
+int
+main()
+{
+	test_merge();
+	test_loss();
+	test_pipe();
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -1006,6 +1006,24 @@ domain_receive_data(net_buffer *buffer)
 						printf(" <ts %lu:%lu>", option->timestamp.value, option->timestamp.reply);
 						length = 10;
 						break;
+					case TCP_OPTION_SACK_PERMITTED:
+						printf(" <sackOK>");
+						length = 2;
+						break;
+					case TCP_OPTION_SACK:
+						length = option->length;
+						if (length < 2) {
+							size = 0;
+							break;
+						}
+						printf(" <sack");
+						for (uint32 i = 0; i < (length - 2) / sizeof(tcp_sack);
+								i++) {
+							printf(" %lu:%lu", ntohl(option->sack[i].left_edge),
+								ntohl(option->sack[i].right_edge));
+						}
+						putchar('>');
+						break;
 
 					default:
 						length = option->length;
@@ -1425,17 +1443,24 @@ do_drop(int argc, char** argv)
 	} else if (isdigit(argv[1][0])) {
 		// add to drop list
 		for (int i = 1; i < argc; i++) {
-			uint32 packet = strtoul(argv[i], NULL, 0);
-			if (packet == 0) {
+			char* end;
+			uint32 packet = strtoul(argv[i], &end, 0);
+			uint32 last = packet;
+			if (end[0] == '-')
+				last = strtoul(end + 1, NULL, 0);
+			if (packet == 0 || last < packet) {
 				fprintf(stderr, "invalid packet number: %s\n", argv[i]);
 				break;
 			}
 
-			sDropList.insert(packet);
+			// a range lets you drop several packets of one window, which is
+			// what SACK based recovery is meant to deal with
+			for (; packet <= last; packet++)
+				sDropList.insert(packet);
 		}
 	} else {
 		// print usage
-		puts("usage: drop <packet-number> [...]\n"
+		puts("usage: drop <packet-number>[-<last-packet>] [...]\n"
 			"   or: drop -r <probability>\n\n"
 			"   or: drop [-f]\n\n"
 			"Specifiying -f flushes the drop list, -r sets the probability a packet\n"
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the TCP throughput between two hosts, in the style of iperf.
+	Start it with -s on the receiving side, and with -c <server> on the
+	sending side. It only uses POSIX APIs, so that the other end can also be
+	the host of a virtual machine.
+*/
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+static const int kDefaultPort = 5201;
+static const size_t kBufferSize = 128 * 1024;
+static const int kMaxStreams = 16;
+
+static int sDuration = 10;
+static volatile bool sQuit;
+
+
+struct stream {
+	int			socket;
+	pthread_t	thread;
+	uint64_t	bytes;
+};
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: tcp_throughput -s [options]\n"
+		"       tcp_throughput -c <server> [options]\n"
+		"  -p <port>    port to listen on, or to connect to (default %d)\n"
+		"  -t <secs>    time to send for (default %d)\n"
+		"  -P <count>   number of parallel streams (default 1, max %d)\n"
+		"  -N           disable Nagle's algorithm\n"
+		"The server needs to be started with the same number of streams.\n",
+		kDefaultPort, sDuration, kMaxStreams);
+	exit(exitCode);
+}
+
+
+static double
+current_time()
+{
+	timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+
+static void
+print_rate(const char* label, uint64_t bytes, double seconds)
+{
+	printf("%-12s %10.2f MB %10.2f Mbit/s\n", label, bytes / 1048576.0,
+		seconds > 0 ? bytes * 8 / seconds / 1000000.0 : 0.0);
+}
+
+
+static void*
+send_stream(void* _stream)
+{
+	stream* info = (stream*)_stream;
+	char* buffer = (char*)malloc(kBufferSize);
+	if (buffer == NULL)
+		return NULL;
+
+	memset(buffer, 0x55, kBufferSize);
+
+	while (!sQuit) {
+		ssize_t bytesWritten = send(info->socket, buffer, kBufferSize, 0);
+		if (bytesWritten < 0) {
+			if (errno == EINTR)
+				continue;
+			if (!sQuit)
+				fprintf(stderr, "send() failed: %s\n", strerror(errno));
+			break;
+		}
+		__sync_fetch_and_add(&info->bytes, (uint64_t)bytesWritten);
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+
+static void*
+receive_stream(void* _stream)
+{
+	stream* info = (stream*)_stream;
+	char* buffer = (char*)malloc(kBufferSize);
+	if (buffer == NULL)
+		return NULL;
+
+	while (true) {
+		ssize_t bytesRead = recv(info->socket, buffer, kBufferSize, 0);
+		if (bytesRead < 0 && errno == EINTR)
+			continue;
+		if (bytesRead <= 0)
+			break;
+		__sync_fetch_and_add(&info->bytes, (uint64_t)bytesRead);
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+
+/*!	Prints the throughput of all streams once a second until \a duration
+	has passed, or, if \a duration is 0, until all streams are done.
+*/
+static void
+report(stream* streams, int count, int duration, const char* what)
+{
+	double start = current_time();
+	uint64_t lastBytes = 0;
+
+	for (int second = 1; duration == 0 || second <= duration; second++) {
+		sleep(1);
+
+		uint64_t bytes = 0;
+		for (int i = 0; i < count; i++)
+			bytes += __sync_fetch_and_add(&streams[i].bytes, 0);
+
+		char label[32];
+		snprintf(label, sizeof(label), "%3d-%3d s", second - 1, second);
+		print_rate(label, bytes - lastBytes, 1.0);
+
+		if (duration == 0 && bytes == lastBytes)
+			break;
+		lastBytes = bytes;
+	}
+
+	sQuit = true;
+
+	uint64_t total = 0;
+	for (int i = 0; i < count; i++) {
+		shutdown(streams[i].socket, SHUT_RDWR);
+		pthread_join(streams[i].thread, NULL);
+		close(streams[i].socket);
+		total += streams[i].bytes;
+	}
+
+	print_rate(what, total, current_time() - start);
+}
+
+
+static int
+run_server(int port, int streamCount)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0) {
+		fprintf(stderr, "socket() failed: %s\n", strerror(errno));
+		return 1;
+	}
+
+	int value = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = INADDR_ANY;
+
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0
+		|| listen(listener, kMaxStreams) < 0) {
+		fprintf(stderr, "could not listen on port %d: %s\n", port,
+			strerror(errno));
+		return 1;
+	}
+
+	printf("waiting for %d stream(s) on port %d\n", streamCount, port);
+
+	while (true) {
+		stream streams[kMaxStreams];
+		for (int i = 0; i < streamCount; i++) {
+			streams[i].socket = accept(listener, NULL, NULL);
+			if (streams[i].socket < 0) {
+				fprintf(stderr, "accept() failed: %s\n", strerror(errno));
+				return 1;
+			}
+			streams[i].bytes = 0;
+			pthread_create(&streams[i].thread, NULL, receive_stream,
+				&streams[i]);
+		}
+
+		report(streams, streamCount, 0, "received");
+	}
+
+	return 0;
+}
+
+
+static int
+run_client(const char* server, int port, int streamCount, bool noDelay)
+{
+	hostent* host = gethostbyname(server);
+	if (host == NULL) {
+		fprintf(stderr, "unknown host: %s\n", server);
+		return 1;
+	}
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	memcpy(&address.sin_addr, host->h_addr, sizeof(address.sin_addr));
+
+	stream streams[kMaxStreams];
+	for (int i = 0; i < streamCount; i++) {
+		streams[i].socket = socket(AF_INET, SOCK_STREAM, 0);
+		if (streams[i].socket < 0
+			|| connect(streams[i].socket, (sockaddr*)&address,
+				sizeof(address)) < 0) {
+			fprintf(stderr, "could not connect to %s: %s\n", server,
+				strerror(errno));
+			return 1;
+		}
+
+		if (noDelay) {
+			int value = 1;
+			setsockopt(streams[i].socket, IPPROTO_TCP, TCP_NODELAY, &value,
+				sizeof(value));
+		}
+
+		streams[i].bytes = 0;
+	}
+
+	sQuit = false;
+	for (int i = 0; i < streamCount; i++)
+		pthread_create(&streams[i].thread, NULL, send_stream, &streams[i]);
+
+	report(streams, streamCount, sDuration, "sent");
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* server = NULL;
+	bool isServer = false;
+	bool noDelay = false;
+	int port = kDefaultPort;
+	int streamCount = 1;
+
+	int option;
+	while ((option = getopt(argc, argv, "c:hNp:P:st:")) != -1) {
+		switch (option) {
+			case 'c':
+				server = optarg;
+				break;
+			case 'N':
+				noDelay = true;
+				break;
+			case 'p':
+				port = atoi(optarg);
+				break;
+			case 'P':
+				streamCount = atoi(optarg);
+				break;
+			case 's':
+				isServer = true;
+				break;
+			case 't':
+				sDuration = atoi(optarg);
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (isServer == (server != NULL) || optind != argc || streamCount < 1
+		|| streamCount > kMaxStreams || sDuration < 1) {
+		usage(1);
+	}
+
+	// a failing send() should be reported, not kill us
+	signal(SIGPIPE, SIG_IGN);
+
+	if (isServer)
+		return run_server(port, streamCount);
+
+	return run_client(server, port, streamCount, noDelay);
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares zlib and Zstandard compressed package heaps. The given files are
+	written into a heap with one and with several compression threads (the
+	resulting heaps must be identical), which is then read back sequentially,
+	like when extracting a package, and at random offsets, like packagefs
+	does.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+#include <DataIO.h>
+#include <OS.h>
+#include <Referenceable.h>
+
+#include <CompressionAlgorithm.h>
+#include <ZlibCompressionAlgorithm.h>
+#include <ZstdCompressionAlgorithm.h>
+#include <package/hpkg/DataReader.h>
+#include <package/hpkg/ErrorOutput.h>
+#include <package/hpkg/HPKGDefs.h>
+#include <package/hpkg/PackageFileHeapReader.h>
+#include <package/hpkg/PackageFileHeapWriter.h>
+
+
+using namespace BPackageKit::BHPKG;
+using BPackageKit::BHPKG::BPrivate::CompressionAlgorithmOwner;
+using BPackageKit::BHPKG::BPrivate::DecompressionAlgorithmOwner;
+using BPackageKit::BHPKG::BPrivate::PackageFileHeapReader;
+using BPackageKit::BHPKG::BPrivate::PackageFileHeapWriter;
+
+
+static const size_t kRandomReadSize = 4096;
+
+
+class StandardErrorOutput : public BErrorOutput {
+	virtual	void PrintErrorVarArgs(const char* format, va_list args)
+	{
+		vfprintf(stderr, format, args);
+	}
+};
+
+
+static StandardErrorOutput sErrorOutput;
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: heap_compression_test [options] <file>...\n"
+		"  -j <count>   number of compression threads, default is one per "
+			"CPU\n"
+		"  -l <level>   compression level, default is 9\n"
+		"  -n <count>   number of random reads, default is 10000\n");
+	exit(exitCode);
+}
+
+
+static void
+print_result(const char* what, uint64 bytes, bigtime_t duration)
+{
+	if (duration <= 0)
+		duration = 1;
+
+	printf("  %-22s %8.1f ms, %8.1f MB/s\n", what, duration / 1000.0,
+		bytes / 1048576.0 / (duration / 1000000.0));
+}
+
+
+static status_t
+create_algorithms(uint32 compression, int32 level,
+	CompressionAlgorithmOwner*& _compression,
+	DecompressionAlgorithmOwner*& _decompression)
+{
+	if (compression == B_HPKG_COMPRESSION_ZSTD) {
+		_compression = CompressionAlgorithmOwner::Create(
+			new(std::nothrow) BZstdCompressionAlgorithm,
+			new(std::nothrow) BZstdCompressionParameters(level));
+		_decompression = DecompressionAlgorithmOwner::Create(
+			new(std::nothrow) BZstdCompressionAlgorithm,
+			new(std::nothrow) BZstdDecompressionParameters);
+	} else {
+		_compression = CompressionAlgorithmOwner::Create(
+			new(std::nothrow) BZlibCompressionAlgorithm,
+			new(std::nothrow) BZlibCompressionParameters(level));
+		_decompression = DecompressionAlgorithmOwner::Create(
+			new(std::nothrow) BZlibCompressionAlgorithm,
+			new(std::nothrow) BZlibDecompressionParameters);
+	}
+
+	if (_compression == NULL || _compression->algorithm == NULL
+		|| _compression->parameters == NULL || _decompression == NULL
+		|| _decompression->algorithm == NULL
+		|| _decompression->parameters == NULL) {
+		if (_compression != NULL)
+			_compression->ReleaseReference();
+		if (_decompression != NULL)
+			_decompression->ReleaseReference();
+		return B_NO_MEMORY;
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+write_heap(BMallocIO& heap, const uint8* data, size_t size,
+	CompressionAlgorithmOwner* compression,
+	DecompressionAlgorithmOwner* decompression, int32 threadCount,
+	bigtime_t& _duration)
+{
+	bigtime_t start = system_time();
+
+	PackageFileHeapWriter writer(&sErrorOutput, &heap, 0, compression,
+		decompression, threadCount);
+	try {
+		writer.Init();
+
+		// add the data in pieces, like the package writer does for files
+		for (size_t offset = 0; offset < size;) {
+			size_t toAdd = std::min(size - offset, (size_t)100000);
+			BBufferDataReader reader(data + offset, toAdd);
+			uint64 heapOffset;
+			status_t error = writer.AddData(reader, toAdd, heapOffset);
+			if (error != B_OK)
+				return error;
+
+			offset += toAdd;
+		}
+	} catch (std::bad_alloc&) {
+		return B_NO_MEMORY;
+	} catch (status_t error) {
+		return error;
+	}
+
+	status_t error = writer.Finish();
+	_duration = system_time() - start;
+	return error;
+}
+
+
+static status_t
+test_compression(uint32 compression, const char* name, const uint8* data,
+	size_t size, int32 threadCount, int32 level, int32 randomReads)
+{
+	printf("%s:\n", name);
+
+	CompressionAlgorithmOwner* compressionAlgorithm;
+	DecompressionAlgorithmOwner* decompressionAlgorithm;
+	status_t error = create_algorithms(compression, level, compressionAlgorithm,
+		decompressionAlgorithm);
+	if (error != B_OK)
+		return error;
+
+	BReference<CompressionAlgorithmOwner> compressionReference(
+		compressionAlgorithm, true);
+	BReference<DecompressionAlgorithmOwner> decompressionReference(
+		decompressionAlgorithm, true);
+
+	// create the heap with one and with several threads
+	BMallocIO serialHeap;
+	bigtime_t serialTime;
+	error = write_heap(serialHeap, data, size, compressionAlgorithm,
+		decompressionAlgorithm, 1, serialTime);
+	if (error != B_OK) {
+		fprintf(stderr, "Creating the heap failed: %s\n", strerror(error));
+		return error;
+	}
+
+	BMallocIO heap;
+	bigtime_t parallelTime;
+	error = write_heap(heap, data, size, compressionAlgorithm,
+		decompressionAlgorithm, threadCount, parallelTime);
+	if (error != B_OK) {
+		fprintf(stderr, "Creating the heap failed: %s\n", strerror(error));
+		return error;
+	}
+
+	if (heap.BufferLength() != serialHeap.BufferLength()
+		|| memcmp(heap.Buffer(), serialHeap.Buffer(), heap.BufferLength())
+			!= 0) {
+		fprintf(stderr, "The heaps created with 1 and %" B_PRId32 " threads "
+			"differ!\n", threadCount);
+		return B_ERROR;
+	}
+
+	printf("  %" B_PRIuSIZE " -> %" B_PRIuSIZE " bytes (%.1f %%)\n", size,
+		heap.BufferLength(), heap.BufferLength() * 100.0 / size);
+	print_result("create, 1 thread", size, serialTime);
+
+	char what[32];
+	snprintf(what, sizeof(what), "create, %" B_PRId32 " threads",
+		threadCount);
+	print_result(what, size, parallelTime);
+
+	// read it back
+	PackageFileHeapReader reader(&sErrorOutput, &heap, 0,
+		heap.BufferLength(), size, decompressionAlgorithm);
+	error = reader.Init();
+	if (error != B_OK) {
+		fprintf(stderr, "Initializing the heap reader failed: %s\n",
+			strerror(error));
+		return error;
+	}
+
+	size_t chunkSize = reader.ChunkSize();
+	uint8* buffer = (uint8*)malloc(chunkSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	bigtime_t start = system_time();
+	for (size_t offset = 0; offset < size;) {
+		size_t toRead = std::min(size - offset, chunkSize);
+		error = reader.ReadData(offset, buffer, toRead);
+		if (error != B_OK || memcmp(buffer, data + offset, toRead) != 0) {
+			fprintf(stderr, "Reading at %" B_PRIuSIZE " failed\n", offset);
+			free(buffer);
+			return error != B_OK ? error : B_BAD_DATA;
+		}
+
+		offset += toRead;
+	}
+	print_result("extract", size, system_time() - start);
+
+	if (size > kRandomReadSize) {
+		srand(1);
+		start = system_time();
+		for (int32 i = 0; i < randomReads; i++) {
+			size_t offset = ((size_t)rand() * RAND_MAX + rand())
+				% (size - kRandomReadSize);
+			error = reader.ReadData(offset, buffer, kRandomReadSize);
+			if (error != B_OK) {
+				fprintf(stderr, "Reading at %" B_PRIuSIZE " failed\n",
+					offset);
+				free(buffer);
+				return error;
+			}
+		}
+		print_result("random read", (uint64)randomReads * kRandomReadSize,
+			system_time() - start);
+	}
+
+	free(buffer);
+	return B_OK;
+}
+
+
+static status_t
+add_file(const char* path, BMallocIO& data)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", path, strerror(errno));
+		return errno;
+	}
+
+	char buffer[65536];
+	while (true) {
+		ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+		if (bytesRead <= 0) {
+			status_t status = bytesRead < 0 ? errno : B_OK;
+			close(fd);
+			return status;
+		}
+
+		data.Write(buffer, bytesRead);
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = 0;
+	int32 level = B_HPKG_COMPRESSION_LEVEL_BEST;
+	int32 randomReads = 10000;
+
+	int option;
+	while ((option = getopt(argc, argv, "j:l:n:h")) != -1) {
+		switch (option) {
+			case 'j':
+				threadCount = strtol(optarg, NULL, 0);
+				break;
+			case 'l':
+				level = strtol(optarg, NULL, 0);
+				break;
+			case 'n':
+				randomReads = strtol(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (optind >= argc || level < 1)
+		usage(1);
+
+	if (threadCount <= 0) {
+		system_info info;
+		get_system_info(&info);
+		threadCount = info.cpu_count;
+	}
+
+	BMallocIO data;
+	for (int i = optind; i < argc; i++) {
+		if (add_file(argv[i], data) != B_OK)
+			return 1;
+	}
+
+	if (data.BufferLength() == 0) {
+		fprintf(stderr, "No data to compress\n");
+		return 1;
+	}
+
+	const uint8* buffer = (const uint8*)data.Buffer();
+	size_t size = data.BufferLength();
+
+	if (test_compression(B_HPKG_COMPRESSION_ZLIB, "zlib", buffer, size,
+			threadCount, level, randomReads) != B_OK
+		|| test_compression(B_HPKG_COMPRESSION_ZSTD, "zstd", buffer, size,
+			threadCount, level, randomReads) != B_OK) {
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how long it takes to parse the TOCs and attributes of the
+	packages in a packages directory, like packagefs does when it is mounted,
+	once with a single thread and once with several threads. Only the
+	activated packages are used if the directory has an activation file.
+	The benchmark is also built for the host, so that it can be run on a
+	package set on other platforms, too.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <OS.h>
+#include <String.h>
+
+#include <package/hpkg/ErrorOutput.h>
+#include <package/hpkg/PackageContentHandler.h>
+#include <package/hpkg/PackageReader.h>
+
+
+using namespace BPackageKit::BHPKG;
+
+
+static const char* const kActivationFilePath
+	= "administrative/activated-packages";
+
+
+class StandardErrorOutput : public BErrorOutput {
+	virtual	void PrintErrorVarArgs(const char* format, va_list args)
+	{
+		vfprintf(stderr, format, args);
+	}
+};
+
+
+class CountingContentHandler : public BPackageContentHandler {
+public:
+	CountingContentHandler()
+		:
+		fEntries(0),
+		fAttributes(0)
+	{
+	}
+
+	virtual status_t HandleEntry(BPackageEntry* entry)
+	{
+		fEntries++;
+		return B_OK;
+	}
+
+	virtual status_t HandleEntryAttribute(BPackageEntry* entry,
+		BPackageEntryAttribute* attribute)
+	{
+		fAttributes++;
+		return B_OK;
+	}
+
+	virtual status_t HandleEntryDone(BPackageEntry* entry)
+	{
+		return B_OK;
+	}
+
+	virtual status_t HandlePackageAttribute(
+		const BPackageInfoAttributeValue& value)
+	{
+		fAttributes++;
+		return B_OK;
+	}
+
+	virtual void HandleErrorOccurred()
+	{
+	}
+
+	int64 Entries() const		{ return fEntries; }
+	int64 Attributes() const	{ return fAttributes; }
+
+private:
+	int64	fEntries;
+	int64	fAttributes;
+};
+
+
+struct load_data {
+	const std::vector<BString>*	paths;
+	int32*						nextIndex;
+	int64						entries;
+	int64						attributes;
+	status_t					status;
+};
+
+
+static StandardErrorOutput sErrorOutput;
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: package_load_benchmark [options] "
+			"<packages directory>\n"
+		"  -j <count>   number of loader threads, default is one per CPU\n"
+		"  -r <count>   number of rounds, default is 3\n");
+	exit(exitCode);
+}
+
+
+static status_t
+load_package(const char* path, CountingContentHandler& handler)
+{
+	BPackageReader reader(&sErrorOutput);
+	status_t error = reader.Init(path);
+	if (error == B_OK)
+		error = reader.ParseContent(&handler);
+
+	if (error != B_OK) {
+		fprintf(stderr, "Loading \"%s\" failed: %s\n", path, strerror(error));
+		return error;
+	}
+
+	return B_OK;
+}
+
+
+static void*
+load_packages(void* _data)
+{
+	load_data* data = (load_data*)_data;
+	CountingContentHandler handler;
+
+	while (true) {
+		int32 index = atomic_add(data->nextIndex, 1);
+		if (index >= (int32)data->paths->size())
+			break;
+
+		status_t error = load_package((*data->paths)[index].String(), handler);
+		if (error != B_OK && data->status == B_OK)
+			data->status = error;
+	}
+
+	data->entries = handler.Entries();
+	data->attributes = handler.Attributes();
+	return NULL;
+}
+
+
+static status_t
+run_round(const std::vector<BString>& paths, int32 threadCount,
+	bigtime_t& _duration)
+{
+	std::vector<load_data> data(threadCount);
+	std::vector<pthread_t> threads(threadCount);
+	int32 nextIndex = 0;
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].paths = &paths;
+		data[i].nextIndex = &nextIndex;
+		data[i].entries = 0;
+		data[i].attributes = 0;
+		data[i].status = B_OK;
+	}
+
+	// the first set of data is used by this thread
+	for (int32 i = 1; i < threadCount; i++) {
+		if (pthread_create(&threads[i], NULL, &load_packages, &data[i])
+				!= 0) {
+			threadCount = i;
+			break;
+		}
+	}
+
+	load_packages(&data[0]);
+
+	for (int32 i = 1; i < threadCount; i++)
+		pthread_join(threads[i], NULL);
+
+	_duration = system_time() - start;
+
+	int64 entries = 0;
+	int64 attributes = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		if (data[i].status != B_OK)
+			return data[i].status;
+
+		entries += data[i].entries;
+		attributes += data[i].attributes;
+	}
+
+	printf("  %2" B_PRId32 " threads: %8.1f ms (%" B_PRId64 " entries, %"
+		B_PRId64 " attributes)\n", threadCount, _duration / 1000.0, entries,
+		attributes);
+	return B_OK;
+}
+
+
+static status_t
+read_activation_file(const char* directory, std::vector<BString>& paths)
+{
+	BString filePath;
+	filePath.SetToFormat("%s/%s", directory, kActivationFilePath);
+
+	FILE* file = fopen(filePath.String(), "r");
+	if (file == NULL)
+		return errno;
+
+	char line[B_FILE_NAME_LENGTH + 2];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strcspn(line, "\r\n");
+		if (length == 0)
+			continue;
+
+		line[length] = '\0';
+
+		BString path;
+		path.SetToFormat("%s/%s", directory, line);
+		paths.push_back(path);
+	}
+
+	fclose(file);
+	return B_OK;
+}
+
+
+static status_t
+read_directory(const char* directory, std::vector<BString>& paths)
+{
+	DIR* dir = opendir(directory);
+	if (dir == NULL)
+		return errno;
+
+	while (dirent* entry = readdir(dir)) {
+		size_t length = strlen(entry->d_name);
+		if (length < 5 || strcmp(entry->d_name + length - 5, ".hpkg") != 0)
+			continue;
+
+		BString path;
+		path.SetToFormat("%s/%s", directory, entry->d_name);
+		paths.push_back(path);
+	}
+
+	closedir(dir);
+	return B_OK;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 threadCount = 0;
+	int32 rounds = 3;
+
+	int option;
+	while ((option = getopt(argc, argv, "j:r:h")) != -1) {
+		switch (option) {
+			case 'j':
+				threadCount = strtol(optarg, NULL, 0);
+				break;
+			case 'r':
+				rounds = strtol(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (optind + 1 != argc || rounds < 1)
+		usage(1);
+
+	if (threadCount <= 0) {
+		system_info info;
+		get_system_info(&info);
+		threadCount = info.cpu_count;
+	}
+
+	const char* directory = argv[optind];
+	std::vector<BString> paths;
+	status_t error = read_activation_file(directory, paths);
+	if (error != B_OK)
+		error = read_directory(directory, paths);
+	if (error != B_OK) {
+		fprintf(stderr, "Could not read \"%s\": %s\n", directory,
+			strerror(error));
+		return 1;
+	}
+
+	if (paths.empty()) {
+		fprintf(stderr, "No packages found in \"%s\"\n", directory);
+		return 1;
+	}
+
+	printf("%" B_PRIuSIZE " packages\n", paths.size());
+
+	bigtime_t serialTime = 0;
+	bigtime_t parallelTime = 0;
+	for (int32 i = 0; i < rounds; i++) {
+		printf("round %" B_PRId32 ":\n", i + 1);
+
+		bigtime_t duration;
+		if (run_round(paths, 1, duration) != B_OK)
+			return 1;
+		serialTime += duration;
+
+		if (run_round(paths, threadCount, duration) != B_OK)
+			return 1;
+		parallelTime += duration;
+	}
+
+	if (parallelTime <= 0)
+		parallelTime = 1;
+
+	printf("speedup with %" B_PRId32 " threads: %.2f\n", threadCount,
+		(double)serialTime / parallelTime);
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how long it takes to start (and exit) a program, with lazy
+	binding and with LD_BIND_NOW set. The first run is reported separately, as
+	it is the only one that might have to load the program and its libraries
+	from disk. The program has to terminate on its own, e.g.
+		startupbench -n 50 /boot/system/apps/Debugger --help
+*/
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+extern char** environ;
+
+
+static double
+current_time()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1000000000.0;
+}
+
+
+static double
+run_program(char** argv, int bindNow)
+{
+	double startTime = current_time();
+
+	pid_t child = fork();
+	if (child < 0) {
+		perror("fork");
+		exit(1);
+	}
+
+	if (child == 0) {
+		int devNull;
+
+		if (bindNow)
+			setenv("LD_BIND_NOW", "1", 1);
+		else
+			unsetenv("LD_BIND_NOW");
+
+		// we're only interested in the startup time, not in the output
+		devNull = open("/dev/null", O_WRONLY);
+		if (devNull >= 0) {
+			dup2(devNull, STDOUT_FILENO);
+			dup2(devNull, STDERR_FILENO);
+			close(devNull);
+		}
+
+		execve(argv[0], argv, environ);
+		_exit(127);
+	}
+
+	int status;
+	if (waitpid(child, &status, 0) < 0) {
+		perror("waitpid");
+		exit(1);
+	}
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+		fprintf(stderr, "Failed to execute \"%s\"\n", argv[0]);
+		exit(1);
+	}
+
+	return current_time() - startTime;
+}
+
+
+static void
+usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-n <iterations>] <program> [<arguments>]\n",
+		name);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int iterations = 20;
+	int argIndex = 1;
+	double lazyTime = 0;
+	double bindNowTime = 0;
+	int i;
+
+	if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+		iterations = atoi(argv[2]);
+		argIndex = 3;
+	}
+	if (argIndex >= argc || iterations < 1)
+		usage(argv[0]);
+
+	printf("first run:   %8.2f ms\n", run_program(argv + argIndex, 0) * 1000);
+
+	// alternate between both modes, so that they see the same conditions
+	for (i = 0; i < iterations; i++) {
+		lazyTime += run_program(argv + argIndex, 0);
+		bindNowTime += run_program(argv + argIndex, 1);
+	}
+
+	printf("lazy:        %8.2f ms\n", lazyTime * 1000 / iterations);
+	printf("LD_BIND_NOW: %8.2f ms\n", bindNowTime * 1000 / iterations);
+
+	return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how well the block cache scales when several threads get and
+	put blocks of the same cache concurrently, optionally while another thread
+	changes other blocks of it in transactions.
+	The same source is also built into the fs_shell as the "cachebench"
+	command. Since the fs_shell cannot run threads, the workers are run one
+	after the other there; this is only useful as a baseline.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FS_SHELL
+#	include "fssh.h"
+
+#	include "fssh_api_wrapper.h"
+#else
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+
+#	include <OS.h>
+#	include <fs_cache.h>
+
+#	include <block_cache.h>
+#endif
+
+
+#ifdef FS_SHELL
+namespace FSShell {
+#endif
+
+
+static const size_t kBlockSize = 2048;
+static const int32 kBlocksPerTransaction = 8;
+
+struct worker_data {
+	uint32		seed;
+	int32		iterations;
+	bigtime_t	time;
+	status_t	status;
+};
+
+static void* sCache;
+static int32 sBlocks = 1024;
+
+
+static uint32
+next_random(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+
+/*!	Gets and puts random blocks of the first half of the cache. */
+static status_t
+reader(void* _data)
+{
+	worker_data* data = (worker_data*)_data;
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < data->iterations; i++) {
+		off_t blockNumber = next_random(data->seed) % sBlocks;
+
+		if (block_cache_get(sCache, blockNumber) == NULL) {
+			data->status = B_IO_ERROR;
+			break;
+		}
+		block_cache_put(sCache, blockNumber);
+	}
+
+	data->time = system_time() - start;
+	return B_OK;
+}
+
+
+static status_t
+change_blocks(worker_data* data, int32 transaction, int32 round)
+{
+	for (int32 i = 0; i < kBlocksPerTransaction; i++) {
+		off_t blockNumber = sBlocks + next_random(data->seed) % sBlocks;
+
+		uint8* block = (uint8*)block_cache_get_writable(sCache, blockNumber,
+			transaction);
+		if (block == NULL)
+			return B_IO_ERROR;
+
+		block[0] = (uint8)round;
+		block_cache_put(sCache, blockNumber);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Changes random blocks of the second half of the cache in transactions,
+	so that it only competes with the readers for the cache, not for the
+	blocks themselves.
+*/
+static status_t
+writer(void* _data)
+{
+	worker_data* data = (worker_data*)_data;
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < data->iterations; i++) {
+		int32 transaction = cache_start_transaction(sCache);
+		if (transaction < 0) {
+			data->status = transaction;
+			break;
+		}
+
+		data->status = change_blocks(data, transaction, i);
+		if (data->status != B_OK) {
+			cache_abort_transaction(sCache, transaction);
+			break;
+		}
+
+		cache_end_transaction(sCache, transaction, NULL, NULL);
+	}
+
+	if (data->status == B_OK)
+		data->status = block_cache_sync(sCache);
+
+	data->time = system_time() - start;
+	return B_OK;
+}
+
+
+static status_t
+run_workers(worker_data* data, int32 readers, bool withWriter)
+{
+	int32 count = readers + (withWriter ? 1 : 0);
+
+#ifdef FS_SHELL
+	for (int32 i = 0; i < count; i++) {
+		if (i < readers)
+			reader(&data[i]);
+		else
+			writer(&data[i]);
+	}
+#else
+	thread_id* threads = new thread_id[count];
+
+	for (int32 i = 0; i < count; i++) {
+		threads[i] = spawn_thread(i < readers ? reader : writer,
+			i < readers ? "reader" : "writer", B_NORMAL_PRIORITY, &data[i]);
+		if (threads[i] < 0) {
+			status_t status = threads[i];
+			for (int32 j = 0; j < i; j++)
+				kill_thread(threads[j]);
+
+			delete[] threads;
+			return status;
+		}
+	}
+
+	for (int32 i = 0; i < count; i++)
+		resume_thread(threads[i]);
+
+	for (int32 i = 0; i < count; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	delete[] threads;
+#endif
+
+	for (int32 i = 0; i < count; i++) {
+		if (data[i].status != B_OK)
+			return data[i].status;
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+run_round(int32 readers, int32 iterations, bool withWriter)
+{
+	worker_data* data = new worker_data[readers + 1];
+
+	for (int32 i = 0; i <= readers; i++) {
+		data[i].seed = i + 1;
+		data[i].iterations = i < readers ? iterations : iterations / 100;
+		data[i].time = 0;
+		data[i].status = B_OK;
+	}
+
+	bigtime_t start = system_time();
+	status_t status = run_workers(data, readers, withWriter);
+	bigtime_t duration = system_time() - start;
+
+	if (status != B_OK) {
+		fprintf(stderr, "Running %" B_PRId32 " readers failed: %s\n", readers,
+			strerror(status));
+		delete[] data;
+		return status;
+	}
+
+	bigtime_t readerTime = 0;
+	for (int32 i = 0; i < readers; i++)
+		readerTime += data[i].time;
+
+	delete[] data;
+
+	double operations = (double)readers * iterations;
+	printf("%3" B_PRId32 " readers: %8.1f us total, %8.3f us per get/put, "
+		"%10.0f get/put per second\n", readers, (double)duration,
+		(double)readerTime / operations, operations * 1000000.0 / duration);
+
+	return B_OK;
+}
+
+
+static void
+print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options] <file>\n"
+		"  -t <count>   maximum number of reader threads, default is 8\n"
+		"  -b <count>   number of blocks the readers use, default is 1024\n"
+		"  -n <count>   number of blocks every reader gets, default is "
+			"100000\n"
+		"  -w           let another thread change blocks in transactions\n"
+		"The file is resized to hold twice the number of blocks.\n", name);
+}
+
+
+static status_t
+block_cache_contention(int argc, const char* const* argv)
+{
+	int32 maxReaders = 8;
+	int32 iterations = 100000;
+	bool withWriter = false;
+	const char* path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		if (!strcmp(arg, "-t") && i + 1 < argc)
+			maxReaders = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(arg, "-b") && i + 1 < argc)
+			sBlocks = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(arg, "-n") && i + 1 < argc)
+			iterations = strtol(argv[++i], NULL, 0);
+		else if (!strcmp(arg, "-w"))
+			withWriter = true;
+		else if (arg[0] != '-' && path == NULL)
+			path = arg;
+		else {
+			print_usage(argv[0]);
+			return B_BAD_VALUE;
+		}
+	}
+
+	if (path == NULL || maxReaders < 1 || sBlocks < 1 || iterations < 100) {
+		print_usage(argv[0]);
+		return B_BAD_VALUE;
+	}
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", path, strerror(errno));
+		return errno;
+	}
+
+	off_t numBlocks = 2 * sBlocks;
+	if (ftruncate(fd, numBlocks * kBlockSize) != 0) {
+		status_t status = errno;
+		fprintf(stderr, "Could not resize \"%s\": %s\n", path,
+			strerror(status));
+		close(fd);
+		return status;
+	}
+
+	sCache = block_cache_create(fd, numBlocks, kBlockSize, false);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache\n");
+		close(fd);
+		return B_NO_MEMORY;
+	}
+
+	// read in all blocks, so that we only measure cached accesses
+	status_t status = B_OK;
+	for (off_t i = 0; i < numBlocks; i++) {
+		if (block_cache_get(sCache, i) == NULL) {
+			fprintf(stderr, "Could not read block %" B_PRIdOFF "\n", i);
+			status = B_IO_ERROR;
+			break;
+		}
+		block_cache_put(sCache, i);
+	}
+
+	printf("%" B_PRId32 " blocks, %" B_PRId32 " get/put per reader%s\n\n",
+		sBlocks, iterations, withWriter ? ", with writer" : "");
+
+	for (int32 readers = 1; status == B_OK && readers <= maxReaders;
+			readers *= 2) {
+		status = run_round(readers, iterations, withWriter);
+	}
+
+	block_cache_delete(sCache, true);
+	close(fd);
+
+	return status;
+}
+
+
+#ifdef FS_SHELL
+
+
+fssh_status_t
+command_cachebench(int argc, const char* const* argv)
+{
+	return block_cache_contention(argc, argv);
+}
+
+
+}	// namespace FSShell
+
+
+#else	// !FS_SHELL
+
+
+int
+main(int argc, char** argv)
+{
+	status_t status = block_cache_init();
+	if (status != B_OK) {
+		fprintf(stderr, "Could not initialize block cache: %s\n",
+			strerror(status));
+		return 1;
+	}
+
+	return block_cache_contention(argc, argv) == B_OK ? 0 : 1;
+}
+
+
+#endif	// !FS_SHELL
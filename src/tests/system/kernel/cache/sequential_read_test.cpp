@@ -0,0 +1,173 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the throughput of sequentially writing and reading a file
+	through the file cache. To see the effect of the read-ahead and
+	write-behind rather than that of the disk, run it on a BFS volume that
+	has been initialized on a RAM disk.
+	The cached pages of the file are dropped between writing and reading
+	it, so that the reads actually have to go to the device.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+static const off_t kDefaultFileSize = 256 * 1024 * 1024LL;
+static const size_t kDefaultBufferSize = 16 * 1024;
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: sequential_read_test [options] <file>\n"
+		"  -s <MB>      size of the file to write, default is 256\n"
+		"  -b <kB>      size of the read and write buffer, default is 16\n"
+		"  -a <advice>  \"normal\", \"sequential\", or \"random\"\n"
+		"  -r           only read the existing file\n");
+	exit(exitCode);
+}
+
+
+static void
+print_result(const char* what, off_t bytes, bigtime_t duration)
+{
+	if (duration <= 0)
+		duration = 1;
+
+	printf("%-6s %8.1f MB in %8.1f ms: %8.1f MB/s\n", what,
+		bytes / 1048576.0, duration / 1000.0,
+		bytes / 1048576.0 / (duration / 1000000.0));
+}
+
+
+int
+main(int argc, char** argv)
+{
+	off_t fileSize = kDefaultFileSize;
+	size_t bufferSize = kDefaultBufferSize;
+	int advice = POSIX_FADV_NORMAL;
+	bool readOnly = false;
+
+	int option;
+	while ((option = getopt(argc, argv, "s:b:a:rh")) != -1) {
+		switch (option) {
+			case 's':
+				fileSize = strtoll(optarg, NULL, 0) * 1024 * 1024;
+				break;
+			case 'b':
+				bufferSize = strtoul(optarg, NULL, 0) * 1024;
+				break;
+			case 'a':
+				if (!strcmp(optarg, "normal"))
+					advice = POSIX_FADV_NORMAL;
+				else if (!strcmp(optarg, "sequential"))
+					advice = POSIX_FADV_SEQUENTIAL;
+				else if (!strcmp(optarg, "random"))
+					advice = POSIX_FADV_RANDOM;
+				else
+					usage(1);
+				break;
+			case 'r':
+				readOnly = true;
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (optind + 1 != argc || fileSize <= 0 || bufferSize == 0)
+		usage(1);
+
+	const char* path = argv[optind];
+
+	char* buffer = (char*)malloc(bufferSize);
+	if (buffer == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	memset(buffer, 0x55, bufferSize);
+
+	int fd = open(path, readOnly ? O_RDONLY : O_RDWR | O_CREAT | O_TRUNC,
+		0644);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	status_t status = posix_fadvise(fd, 0, 0, advice);
+	if (status != 0) {
+		fprintf(stderr, "posix_fadvise() failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	if (!readOnly) {
+		bigtime_t start = system_time();
+
+		for (off_t written = 0; written < fileSize;) {
+			size_t toWrite = bufferSize;
+			if ((off_t)toWrite > fileSize - written)
+				toWrite = fileSize - written;
+
+			ssize_t bytesWritten = write(fd, buffer, toWrite);
+			if (bytesWritten <= 0) {
+				fprintf(stderr, "Writing failed: %s\n", strerror(errno));
+				return 1;
+			}
+			written += bytesWritten;
+		}
+
+		// the write is only complete when the data has reached the device
+		fsync(fd);
+		print_result("write", fileSize, system_time() - start);
+	} else {
+		struct stat stat;
+		if (fstat(fd, &stat) != 0) {
+			fprintf(stderr, "Could not stat \"%s\": %s\n", path,
+				strerror(errno));
+			return 1;
+		}
+		fileSize = stat.st_size;
+	}
+
+	// drop the file's pages from the cache
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	lseek(fd, 0, SEEK_SET);
+
+	bigtime_t start = system_time();
+	off_t bytesTotal = 0;
+
+	while (true) {
+		ssize_t bytesRead = read(fd, buffer, bufferSize);
+		if (bytesRead < 0) {
+			fprintf(stderr, "Reading failed: %s\n", strerror(errno));
+			return 1;
+		}
+		if (bytesRead == 0)
+			break;
+
+		bytesTotal += bytesRead;
+	}
+
+	print_result("read", bytesTotal, system_time() - start);
+
+	close(fd);
+	free(buffer);
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Compares waiting for a few active connections among many idle ones with
+	poll(), and with an event queue. Pipes stand in for the connections, so
+	that the network stack does not influence the results.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+static const int kDefaultConnections = 10000;
+static const int kDefaultActive = 10;
+static const int kDefaultRounds = 1000;
+
+static int* sReadFDs;
+static int* sWriteFDs;
+static int sConnections = kDefaultConnections;
+static int sActive = kDefaultActive;
+static int sRounds = kDefaultRounds;
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: event_queue_benchmark [options]\n"
+		"  -c <count>   number of connections\n"
+		"  -a <count>   number of active connections per round\n"
+		"  -r <count>   number of rounds\n");
+	exit(exitCode);
+}
+
+
+static void
+make_active(int round)
+{
+	// the active connections differ between the rounds
+	for (int i = 0; i < sActive; i++) {
+		int index = (round * 7919 + i * 104729) % sConnections;
+		if (write(sWriteFDs[index], "", 1) != 1) {
+			fprintf(stderr, "write() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+}
+
+
+/*!	Returns the number of writes to the connection that were consumed. */
+static int
+consume(int fd)
+{
+	char buffer[16];
+	ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+	return bytesRead > 0 ? bytesRead : 0;
+}
+
+
+static bigtime_t
+run_poll()
+{
+	pollfd* fds = new pollfd[sConnections];
+	for (int i = 0; i < sConnections; i++) {
+		fds[i].fd = sReadFDs[i];
+		fds[i].events = POLLIN;
+	}
+
+	bigtime_t start = system_time();
+
+	for (int round = 0; round < sRounds; round++) {
+		make_active(round);
+
+		int pending = sActive;
+		while (pending > 0) {
+			int count = poll(fds, sConnections, -1);
+			if (count < 0) {
+				fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+				exit(1);
+			}
+
+			for (int i = 0; i < sConnections && count > 0; i++) {
+				if ((fds[i].revents & POLLIN) == 0)
+					continue;
+
+				pending -= consume(fds[i].fd);
+				count--;
+			}
+		}
+	}
+
+	bigtime_t duration = system_time() - start;
+
+	delete[] fds;
+	return duration;
+}
+
+
+static bigtime_t
+run_event_queue()
+{
+	int queue = create_event_queue(O_CLOEXEC);
+	if (queue < 0) {
+		fprintf(stderr, "create_event_queue() failed: %s\n",
+			strerror(queue));
+		exit(1);
+	}
+
+	event_wait_info* infos = new event_wait_info[sConnections];
+	for (int i = 0; i < sConnections; i++) {
+		infos[i].object = sReadFDs[i];
+		infos[i].type = B_OBJECT_TYPE_FD;
+		infos[i].events = B_EVENT_READ;
+		infos[i].user_data = (void*)(addr_t)i;
+	}
+
+	bigtime_t start = system_time();
+
+	// registering is part of the cost
+	status_t status = event_queue_select(queue, infos, sConnections);
+	if (status != B_OK) {
+		fprintf(stderr, "event_queue_select() failed: %s\n",
+			strerror(status));
+		exit(1);
+	}
+
+	for (int round = 0; round < sRounds; round++) {
+		make_active(round);
+
+		int pending = sActive;
+		while (pending > 0) {
+			ssize_t count = event_queue_wait(queue, infos, sConnections, 0,
+				0);
+			if (count < 0) {
+				fprintf(stderr, "event_queue_wait() failed: %s\n",
+					strerror(count));
+				exit(1);
+			}
+
+			for (ssize_t i = 0; i < count; i++) {
+				int index = (addr_t)infos[i].user_data;
+				if (infos[i].object != sReadFDs[index]) {
+					fprintf(stderr, "wrong user data returned!\n");
+					exit(1);
+				}
+
+				pending -= consume(sReadFDs[index]);
+			}
+		}
+	}
+
+	bigtime_t duration = system_time() - start;
+
+	close(queue);
+	delete[] infos;
+	return duration;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int option;
+	while ((option = getopt(argc, argv, "c:a:r:h")) != -1) {
+		switch (option) {
+			case 'c':
+				sConnections = strtol(optarg, NULL, 0);
+				break;
+			case 'a':
+				sActive = strtol(optarg, NULL, 0);
+				break;
+			case 'r':
+				sRounds = strtol(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (sConnections < 1 || sActive < 1 || sActive > sConnections
+		|| sRounds < 1) {
+		usage(1);
+	}
+
+	rlimit limit;
+	getrlimit(RLIMIT_NOFILE, &limit);
+	limit.rlim_cur = 2 * sConnections + 64;
+	if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		fprintf(stderr, "Could not allow %d descriptors: %s\n",
+			2 * sConnections, strerror(errno));
+		return 1;
+	}
+
+	sReadFDs = new int[sConnections];
+	sWriteFDs = new int[sConnections];
+
+	for (int i = 0; i < sConnections; i++) {
+		int fds[2];
+		if (pipe(fds) != 0) {
+			fprintf(stderr, "pipe() failed: %s\n", strerror(errno));
+			return 1;
+		}
+
+		fcntl(fds[0], F_SETFL, O_NONBLOCK);
+		sReadFDs[i] = fds[0];
+		sWriteFDs[i] = fds[1];
+	}
+
+	printf("%d connections, %d active per round, %d rounds\n\n",
+		sConnections, sActive, sRounds);
+
+	bigtime_t pollTime = run_poll();
+	printf("poll():        %10.1f us per round\n",
+		(double)pollTime / sRounds);
+
+	bigtime_t queueTime = run_event_queue();
+	printf("event queue:   %10.1f us per round\n",
+		(double)queueTime / sRounds);
+
+	for (int i = 0; i < sConnections; i++) {
+		close(sReadFDs[i]);
+		close(sWriteFDs[i]);
+	}
+
+	delete[] sReadFDs;
+	delete[] sWriteFDs;
+	return 0;
+}
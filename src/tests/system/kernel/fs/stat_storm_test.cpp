@@ -0,0 +1,238 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how well path resolution scales by letting an increasing number
+	of threads stat() the same set of paths, like compilers do when searching
+	their include paths. Every thread also stat()s a few entries that don't
+	exist, since most lookups of a header search fail.
+	The paths are taken from the given directories; they are looked up once
+	before measuring, so that only cached lookups are measured.
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <OS.h>
+
+
+static const int32 kMaxPaths = 4096;
+
+struct worker_data {
+	int32		first;
+	int32		iterations;
+	int32		failed;
+	bigtime_t	time;
+};
+
+static char* sPaths[kMaxPaths];
+static int32 sPathCount;
+
+
+static void
+usage(int exitCode)
+{
+	fprintf(stderr, "Usage: stat_storm_test [options] <directory>...\n"
+		"  -t <count>   maximum number of threads, default is 8\n"
+		"  -n <count>   number of stat() calls per thread, default is "
+			"100000\n");
+	exit(exitCode);
+}
+
+
+static void
+add_path(const char* directory, const char* name)
+{
+	if (sPathCount == kMaxPaths)
+		return;
+
+	char* path;
+	if (asprintf(&path, "%s/%s", directory, name) < 0)
+		return;
+
+	sPaths[sPathCount++] = path;
+}
+
+
+static status_t
+add_directory(const char* directory)
+{
+	DIR* dir = opendir(directory);
+	if (dir == NULL) {
+		fprintf(stderr, "Could not open \"%s\": %s\n", directory,
+			strerror(errno));
+		return errno;
+	}
+
+	int32 count = 0;
+	while (dirent* entry = readdir(dir)) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+
+		add_path(directory, entry->d_name);
+
+		// add a missing entry for every few existing ones
+		if (++count % 4 == 0) {
+			char name[B_FILE_NAME_LENGTH];
+			snprintf(name, sizeof(name), "%s.missing", entry->d_name);
+			add_path(directory, name);
+		}
+	}
+
+	closedir(dir);
+	return B_OK;
+}
+
+
+static status_t
+worker(void* _data)
+{
+	worker_data* data = (worker_data*)_data;
+	bigtime_t start = system_time();
+
+	int32 index = data->first;
+	for (int32 i = 0; i < data->iterations; i++) {
+		struct stat st;
+		if (stat(sPaths[index], &st) != 0)
+			data->failed++;
+
+		if (++index == sPathCount)
+			index = 0;
+	}
+
+	data->time = system_time() - start;
+	return B_OK;
+}
+
+
+static status_t
+run_round(int32 threadCount, int32 iterations)
+{
+	worker_data* data = new worker_data[threadCount];
+	thread_id* threads = new thread_id[threadCount];
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].first = i * sPathCount / threadCount;
+		data[i].iterations = iterations;
+		data[i].failed = 0;
+		data[i].time = 0;
+	}
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(worker, "stat worker", B_NORMAL_PRIORITY,
+			&data[i]);
+		if (threads[i] < 0) {
+			status_t status = threads[i];
+			for (int32 j = 0; j < i; j++)
+				kill_thread(threads[j]);
+
+			delete[] threads;
+			delete[] data;
+			return status;
+		}
+	}
+
+	bigtime_t start = system_time();
+
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	bigtime_t duration = system_time() - start;
+	if (duration <= 0)
+		duration = 1;
+
+	bigtime_t workerTime = 0;
+	int32 failed = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		workerTime += data[i].time;
+		failed += data[i].failed;
+	}
+
+	delete[] threads;
+	delete[] data;
+
+	double operations = (double)threadCount * iterations;
+	printf("%3" B_PRId32 " threads: %8.3f us per stat(), %10.0f stat() per "
+		"second (%.0f %% missing)\n", threadCount,
+		(double)workerTime / operations, operations * 1000000.0 / duration,
+		failed * 100.0 / operations);
+
+	return B_OK;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 8;
+	int32 iterations = 100000;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:n:h")) != -1) {
+		switch (option) {
+			case 't':
+				maxThreads = strtol(optarg, NULL, 0);
+				break;
+			case 'n':
+				iterations = strtol(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (optind >= argc || maxThreads < 1 || iterations < 1)
+		usage(1);
+
+	for (int i = optind; i < argc; i++) {
+		if (add_directory(argv[i]) != B_OK)
+			return 1;
+	}
+
+	if (sPathCount == 0) {
+		fprintf(stderr, "No entries found\n");
+		return 1;
+	}
+
+	// warm up the caches
+	for (int32 i = 0; i < sPathCount; i++) {
+		struct stat st;
+		stat(sPaths[i], &st);
+	}
+
+	printf("%" B_PRId32 " paths, %" B_PRId32 " stat() per thread\n\n",
+		sPathCount, iterations);
+
+	status_t status = B_OK;
+	for (int32 threads = 1; status == B_OK && threads <= maxThreads;
+			threads *= 2) {
+		status = run_round(threads, iterations);
+	}
+
+	for (int32 i = 0; i < sPathCount; i++)
+		free(sPaths[i]);
+
+	if (status != B_OK) {
+		fprintf(stderr, "Running the threads failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	return 0;
+}
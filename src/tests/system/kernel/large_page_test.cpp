@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Exercises areas created with the B_LARGE_PAGES hint: first, it checks
+	that a single write populated a whole large page, which only happens when
+	it has actually been mapped as one. Then the whole area is
+	written and verified, then its protection is changed and part of it is
+	unmapped (forcing a large page to be split), and the remaining contents are
+	verified again. Finally, a random access pass over the area is timed once
+	for a normal and once for a large page area.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static const size_t kLargePageSize = 2 * 1024 * 1024;
+static const size_t kAreaSize = 16 * kLargePageSize;
+static const int32 kAccessCount = 16 * 1024 * 1024;
+
+
+static void
+fill(uint32* address, size_t size)
+{
+	for (size_t i = 0; i < size / sizeof(uint32); i++)
+		address[i] = (uint32)i ^ 0x5a5a5a5a;
+}
+
+
+static bool
+verify(const uint32* address, size_t offset, size_t size)
+{
+	size_t end = (offset + size) / sizeof(uint32);
+	for (size_t i = offset / sizeof(uint32); i < end; i++) {
+		if (address[i] != ((uint32)i ^ 0x5a5a5a5a)) {
+			fprintf(stderr, "Mismatch at offset %#" B_PRIxSIZE "\n",
+				i * sizeof(uint32));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static bigtime_t
+time_random_access(uint32 protectionFlags)
+{
+	uint8* address;
+	area_id area = create_area("large page timing", (void**)&address,
+		B_ANY_ADDRESS, kAreaSize, B_NO_LOCK,
+		B_READ_AREA | B_WRITE_AREA | protectionFlags);
+	if (area < 0) {
+		fprintf(stderr, "Creating the area failed: %s\n", strerror(area));
+		exit(1);
+	}
+
+	memset(address, 1, kAreaSize);
+
+	uint32 seed = 42;
+	uint32 sum = 0;
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < kAccessCount; i++) {
+		seed = seed * 1103515245 + 12345;
+		sum += address[(seed >> 4) % kAreaSize];
+	}
+	bigtime_t elapsed = system_time() - startTime;
+
+	delete_area(area);
+
+	if (sum != (uint32)kAccessCount) {
+		fprintf(stderr, "Unexpected checksum %" B_PRIu32 "\n", sum);
+		exit(1);
+	}
+
+	return elapsed;
+}
+
+
+int
+main()
+{
+	uint32* address;
+	area_id area = create_area("large page test", (void**)&address,
+		B_ANY_ADDRESS, kAreaSize, B_NO_LOCK,
+		B_READ_AREA | B_WRITE_AREA | B_LARGE_PAGES);
+	if (area < 0) {
+		fprintf(stderr, "Creating the area failed: %s\n", strerror(area));
+		return 1;
+	}
+
+	if ((addr_t)address % kLargePageSize != 0) {
+		fprintf(stderr, "The area at %p is not large page aligned\n",
+			address);
+		return 1;
+	}
+
+	// A fault in a large page area populates the whole large page at once,
+	// while the fallback to normal pages only adds a single page.
+	address[0] = 1;
+
+	area_info info;
+	if (get_area_info(area, &info) != B_OK) {
+		fprintf(stderr, "Getting the area info failed\n");
+		return 1;
+	}
+	if (info.ram_size != kLargePageSize) {
+		fprintf(stderr, "No large page was mapped (%" B_PRIuSIZE " bytes "
+			"populated after the first fault)\n", info.ram_size);
+		return 1;
+	}
+
+	fill(address, kAreaSize);
+	if (!verify(address, 0, kAreaSize))
+		return 1;
+
+	// change the protection of the whole area back and forth, which keeps
+	// the large pages intact
+	uint8* base = (uint8*)address;
+	if (set_area_protection(area, B_READ_AREA) != B_OK
+		|| set_area_protection(area, B_READ_AREA | B_WRITE_AREA) != B_OK) {
+		fprintf(stderr, "Changing the area protection failed\n");
+		return 1;
+	}
+
+	// shrink the area, so that its last large page is partially unmapped
+	size_t newSize = kAreaSize - kLargePageSize / 2;
+	status_t status = resize_area(area, newSize);
+	if (status != B_OK) {
+		fprintf(stderr, "Resizing the area failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	if (!verify(address, 0, newSize))
+		return 1;
+
+	// write again after the split
+	memset(base + newSize - B_PAGE_SIZE, 0, B_PAGE_SIZE);
+	if (!verify(address, 0, newSize - B_PAGE_SIZE))
+		return 1;
+
+	delete_area(area);
+
+	bigtime_t normalTime = time_random_access(0);
+	bigtime_t largeTime = time_random_access(B_LARGE_PAGES);
+	printf("random access: normal pages %" B_PRIdBIGTIME " us, large pages %"
+		B_PRIdBIGTIME " us\n", normalTime, largeTime);
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Runs the given command and prints how often the kernel's mutexes and
+	rw_locks as well as the user mutexes (pthread mutexes etc.) were
+	contended in the meantime, and how the contention was resolved.
+	Without a command, the totals since boot are printed.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <lock_contention.h>
+#include <syscalls.h>
+
+
+static void
+get_contention_info(lock_contention_info& info)
+{
+	status_t error = _kern_generic_syscall(LOCK_CONTENTION,
+		GET_LOCK_CONTENTION_INFO, &info, sizeof(info));
+	if (error != B_OK) {
+		fprintf(stderr, "Error: Failed to get lock contention info: %s\n",
+			strerror(error));
+		exit(1);
+	}
+}
+
+
+static void
+print_stats(const char* name, const lock_contention_stats& start,
+	const lock_contention_stats& end)
+{
+	int64 contended = end.contended - start.contended;
+	int64 spinAcquired = end.spin_acquired - start.spin_acquired;
+	int64 blocked = end.blocked - start.blocked;
+
+	printf("%-12s  %12" B_PRId64 "  %12" B_PRId64 "  %12" B_PRId64 "  %6.2f\n",
+		name, contended, spinAcquired, blocked,
+		contended > 0 ? spinAcquired * 100.0 / contended : 0.0);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	lock_contention_info startInfo;
+	memset(&startInfo, 0, sizeof(startInfo));
+
+	if (argc > 1) {
+		get_contention_info(startInfo);
+
+		pid_t child = fork();
+		if (child < 0) {
+			fprintf(stderr, "Error: fork() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+
+		if (child == 0) {
+			execvp(argv[1], argv + 1);
+			fprintf(stderr, "Error: exec() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+
+		int status;
+		wait(&status);
+	}
+
+	lock_contention_info endInfo;
+	get_contention_info(endInfo);
+
+	printf("\nlock             contended      spinning       blocked"
+		"  spin %%\n");
+	printf("---------------------------------------------------------------\n");
+	print_stats("mutex", startInfo.mutexes, endInfo.mutexes);
+	print_stats("rw_lock", startInfo.rw_locks, endInfo.rw_locks);
+	print_stats("user mutex", startInfo.user_mutexes, endInfo.user_mutexes);
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how the page fault throughput scales with the number of CPUs.
+	For each thread count from 1 to the number of CPUs, every thread
+	repeatedly creates an anonymous area, touches all of its pages (thus
+	faulting in and allocating a fresh page each time), and deletes it again
+	(freeing the pages). The aggregated page faults per second are printed.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static const int32 kAreaPagesCount = 1024;		// 4 MB
+static const bigtime_t kDefaultRunTime = 2000000;	// 2 s
+
+
+struct thread_data {
+	bigtime_t	end_time;
+	int64		faults;
+	status_t	error;
+};
+
+
+static status_t
+fault_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+
+	while (system_time() < data->end_time) {
+		uint8* address;
+		area_id area = create_area("page fault test", (void**)&address,
+			B_ANY_ADDRESS, kAreaPagesCount * B_PAGE_SIZE, B_NO_LOCK,
+			B_READ_AREA | B_WRITE_AREA);
+		if (area < 0) {
+			data->error = area;
+			return area;
+		}
+
+		for (int32 i = 0; i < kAreaPagesCount; i++)
+			address[i * B_PAGE_SIZE] = 42;
+
+		delete_area(area);
+		data->faults += kAreaPagesCount;
+	}
+
+	return B_OK;
+}
+
+
+static double
+run_test(int32 threadCount, bigtime_t runTime)
+{
+	thread_id threads[B_MAX_CPU_COUNT];
+	thread_data data[B_MAX_CPU_COUNT];
+
+	bigtime_t startTime = system_time();
+	bigtime_t endTime = startTime + runTime;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].end_time = endTime;
+		data[i].faults = 0;
+		data[i].error = B_OK;
+
+		threads[i] = spawn_thread(&fault_thread, "page fault thread",
+			B_NORMAL_PRIORITY, &data[i]);
+		if (threads[i] < 0) {
+			fprintf(stderr, "Failed to spawn thread: %s\n",
+				strerror(threads[i]));
+			exit(1);
+		}
+	}
+
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+
+	int64 faults = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+
+		if (data[i].error != B_OK) {
+			fprintf(stderr, "Creating the area failed: %s\n",
+				strerror(data[i].error));
+			exit(1);
+		}
+
+		faults += data[i].faults;
+	}
+
+	bigtime_t elapsed = system_time() - startTime;
+	return faults * 1000000.0 / elapsed;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	bigtime_t runTime = kDefaultRunTime;
+	if (argc > 1)
+		runTime = atoi(argv[1]) * 1000LL;
+
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = info.cpu_count;
+	if (argc > 2)
+		maxThreads = atoi(argv[2]);
+	if (maxThreads < 1 || maxThreads > B_MAX_CPU_COUNT)
+		maxThreads = info.cpu_count;
+
+	printf("threads  faults/s       per thread  scaling\n");
+
+	double singleRate = 0;
+	for (int32 threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		double rate = run_test(threadCount, runTime);
+		if (threadCount == 1)
+			singleRate = rate;
+
+		printf("%7" B_PRId32 "  %12.0f  %11.0f  %6.2f\n", threadCount, rate,
+			rate / threadCount, singleRate > 0 ? rate / singleRate : 0);
+	}
+
+	return 0;
+}
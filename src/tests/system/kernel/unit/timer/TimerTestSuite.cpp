@@ -0,0 +1,20 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "TimerTestSuite.h"
+
+#include "TimerTests.h"
+
+
+TestSuite*
+create_timer_test_suite()
+{
+	TestSuite* suite = new(std::nothrow) TestSuite("timer");
+
+	ADD_TEST(suite, create_kernel_timer_test_suite());
+
+	return suite;
+}
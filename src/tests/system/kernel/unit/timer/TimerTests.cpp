@@ -0,0 +1,301 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "TimerTests.h"
+
+#include <string.h>
+
+#include <KernelExport.h>
+
+#include <AutoDeleter.h>
+#include <smp.h>
+#include <timer.h>
+
+#include "TestThread.h"
+
+
+static const int32 kMaxStressThreads = 8;
+static const int32 kStressTimerCount = 4096;
+static const int32 kStressOperations = 1000000;
+	// per thread
+static const bigtime_t kShortTimeout = 2000;
+static const bigtime_t kMaxTimerDelay = 1000000;
+	// how late a timer may fire at worst, even on a busy machine
+
+
+enum {
+	TIMER_IDLE = 0,
+	TIMER_ARMED,
+	TIMER_FIRED
+};
+
+
+struct TestTimer : timer {
+	volatile int32	state;
+	bool			short_timeout;
+};
+
+
+class KernelTimerTest : public StandardTestDelegate {
+public:
+	KernelTimerTest()
+	{
+	}
+
+	virtual status_t Setup(TestContext& context)
+	{
+		fEarlyCount = 0;
+		fFireCount = 0;
+		fTestOK = true;
+		return B_OK;
+	}
+
+	bool TestOneShot(TestContext& context)
+	{
+		const int32 count = 64;
+		TestTimer timers[count];
+
+		bigtime_t startTime = system_time();
+		for (int32 i = 0; i < count; i++)
+			_Arm(timers[i], (i % 8) * 1000 + i * 37, B_ONE_SHOT_RELATIVE_TIMER);
+
+		snooze(8000 + count * 37 + kMaxTimerDelay / 10);
+
+		for (int32 i = 0; i < count; i++) {
+			TEST_ASSERT_PRINT(timers[i].state == TIMER_FIRED,
+				"timer %" B_PRId32 " did not fire, scheduled at %" B_PRId64
+				", start %" B_PRId64 ", now %" B_PRId64, i,
+				timers[i].schedule_time, startTime, system_time());
+			TEST_ASSERT(cancel_timer(&timers[i]));
+		}
+
+		TEST_ASSERT(fEarlyCount == 0);
+		TEST_ASSERT(fFireCount == count);
+
+		return true;
+	}
+
+	bool TestAbsolute(TestContext& context)
+	{
+		TestTimer timers[3];
+
+		bigtime_t now = system_time();
+		_Arm(timers[0], now - 1000, B_ONE_SHOT_ABSOLUTE_TIMER);
+		_Arm(timers[1], now + 5000, B_ONE_SHOT_ABSOLUTE_TIMER);
+		_Arm(timers[2], now + 10000, B_ONE_SHOT_ABSOLUTE_TIMER);
+
+		snooze(5000);
+		TEST_ASSERT(timers[0].state == TIMER_FIRED);
+
+		snooze(5000 + kMaxTimerDelay / 10);
+		TEST_ASSERT(timers[1].state == TIMER_FIRED);
+		TEST_ASSERT(timers[2].state == TIMER_FIRED);
+		TEST_ASSERT(fEarlyCount == 0);
+
+		return true;
+	}
+
+	bool TestCancel(TestContext& context)
+	{
+		const int32 count = 64;
+		TestTimer timers[count];
+
+		// spread the timers over all levels of the wheel, including the
+		// overflow list
+		bigtime_t delay = 10000;
+		for (int32 i = 0; i < count; i++) {
+			_Arm(timers[i], delay, B_ONE_SHOT_RELATIVE_TIMER);
+			delay += delay / 2;
+		}
+
+		for (int32 i = 0; i < count; i++) {
+			TEST_ASSERT_PRINT(!cancel_timer(&timers[i]),
+				"timer %" B_PRId32 ", scheduled at %" B_PRId64, i,
+				timers[i].schedule_time);
+			TEST_ASSERT(timers[i].state == TIMER_ARMED);
+		}
+
+		// canceling them again must not do any harm
+		for (int32 i = 0; i < count; i++)
+			TEST_ASSERT(cancel_timer(&timers[i]));
+
+		TEST_ASSERT(fFireCount == 0);
+
+		return true;
+	}
+
+	bool TestPeriodic(TestContext& context)
+	{
+		TestTimer event;
+		_Arm(event, 1000, B_PERIODIC_TIMER);
+
+		snooze(50000);
+		cancel_timer(&event);
+
+		int32 fireCount = fFireCount;
+		TEST_ASSERT_PRINT(fireCount >= 10 && fireCount <= 51,
+			"fired %" B_PRId32 " times", fireCount);
+
+		snooze(10000);
+		TEST_ASSERT(fFireCount == fireCount);
+		TEST_ASSERT(fEarlyCount == 0);
+
+		return true;
+	}
+
+	bool TestStress(TestContext& context)
+	{
+		int32 threadCount = min_c(smp_get_num_cpus() * 2, kMaxStressThreads);
+		thread_id threads[kMaxStressThreads];
+
+		for (int32 i = 0; i < threadCount; i++) {
+			threads[i] = SpawnThread(this, &KernelTimerTest::TestStressThread,
+				"timer stress test", B_NORMAL_PRIORITY, (void*)(addr_t)i);
+			if (threads[i] < 0) {
+				fTestOK = false;
+				context.Error("Failed to spawn thread: %s\n",
+					strerror(threads[i]));
+				threadCount = i;
+				break;
+			}
+		}
+
+		for (int32 i = 0; i < threadCount; i++)
+			resume_thread(threads[i]);
+
+		for (int32 i = 0; i < threadCount; i++)
+			wait_for_thread(threads[i], NULL);
+
+		TEST_ASSERT_PRINT(fEarlyCount == 0,
+			"%" B_PRId32 " timers fired early", fEarlyCount);
+
+		return fTestOK;
+	}
+
+	// thread function wrappers
+
+	void TestStressThread(TestContext& context, void* _index)
+	{
+		if (!_TestStressThread(context, (addr_t)_index))
+			fTestOK = false;
+	}
+
+private:
+	bool _TestStressThread(TestContext& context, int32 threadIndex)
+	{
+		TestTimer* timers = new(std::nothrow) TestTimer[kStressTimerCount];
+		TEST_ASSERT(timers != NULL);
+		ArrayDeleter<TestTimer> timersDeleter(timers);
+		memset(timers, 0, sizeof(TestTimer) * kStressTimerCount);
+
+		uint32 random = (threadIndex + 1) * 2654435761U;
+
+		for (int32 i = 0; fTestOK && i < kStressOperations; i++) {
+			TestTimer& event = timers[_Random(random) % kStressTimerCount];
+
+			if (event.state == TIMER_IDLE) {
+				// Most timers are short, so that they actually fire, the rest
+				// is spread from milliseconds to beyond the range of the
+				// wheel.
+				uint32 value = _Random(random);
+				bigtime_t delay;
+				switch (value % 4) {
+					case 0:
+					case 1:
+						delay = value % kShortTimeout;
+						break;
+					case 2:
+						delay = value % 1000000;
+						break;
+					default:
+						delay = (bigtime_t)value * 32;
+						break;
+				}
+
+				_Arm(event, delay, B_ONE_SHOT_RELATIVE_TIMER);
+				event.short_timeout = delay < kShortTimeout;
+				continue;
+			}
+
+			// Cancel the timer -- either it has fired already, or it is
+			// guaranteed not to fire anymore.
+			int32 state = event.state;
+			bool fired = cancel_timer(&event);
+			TEST_ASSERT_PRINT(fired == (event.state == TIMER_FIRED),
+				"cancel_timer() returned %d, state before %" B_PRId32
+				", after %" B_PRId32, fired, state, event.state);
+
+			event.state = TIMER_IDLE;
+		}
+
+		// all short timers must have fired by now
+		snooze(kShortTimeout + kMaxTimerDelay);
+
+		bigtime_t now = system_time();
+		for (int32 i = 0; i < kStressTimerCount; i++) {
+			TestTimer& event = timers[i];
+			if (event.state == TIMER_IDLE)
+				continue;
+
+			bool fired = cancel_timer(&event);
+			TEST_ASSERT(fired == (event.state == TIMER_FIRED));
+			TEST_ASSERT_PRINT(fired || !event.short_timeout,
+				"short timer did not fire, scheduled at %" B_PRId64 ", now %"
+				B_PRId64, event.schedule_time, now);
+		}
+
+		return true;
+	}
+
+	void _Arm(TestTimer& event, bigtime_t time, uint32 mode)
+	{
+		event.state = TIMER_ARMED;
+		event.user_data = this;
+		add_timer(&event, &_TimerHook, time, mode);
+	}
+
+	static int32 _TimerHook(timer* _event)
+	{
+		TestTimer* event = static_cast<TestTimer*>(_event);
+		KernelTimerTest* test = (KernelTimerTest*)event->user_data;
+
+		if (system_time() < event->schedule_time)
+			atomic_add(&test->fEarlyCount, 1);
+		atomic_add(&test->fFireCount, 1);
+
+		event->state = TIMER_FIRED;
+		return B_HANDLED_INTERRUPT;
+	}
+
+	static uint32 _Random(uint32& state)
+	{
+		// xorshift
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+private:
+			int32		fEarlyCount;
+			int32		fFireCount;
+	volatile bool		fTestOK;
+};
+
+
+TestSuite*
+create_kernel_timer_test_suite()
+{
+	TestSuite* suite = new(std::nothrow) TestSuite("kernel_timer");
+
+	ADD_STANDARD_TEST(suite, KernelTimerTest, TestOneShot);
+	ADD_STANDARD_TEST(suite, KernelTimerTest, TestAbsolute);
+	ADD_STANDARD_TEST(suite, KernelTimerTest, TestCancel);
+	ADD_STANDARD_TEST(suite, KernelTimerTest, TestPeriodic);
+	ADD_STANDARD_TEST(suite, KernelTimerTest, TestStress);
+
+	return suite;
+}
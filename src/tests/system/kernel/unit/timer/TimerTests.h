@@ -0,0 +1,15 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef TIMER_TESTS_H
+#define TIMER_TESTS_H
+
+
+#include "TestSuite.h"
+
+
+TestSuite* create_kernel_timer_test_suite();
+
+
+#endif	// TIMER_TESTS_H
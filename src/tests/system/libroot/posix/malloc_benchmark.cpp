@@ -0,0 +1,277 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the throughput of malloc() and free() for a few typical patterns
+	of multi-threaded applications:
+	- churn: every thread allocates and frees small blocks on its own.
+	- producer/consumer: pairs of threads, where one thread allocates blocks
+	  and passes them through a queue to the other one, which frees them.
+	- cross-thread free: every thread allocates a batch of blocks, and then
+	  frees the batch its neighbour allocated.
+	Each test is run for 1 up to the given number of threads, and the number
+	of allocations per second is printed.
+*/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+static const int32 kDefaultIterations = 1000000;
+static const int32 kChurnBlocks = 16;
+static const int32 kBatchSize = 256;
+static const int32 kQueueSize = 1024;
+static const size_t kMaxBlockSize = 256;
+static const int32 kMaxThreads = 64;
+
+
+struct shared_queue {
+	void*				slots[kQueueSize];
+	sem_id				filled;
+	sem_id				empty;
+	int32				head;
+	int32				tail;
+};
+
+
+struct test_data {
+	int32				index;
+	int32				thread_count;
+	int32				iterations;
+	shared_queue*		queues;
+	void**				batches;
+	pthread_barrier_t*	barrier;
+	status_t			error;
+};
+
+
+typedef status_t (*test_function)(test_data* data);
+
+
+static inline size_t
+random_size(uint32& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % kMaxBlockSize + 1;
+}
+
+
+static status_t
+churn_test(test_data* data)
+{
+	void* blocks[kChurnBlocks];
+	uint32 seed = data->index;
+
+	for (int32 i = 0; i < data->iterations; i += kChurnBlocks) {
+		for (int32 j = 0; j < kChurnBlocks; j++) {
+			blocks[j] = malloc(random_size(seed));
+			if (blocks[j] == NULL)
+				return B_NO_MEMORY;
+
+			*(uint8*)blocks[j] = 1;
+		}
+
+		for (int32 j = 0; j < kChurnBlocks; j++)
+			free(blocks[j]);
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+producer_consumer_test(test_data* data)
+{
+	shared_queue* queue = &data->queues[data->index / 2];
+	bool producer = (data->index & 1) == 0;
+	uint32 seed = data->index;
+
+	for (int32 i = 0; i < data->iterations; i++) {
+		if (producer) {
+			void* block = malloc(random_size(seed));
+			if (block == NULL)
+				return B_NO_MEMORY;
+
+			*(uint8*)block = 1;
+
+			acquire_sem(queue->empty);
+			queue->slots[queue->head] = block;
+			queue->head = (queue->head + 1) % kQueueSize;
+			release_sem_etc(queue->filled, 1, B_DO_NOT_RESCHEDULE);
+		} else {
+			acquire_sem(queue->filled);
+			void* block = queue->slots[queue->tail];
+			queue->tail = (queue->tail + 1) % kQueueSize;
+			release_sem_etc(queue->empty, 1, B_DO_NOT_RESCHEDULE);
+
+			free(block);
+		}
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+cross_thread_free_test(test_data* data)
+{
+	void** ownBatch = &data->batches[data->index * kBatchSize];
+	int32 neighbour = (data->index + 1) % data->thread_count;
+	void** neighbourBatch = &data->batches[neighbour * kBatchSize];
+	uint32 seed = data->index;
+
+	for (int32 i = 0; i < data->iterations; i += kBatchSize) {
+		for (int32 j = 0; j < kBatchSize; j++) {
+			ownBatch[j] = malloc(random_size(seed));
+			if (ownBatch[j] == NULL)
+				return B_NO_MEMORY;
+
+			*(uint8*)ownBatch[j] = 1;
+		}
+
+		pthread_barrier_wait(data->barrier);
+
+		for (int32 j = 0; j < kBatchSize; j++)
+			free(neighbourBatch[j]);
+
+		pthread_barrier_wait(data->barrier);
+	}
+
+	return B_OK;
+}
+
+
+struct thread_args {
+	test_function		function;
+	test_data*			data;
+};
+
+
+static void*
+test_thread(void* _args)
+{
+	thread_args* args = (thread_args*)_args;
+	args->data->error = args->function(args->data);
+	return NULL;
+}
+
+
+static double
+run_test(test_function function, int32 threadCount, int32 iterations)
+{
+	pthread_t threads[kMaxThreads];
+	test_data data[kMaxThreads];
+	thread_args args[kMaxThreads];
+	shared_queue* queues = new shared_queue[kMaxThreads / 2];
+	void** batches = new void*[kMaxThreads * kBatchSize];
+
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, threadCount);
+
+	for (int32 i = 0; i < threadCount / 2; i++) {
+		queues[i].filled = create_sem(0, "queue filled");
+		queues[i].empty = create_sem(kQueueSize, "queue empty");
+		queues[i].head = 0;
+		queues[i].tail = 0;
+	}
+
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].index = i;
+		data[i].thread_count = threadCount;
+		data[i].iterations = iterations;
+		data[i].queues = queues;
+		data[i].batches = batches;
+		data[i].barrier = &barrier;
+		data[i].error = B_OK;
+
+		args[i].function = function;
+		args[i].data = &data[i];
+
+		if (pthread_create(&threads[i], NULL, &test_thread, &args[i]) != 0) {
+			fprintf(stderr, "Failed to create thread\n");
+			exit(1);
+		}
+	}
+
+	for (int32 i = 0; i < threadCount; i++)
+		pthread_join(threads[i], NULL);
+
+	bigtime_t elapsed = system_time() - startTime;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		if (data[i].error != B_OK) {
+			fprintf(stderr, "Test failed: %s\n", strerror(data[i].error));
+			exit(1);
+		}
+	}
+
+	for (int32 i = 0; i < threadCount / 2; i++) {
+		delete_sem(queues[i].filled);
+		delete_sem(queues[i].empty);
+	}
+
+	pthread_barrier_destroy(&barrier);
+	delete[] batches;
+	delete[] queues;
+
+	// producer/consumer threads only allocate half of the time
+	int64 allocations = (int64)iterations * threadCount;
+	if (function == &producer_consumer_test)
+		allocations /= 2;
+
+	return allocations * 1000000.0 / elapsed;
+}
+
+
+static void
+run_tests(const char* name, test_function function, int32 minThreads,
+	int32 threadStep, int32 maxThreads, int32 iterations)
+{
+	printf("%s\nthreads  allocs/s       per thread\n", name);
+
+	for (int32 threadCount = minThreads; threadCount <= maxThreads;
+			threadCount += threadStep) {
+		double rate = run_test(function, threadCount, iterations);
+		printf("%7" B_PRId32 "  %12.0f  %11.0f\n", threadCount, rate,
+			rate / threadCount);
+	}
+
+	putchar('\n');
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 iterations = kDefaultIterations;
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (iterations < kBatchSize)
+		iterations = kBatchSize;
+
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = info.cpu_count;
+	if (argc > 2)
+		maxThreads = atoi(argv[2]);
+	if (maxThreads < 1 || maxThreads > kMaxThreads)
+		maxThreads = min_c(info.cpu_count, kMaxThreads);
+
+	run_tests("churn", &churn_test, 1, 1, maxThreads, iterations);
+	run_tests("producer/consumer", &producer_consumer_test, 2, 2,
+		max_c(maxThreads, 2), iterations);
+	run_tests("cross-thread free", &cross_thread_free_test, 1, 1, maxThreads,
+		iterations);
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the throughput of the string and memory functions for a range
+	of sizes. Like string_test, it only uses POSIX functions, so that it can
+	be built on the host as well.
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+static const size_t kSizes[] = { 8, 16, 32, 64, 128, 256, 1024, 4096, 65536 };
+static const size_t kMaxSize = 65536;
+static const size_t kBytesPerTest = 256 * 1024 * 1024;
+
+static uint8_t sFirst[kMaxSize + 64];
+static uint8_t sSecond[kMaxSize + 64];
+static volatile size_t sSink;
+
+
+enum {
+	TEST_MEMCPY,
+	TEST_MEMMOVE,
+	TEST_MEMSET,
+	TEST_MEMCHR,
+	TEST_MEMCMP,
+	TEST_STRLEN,
+	TEST_STRCHR,
+	TEST_STRCMP,
+	TEST_COUNT
+};
+
+static const char* const kTestNames[] = {
+	"memcpy", "memmove", "memset", "memchr", "memcmp", "strlen", "strchr",
+	"strcmp"
+};
+
+
+static double
+current_time()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1000000000.0;
+}
+
+
+static void
+prepare(size_t size)
+{
+	memset(sFirst, 'a', sizeof(sFirst));
+	memset(sSecond, 'a', sizeof(sSecond));
+
+	// terminate the strings, so that the whole size is scanned
+	sFirst[size] = '\0';
+	sSecond[size] = '\0';
+}
+
+
+static size_t
+run(int test, size_t size, size_t iterations)
+{
+	size_t result = 0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		switch (test) {
+			case TEST_MEMCPY:
+				memcpy(sFirst, sSecond, size);
+				break;
+			case TEST_MEMMOVE:
+				memmove(sFirst + 1, sFirst, size);
+				break;
+			case TEST_MEMSET:
+				memset(sFirst, (int)i, size);
+				break;
+			case TEST_MEMCHR:
+				result += memchr(sFirst, 'b', size) != NULL;
+				break;
+			case TEST_MEMCMP:
+				result += memcmp(sFirst, sSecond, size);
+				break;
+			case TEST_STRLEN:
+				result += strlen((char*)sFirst);
+				break;
+			case TEST_STRCHR:
+				result += strchr((char*)sFirst, 'b') != NULL;
+				break;
+			case TEST_STRCMP:
+				result += strcmp((char*)sFirst, (char*)sSecond);
+				break;
+		}
+	}
+
+	return result;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	printf("%-8s", "size");
+	for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++)
+		printf(" %8zu", kSizes[i]);
+	printf("\n(MB/s)\n");
+
+	for (int test = 0; test < TEST_COUNT; test++) {
+		if (argc > 1 && strcmp(argv[1], kTestNames[test]) != 0)
+			continue;
+
+		printf("%-8s", kTestNames[test]);
+
+		for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+			size_t size = kSizes[i];
+			size_t iterations = kBytesPerTest / size;
+
+			prepare(size);
+
+			double startTime = current_time();
+			sSink = run(test, size, iterations);
+			double elapsed = current_time() - startTime;
+
+			printf(" %8.0f", kBytesPerTest / elapsed / (1024 * 1024));
+			fflush(stdout);
+		}
+
+		putchar('\n');
+	}
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2018, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Checks the string and memory functions against simple reference
+	implementations for all combinations of alignments and lengths up to a
+	certain size. The strings and buffers are placed right in front of an
+	inaccessible page, so that reading beyond their end is caught as well.
+
+	The test only uses POSIX functions, so that the architecture specific
+	implementations can also be checked on the host, e.g.:
+		g++ -std=gnu++11 -O2 -fno-builtin string_test.cpp \
+			src/system/libroot/posix/string/arch/x86_64/arch_string.cpp
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+static const size_t kMaxLength = 300;
+static const size_t kMaxAlignment = 32;
+static const int kMaxDistance = 40;
+
+static int sFailures = 0;
+
+
+#define CHECK(condition, format...) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: ", __FUNCTION__, __LINE__); \
+			fprintf(stderr, format); \
+			fputc('\n', stderr); \
+			if (++sFailures > 20) \
+				exit(1); \
+		} \
+	} while (false)
+
+
+static int
+sign(int value)
+{
+	return value < 0 ? -1 : (value > 0 ? 1 : 0);
+}
+
+
+static int
+reference_memcmp(const uint8_t* first, const uint8_t* second, size_t length)
+{
+	for (size_t i = 0; i < length; i++) {
+		if (first[i] != second[i])
+			return first[i] - second[i];
+	}
+	return 0;
+}
+
+
+static int
+reference_strcmp(const uint8_t* first, const uint8_t* second)
+{
+	while (*first == *second && *first != '\0') {
+		first++;
+		second++;
+	}
+	return *first - *second;
+}
+
+
+static void
+test_search(uint8_t* pageEnd)
+{
+	for (size_t length = 0; length < kMaxLength; length++) {
+		for (size_t alignment = 0; alignment < kMaxAlignment; alignment++) {
+			// the terminating null byte is the last accessible byte
+			char* string = (char*)pageEnd - alignment - length - 1;
+			memset(string, 'a', length);
+			string[length] = '\0';
+
+			CHECK(strlen(string) == length, "length %zu, alignment %zu",
+				length, alignment);
+			CHECK(strchr(string, 'b') == NULL, "length %zu, alignment %zu",
+				length, alignment);
+			CHECK(strchr(string, '\0') == string + length,
+				"length %zu, alignment %zu", length, alignment);
+			CHECK(memchr(string, 'b', length) == NULL,
+				"length %zu, alignment %zu", length, alignment);
+
+			for (size_t position = 0; position < length; position++) {
+				string[position] = 'b';
+
+				CHECK(strchr(string, 'b') == string + position,
+					"length %zu, alignment %zu, position %zu", length,
+					alignment, position);
+				CHECK(memchr(string, 'b', length) == string + position,
+					"length %zu, alignment %zu, position %zu", length,
+					alignment, position);
+				CHECK(memchr(string, 'b', position) == NULL,
+					"length %zu, alignment %zu, position %zu", length,
+					alignment, position);
+
+				string[position] = 'a';
+			}
+		}
+	}
+}
+
+
+static void
+test_compare(uint8_t* pageEnd, uint8_t* buffer)
+{
+	for (size_t length = 0; length < kMaxLength; length++) {
+		for (size_t alignment = 0; alignment < kMaxAlignment; alignment++) {
+			uint8_t* first = pageEnd - alignment - length - 1;
+			uint8_t* second = buffer + (alignment * 7) % kMaxAlignment;
+			memset(first, 'a', length);
+			first[length] = '\0';
+			memset(second, 'a', length);
+			second[length] = '\0';
+
+			CHECK(strcmp((char*)first, (char*)second) == 0,
+				"length %zu, alignment %zu", length, alignment);
+			CHECK(memcmp(first, second, length) == 0,
+				"length %zu, alignment %zu", length, alignment);
+
+			for (size_t position = 0; position < length; position++) {
+				static const uint8_t kValues[] = { 'b', 0x80, 0xff, '\0' };
+				for (size_t i = 0; i < sizeof(kValues); i++) {
+					second[position] = kValues[i];
+
+					CHECK(sign(strcmp((char*)first, (char*)second))
+							== sign(reference_strcmp(first, second)),
+						"length %zu, alignment %zu, position %zu", length,
+						alignment, position);
+					CHECK(sign(strcmp((char*)second, (char*)first))
+							== sign(reference_strcmp(second, first)),
+						"length %zu, alignment %zu, position %zu", length,
+						alignment, position);
+					CHECK(sign(memcmp(first, second, length))
+							== sign(reference_memcmp(first, second, length)),
+						"length %zu, alignment %zu, position %zu", length,
+						alignment, position);
+				}
+
+				second[position] = 'a';
+			}
+		}
+	}
+}
+
+
+static void
+test_copy()
+{
+	static const size_t kBufferSize = kMaxLength + 4 * kMaxDistance
+		+ 2 * kMaxAlignment;
+	uint8_t buffer[kBufferSize];
+	uint8_t expected[kBufferSize];
+
+	for (size_t length = 0; length < kMaxLength; length++) {
+		for (size_t alignment = 0; alignment < kMaxAlignment; alignment++) {
+			for (int distance = -kMaxDistance; distance <= kMaxDistance;
+					distance++) {
+				size_t from = 2 * kMaxDistance + alignment;
+				size_t to = from + distance;
+
+				for (size_t i = 0; i < kBufferSize; i++)
+					buffer[i] = expected[i] = (uint8_t)(i * 7 + 1);
+				for (size_t i = 0; i < length; i++)
+					expected[to + i] = (uint8_t)((from + i) * 7 + 1);
+
+				CHECK(memmove(buffer + to, buffer + from, length)
+						== buffer + to,
+					"length %zu, alignment %zu, distance %d", length,
+					alignment, distance);
+				CHECK(reference_memcmp(buffer, expected, kBufferSize) == 0,
+					"length %zu, alignment %zu, distance %d", length,
+					alignment, distance);
+
+				if (distance <= -(int)length || distance >= (int)length) {
+					for (size_t i = 0; i < kBufferSize; i++)
+						buffer[i] = (uint8_t)(i * 7 + 1);
+					memcpy(buffer + to, buffer + from, length);
+					CHECK(reference_memcmp(buffer, expected, kBufferSize)
+							== 0,
+						"length %zu, alignment %zu, distance %d", length,
+						alignment, distance);
+				}
+			}
+		}
+	}
+}
+
+
+int
+main()
+{
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	uint8_t* pages = (uint8_t*)mmap(NULL, 3 * pageSize,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	// make the last page inaccessible
+	uint8_t* pageEnd = pages + 2 * pageSize;
+	if (mprotect(pageEnd, pageSize, PROT_NONE) != 0) {
+		perror("mprotect");
+		return 1;
+	}
+
+	test_search(pageEnd);
+	test_compare(pageEnd, pages);
+	test_copy();
+
+	munmap(pages, 3 * pageSize);
+
+	if (sFailures > 0) {
+		printf("%d checks failed.\n", sFailures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -53,6 +53,10 @@ static	const char* const*	sArgv;
 static mode_t sUmask = 0022;
 
 
+// in src/tests/system/kernel/cache/block_cache_contention_test.cpp
+fssh_status_t command_cachebench(int argc, const char* const* argv);
+
+
 static fssh_status_t
 init_kernel()
 {
@@ -1211,6 +1215,7 @@ static void
 register_commands()
 {
 	CommandManager::Default()->AddCommands(
+		command_cachebench,	"cachebench",	"measure block cache contention",
 		command_cd,			"cd",			"change current directory",
 		command_chmod,		"chmod",		"change file permissions",
 		command_cp,			"cp",			"copy files and directories",
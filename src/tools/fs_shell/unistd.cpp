@@ -420,6 +420,13 @@ fssh_write_pos(int fd, fssh_off_t pos, const void *buffer, fssh_size_t count)
 }
 
 
+int
+fssh_ftruncate(int fd, fssh_off_t newSize)
+{
+	return ftruncate(fd, newSize);
+}
+
+
 // fssh_lseek() -- implemented in partition_support.cpp
 
 
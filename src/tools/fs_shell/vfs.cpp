@@ -2294,6 +2294,15 @@ fssh_entry_cache_remove(fssh_dev_t mountID, fssh_ino_t dirID, const char* name)
 }
 
 
+extern "C" fssh_status_t
+fssh_entry_cache_add_complete_directory(fssh_dev_t mountID, fssh_ino_t dirID,
+	const char* const* names, const fssh_ino_t* nodeIDs, int32_t count)
+{
+	// We don't implement an entry cache in the FS shell.
+	return FSSH_B_OK;
+}
+
+
 //	#pragma mark - private VFS API
 //	Functions the VFS exports for other parts of the kernel
 